@@ -590,5 +590,6 @@ const cairo_perf_case_t perf_cases[] = {
     { FUNC(wave), 500, 500 },
     { FUNC(fill_clip), 16, 512 },
     { FUNC(tiger), 16, 1024 },
+    { FUNC(blackbox), 1024, 1024 },
     { NULL }
 };
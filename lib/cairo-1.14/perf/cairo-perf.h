@@ -246,5 +246,6 @@ CAIRO_PERF_DECL (a1_pixel);
 CAIRO_PERF_DECL (sierpinski);
 CAIRO_PERF_DECL (fill_clip);
 CAIRO_PERF_DECL (tiger);
+CAIRO_PERF_DECL (blackbox);
 
 #endif
@@ -0,0 +1,294 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* The shapes that blackbox_render draws for every frame of a flight log
+ * video, with the same sizes, line widths and dash patterns (see
+ * src/blackbox_render.c at the top of this repository).
+ */
+
+#include "cairo-perf.h"
+
+/* Points in each graph line, about what a 1920 pixel wide window covers */
+#define POLYLINE_POINTS 8192
+
+#define NUM_MOTORS 4
+#define NUM_BLADES 2
+
+#define STICK_TRAIL_LENGTH 30
+
+static const double DASHED_LINE[] = { 20.0, 5.0 };
+static const double DOTTED_LINE[] = { 5.0, 5.0 };
+
+/* FONTSIZE_CURRENT_VALUE_LABEL, _PID_TABLE_LABEL, _AXIS_LABEL and _FRAME_LABEL */
+static const double LABEL_FONT_SIZES[] = { 36, 34, 34, 32 };
+
+static uint32_t state;
+
+static double
+uniform_random (double minval, double maxval)
+{
+    static uint32_t const poly = 0x9a795537U;
+    uint32_t n = 32;
+    while (n-->0)
+	state = 2*state < state ? (2*state ^ poly) : 2*state;
+    return minval + state * (maxval - minval) / 4294967296.0;
+}
+
+/* A noisy x-monotone line across the whole width, like a gyro or motor trace */
+static void
+polyline_path (cairo_t *cr, int width, int height)
+{
+    double y = height / 2.;
+    int i;
+
+    state = 0xc0ffee;
+
+    cairo_new_path (cr);
+    for (i = 0; i < POLYLINE_POINTS; i++) {
+	double x = (double) i * width / (POLYLINE_POINTS - 1);
+
+	y += uniform_random (-height / 40., height / 40.);
+	if (y < 0)
+	    y = 0;
+	else if (y > height)
+	    y = height;
+
+	if (i == 0)
+	    cairo_move_to (cr, x, y);
+	else
+	    cairo_line_to (cr, x, y);
+    }
+}
+
+static cairo_time_t
+stroke_polyline (cairo_t *cr, int width, int height, int loops)
+{
+    polyline_path (cr, width, height);
+
+    cairo_perf_timer_start ();
+
+    while (loops--)
+	cairo_stroke_preserve (cr);
+
+    cairo_perf_timer_stop ();
+
+    cairo_new_path (cr);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_blackbox_motor_line (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_set_line_width (cr, 2.5);
+
+    return stroke_polyline (cr, width, height, loops);
+}
+
+static cairo_time_t
+do_blackbox_pid_line (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_set_line_width (cr, 2.);
+
+    return stroke_polyline (cr, width, height, loops);
+}
+
+static cairo_time_t
+do_blackbox_pid_dashed (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_time_t elapsed;
+
+    cairo_save (cr);
+    cairo_set_line_width (cr, 2.);
+    cairo_set_dash (cr, DASHED_LINE, ARRAY_LENGTH (DASHED_LINE), 0);
+
+    elapsed = stroke_polyline (cr, width, height, loops);
+
+    cairo_restore (cr);
+
+    return elapsed;
+}
+
+static cairo_time_t
+do_blackbox_pid_dotted (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_time_t elapsed;
+
+    cairo_save (cr);
+    cairo_set_line_width (cr, 2.);
+    cairo_set_dash (cr, DOTTED_LINE, ARRAY_LENGTH (DOTTED_LINE), 0);
+
+    elapsed = stroke_polyline (cr, width, height, loops);
+
+    cairo_restore (cr);
+
+    return elapsed;
+}
+
+/* The spinning props of the craft: a filled pair of bezier blades per motor */
+static cairo_time_t
+do_blackbox_propellers (cairo_t *cr, int width, int height, int loops)
+{
+    double blade_length = MIN (width, height) / 6.;
+    double tip_bezier_width = 0.2 * blade_length;
+    double tip_bezier_height = 0.1 * blade_length;
+    double angle = 0;
+    int motor, blade;
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	for (motor = 0; motor < NUM_MOTORS; motor++) {
+	    cairo_save (cr);
+
+	    cairo_translate (cr,
+			     width * (motor % 2 ? .75 : .25),
+			     height * (motor / 2 ? .75 : .25));
+	    cairo_rotate (cr, angle + motor);
+
+	    cairo_move_to (cr, 0, 0);
+	    for (blade = 0; blade < NUM_BLADES; blade++) {
+		cairo_curve_to (cr,
+				tip_bezier_width, -tip_bezier_height,
+				tip_bezier_width, blade_length + tip_bezier_height,
+				0, blade_length);
+		cairo_curve_to (cr,
+				-tip_bezier_width, blade_length + tip_bezier_height,
+				-tip_bezier_width, -tip_bezier_height,
+				0, 0);
+		cairo_rotate (cr, M_PI * 2 / NUM_BLADES);
+	    }
+	    cairo_fill (cr);
+
+	    cairo_restore (cr);
+	}
+
+	angle += 0.1;
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+/* The fading trail of circles behind both stick positions, each filled on its own */
+static cairo_time_t
+do_blackbox_stick_trail (cairo_t *cr, int width, int height, int loops)
+{
+    double surround_radius = MIN (width / 2., height) / 2.;
+    double radius = surround_radius / 5.;
+    double trail[2][STICK_TRAIL_LENGTH][2];
+    int stick, i;
+
+    state = 0xc0ffee;
+
+    for (stick = 0; stick < 2; stick++) {
+	double x = 0, y = 0;
+
+	for (i = 0; i < STICK_TRAIL_LENGTH; i++) {
+	    x = MAX (-surround_radius, MIN (surround_radius, x + uniform_random (-radius, radius)));
+	    y = MAX (-surround_radius, MIN (surround_radius, y + uniform_random (-radius, radius)));
+	    trail[stick][i][0] = x;
+	    trail[stick][i][1] = y;
+	}
+    }
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	for (stick = 0; stick < 2; stick++) {
+	    double centre_x = width * (stick ? .75 : .25);
+	    double centre_y = height / 2.;
+
+	    for (i = 0; i < STICK_TRAIL_LENGTH; i++) {
+		cairo_set_source_rgba (cr, 1., 1., 1.,
+				       (double) i / (STICK_TRAIL_LENGTH + 1));
+		cairo_arc (cr,
+			   centre_x + trail[stick][i][0],
+			   centre_y + trail[stick][i][1],
+			   radius, 0, 2 * M_PI);
+		cairo_fill (cr);
+	    }
+	}
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+/* Short numeric labels, measured and then drawn, at each of our font sizes */
+static cairo_time_t
+do_blackbox_labels (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_text_extents_t extents;
+    char label[16];
+    int value = -500;
+    int size;
+    double y;
+
+    cairo_select_font_face (cr, "Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	for (size = 0; size < ARRAY_LENGTH (LABEL_FONT_SIZES); size++) {
+	    cairo_set_font_size (cr, LABEL_FONT_SIZES[size]);
+
+	    for (y = LABEL_FONT_SIZES[size]; y < height; y += 2 * LABEL_FONT_SIZES[size]) {
+		snprintf (label, sizeof (label), "%d", value);
+		value = value < 2000 ? value + 37 : -500;
+
+		cairo_text_extents (cr, label, &extents);
+		cairo_move_to (cr, (width - extents.width) / 2, y);
+		cairo_show_text (cr, label);
+	    }
+	}
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+cairo_bool_t
+blackbox_enabled (cairo_perf_t *perf)
+{
+    return cairo_perf_can_run (perf, "blackbox", NULL);
+}
+
+void
+blackbox (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+    cairo_set_source_rgb (cr, 1., 1., 1.);
+
+    cairo_perf_run (perf, "blackbox-motor-line", do_blackbox_motor_line, NULL);
+    cairo_perf_run (perf, "blackbox-pid-line", do_blackbox_pid_line, NULL);
+    cairo_perf_run (perf, "blackbox-pid-dashed", do_blackbox_pid_dashed, NULL);
+    cairo_perf_run (perf, "blackbox-pid-dotted", do_blackbox_pid_dotted, NULL);
+    cairo_perf_run (perf, "blackbox-propellers", do_blackbox_propellers, NULL);
+    cairo_perf_run (perf, "blackbox-stick-trail", do_blackbox_stick_trail, NULL);
+    cairo_perf_run (perf, "blackbox-labels", do_blackbox_labels, NULL);
+}
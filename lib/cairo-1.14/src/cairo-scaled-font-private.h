@@ -68,9 +68,10 @@ struct _cairo_scaled_font {
      * 1. The reference count (scaled_font->ref_count)
      *
      *    Modifications to the reference count are protected by the
-     *    _cairo_scaled_font_map_mutex. This is because the reference
-     *    count of a scaled font is intimately related with the font
-     *    map itself, (and the magic holdovers array).
+     *    _cairo_scaled_font_map_mutex (or the mutex of the per-thread
+     *    font map the font was created in). This is because the
+     *    reference count of a scaled font is intimately related with
+     *    the font map itself, (and the magic holdovers array).
      *
      * 2. The cache of glyphs (scaled_font->glyphs)
      * 3. The backend private data (scaled_font->surface_backend,
@@ -119,6 +120,9 @@ struct _cairo_scaled_font {
     /* font backend managing this scaled font */
     const cairo_scaled_font_backend_t *backend;
     cairo_list_t link;
+
+    /* per-thread font map holding this font, or NULL for the global map */
+    struct _cairo_scaled_font_map *font_map;
 };
 
 struct _cairo_scaled_font_private {
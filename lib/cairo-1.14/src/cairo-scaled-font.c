@@ -358,6 +358,22 @@ typedef struct _cairo_scaled_font_map {
     cairo_hash_table_t *hash_table;
     cairo_scaled_font_t *holdovers[CAIRO_SCALED_FONT_MAX_HOLDOVERS];
     int num_holdovers;
+
+    /* The mutex protecting this map: _cairo_scaled_font_map_mutex for
+     * the global map, or thread_mutex for a per-thread map. */
+    cairo_mutex_t *mutex;
+
+    /* Per-thread maps (see cairo_scaled_font_set_per_thread_caches())
+     * also have their own glyph page cache. A font keeps using the map
+     * that created it even when other threads draw with it, so the map
+     * outlives its thread until num_fonts (the number of its fonts not
+     * yet finished) drops to zero. */
+    cairo_bool_t per_thread;
+    cairo_bool_t orphaned;
+    int num_fonts;
+    cairo_mutex_t thread_mutex;
+    cairo_mutex_t thread_page_cache_mutex;
+    cairo_cache_t thread_page_cache;
 } cairo_scaled_font_map_t;
 
 static cairo_scaled_font_map_t *cairo_scaled_font_map;
@@ -366,7 +382,12 @@ static int
 _cairo_scaled_font_keys_equal (const void *abstract_key_a, const void *abstract_key_b);
 
 static cairo_scaled_font_map_t *
-_cairo_scaled_font_map_lock (void)
+_cairo_scaled_font_thread_map (cairo_bool_t create);
+
+static cairo_bool_t cairo_scaled_font_per_thread_caches;
+
+static cairo_scaled_font_map_t *
+_cairo_scaled_font_global_map_lock (void)
 {
     CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
 
@@ -383,6 +404,10 @@ _cairo_scaled_font_map_lock (void)
 	    goto CLEANUP_SCALED_FONT_MAP;
 
 	cairo_scaled_font_map->num_holdovers = 0;
+	cairo_scaled_font_map->mutex = &_cairo_scaled_font_map_mutex;
+	cairo_scaled_font_map->per_thread = FALSE;
+	cairo_scaled_font_map->orphaned = FALSE;
+	cairo_scaled_font_map->num_fonts = 0;
     }
 
     return cairo_scaled_font_map;
@@ -396,10 +421,118 @@ _cairo_scaled_font_map_lock (void)
     return NULL;
 }
 
+/* Lock and return the map that new fonts should be created in: the
+ * calling thread's own map when per-thread caches are enabled. */
+static cairo_scaled_font_map_t *
+_cairo_scaled_font_map_lock (void)
+{
+    if (cairo_scaled_font_per_thread_caches) {
+	cairo_scaled_font_map_t *font_map = _cairo_scaled_font_thread_map (TRUE);
+
+	if (font_map != NULL) {
+	    CAIRO_MUTEX_LOCK (font_map->thread_mutex);
+	    return font_map;
+	}
+    }
+
+    return _cairo_scaled_font_global_map_lock ();
+}
+
+static void
+_cairo_scaled_font_map_unlock (cairo_scaled_font_map_t *font_map)
+{
+   CAIRO_MUTEX_UNLOCK (*font_map->mutex);
+}
+
+/* The map which the calling thread has locked with
+ * _cairo_scaled_font_map_lock() (for the placeholder functions, which
+ * are called from inside a backend's scaled_font_create). */
+static cairo_scaled_font_map_t *
+_cairo_scaled_font_map_current (void)
+{
+    cairo_scaled_font_map_t *font_map = NULL;
+
+    if (cairo_scaled_font_per_thread_caches)
+	font_map = _cairo_scaled_font_thread_map (FALSE);
+
+    return font_map != NULL ? font_map : cairo_scaled_font_map;
+}
+
+/* Lock the map which the font was added to (or the global map, for
+ * fonts which were never added to a map) */
+static cairo_scaled_font_map_t *
+_cairo_scaled_font_owner_map_lock (cairo_scaled_font_t *scaled_font)
+{
+    cairo_scaled_font_map_t *font_map = scaled_font->font_map;
+
+    if (font_map == NULL)
+	return _cairo_scaled_font_global_map_lock ();
+
+    CAIRO_MUTEX_LOCK (*font_map->mutex);
+    return font_map;
+}
+
+/* Record which map a new font belongs to, if it isn't the global one */
 static void
-_cairo_scaled_font_map_unlock (void)
+_cairo_scaled_font_map_insert_font (cairo_scaled_font_map_t *font_map,
+				    cairo_scaled_font_t *scaled_font)
 {
-   CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+    if (font_map->per_thread) {
+	scaled_font->font_map = font_map;
+	font_map->num_fonts++;
+    }
+}
+
+/* Return the glyph page cache used by the font, and its mutex */
+static cairo_cache_t *
+_cairo_scaled_font_page_cache (cairo_scaled_font_t *scaled_font,
+			       cairo_mutex_t **mutex)
+{
+    cairo_scaled_font_map_t *font_map = scaled_font->font_map;
+
+    if (font_map != NULL) {
+	*mutex = &font_map->thread_page_cache_mutex;
+	return &font_map->thread_page_cache;
+    }
+
+    *mutex = &_cairo_scaled_glyph_page_cache_mutex;
+    return &cairo_scaled_glyph_page_cache;
+}
+
+static void
+_cairo_scaled_font_thread_map_free (cairo_scaled_font_map_t *font_map)
+{
+    _cairo_hash_table_destroy (font_map->hash_table);
+
+    if (font_map->thread_page_cache.hash_table != NULL)
+	_cairo_cache_fini (&font_map->thread_page_cache);
+
+    CAIRO_MUTEX_FINI (font_map->thread_page_cache_mutex);
+    CAIRO_MUTEX_FINI (font_map->thread_mutex);
+
+    free (font_map);
+}
+
+/* Finish and free a font which has been removed from its map (or was
+ * never added to one), without holding any lock. */
+static void
+_cairo_scaled_font_free (cairo_scaled_font_t *scaled_font)
+{
+    cairo_scaled_font_map_t *font_map = scaled_font->font_map;
+    cairo_bool_t free_map;
+
+    _cairo_scaled_font_fini_internal (scaled_font);
+    free (scaled_font);
+
+    if (font_map == NULL)
+	return;
+
+    CAIRO_MUTEX_LOCK (font_map->thread_mutex);
+    free_map = --font_map->num_fonts == 0 && font_map->orphaned;
+    CAIRO_MUTEX_UNLOCK (font_map->thread_mutex);
+
+    if (free_map)
+	_cairo_scaled_font_thread_map_free (font_map);
 }
 
 void
@@ -436,7 +569,9 @@ _cairo_scaled_font_map_destroy (void)
 	 * recursive deadlock when the scaled font destroy closure gets
 	 * called
 	 */
-	_cairo_scaled_font_fini (scaled_font);
+	CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+	_cairo_scaled_font_fini_internal (scaled_font);
+	CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
 
 	free (scaled_font);
     }
@@ -450,6 +585,214 @@ _cairo_scaled_font_map_destroy (void)
     CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
 }
 
+/* Called when the thread owning a per-thread map exits. The cached
+ * fonts are dropped now, but fonts the thread handed to others keep
+ * the map alive until they are destroyed. */
+static void
+_cairo_scaled_font_thread_map_release (cairo_scaled_font_map_t *font_map)
+{
+    cairo_scaled_font_t *holdovers[CAIRO_SCALED_FONT_MAX_HOLDOVERS];
+    cairo_scaled_font_t *mru;
+    cairo_bool_t free_map;
+    int num_holdovers, i;
+
+    CAIRO_MUTEX_LOCK (font_map->thread_mutex);
+
+    font_map->orphaned = TRUE;
+
+    mru = font_map->mru_scaled_font;
+    font_map->mru_scaled_font = NULL;
+
+    num_holdovers = font_map->num_holdovers;
+    for (i = 0; i < num_holdovers; i++) {
+	holdovers[i] = font_map->holdovers[i];
+	holdovers[i]->holdover = FALSE;
+	_cairo_hash_table_remove (font_map->hash_table,
+				  &holdovers[i]->hash_entry);
+    }
+    font_map->num_holdovers = 0;
+
+    /* Nothing can be added to the map once it is orphaned, so if it has
+     * no fonts left nobody else can be holding on to it. */
+    free_map = font_map->num_fonts == 0;
+
+    CAIRO_MUTEX_UNLOCK (font_map->thread_mutex);
+
+    if (free_map) {
+	_cairo_scaled_font_thread_map_free (font_map);
+	return;
+    }
+
+    for (i = 0; i < num_holdovers; i++)
+	_cairo_scaled_font_free (holdovers[i]);
+
+    /* This may be the map's last font, and free it */
+    cairo_scaled_font_destroy (mru);
+}
+
+#if CAIRO_MUTEX_IMPL_PTHREAD
+
+static pthread_key_t cairo_scaled_font_map_key;
+
+static void
+_cairo_scaled_font_thread_map_key_destroy (void *font_map)
+{
+    _cairo_scaled_font_thread_map_release (font_map);
+}
+
+static cairo_bool_t
+_cairo_scaled_font_thread_map_key_create (void)
+{
+    return pthread_key_create (&cairo_scaled_font_map_key,
+			       _cairo_scaled_font_thread_map_key_destroy) == 0;
+}
+
+#define _cairo_scaled_font_thread_map_get() \
+    ((cairo_scaled_font_map_t *) pthread_getspecific (cairo_scaled_font_map_key))
+#define _cairo_scaled_font_thread_map_set(font_map) \
+    (pthread_setspecific (cairo_scaled_font_map_key, (font_map)) == 0)
+
+#define CAIRO_SCALED_FONT_HAS_THREAD_MAPS 1
+
+#elif CAIRO_MUTEX_IMPL_WIN32
+
+/* Threads only release their maps through DllMain, so static builds
+ * leak a map (and the fonts cached in it) for each thread that exits. */
+
+static DWORD cairo_scaled_font_map_key = TLS_OUT_OF_INDEXES;
+
+static cairo_bool_t
+_cairo_scaled_font_thread_map_key_create (void)
+{
+    cairo_scaled_font_map_key = TlsAlloc ();
+
+    return cairo_scaled_font_map_key != TLS_OUT_OF_INDEXES;
+}
+
+#define _cairo_scaled_font_thread_map_get() \
+    ((cairo_scaled_font_map_t *) TlsGetValue (cairo_scaled_font_map_key))
+#define _cairo_scaled_font_thread_map_set(font_map) \
+    (TlsSetValue (cairo_scaled_font_map_key, (font_map)) != 0)
+
+#define CAIRO_SCALED_FONT_HAS_THREAD_MAPS 1
+
+void
+_cairo_scaled_font_thread_map_release_current (void)
+{
+    cairo_scaled_font_map_t *font_map;
+
+    if (cairo_scaled_font_map_key == TLS_OUT_OF_INDEXES)
+	return;
+
+    font_map = _cairo_scaled_font_thread_map_get ();
+    if (font_map != NULL) {
+	TlsSetValue (cairo_scaled_font_map_key, NULL);
+	_cairo_scaled_font_thread_map_release (font_map);
+    }
+}
+
+#else
+
+#define CAIRO_SCALED_FONT_HAS_THREAD_MAPS 0
+
+#endif
+
+#if CAIRO_SCALED_FONT_HAS_THREAD_MAPS
+
+static cairo_bool_t cairo_scaled_font_map_key_created;
+
+static cairo_scaled_font_map_t *
+_cairo_scaled_font_thread_map (cairo_bool_t create)
+{
+    cairo_scaled_font_map_t *font_map;
+
+    font_map = _cairo_scaled_font_thread_map_get ();
+    if (font_map != NULL || ! create)
+	return font_map;
+
+    font_map = malloc (sizeof (cairo_scaled_font_map_t));
+    if (unlikely (font_map == NULL))
+	return NULL;
+
+    font_map->hash_table =
+	_cairo_hash_table_create (_cairo_scaled_font_keys_equal);
+    if (unlikely (font_map->hash_table == NULL)) {
+	free (font_map);
+	return NULL;
+    }
+
+    font_map->mru_scaled_font = NULL;
+    font_map->num_holdovers = 0;
+    font_map->mutex = &font_map->thread_mutex;
+    font_map->per_thread = TRUE;
+    font_map->orphaned = FALSE;
+    font_map->num_fonts = 0;
+    font_map->thread_page_cache.hash_table = NULL;
+    CAIRO_MUTEX_INIT (font_map->thread_mutex);
+    CAIRO_MUTEX_INIT (font_map->thread_page_cache_mutex);
+
+    if (unlikely (! _cairo_scaled_font_thread_map_set (font_map))) {
+	_cairo_scaled_font_thread_map_free (font_map);
+	return NULL;
+    }
+
+    return font_map;
+}
+
+#else
+
+static cairo_scaled_font_map_t *
+_cairo_scaled_font_thread_map (cairo_bool_t create)
+{
+    (void) create;
+
+    return NULL;
+}
+
+#endif
+
+/**
+ * cairo_scaled_font_set_per_thread_caches:
+ * @enabled: whether each thread should cache scaled fonts separately
+ *
+ * By default all threads share one cache of scaled fonts and one cache
+ * of glyphs, behind a global lock, which serialises threads that draw
+ * text at the same time. When per-thread caches are enabled, the scaled
+ * fonts a thread creates (and the glyphs rendered for them) are cached
+ * by that thread alone, so threads drawing text only contend when they
+ * share a #cairo_scaled_font_t. Each thread's caches are freed when it
+ * exits.
+ *
+ * This costs memory, and fonts are no longer shared between threads
+ * unless the application passes them around itself. It should be set
+ * before any thread draws text.
+ *
+ * Return value: %TRUE if per-thread caches are supported on this
+ * platform (otherwise the shared caches continue to be used).
+ *
+ * Since: 1.14
+ **/
+cairo_bool_t
+cairo_scaled_font_set_per_thread_caches (cairo_bool_t enabled)
+{
+#if CAIRO_SCALED_FONT_HAS_THREAD_MAPS
+    CAIRO_MUTEX_INITIALIZE ();
+
+    CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
+    if (enabled && ! cairo_scaled_font_map_key_created)
+	cairo_scaled_font_map_key_created = _cairo_scaled_font_thread_map_key_create ();
+
+    cairo_scaled_font_per_thread_caches = enabled && cairo_scaled_font_map_key_created;
+    CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+
+    return cairo_scaled_font_map_key_created;
+#else
+    (void) enabled;
+
+    return FALSE;
+#endif
+}
+
 static void
 _cairo_scaled_glyph_page_destroy (cairo_scaled_font_t *scaled_font,
 				  cairo_scaled_glyph_page_t *page)
@@ -503,10 +846,11 @@ _cairo_scaled_glyph_page_pluck (void *closure)
 cairo_status_t
 _cairo_scaled_font_register_placeholder_and_unlock_font_map (cairo_scaled_font_t *scaled_font)
 {
+    cairo_scaled_font_map_t *font_map = _cairo_scaled_font_map_current ();
     cairo_status_t status;
     cairo_scaled_font_t *placeholder_scaled_font;
 
-    assert (CAIRO_MUTEX_IS_LOCKED (_cairo_scaled_font_map_mutex));
+    assert (CAIRO_MUTEX_IS_LOCKED (*font_map->mutex));
 
     status = scaled_font->status;
     if (unlikely (status))
@@ -530,12 +874,12 @@ _cairo_scaled_font_register_placeholder_and_unlock_font_map (cairo_scaled_font_t
 
     placeholder_scaled_font->hash_entry.hash
 	= _cairo_scaled_font_compute_hash (placeholder_scaled_font);
-    status = _cairo_hash_table_insert (cairo_scaled_font_map->hash_table,
+    status = _cairo_hash_table_insert (font_map->hash_table,
 				       &placeholder_scaled_font->hash_entry);
     if (unlikely (status))
 	goto FINI_PLACEHOLDER;
 
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_UNLOCK (*font_map->mutex);
     CAIRO_MUTEX_LOCK (placeholder_scaled_font->mutex);
 
     return CAIRO_STATUS_SUCCESS;
@@ -551,39 +895,41 @@ _cairo_scaled_font_register_placeholder_and_unlock_font_map (cairo_scaled_font_t
 void
 _cairo_scaled_font_unregister_placeholder_and_lock_font_map (cairo_scaled_font_t *scaled_font)
 {
+    cairo_scaled_font_map_t *font_map = _cairo_scaled_font_map_current ();
     cairo_scaled_font_t *placeholder_scaled_font;
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_LOCK (*font_map->mutex);
 
     /* temporary hash value to match the placeholder */
     scaled_font->hash_entry.hash
 	= _cairo_scaled_font_compute_hash (scaled_font);
     placeholder_scaled_font =
-	_cairo_hash_table_lookup (cairo_scaled_font_map->hash_table,
+	_cairo_hash_table_lookup (font_map->hash_table,
 				  &scaled_font->hash_entry);
     assert (placeholder_scaled_font != NULL);
     assert (placeholder_scaled_font->placeholder);
     assert (CAIRO_MUTEX_IS_LOCKED (placeholder_scaled_font->mutex));
 
-    _cairo_hash_table_remove (cairo_scaled_font_map->hash_table,
+    _cairo_hash_table_remove (font_map->hash_table,
 			      &placeholder_scaled_font->hash_entry);
 
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_UNLOCK (*font_map->mutex);
 
     CAIRO_MUTEX_UNLOCK (placeholder_scaled_font->mutex);
     cairo_scaled_font_destroy (placeholder_scaled_font);
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_LOCK (*font_map->mutex);
 }
 
 static void
-_cairo_scaled_font_placeholder_wait_for_creation_to_finish (cairo_scaled_font_t *placeholder_scaled_font)
+_cairo_scaled_font_placeholder_wait_for_creation_to_finish (cairo_scaled_font_map_t *font_map,
+							    cairo_scaled_font_t *placeholder_scaled_font)
 {
     /* reference the place holder so it doesn't go away */
     cairo_scaled_font_reference (placeholder_scaled_font);
 
     /* now unlock the fontmap mutex so creation has a chance to finish */
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_UNLOCK (*font_map->mutex);
 
     /* wait on placeholder mutex until we are awaken */
     CAIRO_MUTEX_LOCK (placeholder_scaled_font->mutex);
@@ -592,7 +938,7 @@ _cairo_scaled_font_placeholder_wait_for_creation_to_finish (cairo_scaled_font_t
     CAIRO_MUTEX_UNLOCK (placeholder_scaled_font->mutex);
     cairo_scaled_font_destroy (placeholder_scaled_font);
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_LOCK (*font_map->mutex);
 }
 
 /* Fowler / Noll / Vo (FNV) Hash (http://www.isthe.com/chongo/tech/comp/fnv/)
@@ -785,6 +1131,7 @@ _cairo_scaled_font_init (cairo_scaled_font_t               *scaled_font,
 
     scaled_font->backend = backend;
     cairo_list_init (&scaled_font->link);
+    scaled_font->font_map = NULL;
 
     return CAIRO_STATUS_SUCCESS;
 }
@@ -805,9 +1152,13 @@ _cairo_scaled_font_thaw_cache (cairo_scaled_font_t *scaled_font)
     assert (scaled_font->cache_frozen);
 
     if (scaled_font->global_cache_frozen) {
-	CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-	_cairo_cache_thaw (&cairo_scaled_glyph_page_cache);
-	CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+	cairo_mutex_t *page_cache_mutex;
+	cairo_cache_t *page_cache =
+	    _cairo_scaled_font_page_cache (scaled_font, &page_cache_mutex);
+
+	CAIRO_MUTEX_LOCK (*page_cache_mutex);
+	_cairo_cache_thaw (page_cache);
+	CAIRO_MUTEX_UNLOCK (*page_cache_mutex);
 	scaled_font->global_cache_frozen = FALSE;
     }
 
@@ -818,23 +1169,27 @@ _cairo_scaled_font_thaw_cache (cairo_scaled_font_t *scaled_font)
 void
 _cairo_scaled_font_reset_cache (cairo_scaled_font_t *scaled_font)
 {
+    cairo_mutex_t *page_cache_mutex;
+    cairo_cache_t *page_cache =
+	_cairo_scaled_font_page_cache (scaled_font, &page_cache_mutex);
+
     CAIRO_MUTEX_LOCK (scaled_font->mutex);
     assert (! scaled_font->cache_frozen);
     assert (! scaled_font->global_cache_frozen);
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    CAIRO_MUTEX_LOCK (*page_cache_mutex);
     while (! cairo_list_is_empty (&scaled_font->glyph_pages)) {
 	cairo_scaled_glyph_page_t *page =
 	    cairo_list_first_entry (&scaled_font->glyph_pages,
 				    cairo_scaled_glyph_page_t,
 				    link);
 
-	cairo_scaled_glyph_page_cache.size -= page->cache_entry.size;
-	_cairo_hash_table_remove (cairo_scaled_glyph_page_cache.hash_table,
+	page_cache->size -= page->cache_entry.size;
+	_cairo_hash_table_remove (page_cache->hash_table,
 				  (cairo_hash_entry_t *) &page->cache_entry);
 
 	_cairo_scaled_glyph_page_destroy (scaled_font, page);
     }
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    CAIRO_MUTEX_UNLOCK (*page_cache_mutex);
     CAIRO_MUTEX_UNLOCK (scaled_font->mutex);
 }
 
@@ -899,11 +1254,16 @@ _cairo_scaled_font_fini_internal (cairo_scaled_font_t *scaled_font)
 void
 _cairo_scaled_font_fini (cairo_scaled_font_t *scaled_font)
 {
+    cairo_scaled_font_map_t *font_map = scaled_font->font_map;
+
+    if (font_map == NULL)
+	font_map = _cairo_scaled_font_map_current ();
+
     /* Release the lock to avoid the possibility of a recursive
      * deadlock when the scaled font destroy closure gets called. */
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_UNLOCK (*font_map->mutex);
     _cairo_scaled_font_fini_internal (scaled_font);
-    CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
+    CAIRO_MUTEX_LOCK (*font_map->mutex);
 }
 
 void
@@ -1040,7 +1400,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 	     * must modify the reference count while our lock is still
 	     * held. */
 	    _cairo_reference_count_inc (&scaled_font->ref_count);
-	    _cairo_scaled_font_map_unlock ();
+	    _cairo_scaled_font_map_unlock (font_map);
 	    return scaled_font;
 	}
 
@@ -1062,7 +1422,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 
 	/* If the scaled font is being created (happens for user-font),
 	 * just wait until it's done, then retry */
-	_cairo_scaled_font_placeholder_wait_for_creation_to_finish (scaled_font);
+	_cairo_scaled_font_placeholder_wait_for_creation_to_finish (font_map, scaled_font);
     }
 
     if (scaled_font != NULL) {
@@ -1104,7 +1464,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 	    _cairo_reference_count_inc (&scaled_font->ref_count);
 	    /* and increment for the returned reference */
 	    _cairo_reference_count_inc (&scaled_font->ref_count);
-	    _cairo_scaled_font_map_unlock ();
+	    _cairo_scaled_font_map_unlock (font_map);
 
 	    cairo_scaled_font_destroy (old);
 	    if (font_face != original_font_face)
@@ -1127,7 +1487,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 							    ctm,
 							    options);
 	if (unlikely (font_face->status)) {
-	    _cairo_scaled_font_map_unlock ();
+	    _cairo_scaled_font_map_unlock (font_map);
 	    return _cairo_scaled_font_create_in_error (font_face->status);
 	}
     }
@@ -1136,7 +1496,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 						     ctm, options, &scaled_font);
     /* Did we leave the backend in an error state? */
     if (unlikely (status)) {
-	_cairo_scaled_font_map_unlock ();
+	_cairo_scaled_font_map_unlock (font_map);
 	if (font_face != original_font_face)
 	    cairo_font_face_destroy (font_face);
 
@@ -1148,7 +1508,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
     }
     /* Or did we encounter an error whilst constructing the scaled font? */
     if (unlikely (scaled_font->status)) {
-	_cairo_scaled_font_map_unlock ();
+	_cairo_scaled_font_map_unlock (font_map);
 	if (font_face != original_font_face)
 	    cairo_font_face_destroy (font_face);
 
@@ -1174,12 +1534,13 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
     status = _cairo_hash_table_insert (font_map->hash_table,
 				       &scaled_font->hash_entry);
     if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	_cairo_scaled_font_map_insert_font (font_map, scaled_font);
 	old = font_map->mru_scaled_font;
 	font_map->mru_scaled_font = scaled_font;
 	_cairo_reference_count_inc (&scaled_font->ref_count);
     }
 
-    _cairo_scaled_font_map_unlock ();
+    _cairo_scaled_font_map_unlock (font_map);
 
     cairo_scaled_font_destroy (old);
     if (font_face != original_font_face)
@@ -1317,7 +1678,7 @@ cairo_scaled_font_destroy (cairo_scaled_font_t *scaled_font)
     assert (! scaled_font->cache_frozen);
     assert (! scaled_font->global_cache_frozen);
 
-    font_map = _cairo_scaled_font_map_lock ();
+    font_map = _cairo_scaled_font_owner_map_lock (scaled_font);
     assert (font_map != NULL);
 
     /* Another thread may have resurrected the font whilst we waited */
@@ -1329,6 +1690,14 @@ cairo_scaled_font_destroy (cairo_scaled_font_t *scaled_font)
 	    if (scaled_font->holdover)
 		goto unlock;
 
+	    /* Nothing will look the font up again once its thread has gone */
+	    if (font_map->orphaned) {
+		_cairo_hash_table_remove (font_map->hash_table,
+					  &scaled_font->hash_entry);
+		lru = scaled_font;
+		goto unlock;
+	    }
+
 	    /* Rather than immediately destroying this object, we put it into
 	     * the font_map->holdovers array in case it will get used again
 	     * soon (and is why we must hold the lock over the atomic op on
@@ -1356,7 +1725,7 @@ cairo_scaled_font_destroy (cairo_scaled_font_t *scaled_font)
     }
 
   unlock:
-    _cairo_scaled_font_map_unlock ();
+    _cairo_scaled_font_map_unlock (font_map);
 
     /* If we pulled an item from the holdovers array, (while the font
      * map lock was held, of course), then there is no way that anyone
@@ -1364,10 +1733,8 @@ cairo_scaled_font_destroy (cairo_scaled_font_t *scaled_font)
      * safely call fini on it without any lock held. This is desirable
      * as we never want to call into any backend function with a lock
      * held. */
-    if (lru != NULL) {
-	_cairo_scaled_font_fini_internal (lru);
-	free (lru);
-    }
+    if (lru != NULL)
+	_cairo_scaled_font_free (lru);
 }
 slim_hidden_def (cairo_scaled_font_destroy);
 
@@ -2833,6 +3200,8 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
 				   cairo_scaled_glyph_t **scaled_glyph)
 {
     cairo_scaled_glyph_page_t *page;
+    cairo_cache_t *page_cache;
+    cairo_mutex_t *page_cache_mutex;
     cairo_status_t status;
 
     assert (scaled_font->cache_frozen);
@@ -2856,28 +3225,30 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
     page->cache_entry.size = 1; /* XXX occupancy weighting? */
     page->num_glyphs = 0;
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    page_cache = _cairo_scaled_font_page_cache (scaled_font, &page_cache_mutex);
+
+    CAIRO_MUTEX_LOCK (*page_cache_mutex);
     if (scaled_font->global_cache_frozen == FALSE) {
-	if (unlikely (cairo_scaled_glyph_page_cache.hash_table == NULL)) {
-	    status = _cairo_cache_init (&cairo_scaled_glyph_page_cache,
+	if (unlikely (page_cache->hash_table == NULL)) {
+	    status = _cairo_cache_init (page_cache,
 					NULL,
 					_cairo_scaled_glyph_page_can_remove,
 					_cairo_scaled_glyph_page_pluck,
 					MAX_GLYPH_PAGES_CACHED);
 	    if (unlikely (status)) {
-		CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+		CAIRO_MUTEX_UNLOCK (*page_cache_mutex);
 		free (page);
 		return status;
 	    }
 	}
 
-	_cairo_cache_freeze (&cairo_scaled_glyph_page_cache);
+	_cairo_cache_freeze (page_cache);
 	scaled_font->global_cache_frozen = TRUE;
     }
 
-    status = _cairo_cache_insert (&cairo_scaled_glyph_page_cache,
+    status = _cairo_cache_insert (page_cache,
 				  &page->cache_entry);
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    CAIRO_MUTEX_UNLOCK (*page_cache_mutex);
     if (unlikely (status)) {
 	free (page);
 	return status;
@@ -2904,14 +3275,18 @@ _cairo_scaled_font_free_last_glyph (cairo_scaled_font_t *scaled_font,
     _cairo_scaled_glyph_fini (scaled_font, scaled_glyph);
 
     if (--page->num_glyphs == 0) {
-	CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+	cairo_mutex_t *page_cache_mutex;
+	cairo_cache_t *page_cache =
+	    _cairo_scaled_font_page_cache (scaled_font, &page_cache_mutex);
+
+	CAIRO_MUTEX_LOCK (*page_cache_mutex);
 	/* Temporarily disconnect callback to avoid recursive locking */
-	cairo_scaled_glyph_page_cache.entry_destroy = NULL;
-	_cairo_cache_remove (&cairo_scaled_glyph_page_cache,
+	page_cache->entry_destroy = NULL;
+	_cairo_cache_remove (page_cache,
 		             &page->cache_entry);
 	_cairo_scaled_glyph_page_destroy (scaled_font, page);
-	cairo_scaled_glyph_page_cache.entry_destroy = _cairo_scaled_glyph_page_pluck;
-	CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+	page_cache->entry_destroy = _cairo_scaled_glyph_page_pluck;
+	CAIRO_MUTEX_UNLOCK (*page_cache_mutex);
     }
 }
 
@@ -1587,6 +1587,9 @@ cairo_scaled_font_status (cairo_scaled_font_t *scaled_font);
 cairo_public cairo_font_type_t
 cairo_scaled_font_get_type (cairo_scaled_font_t *scaled_font);
 
+cairo_public cairo_bool_t
+cairo_scaled_font_set_per_thread_caches (cairo_bool_t enabled);
+
 cairo_public void *
 cairo_scaled_font_get_user_data (cairo_scaled_font_t         *scaled_font,
 				 const cairo_user_data_key_t *key);
@@ -1255,6 +1255,9 @@ _cairo_scaled_font_get_max_scale (cairo_scaled_font_t *scaled_font);
 cairo_private void
 _cairo_scaled_font_map_destroy (void);
 
+cairo_private void
+_cairo_scaled_font_thread_map_release_current (void);
+
 /* cairo-stroke-style.c */
 
 cairo_private void
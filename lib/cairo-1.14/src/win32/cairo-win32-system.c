@@ -77,6 +77,10 @@ DllMain (HINSTANCE hinstDLL,
             CAIRO_MUTEX_INITIALIZE ();
             break;
 
+        case DLL_THREAD_DETACH:
+            _cairo_scaled_font_thread_map_release_current ();
+            break;
+
         case DLL_PROCESS_DETACH:
             CAIRO_MUTEX_FINALIZE ();
             break;
@@ -544,6 +544,7 @@ extern void _register_xlib_expose_event (void);
 extern void _register_zero_alpha (void);
 extern void _register_zero_mask (void);
 extern void _register_pthread_same_source (void);
+extern void _register_pthread_shared_scaled_font (void);
 extern void _register_pthread_show_text (void);
 extern void _register_pthread_similar (void);
 extern void _register_bitmap_font (void);
@@ -1112,6 +1113,7 @@ _cairo_test_runner_register_tests (void)
     _register_zero_alpha ();
     _register_zero_mask ();
     _register_pthread_same_source ();
+    _register_pthread_shared_scaled_font ();
     _register_pthread_show_text ();
     _register_pthread_similar ();
     _register_bitmap_font ();
@@ -0,0 +1,186 @@
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Threads drawing text at the same time with per-thread scaled font
+ * caches (cairo_scaled_font_set_per_thread_caches()): each thread shows
+ * text both with one scaled font shared between them all, and with fonts
+ * it selects itself (which land in its own font map). Every thread must
+ * draw the same image, and the fonts created by threads must survive
+ * those threads exiting.
+ */
+
+#include "cairo-test.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#define N_THREADS 8
+#define NUM_ITERATIONS 40
+
+#define WIDTH 400
+#define HEIGHT 84
+
+static void *
+draw_thread (void *arg)
+{
+    const char *text = "Hello world. ";
+    cairo_scaled_font_t *shared_font = arg;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    int i;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cr = cairo_create (surface);
+    cairo_surface_destroy (surface);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+
+    cairo_set_scaled_font (cr, shared_font);
+    for (i = 0; i < NUM_ITERATIONS; i++) {
+	cairo_move_to (cr, 1 + i * 9, HEIGHT / 2 - 4);
+	cairo_show_text (cr, "0123456789");
+    }
+
+    cairo_move_to (cr, 1, HEIGHT - 4);
+    for (i = 0; i < NUM_ITERATIONS; i++) {
+	char buf[2];
+
+	cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+				CAIRO_FONT_SLANT_NORMAL,
+				CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size (cr, i);
+
+	buf[0] = text[i%strlen(text)];
+	buf[1] = '\0';
+	cairo_show_text (cr, buf);
+    }
+
+    surface = cairo_surface_reference (cairo_get_target (cr));
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_bool_t
+surfaces_equal (cairo_surface_t *a, cairo_surface_t *b)
+{
+    int stride = cairo_image_surface_get_stride (a);
+    const unsigned char *data_a, *data_b;
+    int y;
+
+    cairo_surface_flush (a);
+    cairo_surface_flush (b);
+
+    data_a = cairo_image_surface_get_data (a);
+    data_b = cairo_image_surface_get_data (b);
+
+    for (y = 0; y < HEIGHT; y++) {
+	if (memcmp (data_a + y * stride, data_b + y * stride, WIDTH * 4))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    pthread_t threads[N_THREADS];
+    cairo_surface_t *surfaces[N_THREADS];
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_font_face_t *font_face;
+    cairo_scaled_font_t *shared_font;
+    cairo_font_options_t *options;
+    cairo_matrix_t font_matrix, ctm;
+    int num_threads, i;
+
+    if (! cairo_scaled_font_set_per_thread_caches (TRUE))
+	cairo_test_log (ctx, "Per-thread caches unsupported, threads share the global caches\n");
+
+    font_face = cairo_toy_font_face_create (CAIRO_TEST_FONT_FAMILY " Sans",
+					    CAIRO_FONT_SLANT_NORMAL,
+					    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_matrix_init_scale (&font_matrix, 16, 16);
+    cairo_matrix_init_identity (&ctm);
+    options = cairo_font_options_create ();
+    shared_font = cairo_scaled_font_create (font_face, &font_matrix, &ctm, options);
+    cairo_font_options_destroy (options);
+    cairo_font_face_destroy (font_face);
+
+    for (num_threads = 0; num_threads < N_THREADS; num_threads++) {
+	if (pthread_create (&threads[num_threads], NULL, draw_thread, shared_font) != 0) {
+	    cairo_test_log (ctx, "Failed to create thread %d\n", num_threads);
+	    status = CAIRO_TEST_FAILURE;
+	    break;
+	}
+    }
+
+    for (i = 0; i < num_threads; i++) {
+	void *surface;
+
+	if (pthread_join (threads[i], &surface) == 0) {
+	    surfaces[i] = surface;
+	} else {
+	    surfaces[i] = NULL;
+	    status = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    /* Every thread has exited, so the fonts they created now belong to
+     * orphaned font maps */
+    for (i = 0; i < num_threads; i++) {
+	if (surfaces[i] == NULL)
+	    continue;
+
+	if (cairo_surface_status (surfaces[i])) {
+	    cairo_test_log (ctx, "Thread %d finished with %s\n", i,
+			    cairo_status_to_string (cairo_surface_status (surfaces[i])));
+	    status = CAIRO_TEST_FAILURE;
+	} else if (surfaces[0] != NULL && ! surfaces_equal (surfaces[0], surfaces[i])) {
+	    cairo_test_log (ctx, "Thread %d drew different text to thread 0\n", i);
+	    status = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    for (i = 0; i < num_threads; i++)
+	cairo_surface_destroy (surfaces[i]);
+
+    if (cairo_scaled_font_status (shared_font)) {
+	cairo_test_log (ctx, "Shared scaled font finished with %s\n",
+			cairo_status_to_string (cairo_scaled_font_status (shared_font)));
+	status = CAIRO_TEST_FAILURE;
+    }
+    cairo_scaled_font_destroy (shared_font);
+
+    cairo_scaled_font_set_per_thread_caches (FALSE);
+
+    return status;
+}
+
+CAIRO_TEST (pthread_shared_scaled_font,
+	    "Concurrent cairo_show_text() with per-thread scaled font caches.",
+	    "thread, text", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+//For msvcrt to define M_PI:
+#define _USE_MATH_DEFINES
+
+#include <math.h>
+
+#include "platform.h"
+#include "tools.h"
+#include "attitude.h"
+
+/*
+ * The complementary filter only remembers its starting estimate for a few thousand frames (the gravity estimate keeps
+ * 600/601 of itself each frame, the magnetometer estimate 250/251), so a log can be split into segments which are
+ * filtered independently, each starting warmupFrames before its segment.
+ *
+ * Without a magnetometer the heading is pure gyro integration and never forgets its starting point, so in that case
+ * each segment's heading is relative to where the segment began.
+ */
+
+typedef struct attitudeTask_t {
+    datapoints_t *points;
+    const attitudeFields_t *fields;
+    const attitudeSettings_t *settings;
+
+    // The filter runs from warmupFrame and stores the attitude for frames [firstFrame...lastFrame)
+    int warmupFrame, firstFrame, lastFrame;
+
+    semaphore_t *done;
+} attitudeTask_t;
+
+static void updateAttitudeAtIndex(imuState_t *state, datapoints_t *points, const attitudeFields_t *fields,
+    const attitudeSettings_t *settings, int frameIndex, attitude_t *attitude)
+{
+    const int64_t *frame = points->frames + (size_t) frameIndex * points->fieldCount;
+    int16_t gyroADC[3], accSmooth[3], magADC[3];
+    bool hasMag = fields->magADC[0] != -1;
+
+    for (int axis = 0; axis < 3; axis++) {
+        gyroADC[axis] = (int16_t) frame[fields->gyroADC[axis]];
+        accSmooth[axis] = (int16_t) frame[fields->accSmooth[axis]];
+        magADC[axis] = hasMag ? (int16_t) frame[fields->magADC[axis]] : 0;
+    }
+
+    imuStateUpdateAttitude(state, gyroADC, accSmooth, hasMag ? magADC : NULL, (uint32_t) points->frameTime[frameIndex],
+        settings->acc_1G, settings->gyroScale, attitude);
+}
+
+static void* attitudeWorkerThread(void *arg)
+{
+    attitudeTask_t *task = (attitudeTask_t *) arg;
+    datapoints_t *points = task->points;
+    imuState_t state;
+    attitude_t attitude;
+
+    imuStateInit(&state, task->settings->fastMath);
+
+    for (int frameIndex = task->warmupFrame; frameIndex < task->lastFrame; frameIndex++) {
+        updateAttitudeAtIndex(&state, points, task->fields, task->settings, frameIndex, &attitude);
+
+        if (frameIndex >= task->firstFrame) {
+            datapointsSetFieldAtIndex(points, frameIndex, task->fields->roll, floatToInt(attitude.roll));
+            datapointsSetFieldAtIndex(points, frameIndex, task->fields->pitch, floatToInt(attitude.pitch));
+            datapointsSetFieldAtIndex(points, frameIndex, task->fields->heading, floatToInt(attitude.heading));
+        }
+    }
+
+    semaphore_signal(task->done);
+
+    return 0;
+}
+
+/**
+ * Compute the attitude for every frame of the log, with the log divided into one segment per thread. With a single
+ * thread (or a log too short to be worth splitting) this is exactly the sequential calculation.
+ */
+void attitudeCompute(datapoints_t *points, const attitudeFields_t *fields, const attitudeSettings_t *settings, int threads)
+{
+    attitudeTask_t *tasks;
+    semaphore_t done;
+    int warmupFrames = settings->warmupFrames > 0 ? settings->warmupFrames : 0;
+
+    // Don't spend longer warming up each segment than filtering it
+    if (warmupFrames > 0 && threads > points->frameCount / warmupFrames)
+        threads = points->frameCount / warmupFrames;
+
+    if (threads < 1)
+        threads = 1;
+
+    semaphore_create(&done, 0);
+
+    tasks = malloc(threads * sizeof(*tasks));
+
+    for (int i = 0; i < threads; i++) {
+        attitudeTask_t *task = &tasks[i];
+
+        task->points = points;
+        task->fields = fields;
+        task->settings = settings;
+        task->firstFrame = (int) ((int64_t) points->frameCount * i / threads);
+        task->lastFrame = (int) ((int64_t) points->frameCount * (i + 1) / threads);
+        task->warmupFrame = task->firstFrame > warmupFrames ? task->firstFrame - warmupFrames : 0;
+        task->done = &done;
+
+        thread_create_detached(attitudeWorkerThread, task);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        semaphore_wait(&done);
+    }
+
+    semaphore_destroy(&done);
+
+    free(tasks);
+}
+
+static double angleDifference(float a, float b)
+{
+    double difference = fabs((double) a - b);
+
+    // Roll and heading wrap around at 2 pi
+    return fmin(difference, 2 * M_PI - difference);
+}
+
+/**
+ * Run the filter sequentially over the whole log and find the largest difference on each axis between its result and
+ * the attitude stored by attitudeCompute().
+ */
+void attitudeMaxDivergence(datapoints_t *points, const attitudeFields_t *fields, const attitudeSettings_t *settings, attitude_t *divergence)
+{
+    imuState_t state;
+    attitude_t attitude;
+    int64_t stored;
+
+    divergence->roll = divergence->pitch = divergence->heading = 0;
+
+    imuStateInit(&state, settings->fastMath);
+
+    for (int frameIndex = 0; frameIndex < points->frameCount; frameIndex++) {
+        updateAttitudeAtIndex(&state, points, fields, settings, frameIndex, &attitude);
+
+        datapointsGetFieldAtIndex(points, frameIndex, fields->roll, &stored);
+        divergence->roll = fmax(divergence->roll, angleDifference(attitude.roll, intToFloat((int32_t) stored)));
+
+        datapointsGetFieldAtIndex(points, frameIndex, fields->pitch, &stored);
+        divergence->pitch = fmax(divergence->pitch, angleDifference(attitude.pitch, intToFloat((int32_t) stored)));
+
+        datapointsGetFieldAtIndex(points, frameIndex, fields->heading, &stored);
+        divergence->heading = fmax(divergence->heading, angleDifference(attitude.heading, intToFloat((int32_t) stored)));
+    }
+}
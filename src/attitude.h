@@ -0,0 +1,34 @@
+#ifndef ATTITUDE_H_
+#define ATTITUDE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "datapoints.h"
+#include "imu.h"
+
+/*
+ * Where the IMU inputs are read from and where the computed attitude is stored (as floatToInt()-packed radians).
+ * Set magADC[0] to -1 if the log has no magnetometer.
+ */
+typedef struct attitudeFields_t {
+    int gyroADC[3], accSmooth[3], magADC[3];
+    int roll, pitch, heading;
+} attitudeFields_t;
+
+typedef struct attitudeSettings_t {
+    uint16_t acc_1G;
+    float gyroScale;
+    bool fastMath;
+
+    /*
+     * Frames run through the filter before the start of each segment (and then discarded) so that it has forgotten
+     * its initial state by the time it reaches the segment.
+     */
+    int warmupFrames;
+} attitudeSettings_t;
+
+void attitudeCompute(datapoints_t *points, const attitudeFields_t *fields, const attitudeSettings_t *settings, int threads);
+void attitudeMaxDivergence(datapoints_t *points, const attitudeFields_t *fields, const attitudeSettings_t *settings, attitude_t *divergence);
+
+#endif
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #ifdef WIN32
     #include "getopt.h"
@@ -32,16 +33,34 @@
 #include "battery.h"
 #include "units.h"
 #include "stats.h"
+#include "stepresponse.h"
+#include "rowfilter.h"
+#include "resample.h"
+#include "profile.h"
+#include "decodecache.h"
+#include "compressedfile.h"
 
 #define MIN_GPS_SATELLITES 5
 
 typedef struct decodeOptions_t {
-    int help, raw, limits, debug, toStdout;
+    int help, raw, limits, debug, toStdout, fieldCosts, profile;
     int logNumber;
-    int simulateIMU, imuIgnoreMag;
+    int simulateIMU, imuIgnoreMag, imuFast;
     int simulateCurrentMeter;
     int mergeGPS;
+    int stepResponse;
+    int threads;
     const char *outputPrefix;
+    const char *where;
+    const char *profileJSONFilename;
+    int contextBefore, contextAfter;
+    double resampleRate;
+    ioBackend_e ioBackend;
+    int ioHugePages;
+    int follow, followTimeout;
+    const char *cacheDir;
+    int inventory;
+    compressionFormat_e compression;
 
     bool overrideSimCurrentMeterOffset, overrideSimCurrentMeterScale;
     int16_t simCurrentMeterOffset, simCurrentMeterScale;
@@ -51,13 +70,25 @@ typedef struct decodeOptions_t {
 } decodeOptions_t;
 
 decodeOptions_t options = {
-    .help = 0, .raw = 0, .limits = 0, .debug = 0, .toStdout = 0,
+    .help = 0, .raw = 0, .limits = 0, .debug = 0, .toStdout = 0, .fieldCosts = 0, .profile = 0,
     .logNumber = -1,
-    .simulateIMU = false, .imuIgnoreMag = 0,
+    .simulateIMU = false, .imuIgnoreMag = 0, .imuFast = 0,
     .simulateCurrentMeter = false,
     .mergeGPS = 0,
+    .stepResponse = 0,
+    .threads = 4,
     .altOffset = 0,
 
+    .where = NULL,
+    .profileJSONFilename = NULL,
+    .contextBefore = 0, .contextAfter = 0,
+    .resampleRate = 0,
+    .ioBackend = IO_BACKEND_AUTO, .ioHugePages = 0,
+    .follow = 0, .followTimeout = 10,
+    .cacheDir = NULL,
+    .inventory = 0,
+    .compression = COMPRESSION_NONE,
+
     .overrideSimCurrentMeterOffset = false,
     .overrideSimCurrentMeterScale = false,
 
@@ -75,6 +106,11 @@ decodeOptions_t options = {
     .unitFlags = UNIT_FLAGS,
 };
 
+static profileProbe_t frameReadyProbe = PROFILE_PROBE_INIT("decode.onFrameReady");
+static profileProbe_t writeRowProbe = PROFILE_PROBE_INIT("decode.writeRow");
+static profileProbe_t writeGPSProbe = PROFILE_PROBE_INIT("decode.writeGPS");
+static profileProbe_t closeFilesProbe = PROFILE_PROBE_INIT("decode.closeFiles");
+
 //We'll use field names to identify GPS field units so the values can be formatted for display
 typedef enum {
     GPS_FIELD_TYPE_INTEGER,
@@ -90,6 +126,15 @@ static int64_t lastFrameTime;
 static uint32_t lastFrameIteration;
 
 static FILE *csvFile = 0, *eventFile = 0, *gpsCsvFile = 0;
+// The statistics we print about each log go here, so they can be saved in the decode cache along with the outputs
+static FILE *statsFile = 0;
+
+// The decode options which affect our output, which are part of each decode cache key
+static char *cacheOptions = NULL;
+static size_t cacheOptionsLength = 0;
+
+// Bump this when the output changes in a way that isn't captured by the decoder's build timestamp
+#define DECODE_CACHE_VERSION 1
 static char *eventFilename = 0, *gpsCsvFilename = 0;
 static gpxWriter_t *gpx = 0;
 
@@ -113,6 +158,51 @@ static int64_t bufferedGPSFrame[FLIGHT_LOG_MAX_FIELDS];
 
 static seriesStats_t looptimeStats;
 
+static stepResponseLog_t *stepResponseLog;
+
+/*
+ * A main frame row which didn't match the --where filter, along with the computed state we need to print it, kept in
+ * case a following row matches and this one needs to be printed as context.
+ */
+typedef struct heldRow_t {
+    int64_t frameTime;
+    uint8_t frameType;
+    int64_t frameOffset;
+    int frameSize;
+
+    int64_t mainFrame[FLIGHT_LOG_MAX_FIELDS];
+    int64_t slowFrame[FLIGHT_LOG_MAX_FIELDS];
+    int64_t gpsFrame[FLIGHT_LOG_MAX_FIELDS];
+
+    attitude_t attitude;
+    currentMeterState_t currentMeterMeasured, currentMeterVirtual;
+} heldRow_t;
+
+static rowFilter_t *rowFilter;
+
+// Ring buffer of the last options.contextBefore rows which didn't match the filter
+static heldRow_t *heldRows;
+static int heldRowCount, heldRowNext;
+
+static int rowsAfterMatchRemaining;
+static uint64_t rowsTested, rowsMatched;
+
+/*
+ * When resampling, output rows lag behind the frames being decoded while the filter waits for the frames that follow
+ * them, so slow and GPS frames are queued up until the output reaches their time.
+ */
+typedef struct pendingFrame_t {
+    int64_t time;
+    uint8_t frameType;
+    int64_t frame[FLIGHT_LOG_MAX_FIELDS];
+} pendingFrame_t;
+
+static resampler_t *resampler;
+static int64_t resampledFrame[FLIGHT_LOG_MAX_FIELDS];
+
+static pendingFrame_t *pendingFrames;
+static int pendingFrameStart, pendingFrameCount, pendingFrameCapacity;
+
 #define ADJUSTMENT_FUNCTION_COUNT 21
 static char *INFLIGHT_ADJUSTMENT_FUNCTIONS[ADJUSTMENT_FUNCTION_COUNT] = {
         "NONE",
@@ -268,6 +358,7 @@ void onEvent(flightLog_t *log, flightLogEvent_t *event)
     // Open the event log if it wasn't open already
     if (!eventFile) {
         if (eventFilename) {
+            remove(eventFilename);
             eventFile = fopen(eventFilename, "wb");
 
             if (!eventFile) {
@@ -333,13 +424,27 @@ void outputFieldNamesHeader(FILE *file, flightLogFrameDef_t *frame, Unit *fieldU
     }
 }
 
+/**
+ * Create a CSV output file, compressed if the user asked for that.
+ */
+static FILE* createCSVFile(const char *filename)
+{
+    remove(filename);
+
+    if (options.compression != COMPRESSION_NONE) {
+        return compressedFileOpen(filename, options.compression, options.threads);
+    }
+
+    return fopen(filename, "wb");
+}
+
 /**
  * Attempt to create a file to log GPS data in CSV format. On success, gpsCsvFile is non-NULL.
  */
 void createGPSCSVFile(flightLog_t *log)
 {
     if (!gpsCsvFile && gpsCsvFilename) {
-        gpsCsvFile = fopen(gpsCsvFilename, "wb");
+        gpsCsvFile = createCSVFile(gpsCsvFilename);
 
         if (gpsCsvFile) {
             // Since the GPS frame itself may or may not include a timestamp field, skip it and print our own:
@@ -476,10 +581,23 @@ float getAltitude(flightLog_t *log, int64_t *frame)
             + options.altOffset; //Change [cm] to [m] for gpx format
 }
 
+void addGPXPoint(flightLog_t *log, int64_t gpsFrameTime, int64_t *frame)
+{
+    // We need at least lat/lon/altitude from the log to write a useful GPX track
+    bool haveRequiredFields = log->gpsFieldIndexes.GPS_coord[0] != -1 && log->gpsFieldIndexes.GPS_coord[1] != -1 && log->gpsFieldIndexes.GPS_altitude != -1;
+    bool haveRequiredPrecision = log->gpsFieldIndexes.GPS_numSat == -1 || frame[log->gpsFieldIndexes.GPS_numSat] >= MIN_GPS_SATELLITES;
+
+    if (haveRequiredFields && haveRequiredPrecision) {
+        gpxWriterAddPoint(gpx, log->dateTime, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], getAltitude(log, frame));
+    }
+}
+
 void outputGPSFrame(flightLog_t *log, int64_t *frame)
 {
     int64_t gpsFrameTime;
 
+    PROFILE_BEGIN(write_gps);
+
     // If we're not logging every loop iteration, we include a timestamp field in the GPS frame:
     if (log->gpsFieldIndexes.time != -1) {
         gpsFrameTime = frame[log->gpsFieldIndexes.time];
@@ -488,12 +606,7 @@ void outputGPSFrame(flightLog_t *log, int64_t *frame)
         gpsFrameTime = lastFrameTime;
     }
 
-	bool haveRequiredFields = log->gpsFieldIndexes.GPS_coord[0] != -1 && log->gpsFieldIndexes.GPS_coord[1] != -1 && log->gpsFieldIndexes.GPS_altitude != -1;
-	bool haveRequiredPrecision = log->gpsFieldIndexes.GPS_numSat == -1 || frame[log->gpsFieldIndexes.GPS_numSat] >= MIN_GPS_SATELLITES;
-
-    if (haveRequiredFields && haveRequiredPrecision) {
-		gpxWriterAddPoint(gpx, log->dateTime, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], getAltitude(log, frame));
-    }
+    addGPXPoint(log, gpsFrameTime, frame);
 
     createGPSCSVFile(log);
 
@@ -505,6 +618,8 @@ void outputGPSFrame(flightLog_t *log, int64_t *frame)
 
         fprintf(gpsCsvFile, "\n");
     }
+
+    PROFILE_END(write_gps, &writeGPSProbe);
 }
 
 void outputSlowFrameFields(flightLog_t *log, int64_t *frame)
@@ -600,13 +715,156 @@ void outputMainFrameFields(flightLog_t *log, int64_t frameTime, int64_t *frame)
     }
 }
 
-void outputMergeFrame(flightLog_t *log)
+void outputMainRow(flightLog_t *log, int64_t frameTime, int64_t *frame, uint8_t frameType, int64_t frameOffset, int frameSize)
+{
+    PROFILE_BEGIN(write_row);
+
+    outputMainFrameFields(log, frameTime, frame);
+
+    if (options.debug) {
+        fprintf(csvFile, ", %c, offset %" PRId64 ", size %d\n", (char) frameType, frameOffset, frameSize);
+    } else {
+        fprintf(csvFile, "\n");
+    }
+
+    PROFILE_END(write_row, &writeRowProbe);
+}
+
+void outputMergeRow(flightLog_t *log, int64_t frameTime, int64_t *frame)
 {
-    outputMainFrameFields(log, bufferedFrameTime, bufferedMainFrame);
+    PROFILE_BEGIN(write_row);
+
+    outputMainFrameFields(log, frameTime, frame);
     fprintf(csvFile, ", ");
     outputGPSFields(log, csvFile, bufferedGPSFrame);
     fprintf(csvFile, "\n");
 
+    PROFILE_END(write_row, &writeRowProbe);
+}
+
+static bool isMergingGPS(flightLog_t *log)
+{
+    return options.mergeGPS && log->frameDefs['G'].fieldCount > 0;
+}
+
+static void captureHeldRow(flightLog_t *log, heldRow_t *row, int64_t frameTime, int64_t *frame, uint8_t frameType, int64_t frameOffset, int frameSize)
+{
+    row->frameTime = frameTime;
+    row->frameType = frameType;
+    row->frameOffset = frameOffset;
+    row->frameSize = frameSize;
+
+    memcpy(row->mainFrame, frame, sizeof(*frame) * log->frameDefs['I'].fieldCount);
+    memcpy(row->slowFrame, bufferedSlowFrame, sizeof(*bufferedSlowFrame) * log->frameDefs['S'].fieldCount);
+
+    if (isMergingGPS(log)) {
+        memcpy(row->gpsFrame, bufferedGPSFrame, sizeof(*bufferedGPSFrame) * log->frameDefs['G'].fieldCount);
+    }
+
+    row->attitude = attitude;
+    row->currentMeterMeasured = currentMeterMeasured;
+    row->currentMeterVirtual = currentMeterVirtual;
+}
+
+/**
+ * Exchange the computed state stored in the held row with our current state, so that the row can be printed by the
+ * regular output routines.
+ */
+static void exchangeHeldRowState(flightLog_t *log, heldRow_t *row)
+{
+    attitude_t tempAttitude;
+    currentMeterState_t tempCurrentMeter;
+    int64_t temp;
+
+    for (int i = 0; i < log->frameDefs['S'].fieldCount; i++) {
+        temp = bufferedSlowFrame[i];
+        bufferedSlowFrame[i] = row->slowFrame[i];
+        row->slowFrame[i] = temp;
+    }
+
+    if (isMergingGPS(log)) {
+        for (int i = 0; i < log->frameDefs['G'].fieldCount; i++) {
+            temp = bufferedGPSFrame[i];
+            bufferedGPSFrame[i] = row->gpsFrame[i];
+            row->gpsFrame[i] = temp;
+        }
+    }
+
+    tempAttitude = attitude;
+    attitude = row->attitude;
+    row->attitude = tempAttitude;
+
+    tempCurrentMeter = currentMeterMeasured;
+    currentMeterMeasured = row->currentMeterMeasured;
+    row->currentMeterMeasured = tempCurrentMeter;
+
+    tempCurrentMeter = currentMeterVirtual;
+    currentMeterVirtual = row->currentMeterVirtual;
+    row->currentMeterVirtual = tempCurrentMeter;
+}
+
+static void outputHeldRow(flightLog_t *log, heldRow_t *row)
+{
+    exchangeHeldRowState(log, row);
+
+    if (isMergingGPS(log)) {
+        outputMergeRow(log, row->frameTime, row->mainFrame);
+    } else {
+        outputMainRow(log, row->frameTime, row->mainFrame, row->frameType, row->frameOffset, row->frameSize);
+    }
+
+    exchangeHeldRowState(log, row);
+}
+
+/**
+ * Test a main frame row against the --where filter, returning true if it should be printed. Rows which don't match
+ * are held back in case one of the next few rows matches and they need to be printed before it as context.
+ */
+bool filterMainRow(flightLog_t *log, int64_t frameTime, int64_t *frame, uint8_t frameType, int64_t frameOffset, int frameSize)
+{
+    if (!rowFilter) {
+        return true;
+    }
+
+    rowsTested++;
+
+    if (rowFilterMatches(rowFilter, frame, bufferedSlowFrame)) {
+        rowsMatched++;
+
+        for (int i = 0; i < heldRowCount; i++) {
+            outputHeldRow(log, &heldRows[(heldRowNext - heldRowCount + i + options.contextBefore) % options.contextBefore]);
+        }
+
+        heldRowCount = 0;
+        rowsAfterMatchRemaining = options.contextAfter;
+
+        return true;
+    }
+
+    if (rowsAfterMatchRemaining > 0) {
+        rowsAfterMatchRemaining--;
+        return true;
+    }
+
+    if (options.contextBefore > 0) {
+        captureHeldRow(log, &heldRows[heldRowNext], frameTime, frame, frameType, frameOffset, frameSize);
+
+        heldRowNext = (heldRowNext + 1) % options.contextBefore;
+
+        if (heldRowCount < options.contextBefore) {
+            heldRowCount++;
+        }
+    }
+
+    return false;
+}
+
+void outputMergeFrame(flightLog_t *log)
+{
+    if (filterMainRow(log, bufferedFrameTime, bufferedMainFrame, 'I', 0, 0)) {
+        outputMergeRow(log, bufferedFrameTime, bufferedMainFrame);
+    }
+
     haveBufferedMainFrame = false;
 }
 
@@ -628,7 +886,7 @@ void updateFrameStatistics(flightLog_t *log, int64_t *frame)
  * We also keep a copy of the GPS frame data so we can print it out multiple times if multiple main frames arrive
  * between GPS updates.
  */
-void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
 {
     int64_t gpsFrameTime;
 
@@ -662,13 +920,7 @@ void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_
 
                 outputMergeFrame(log);
 
-                // We need at least lat/lon/altitude from the log to write a useful GPX track
-				bool haveRequiredFields = log->gpsFieldIndexes.GPS_coord[0] != -1 && log->gpsFieldIndexes.GPS_coord[1] != -1 && log->gpsFieldIndexes.GPS_altitude != -1;
-				bool haveRequiredPrecision = log->gpsFieldIndexes.GPS_numSat == -1 || frame[log->gpsFieldIndexes.GPS_numSat] >= MIN_GPS_SATELLITES;
-
-                if (haveRequiredFields && haveRequiredPrecision) {
-                    gpxWriterAddPoint(gpx, log->dateTime, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], getAltitude(log, frame));
-                }
+                addGPXPoint(log, gpsFrameTime, frame);
             }
         break;
         case 'S':
@@ -715,8 +967,154 @@ void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_
     }
 }
 
-void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+static void queuePendingFrame(uint8_t frameType, int64_t time, int64_t *frame, int fieldCount)
+{
+    pendingFrame_t *pending;
+
+    if (pendingFrameCount == 0) {
+        pendingFrameStart = 0;
+    } else if (pendingFrameStart + pendingFrameCount == pendingFrameCapacity && pendingFrameStart > 0) {
+        memmove(pendingFrames, pendingFrames + pendingFrameStart, pendingFrameCount * sizeof(*pendingFrames));
+        pendingFrameStart = 0;
+    }
+
+    if (pendingFrameStart + pendingFrameCount == pendingFrameCapacity) {
+        pendingFrameCapacity = pendingFrameCapacity ? pendingFrameCapacity * 2 : 16;
+        pendingFrames = realloc(pendingFrames, pendingFrameCapacity * sizeof(*pendingFrames));
+    }
+
+    pending = &pendingFrames[pendingFrameStart + pendingFrameCount];
+
+    pending->time = time;
+    pending->frameType = frameType;
+    memcpy(pending->frame, frame, fieldCount * sizeof(*frame));
+
+    pendingFrameCount++;
+}
+
+/**
+ * Bring the buffered slow and GPS frames up to date for an output row at the given time.
+ */
+static void applyPendingFrames(flightLog_t *log, int64_t time)
+{
+    while (pendingFrameCount > 0 && pendingFrames[pendingFrameStart].time <= time) {
+        pendingFrame_t *pending = &pendingFrames[pendingFrameStart];
+
+        if (pending->frameType == 'S') {
+            memcpy(bufferedSlowFrame, pending->frame, log->frameDefs['S'].fieldCount * sizeof(*pending->frame));
+        } else {
+            memcpy(bufferedGPSFrame, pending->frame, log->frameDefs['G'].fieldCount * sizeof(*pending->frame));
+        }
+
+        pendingFrameStart++;
+        pendingFrameCount--;
+    }
+}
+
+void outputResampledRows(flightLog_t *log)
+{
+    int64_t rowTime;
+
+    while (resamplerGetRow(resampler, &rowTime, resampledFrame)) {
+        resampledFrame[FLIGHT_LOG_FIELD_INDEX_TIME] = rowTime;
+
+        applyPendingFrames(log, rowTime);
+
+        // Simulations run on the resampled data so their output lines up with the rows
+        updateSimulations(log, resampledFrame, rowTime);
+
+        if (filterMainRow(log, rowTime, resampledFrame, 'I', 0, 0)) {
+            if (isMergingGPS(log)) {
+                outputMergeRow(log, rowTime, resampledFrame);
+            } else {
+                outputMainRow(log, rowTime, resampledFrame, 'I', 0, 0);
+            }
+        }
+    }
+}
+
+/**
+ * In resampling mode, main frames are fed through the resampler and rows are printed as they become available.
+ */
+void onFrameReadyResample(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount)
+{
+    int64_t gpsFrameTime;
+
+    if (!frameValid && frameType != 'P' && frameType != 'I') {
+        return;
+    }
+
+    switch (frameType) {
+        case 'G':
+            if (isMergingGPS(log)) {
+                gpsFrameTime = log->gpsFieldIndexes.time == -1 ? lastFrameTime : frame[log->gpsFieldIndexes.time];
+
+                queuePendingFrame(frameType, gpsFrameTime, frame, fieldCount);
+                addGPXPoint(log, gpsFrameTime, frame);
+            } else {
+                outputGPSFrame(log, frame);
+            }
+        break;
+        case 'S':
+            queuePendingFrame(frameType, lastFrameTime, frame, fieldCount);
+        break;
+        case 'P':
+        case 'I':
+            if (frameValid) {
+                updateFrameStatistics(log, frame);
+
+                lastFrameIteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+                lastFrameTime = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+
+                resamplerAddFrame(resampler, lastFrameTime, frame);
+            } else {
+                // Don't let the filter bridge the corrupt section
+                resamplerEndSegment(resampler);
+            }
+
+            outputResampledRows(log);
+        break;
+    }
+}
+
+/**
+ * In step response mode we just collect the setpoint and gyro from each main frame for analysis after the log
+ * has been parsed.
+ */
+void collectStepResponseSample(flightLog_t *log, bool frameValid, int64_t *frame)
+{
+    double setpoint[STEP_RESPONSE_AXES], gyro[STEP_RESPONSE_AXES];
+
+    // Frames which don't pass the --where filter are left out of the analysis
+    if (!frameValid || (rowFilter && !rowFilterMatches(rowFilter, frame, bufferedSlowFrame))) {
+        stepResponseLogAddGap(stepResponseLog);
+        return;
+    }
+
+    for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+        setpoint[axis] = frame[log->mainFieldIndexes.rcCommand[axis]];
+        gyro[axis] = flightlogGyroToRadiansPerSecond(log, frame[log->mainFieldIndexes.gyroADC[axis]]) * (180 / M_PI);
+    }
+
+    stepResponseLogAddSample(stepResponseLog, frame[FLIGHT_LOG_FIELD_INDEX_TIME], setpoint, gyro);
+}
+
+static void dispatchFrame(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
 {
+    if (options.stepResponse) {
+        if (frameType == 'S' && frameValid) {
+            memcpy(bufferedSlowFrame, frame, sizeof(bufferedSlowFrame));
+        } else if ((frameType == 'P' || frameType == 'I') && log->mainFieldIndexes.rcCommand[0] > -1 && log->mainFieldIndexes.gyroADC[0] > -1) {
+            collectStepResponseSample(log, frameValid, frame);
+        }
+        return;
+    }
+
+    if (resampler) {
+        onFrameReadyResample(log, frameValid, frame, frameType, fieldCount);
+        return;
+    }
+
     if (options.mergeGPS && log->frameDefs['G'].fieldCount > 0) {
         //Use the alternate frame processing routine which merges main stream data and GPS data together
         onFrameReadyMerge(log, frameValid, frame, frameType, fieldCount, frameOffset, frameSize);
@@ -752,13 +1150,11 @@ void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t fra
                     lastFrameTime = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
                 }
 
-                outputMainFrameFields(log, frameValid ? frame[FLIGHT_LOG_FIELD_INDEX_TIME] : -1, frame);
+                int64_t frameTime = frameValid ? frame[FLIGHT_LOG_FIELD_INDEX_TIME] : -1;
 
-                if (options.debug) {
-                    fprintf(csvFile, ", %c, offset %d, size %d\n", (char) frameType, frameOffset, frameSize);
-                } else {
-                    fprintf(csvFile, "\n");
-				}
+                if (filterMainRow(log, frameTime, frame, frameType, frameOffset, frameSize)) {
+                    outputMainRow(log, frameTime, frame, frameType, frameOffset, frameSize);
+                }
             } else if (options.debug) {
                 // Print to stdout so that these messages line up with our other output on stdout (stderr isn't synchronised to it)
                 if (frame) {
@@ -766,15 +1162,24 @@ void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t fra
                      * We'll assume that the frame's iteration count is still fairly sensible (if an earlier frame was corrupt,
                      * the frame index will be smaller than it should be)
                      */
-                    fprintf(csvFile, "%c Frame unusuable due to prior corruption, offset %d, size %d\n", (char) frameType, frameOffset, frameSize);
+                    fprintf(csvFile, "%c Frame unusuable due to prior corruption, offset %" PRId64 ", size %d\n", (char) frameType, frameOffset, frameSize);
                 } else {
-                    fprintf(csvFile, "Failed to decode %c frame, offset %d, size %d\n", (char) frameType, frameOffset, frameSize);
+                    fprintf(csvFile, "Failed to decode %c frame, offset %" PRId64 ", size %d\n", (char) frameType, frameOffset, frameSize);
                 }
             }
         break;
     }
 }
 
+void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+    PROFILE_BEGIN(frame_ready);
+
+    dispatchFrame(log, frameValid, frame, frameType, fieldCount, frameOffset, frameSize);
+
+    PROFILE_END(frame_ready, &frameReadyProbe);
+}
+
 void resetGPSFieldIdents()
 {
     for (int i = 0; i < FLIGHT_LOG_MAX_FIELDS; i++) {
@@ -910,6 +1315,23 @@ void writeMainCSVHeader(flightLog_t *log)
     fprintf(csvFile, "\n");
 }
 
+/**
+ * Called when we've decoded everything that has been written to a log we're following, so whatever is watching our
+ * output can see the rows so far.
+ */
+void onFollowWait(flightLog_t *log)
+{
+    (void) log;
+
+    fflush(csvFile);
+
+    if (eventFile)
+        fflush(eventFile);
+
+    if (gpsCsvFile)
+        fflush(gpsCsvFile);
+}
+
 void onMetadataReady(flightLog_t *log)
 {
     if (log->frameDefs['I'].fieldCount == 0) {
@@ -923,7 +1345,30 @@ void onMetadataReady(flightLog_t *log)
     identifyGPSFields(log);
     applyFieldUnits(log);
 
-    writeMainCSVHeader(log);
+    if (options.where) {
+        char error[256];
+
+        rowFilterDestroy(rowFilter);
+        rowFilter = rowFilterCompile(options.where, &log->frameDefs['I'], &log->frameDefs['S'], error, sizeof(error));
+
+        if (!rowFilter) {
+            fprintf(stderr, "Bad --where expression: %s\n", error);
+            exit(-1);
+        }
+    }
+
+    if (options.resampleRate > 0 && !options.stepResponse) {
+        resamplerDestroy(resampler);
+        resampler = resamplerCreate(log->frameDefs['I'].fieldCount, options.resampleRate);
+    }
+
+    if (options.stepResponse) {
+        if (log->mainFieldIndexes.rcCommand[0] == -1 || log->mainFieldIndexes.gyroADC[0] == -1) {
+            fprintf(stderr, "Can't estimate the step response because rcCommand or gyroscope data is missing\n");
+        }
+    } else {
+        writeMainCSVHeader(log);
+    }
 }
 
 void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
@@ -931,10 +1376,10 @@ void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
     flightLogStatistics_t *stats = &log->stats;
     uint32_t intervalMS = (uint32_t) ((stats->field[FLIGHT_LOG_FIELD_INDEX_TIME].max - stats->field[FLIGHT_LOG_FIELD_INDEX_TIME].min) / 1000);
 
-    uint32_t goodBytes = stats->frame['I'].bytes + stats->frame['P'].bytes;
-    uint32_t goodFrames = stats->frame['I'].validCount + stats->frame['P'].validCount;
-    uint32_t totalFrames = (uint32_t) (stats->field[FLIGHT_LOG_FIELD_INDEX_ITERATION].max - stats->field[FLIGHT_LOG_FIELD_INDEX_ITERATION].min + 1);
-    int32_t missingFrames = totalFrames - goodFrames - stats->intentionallyAbsentIterations;
+    uint64_t goodBytes = stats->frame['I'].bytes + stats->frame['P'].bytes;
+    uint64_t goodFrames = stats->frame['I'].validCount + stats->frame['P'].validCount;
+    uint64_t totalFrames = (uint64_t) (stats->field[FLIGHT_LOG_FIELD_INDEX_ITERATION].max - stats->field[FLIGHT_LOG_FIELD_INDEX_ITERATION].min + 1);
+    int64_t missingFrames = (int64_t) (totalFrames - goodFrames - stats->intentionallyAbsentIterations);
 
     uint32_t runningTimeMS, runningTimeSecs, runningTimeMins;
     uint32_t startTimeMS, startTimeSecs, startTimeMins;
@@ -968,17 +1413,17 @@ void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
     fprintf(stderr, "\nLog %d of %d", logIndex + 1, log->logCount);
 
     if (intervalMS > 0 && !raw) {
-        fprintf(stderr, ", start %02d:%02d.%03d, end %02d:%02d.%03d, duration %02d:%02d.%03d\n\n",
+        fprintf(statsFile, ", start %02d:%02d.%03d, end %02d:%02d.%03d, duration %02d:%02d.%03d\n\n",
             startTimeMins, startTimeSecs, startTimeMS,
             endTimeMins, endTimeSecs, endTimeMS,
             runningTimeMins, runningTimeSecs, runningTimeMS
         );
     }
 
-    fprintf(stderr, "Statistics\n");
+    fprintf(statsFile, "Statistics\n");
 
     if (seriesStats_getCount(&looptimeStats) > 0) {
-        fprintf(stderr, "Looptime %14d avg %14.1f std dev (%.1f%%)\n", (int) seriesStats_getMean(&looptimeStats),
+        fprintf(statsFile, "Looptime %14d avg %14.1f std dev (%.1f%%)\n", (int) seriesStats_getMean(&looptimeStats),
             seriesStats_getStandardDeviation(&looptimeStats), seriesStats_getStandardDeviation(&looptimeStats) / seriesStats_getMean(&looptimeStats) * 100);
     }
 
@@ -986,54 +1431,54 @@ void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
         uint8_t frameType = frameTypes[i];
 
         if (stats->frame[frameType].validCount ) {
-            fprintf(stderr, "%c frames %7d %6.1f bytes avg %8d bytes total\n", (char) frameType, stats->frame[frameType].validCount,
+            fprintf(statsFile, "%c frames %7" PRIu64 " %6.1f bytes avg %8" PRIu64 " bytes total\n", (char) frameType, stats->frame[frameType].validCount,
                 (float) stats->frame[frameType].bytes / stats->frame[frameType].validCount, stats->frame[frameType].bytes);
         }
     }
 
     if (goodFrames) {
-        fprintf(stderr, "Frames %9d %6.1f bytes avg %8d bytes total\n", goodFrames, (float) goodBytes / goodFrames, goodBytes);
+        fprintf(statsFile, "Frames %9" PRIu64 " %6.1f bytes avg %8" PRIu64 " bytes total\n", goodFrames, (float) goodBytes / goodFrames, goodBytes);
     } else {
-        fprintf(stderr, "Frames %8d\n", 0);
+        fprintf(statsFile, "Frames %8d\n", 0);
     }
 
     if (intervalMS > 0 && !raw) {
-        fprintf(stderr, "Data rate %4uHz %6u bytes/s %10u baud\n",
-            (unsigned int) (((int64_t) goodFrames * 1000) / intervalMS),
-            (unsigned int) (((int64_t) stats->totalBytes * 1000) / intervalMS),
-            (unsigned int) ((((int64_t) stats->totalBytes * 1000 * (8 + 1 + 1)) / intervalMS + 100 - 1) / 100 * 100)); /* Round baud rate up to nearest 100 */
+        fprintf(statsFile, "Data rate %4" PRIu64 "Hz %6" PRIu64 " bytes/s %10" PRIu64 " baud\n",
+            (goodFrames * 1000) / intervalMS,
+            (stats->totalBytes * 1000) / intervalMS,
+            ((stats->totalBytes * 1000 * (8 + 1 + 1)) / intervalMS + 100 - 1) / 100 * 100); /* Round baud rate up to nearest 100 */
     } else {
-        fprintf(stderr, "Data rate: Unknown, no timing information available.\n");
+        fprintf(statsFile, "Data rate: Unknown, no timing information available.\n");
     }
 
     if (totalFrames && (stats->totalCorruptFrames || missingFrames || stats->intentionallyAbsentIterations)) {
-        fprintf(stderr, "\n");
+        fprintf(statsFile, "\n");
 
         if (stats->totalCorruptFrames || stats->frame['P'].desyncCount || stats->frame['I'].desyncCount) {
-            fprintf(stderr, "%d frames failed to decode, rendering %d loop iterations unreadable. ", stats->totalCorruptFrames, stats->frame['P'].desyncCount + stats->frame['P'].corruptCount + stats->frame['I'].desyncCount + stats->frame['I'].corruptCount);
+            fprintf(statsFile, "%" PRIu64 " frames failed to decode, rendering %" PRIu64 " loop iterations unreadable. ", stats->totalCorruptFrames, stats->frame['P'].desyncCount + stats->frame['P'].corruptCount + stats->frame['I'].desyncCount + stats->frame['I'].corruptCount);
             if (!missingFrames)
-                fprintf(stderr, "\n");
+                fprintf(statsFile, "\n");
         }
         if (missingFrames) {
-            fprintf(stderr, "%d iterations are missing in total (%ums, %.2f%%)\n",
+            fprintf(statsFile, "%" PRId64 " iterations are missing in total (%" PRId64 "ms, %.2f%%)\n",
                 missingFrames,
-                (unsigned int) (((int64_t) missingFrames * intervalMS) / totalFrames),
+                (missingFrames * intervalMS) / (int64_t) totalFrames,
                 (double) missingFrames / totalFrames * 100);
         }
         if (stats->intentionallyAbsentIterations) {
-            fprintf(stderr, "%d loop iterations weren't logged because of your blackbox_rate settings (%ums, %.2f%%)\n",
+            fprintf(statsFile, "%" PRIu64 " loop iterations weren't logged because of your blackbox_rate settings (%" PRIu64 "ms, %.2f%%)\n",
                 stats->intentionallyAbsentIterations,
-                (unsigned int) (((int64_t)stats->intentionallyAbsentIterations * intervalMS) / totalFrames),
+                (stats->intentionallyAbsentIterations * intervalMS) / totalFrames,
                 (double) stats->intentionallyAbsentIterations / totalFrames * 100);
         }
     }
 
     if (limits) {
-        fprintf(stderr, "\n\n    Field name          Min          Max        Range\n");
-        fprintf(stderr,     "-----------------------------------------------------\n");
+        fprintf(statsFile, "\n\n    Field name          Min          Max        Range\n");
+        fprintf(statsFile,     "-----------------------------------------------------\n");
 
         for (i = 0; i < log->frameDefs['I'].fieldCount; i++) {
-            fprintf(stderr, "%14s %12" PRId64 " %12" PRId64 " %12" PRId64 "\n",
+            fprintf(statsFile, "%14s %12" PRId64 " %12" PRId64 " %12" PRId64 "\n",
                 log->frameDefs['I'].fieldName[i],
                 stats->field[i].min,
                 stats->field[i].max,
@@ -1042,12 +1487,145 @@ void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
         }
     }
 
-    fprintf(stderr, "\n");
+    fprintf(statsFile, "\n");
+}
+
+/**
+ * Find the smallest number of bits that the field fit into in the given fraction of frames.
+ */
+static int fieldCostPercentile(const flightLogFieldCost_t *cost, uint64_t frameCount, double fraction)
+{
+    uint64_t target = (uint64_t) ceil(frameCount * fraction);
+    uint64_t seen = 0;
+
+    for (int bits = 0; bits < FLIGHT_LOG_FIELD_COST_MAX_BITS; bits++) {
+        seen += cost->bitsCount[bits];
+
+        if (seen >= target) {
+            return bits;
+        }
+    }
+
+    return FLIGHT_LOG_FIELD_COST_MAX_BITS;
+}
+
+/**
+ * Print the number of bits that each field (or group of fields that are encoded together) used in each frame type.
+ */
+void printFieldCosts(flightLog_t *log)
+{
+    uint8_t frameTypes[] = {'I', 'P', 'H', 'G', 'S'};
+
+    for (int i = 0; i < (int) sizeof(frameTypes); i++) {
+        uint8_t frameType = frameTypes[i];
+        const flightLogFrameCost_t *frameCost = flightLogGetFrameCost(log, frameType);
+        flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
+
+        if (!frameCost || frameCost->frameCount == 0) {
+            continue;
+        }
+
+        fprintf(statsFile, "%c frame field costs, %" PRIu64 " frames, %.1f bits avg\n", (char) frameType, frameCost->frameCount,
+            (double) frameCost->totalBits / frameCost->frameCount);
+        fprintf(statsFile, "%-36s %8s %5s %5s %5s %5s %6s\n", "Field", "Bits avg", "p50", "p90", "p99", "Max", "Share");
+
+        for (int j = 0; j < frameDef->fieldCount; j++) {
+            const flightLogFieldCost_t *fieldCost = &frameCost->field[j];
+            char name[64];
+            int maxBits;
+
+            // Fields which were charged to the start of their group
+            if (fieldCost->groupSize == 0) {
+                continue;
+            }
+
+            if (fieldCost->groupSize > 1) {
+                snprintf(name, sizeof(name), "%s..%s", frameDef->fieldName[j], frameDef->fieldName[j + fieldCost->groupSize - 1]);
+            } else {
+                snprintf(name, sizeof(name), "%s", frameDef->fieldName[j]);
+            }
+
+            for (maxBits = FLIGHT_LOG_FIELD_COST_MAX_BITS; maxBits > 0 && fieldCost->bitsCount[maxBits] == 0; maxBits--)
+                ;
+
+            fprintf(statsFile, "%-36s %8.1f %5d %5d %5d %5d %5.1f%%\n", name,
+                (double) fieldCost->totalBits / frameCost->frameCount,
+                fieldCostPercentile(fieldCost, frameCost->frameCount, 0.5),
+                fieldCostPercentile(fieldCost, frameCost->frameCount, 0.9),
+                fieldCostPercentile(fieldCost, frameCost->frameCount, 0.99),
+                maxBits,
+                (double) fieldCost->totalBits / frameCost->totalBits * 100);
+        }
+
+        fprintf(statsFile, "%-36s %8.1f %5s %5s %5s %5s %5.1f%%\n", "(frame type byte)", (double) CHAR_BIT, "", "", "", "",
+            (double) frameCost->frameCount * CHAR_BIT / frameCost->totalBits * 100);
+        fprintf(statsFile, "%-36s %8.1f %5s %5s %5s %5s %5.1f%%\n", "(padding)", (double) frameCost->paddingBits / frameCost->frameCount, "", "", "", "",
+            (double) frameCost->paddingBits / frameCost->totalBits * 100);
+        fprintf(statsFile, "\n");
+    }
+}
+
+/**
+ * Analyse the samples we collected during the parse and write the step response of each axis to the CSV file,
+ * with a summary on statsFile.
+ *
+ * Returns false (having written nothing to the CSV file) if there wasn't enough data to analyse.
+ */
+bool writeStepResponse(void)
+{
+    static const char *const axisNames[STEP_RESPONSE_AXES] = {"roll", "pitch", "yaw"};
+    stepResponse_t response;
+
+    if (!stepResponseCompute(stepResponseLog, options.threads, &response)) {
+        fprintf(statsFile, "Not enough continuous data in this log to estimate the step response\n");
+        return false;
+    }
+
+    fprintf(csvFile, "time (ms)");
+    for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+        fprintf(csvFile, ", %s", axisNames[axis]);
+    }
+    fprintf(csvFile, "\n");
+
+    for (int i = 0; i < response.length; i++) {
+        fprintf(csvFile, "%.3f", i * response.sampleIntervalMs);
+
+        for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+            if (response.axis[axis].response) {
+                fprintf(csvFile, ", %.4f", response.axis[axis].response[i]);
+            } else {
+                fprintf(csvFile, ", ");
+            }
+        }
+
+        fprintf(csvFile, "\n");
+    }
+
+    fprintf(statsFile, "Step response\n");
+    fprintf(statsFile, "Axis   Windows  Rise time  Peak time  Overshoot\n");
+
+    for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+        stepResponseAxis_t *axisResponse = &response.axis[axis];
+
+        if (axisResponse->response) {
+            fprintf(statsFile, "%-5s %8d %8.1fms %8.1fms %9.1f%%\n", axisNames[axis], axisResponse->windowCount,
+                axisResponse->riseTimeMs, axisResponse->peakTimeMs, axisResponse->overshootPercent);
+        } else {
+            fprintf(statsFile, "%-5s %8d   (not enough stick movement)\n", axisNames[axis], axisResponse->windowCount);
+        }
+    }
+
+    fprintf(statsFile, "\n");
+
+    stepResponseFree(&response);
+
+    return true;
 }
 
 void resetParseState() {
     if (options.simulateIMU) {
         imuInit();
+        imuSetFastMath(options.imuFast);
     }
 
     if (options.mergeGPS) {
@@ -1064,10 +1642,55 @@ void resetParseState() {
     lastFrameTime = -1;
 
     seriesStats_init(&looptimeStats);
+
+    if (options.stepResponse) {
+        stepResponseLogDestroy(stepResponseLog);
+        stepResponseLog = stepResponseLogCreate();
+    }
+
+    if (options.where && options.contextBefore > 0 && !heldRows) {
+        heldRows = malloc(options.contextBefore * sizeof(*heldRows));
+    }
+
+    pendingFrameCount = 0;
+
+    heldRowCount = 0;
+    heldRowNext = 0;
+    rowsAfterMatchRemaining = 0;
+    rowsTested = 0;
+    rowsMatched = 0;
+}
+
+/**
+ * Read the statistics for the log we just decoded back from the temporary statsFile, print them and return them as a
+ * string for the decode cache.
+ */
+static char* finishCachedStats(size_t *length)
+{
+    long statsLength = ftell(statsFile);
+    char *stats = malloc(statsLength > 0 ? statsLength : 1);
+
+    rewind(statsFile);
+
+    *length = fread(stats, 1, statsLength > 0 ? statsLength : 0, statsFile);
+
+    fwrite(stats, 1, *length, stderr);
+
+    fclose(statsFile);
+    statsFile = stderr;
+
+    return stats;
 }
 
 int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
 {
+    char *csvFilename = NULL, *gpxFilename = NULL;
+    bool useCache = options.cacheDir && !options.toStdout && !options.follow;
+    char cacheKey[DECODE_CACHE_KEY_LENGTH + 1];
+    decodeCacheOutput_t cacheOutputs[4];
+    size_t statsLength;
+    bool removeCSV = false;
+
     // Organise output files/streams
     gpx = NULL;
 
@@ -1080,8 +1703,8 @@ int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
     if (options.toStdout) {
         csvFile = stdout;
     } else {
-        char *csvFilename = 0, *gpxFilename = 0;
         int filenameLen;
+        const char *compressionExtension = compressionFormatExtension(options.compression);
 
         const char *outputPrefix = 0;
         int outputPrefixLen;
@@ -1103,42 +1726,80 @@ int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
             outputPrefixLen = logNameEnd - outputPrefix;
         }
 
-        filenameLen = outputPrefixLen + strlen(".00.csv") + 1;
+        filenameLen = outputPrefixLen + strlen(".00.step.csv") + strlen(compressionExtension) + 1;
         csvFilename = malloc(filenameLen * sizeof(char));
 
-        snprintf(csvFilename, filenameLen, "%.*s.%02d.csv", outputPrefixLen, outputPrefix, logIndex + 1);
+        snprintf(csvFilename, filenameLen, options.stepResponse ? "%.*s.%02d.step.csv%s" : "%.*s.%02d.csv%s", outputPrefixLen, outputPrefix, logIndex + 1,
+            compressionExtension);
 
         filenameLen = outputPrefixLen + strlen(".00.gps.gpx") + 1;
         gpxFilename = malloc(filenameLen * sizeof(char));
 
         snprintf(gpxFilename, filenameLen, "%.*s.%02d.gps.gpx", outputPrefixLen, outputPrefix, logIndex + 1);
 
-        filenameLen = outputPrefixLen + strlen(".00.gps.csv") + 1;
+        filenameLen = outputPrefixLen + strlen(".00.gps.csv") + strlen(compressionExtension) + 1;
         gpsCsvFilename = malloc(filenameLen * sizeof(char));
 
-        snprintf(gpsCsvFilename, filenameLen, "%.*s.%02d.gps.csv", outputPrefixLen, outputPrefix, logIndex + 1);
+        snprintf(gpsCsvFilename, filenameLen, "%.*s.%02d.gps.csv%s", outputPrefixLen, outputPrefix, logIndex + 1, compressionExtension);
 
         filenameLen = outputPrefixLen + strlen(".00.event") + 1;
         eventFilename = malloc(filenameLen * sizeof(char));
 
         snprintf(eventFilename, filenameLen, "%.*s.%02d.event", outputPrefixLen, outputPrefix, logIndex + 1);
 
-        csvFile = fopen(csvFilename, "wb");
+        if (useCache) {
+            // Capture the statistics we print so we can store them with the outputs
+            statsFile = tmpfile();
+            useCache = statsFile != NULL;
+
+            if (!useCache) {
+                statsFile = stderr;
+            }
+        }
+
+        if (useCache) {
+            mmapStream_t *stream = log->private->stream;
+
+            // If this log's data has been decoded with these options before, we can just reuse those outputs
+            streamWaitForData(stream, log->logBegin[logIndex + 1] - stream->data);
+
+            decodeCacheMakeKey(cacheKey, log->logBegin[logIndex], log->logBegin[logIndex + 1] - log->logBegin[logIndex], cacheOptions);
+
+            cacheOutputs[0] = (decodeCacheOutput_t) {.name = "csv", .filename = csvFilename};
+            cacheOutputs[1] = (decodeCacheOutput_t) {.name = "event", .filename = eventFilename};
+            cacheOutputs[2] = (decodeCacheOutput_t) {.name = "gps.csv", .filename = gpsCsvFilename};
+            cacheOutputs[3] = (decodeCacheOutput_t) {.name = "gps.gpx", .filename = gpxFilename};
+
+            if (decodeCacheRestore(options.cacheDir, cacheKey, cacheOutputs, ARRAY_LENGTH(cacheOutputs), statsFile)) {
+                fprintf(stderr, "Decoding log '%s' to '%s'... (cached)\n", filename, csvFilename);
+                fprintf(stderr, "\nLog %d of %d", logIndex + 1, log->logCount);
+
+                free(finishCachedStats(&statsLength));
+                free(csvFilename);
+                free(gpxFilename);
+                free(gpsCsvFilename);
+                free(eventFilename);
+
+                return 0;
+            }
+        }
+
+        csvFile = createCSVFile(csvFilename);
 
         if (!csvFile) {
             fprintf(stderr, "Failed to create output file %s\n", csvFilename);
 
             free(csvFilename);
+            free(gpxFilename);
             return -1;
         }
 
         fprintf(stderr, "Decoding log '%s' to '%s'...\n", filename, csvFilename);
-        free(csvFilename);
 
         gpx = gpxWriterCreate(gpxFilename);
-        free(gpxFilename);
     }
 
+
     resetParseState();
 
     if ((log->private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //prime data buffer with data
@@ -1147,7 +1808,14 @@ int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
 
     int success = flightLogParse(log, logIndex, onMetadataReady, onFrameReady, onEvent, options.raw);
 
-    if (options.mergeGPS && haveBufferedMainFrame) {
+    if (resampler) {
+        // Flush out the rows at the end of the log that were waiting for more frames
+        resamplerEndSegment(resampler);
+        outputResampledRows(log);
+
+        resamplerDestroy(resampler);
+        resampler = NULL;
+    } else if (options.mergeGPS && haveBufferedMainFrame) {
         // Print out last log entry that wasn't already printed
         outputMergeFrame(log);
     }
@@ -1155,22 +1823,126 @@ int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
     if (success)
         printStats(log, logIndex, options.raw, options.limits);
 
+    if (success && options.fieldCosts)
+        printFieldCosts(log);
+
+    if (success && rowFilter)
+        fprintf(statsFile, "%" PRIu64 " of %" PRIu64 " rows matched the filter\n", rowsMatched, rowsTested);
+
+    // Don't leave an empty CSV file behind for a log we couldn't analyse
+    if (options.stepResponse && !(success && writeStepResponse()))
+        removeCSV = !options.toStdout;
+
+    rowFilterDestroy(rowFilter);
+    rowFilter = NULL;
+
+    if (options.stepResponse) {
+        stepResponseLogDestroy(stepResponseLog);
+        stepResponseLog = NULL;
+    }
+
+    if (useCache) {
+        cacheOutputs[0].written = !removeCSV;
+        cacheOutputs[1].written = eventFile != NULL;
+        cacheOutputs[2].written = gpsCsvFile != NULL;
+        cacheOutputs[3].written = gpx->file != NULL;
+    }
+
+    PROFILE_BEGIN(close_files);
+
     if (!options.toStdout)
         fclose(csvFile);
+    else
+        fflush(csvFile);
+
+    if (removeCSV)
+        remove(csvFilename);
 
-    free(eventFilename);
     if (eventFile)
         fclose(eventFile);
 
-    free(gpsCsvFilename);
     if (gpsCsvFile)
         fclose(gpsCsvFile);
 
     gpxWriterDestroy(gpx);
 
+    PROFILE_END(close_files, &closeFilesProbe);
+
+    if (useCache) {
+        char *stats = finishCachedStats(&statsLength);
+
+        if (success) {
+            decodeCacheStore(options.cacheDir, cacheKey, cacheOutputs, ARRAY_LENGTH(cacheOutputs), stats, statsLength);
+        }
+
+        free(stats);
+    }
+
+    free(csvFilename);
+    free(gpxFilename);
+    free(eventFilename);
+    free(gpsCsvFilename);
+
     return success ? 0 : -1;
 }
 
+/**
+ * Print a JSON summary of each log in the file, using only the log headers and the first and last I-frames of each log
+ * (see flightLogInventory()). Logs are described by the members of a JSON array, the caller prints the brackets.
+ */
+void printInventory(flightLog_t *log, const char *filename, bool firstFile)
+{
+    mmapStream_t *stream = log->private->stream;
+
+    printf("%s\n  {\n    \"file\": ", firstFile ? "" : ",");
+    fprintJSONString(stdout, filename, strlen(filename));
+    printf(",\n    \"size\": %" PRIu64 ",\n    \"logs\": [", (uint64_t) stream->size);
+
+    for (int logIndex = 0; logIndex < log->logCount; logIndex++) {
+        flightLogInventory_t inventory;
+
+        flightLogInventory(log, logIndex, &inventory);
+
+        printf("%s\n      {\n", logIndex > 0 ? "," : "");
+        printf("        \"index\": %d,\n", logIndex + 1);
+        printf("        \"offset\": %" PRId64 ",\n", (int64_t) (log->logBegin[logIndex] - stream->data));
+        printf("        \"size\": %" PRId64 ",\n", (int64_t) (log->logBegin[logIndex + 1] - log->logBegin[logIndex]));
+        printf("        \"headerBytes\": %" PRId64 ",\n", inventory.headerBytes);
+        printf("        \"iInterval\": %u,\n", log->frameIntervalI);
+        printf("        \"pInterval\": \"%u/%u\",\n", log->frameIntervalPNum, log->frameIntervalPDenom);
+
+        if (inventory.haveFirstFrame) {
+            printf("        \"firstIteration\": %" PRIu32 ",\n", inventory.firstIteration);
+            printf("        \"startTime\": %" PRId64 ",\n", inventory.firstTime);
+        }
+
+        if (inventory.haveLastFrame) {
+            uint32_t iIntervals = (inventory.lastIteration - inventory.firstIteration) / log->frameIntervalI;
+            uint32_t framesPerIInterval = 0;
+
+            // Count the frames the P interval lets through in each I interval (the same test as the parser uses)
+            for (unsigned int i = 0; i < log->frameIntervalI; i++) {
+                if ((i + log->frameIntervalPNum - 1) % log->frameIntervalPDenom < log->frameIntervalPNum) {
+                    framesPerIInterval++;
+                }
+            }
+
+            // These only cover the log up to its last I-frame, the frames after that add less than one I interval
+            printf("        \"lastIteration\": %" PRIu32 ",\n", inventory.lastIteration);
+            printf("        \"endTime\": %" PRId64 ",\n", inventory.lastTime);
+            printf("        \"durationMicros\": %" PRId64 ",\n", inventory.lastTime - inventory.firstTime);
+            printf("        \"estimatedIFrames\": %" PRIu64 ",\n", (uint64_t) iIntervals + 1);
+            printf("        \"estimatedMainFrames\": %" PRIu64 ",\n", (uint64_t) iIntervals * framesPerIInterval + 1);
+        }
+
+        printf("        \"headers\": ");
+        fprintHeaderLinesJSON(stdout, log->logBegin[logIndex], log->logBegin[logIndex + 1], 10);
+        printf("\n      }");
+    }
+
+    printf("\n    ]\n  }");
+}
+
 int validateLogIndex(flightLog_t *log)
 {
     //Did the user pick a log to render?
@@ -1189,7 +1961,7 @@ int validateLogIndex(flightLog_t *log)
 
         fprintf(stderr, "Index  Start offset  Size (bytes)\n");
         for (int i = 0; i < log->logCount; i++) {
-            fprintf(stderr, "%5d %13d %13d\n", i + 1, (int) (log->logBegin[i] - log->logBegin[0]), (int) (log->logBegin[i + 1] - log->logBegin[i]));
+            fprintf(stderr, "%5d %13" PRId64 " %13" PRId64 "\n", i + 1, (int64_t) (log->logBegin[i] - log->logBegin[0]), (int64_t) (log->logBegin[i + 1] - log->logBegin[i]));
         }
 
         return -1;
@@ -1210,7 +1982,19 @@ void printUsage(const char *argv0)
         "   --help                   This page\n"
         "   --index <num>            Choose the log from the file that should be decoded (or omit to decode all)\n"
         "   --limits                 Print the limits and range of each field\n"
+        "   --field-costs            Print the number of bits used by each field in the log\n"
+        "   --profile                Print a breakdown of the time spent in each stage of decoding\n"
+        "   --profile-json <file>    Also write the --profile breakdown to this file as JSON\n"
+        "   --io-backend <name>      How to read the log (auto|mmap|pread|io_uring), default is auto\n"
+        "   --io-huge-pages          Align the log's buffer so that it can be backed by huge pages\n"
+        "                            (pread and io_uring then keep the whole log in memory)\n"
+        "   --follow                 Keep decoding the last log as the file grows, until the writer closes it\n"
+        "   --follow-timeout <secs>  Stop following once the log hasn't grown for this long (0 for never), default 10\n"
+        "   --cache-dir <dir>        Reuse the outputs of logs which have been decoded before with the same options\n"
+        "                            (parser warnings aren't repeated for logs restored from the cache)\n"
+        "   --inventory              Print a JSON summary of the logs in each file to stdout instead of decoding them\n"
         "   --stdout                 Write log to stdout instead of to a file\n"
+        "   --compress <format>      Compress the CSV files as they're written (none|gzip|zstd), default is none\n"
         "   --unit-amperage <unit>   Current meter unit (raw|mA|A), default is A (amps)\n"
         "   --unit-flags <unit>      State flags unit (raw|flags), default is flags\n"
         "   --unit-frame-time <unit> Frame timestamp unit (us|s), default is us (microseconds)\n"
@@ -1225,12 +2009,20 @@ void printUsage(const char *argv0)
         "   --sim-current-meter-scale   Override the FC's settings for the current meter simulation\n"
         "   --sim-current-meter-offset  Override the FC's settings for the current meter simulation\n"
         "   --simulate-imu           Compute tilt/roll/heading fields from gyro/accel/mag data\n"
+        "   --step-response          Estimate the roll/pitch/yaw step responses and write them instead of the log\n"
+        "   --threads <num>          Number of threads to use for analysis and compression (default %d)\n"
+        "   --where <expr>           Only output rows where the expression is true (e.g. \"motor[*] > 1950\")\n"
+        "                            Unlike C, & and | bind tighter than comparisons, and !a > b means !(a > b)\n"
+        "   --context-before <rows>  Also output this many rows before each row that matches --where\n"
+        "   --context-after <rows>   Also output this many rows after each row that matches --where\n"
+        "   --resample <rate>        Low-pass filter the log and output it at this many rows per second\n"
         "   --imu-ignore-mag         Ignore magnetometer data when computing heading\n"
+        "   --imu-fast               Use faster, approximate trig when computing attitude (within 0.0001 radians)\n"
         "   --declination <val>      Set magnetic declination in degrees.minutes format (e.g. -12.58 for New York)\n"
         "   --declination-dec <val>  Set magnetic declination in decimal degrees (e.g. -12.97 for New York)\n"
         "   --debug                  Show extra debugging information\n"
         "   --raw                    Don't apply predictions to fields (show raw field deltas)\n"
-        "\n", argv0
+        "\n", argv0, options.threads
     );
 }
 
@@ -1244,6 +2036,31 @@ double parseDegreesMinutes(const char *s)
     return degrees + (double) minutes / 60;
 }
 
+/**
+ * Record an option which affects the decoded output in the decode cache key.
+ */
+static void addCacheOption(const char *name, const char *value)
+{
+    // Options which only affect which logs we decode, where the output goes, or how fast we get there
+    static const char *IGNORED_OPTIONS[] = {
+        "help", "index", "prefix", "stdout", "threads", "profile", "profile-json", "io-backend", "io-huge-pages", "follow",
+        "follow-timeout", "cache-dir", "inventory"
+    };
+    size_t length;
+
+    for (unsigned int i = 0; i < ARRAY_LENGTH(IGNORED_OPTIONS); i++) {
+        if (strcmp(name, IGNORED_OPTIONS[i]) == 0) {
+            return;
+        }
+    }
+
+    length = strlen(name) + (value ? 1 + strlen(value) : 0) + 1;
+
+    cacheOptions = realloc(cacheOptions, cacheOptionsLength + length + 1);
+
+    cacheOptionsLength += snprintf(cacheOptions + cacheOptionsLength, length + 1, value ? "%s=%s;" : "%s;", name, value);
+}
+
 void parseCommandlineOptions(int argc, char **argv)
 {
     int c;
@@ -1264,6 +2081,16 @@ void parseCommandlineOptions(int argc, char **argv)
         SETTING_UNIT_FRAME_TIME,
         SETTING_UNIT_FLAGS,
 		SETTING_ALT_OFFSET,
+        SETTING_THREADS,
+        SETTING_WHERE,
+        SETTING_CONTEXT_BEFORE,
+        SETTING_CONTEXT_AFTER,
+        SETTING_RESAMPLE,
+        SETTING_PROFILE_JSON,
+        SETTING_IO_BACKEND,
+        SETTING_FOLLOW_TIMEOUT,
+        SETTING_CACHE_DIR,
+        SETTING_COMPRESS,
     };
 
     while (1)
@@ -1273,11 +2100,23 @@ void parseCommandlineOptions(int argc, char **argv)
             {"raw", no_argument, &options.raw, 1},
             {"debug", no_argument, &options.debug, 1},
             {"limits", no_argument, &options.limits, 1},
+            {"field-costs", no_argument, &options.fieldCosts, 1},
+            {"profile", no_argument, &options.profile, 1},
+            {"profile-json", required_argument, 0, SETTING_PROFILE_JSON},
+            {"io-backend", required_argument, 0, SETTING_IO_BACKEND},
+            {"io-huge-pages", no_argument, &options.ioHugePages, 1},
+            {"follow", no_argument, &options.follow, 1},
+            {"inventory", no_argument, &options.inventory, 1},
+            {"follow-timeout", required_argument, 0, SETTING_FOLLOW_TIMEOUT},
+            {"cache-dir", required_argument, 0, SETTING_CACHE_DIR},
             {"stdout", no_argument, &options.toStdout, 1},
+            {"compress", required_argument, 0, SETTING_COMPRESS},
             {"merge-gps", no_argument, &options.mergeGPS, 1},
             {"simulate-imu", no_argument, &options.simulateIMU, 1},
+            {"step-response", no_argument, &options.stepResponse, 1},
             {"simulate-current-meter", no_argument, &options.simulateCurrentMeter, 1},
             {"imu-ignore-mag", no_argument, &options.imuIgnoreMag, 1},
+            {"imu-fast", no_argument, &options.imuFast, 1},
             {"sim-current-meter-scale", required_argument, 0, SETTING_CURRENT_METER_SCALE},
             {"sim-current-meter-offset", required_argument, 0, SETTING_CURRENT_METER_OFFSET},
             {"declination", required_argument, 0, SETTING_DECLINATION},
@@ -1293,6 +2132,11 @@ void parseCommandlineOptions(int argc, char **argv)
             {"unit-frame-time", required_argument, 0, SETTING_UNIT_FRAME_TIME},
             {"unit-flags", required_argument, 0, SETTING_UNIT_FLAGS},
             {"alt-offset", required_argument, 0, SETTING_ALT_OFFSET},
+            {"threads", required_argument, 0, SETTING_THREADS},
+            {"where", required_argument, 0, SETTING_WHERE},
+            {"context-before", required_argument, 0, SETTING_CONTEXT_BEFORE},
+            {"context-after", required_argument, 0, SETTING_CONTEXT_AFTER},
+            {"resample", required_argument, 0, SETTING_RESAMPLE},
             {0, 0, 0, 0}
         };
 
@@ -1305,6 +2149,10 @@ void parseCommandlineOptions(int argc, char **argv)
         if (c == -1)
             break;
 
+        if (c != '?' && c != ':') {
+            addCacheOption(long_options[option_index].name, long_options[option_index].has_arg ? optarg : NULL);
+        }
+
         switch (c) {
             case SETTING_INDEX:
                 options.logNumber = atoi(optarg);
@@ -1377,6 +2225,64 @@ void parseCommandlineOptions(int argc, char **argv)
             case SETTING_ALT_OFFSET:
                 options.altOffset = atof(optarg);
             break;
+            case SETTING_THREADS:
+                options.threads = atoi(optarg);
+                if (options.threads < 1) {
+                    options.threads = 1;
+                }
+            break;
+            case SETTING_WHERE:
+                options.where = optarg;
+            break;
+            case SETTING_CONTEXT_BEFORE:
+                options.contextBefore = atoi(optarg);
+                if (options.contextBefore < 0) {
+                    options.contextBefore = 0;
+                }
+            break;
+            case SETTING_RESAMPLE:
+                options.resampleRate = atof(optarg);
+                if (options.resampleRate <= 0) {
+                    fprintf(stderr, "Bad resample rate\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_IO_BACKEND:
+                if (!ioBackendFromName(optarg, &options.ioBackend)) {
+                    fprintf(stderr, "Bad IO backend (choose from auto, mmap, pread or io_uring)\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_FOLLOW_TIMEOUT:
+                options.followTimeout = atoi(optarg);
+                if (options.followTimeout < 0) {
+                    options.followTimeout = 0;
+                }
+            break;
+            case SETTING_CACHE_DIR:
+                options.cacheDir = optarg;
+            break;
+            case SETTING_COMPRESS:
+                if (!compressionFormatFromName(optarg, &options.compression)) {
+                    fprintf(stderr, "Bad compression format (choose from none, gzip or zstd)\n");
+                    exit(-1);
+                }
+
+                if (!compressionFormatAvailable(options.compression)) {
+                    fprintf(stderr, "This build of blackbox_decode doesn't support %s compression\n", compressionFormatName(options.compression));
+                    exit(-1);
+                }
+            break;
+            case SETTING_PROFILE_JSON:
+                options.profile = 1;
+                options.profileJSONFilename = optarg;
+            break;
+            case SETTING_CONTEXT_AFTER:
+                options.contextAfter = atoi(optarg);
+                if (options.contextAfter < 0) {
+                    options.contextAfter = 0;
+                }
+            break;
             case '\0':
                 //Longopt which has set a flag
             break;
@@ -1401,9 +2307,19 @@ int main(int argc, char **argv)
     flightLog_t *log;
     int fd;
     int logIndex;
+    int inventoryCount = 0;
 
     platform_init();
 
+    statsFile = stderr;
+
+    // Outputs from a different build of the decoder might not match ours
+    addCacheOption("decoder", "v" STR(DECODE_CACHE_VERSION) " "
+#ifdef BLACKBOX_VERSION
+        STR(BLACKBOX_VERSION) " "
+#endif
+        __DATE__ " " __TIME__);
+
     parseCommandlineOptions(argc, argv);
 
     if (options.help || argc == 1) {
@@ -1411,11 +2327,29 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (options.raw && options.resampleRate > 0) {
+        fprintf(stderr, "Raw field deltas can't be resampled, choose either --raw or --resample\n");
+        return -1;
+    }
+
     if (options.toStdout && argc - optind > 1) {
         fprintf(stderr, "You can only decode one log at a time if you're printing to stdout\n");
         return -1;
     }
 
+    if (options.toStdout && options.compression != COMPRESSION_NONE) {
+        fprintf(stderr, "Output to stdout can't be compressed, pipe it through a compressor instead\n");
+        return -1;
+    }
+
+    if (options.profile) {
+        profileEnable();
+    }
+
+    if (options.inventory) {
+        printf("[");
+    }
+
     for (int i = optind; i < argc; i++) {
         const char *filename = argv[i];
 
@@ -1425,18 +2359,44 @@ int main(int argc, char **argv)
             continue;
         }
 
-        log = flightLogCreate(fd);
+        if (options.follow) {
+            log = flightLogCreateFollowing(fd, options.followTimeout * 1000, onFollowWait);
+
+            if (!log) {
+                fprintf(stderr, "Can't follow the log file '%s', only regular files can be followed\n\n", filename);
+                continue;
+            }
+        } else if (options.inventory && options.ioBackend == IO_BACKEND_AUTO) {
+            // Only the headers and the ends of each log are read, so don't let a buffered backend read the whole file
+            log = flightLogCreateWithIOBackend(fd, IO_BACKEND_MMAP, options.ioHugePages);
+        } else {
+            log = flightLogCreateWithIOBackend(fd, options.ioBackend, options.ioHugePages);
+        }
 
         if (!log) {
             fprintf(stderr, "Failed to read log file '%s'\n\n", filename);
             continue;
         }
 
+        flightLogSetFieldCostProfiling(log, options.fieldCosts);
+
+        if (options.debug) {
+            fprintf(stderr, "Reading '%s' using the %s IO backend\n", filename, ioBackendName(log->private->stream->backend));
+        }
+
         if (log->logCount == 0) {
             fprintf(stderr, "Couldn't find the header of a flight log in the file '%s', is this the right kind of file?\n\n", filename);
             continue;
         }
 
+        if (options.inventory) {
+            printInventory(log, filename, inventoryCount == 0);
+            inventoryCount++;
+
+            flightLogDestroy(log);
+            continue;
+        }
+
         if (options.logNumber > 0 || options.toStdout) {
             logIndex = validateLogIndex(log);
 
@@ -1453,5 +2413,18 @@ int main(int argc, char **argv)
         flightLogDestroy(log);
     }
 
+    if (options.inventory) {
+        printf("%s]\n", inventoryCount > 0 ? "\n" : "");
+    }
+
+    if (options.profile) {
+        profilePrintReport(stderr);
+
+        if (options.profileJSONFilename && !profileWriteJSON(options.profileJSONFilename)) {
+            fprintf(stderr, "Failed to write profile to '%s'\n", options.profileJSONFilename);
+            return -1;
+        }
+    }
+
     return 0;
 }
@@ -32,6 +32,11 @@
 #include "datapoints.h"
 #include "expo.h"
 #include "imu.h"
+#include "attitude.h"
+#include "spectrogram.h"
+#include "profile.h"
+#include "qoi.h"
+#include "hash.h"
 
 #define STR_HELPER(x) #x
 #define STR(x) STR_HELPER(x)
@@ -52,6 +57,8 @@
 
 #define DATAPOINTS_EXTRA_COMPUTED_FIELDS 6
 
+#define SPECTROGRAM_FFT_SIZE 256
+
 typedef enum Unit {
     UNIT_RAW = 0,
     UNIT_DEGREES_PER_SEC = 1
@@ -72,6 +79,16 @@ static const char* const PROP_STYLE_NAME[] = {
     "pie"
 };
 
+typedef enum ImageFormat {
+    IMAGE_FORMAT_PNG = 0,
+    IMAGE_FORMAT_QOI = 1
+} ImageFormat;
+
+static const char* const IMAGE_FORMAT_NAME[] = {
+    "png",
+    "qoi"
+};
+
 typedef struct point_t {
   double x, y;
 } point_t;
@@ -87,6 +104,8 @@ typedef struct colorAlpha_t {
 typedef struct pngRenderingTask_t {
     cairo_surface_t *surface;
     int outputLogIndex, outputFrameIndex;
+    // The number of frames after this one which are identical to it
+    int repeatCount;
 } pngRenderingTask_t;
 
 typedef struct craftDrawingParameters_t {
@@ -102,9 +121,18 @@ typedef struct craftDrawingParameters_t {
     color_t propColor[MAX_MOTORS];
 } craft_parameters_t;
 
+#define MAX_OUTPUT_SIZES 8
+
+typedef struct imageSize_t {
+    int width, height;
+} imageSize_t;
+
 typedef struct renderOptions_t {
     int logNumber;
     int imageWidth, imageHeight;
+    // If set, frames are laid out at imageWidth x imageHeight and then scaled to each of these sizes
+    imageSize_t outputSizes[MAX_OUTPUT_SIZES];
+    int outputSizeCount;
     int sticksTop, sticksRight, sticksWidth;
     int craftTop, craftRight, craftWidth;
     int fps;
@@ -112,7 +140,7 @@ typedef struct renderOptions_t {
     int threads;
 
     int plotPids, plotPidSum, plotGyros, plotMotors;
-    int drawPidTable, drawSticks, drawCraft, drawTime, drawAcc;
+    int drawPidTable, drawSticks, drawCraft, drawTime, drawAcc, drawSpectrogram;
 
     int pidSmoothing, gyroSmoothing, motorSmoothing;
 
@@ -123,7 +151,16 @@ typedef struct renderOptions_t {
     int gapless;
     int rawAmperage;
 
+    // Compute the attitude on the worker threads in segments, each warmed up over this many frames
+    int imuParallel, imuWarmupFrames;
+    int imuValidate;
+    int linkDuplicates;
+
+    int profile;
+    const char *profileJSONFilename;
+
     PropStyle propStyle;
+    ImageFormat imageFormat;
 
     //Start and end time of video in seconds offset from the beginning of the log
     uint32_t timeStart, timeEnd;
@@ -203,11 +240,11 @@ static const colorAlpha_t craftColor = {0.3, 0.3, 0.3, 1};
 
 static const renderOptions_t defaultOptions = {
     .imageWidth = 1920, .imageHeight = 1080,
-    .fps = 30, .help = 0, .threads = 3, .propStyle = PROP_STYLE_PIE_CHART,
+    .fps = 30, .help = 0, .threads = 3, .propStyle = PROP_STYLE_PIE_CHART, .imageFormat = IMAGE_FORMAT_PNG,
     .plotPids = false, .plotPidSum = false, .plotGyros = true, .plotMotors = true,
     .pidSmoothing = 4, .gyroSmoothing = 2, .motorSmoothing = 2,
     .drawCraft = true, .drawPidTable = true, .drawSticks = true, .drawTime = true,
-    .drawAcc = true,
+    .drawAcc = true, .drawSpectrogram = false,
     .sticksTop = 0, .sticksRight = 0, .sticksWidth = 0,
     .craftTop = 0, .craftRight = 0, .craftWidth = 0,
     .gyroUnit = UNIT_RAW,
@@ -216,6 +253,9 @@ static const renderOptions_t defaultOptions = {
     .logNumber = 0,
     .gapless = 0,
     .rawAmperage = 0,
+    .imuParallel = 0, .imuWarmupFrames = 10000, .imuValidate = 0,
+    .linkDuplicates = 1,
+    .profile = 0, .profileJSONFilename = NULL,
     .sticksTextColor = {1, 1, 1, 1},
     .stickColor = {1, 0.4, 0.4, 1.0},
     .stickAreaColor = {0.3, 0.3, 0.3, 0.8},
@@ -232,8 +272,33 @@ extern cairo_font_face_t* cairo_ft_font_face_create_for_ft_face(FT_Face face, in
 static renderOptions_t options;
 static expoCurve_t *pitchStickCurve, *pidCurve, *gyroCurve, *accCurve, *motorCurve, *servoCurve;
 
-static semaphore_t pngRenderingSem;
-static bool pngRenderingSemCreated = false;
+static profileProbe_t parseProbe = PROFILE_PROBE_INIT("render.parse");
+static profileProbe_t imuProbe = PROFILE_PROBE_INIT("render.imu");
+static profileProbe_t spectrogramProbe = PROFILE_PROBE_INIT("render.spectrogram");
+static profileProbe_t smoothingProbe = PROFILE_PROBE_INIT("render.smoothing");
+static profileProbe_t frameProbe = PROFILE_PROBE_INIT("render.frame");
+static profileProbe_t drawPlotLineProbe = PROFILE_PROBE_INIT("render.draw.plotLine");
+static profileProbe_t drawSpectrogramProbe = PROFILE_PROBE_INIT("render.draw.spectrogram");
+static profileProbe_t drawAxisLabelProbe = PROFILE_PROBE_INIT("render.draw.axisLabel");
+static profileProbe_t drawSticksProbe = PROFILE_PROBE_INIT("render.draw.sticks");
+static profileProbe_t drawPIDTableProbe = PROFILE_PROBE_INIT("render.draw.pidTable");
+static profileProbe_t drawCraftProbe = PROFILE_PROBE_INIT("render.draw.craft");
+static profileProbe_t drawAccelerometerProbe = PROFILE_PROBE_INIT("render.draw.accelerometer");
+static profileProbe_t drawFrameLabelProbe = PROFILE_PROBE_INIT("render.draw.frameLabel");
+static profileProbe_t pngProbe = PROFILE_PROBE_INIT("render.png");
+static profileProbe_t qoiProbe = PROFILE_PROBE_INIT("render.qoi");
+static profileProbe_t replayProbe = PROFILE_PROBE_INIT("render.replay");
+
+/*
+ * Frames are saved by a pool of options.threads threads which live until the program exits, so that each one keeps its
+ * cairo font caches from one frame to the next. saveSurfaceAsync() hands them frames through this ring of tasks.
+ */
+static semaphore_t pngRenderingSem; // Free slots in the pool
+static semaphore_t pngTaskQueuedSem; // Tasks waiting in the ring
+static semaphore_t pngTaskQueueLock;
+static pngRenderingTask_t **pngTaskQueue;
+static int pngTaskQueueHead, pngTaskQueueTail;
+static bool pngRenderingPoolCreated = false;
 
 static flightLog_t *flightLog;
 static datapoints_t *points;
@@ -248,7 +313,18 @@ static uint32_t syncBeepTime = -1;
 
 static point_t *stickTrails[2];
 
-void loadFrameIntoPoints(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+// The smoothed values shown by drawAccelerometerData()
+static double lastAccel = 0, lastVoltage = 0, lastCurrent = 0;
+static int lastAlt = 0;
+
+// One gyro spectrogram per lower graph (all axes combined, or one per axis if the graphs are split)
+static spectrogram_t *gyroSpectrograms[3];
+static int gyroSpectrogramCount = 0;
+
+static uint32_t spectrogramPalette[256];
+static cairo_surface_t *spectrogramTexture;
+
+void loadFrameIntoPoints(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
 {
     (void) log;
     (void) frameSize;
@@ -710,6 +786,8 @@ void plotLine(cairo_t *cr, color_t color, int64_t windowStartTime, int64_t windo
     bool drawingLine = false;
     double lastX, lastY;
 
+    PROFILE_BEGIN(draw_plot_line);
+
     //Draw points from this line until we leave the window
     for (int frameIndex = firstFrameIndex; frameIndex < points->frameCount; frameIndex++) {
         datapointsGetFieldAtIndex(points, frameIndex, fieldIndex, &fieldValue);
@@ -744,6 +822,8 @@ void plotLine(cairo_t *cr, color_t color, int64_t windowStartTime, int64_t windo
 
     cairo_set_source_rgb(cr, color.r, color.g, color.b);
     cairo_stroke(cr);
+
+    PROFILE_END(draw_plot_line, &drawPlotLineProbe);
 }
 
 void drawPIDTable(cairo_t *cr, int64_t *frame)
@@ -912,12 +992,16 @@ void drawAxisLabel(cairo_t *cr, const char *axisLabel)
 {
     cairo_text_extents_t extent;
 
+    PROFILE_BEGIN(draw_axis_label);
+
     cairo_set_font_size(cr, FONTSIZE_AXIS_LABEL);
     cairo_set_source_rgba(cr, 1, 1, 1, 0.9);
 
     cairo_text_extents(cr, axisLabel, &extent);
     cairo_move_to(cr, options.imageWidth - 8 - extent.width, -8);
     cairo_show_text(cr, axisLabel);
+
+    PROFILE_END(draw_axis_label, &drawAxisLabelProbe);
 }
 
 void drawFrameLabel(cairo_t *cr, uint32_t frameIndex, uint32_t frameTimeMsec)
@@ -957,8 +1041,6 @@ void drawAccelerometerData(cairo_t *cr, int64_t *frame)
     attitude_t attitude;
     t_fp_vector acceleration;
     double magnitude;
-    static double lastAccel = 0, lastVoltage = 0, lastCurrent = 0;
-    static int lastAlt = 0;
     cairo_text_extents_t extent;
 
     char labelBuf[32];
@@ -1049,19 +1131,255 @@ void drawAccelerometerData(cairo_t *cr, int64_t *frame)
     }
 }
 
-void* pngRenderThread(void *arg)
+/**
+ * Build a black-body style colour map for the spectrogram (quiet bins are dark, loud bins are bright yellow).
+ */
+static void buildSpectrogramPalette()
 {
-    char filename[256];
-    pngRenderingTask_t *task = (pngRenderingTask_t *) arg;
+    static const color_t stops[] = {
+        {0.0,  0.0,  0.02},
+        {0.34, 0.06, 0.43},
+        {0.73, 0.21, 0.33},
+        {0.98, 0.55, 0.04},
+        {0.99, 1.0,  0.64}
+    };
+    const int numStops = ARRAY_LENGTH(stops);
 
-    snprintf(filename, sizeof(filename), "%s.%02d.%06d.png", options.outputPrefix, task->outputLogIndex + 1, task->outputFrameIndex);
-    cairo_surface_write_to_png (task->surface, filename);
-    cairo_surface_destroy (task->surface);
+    for (int i = 0; i < 256; i++) {
+        double position = i / 255.0 * (numStops - 1);
+        int stop = (int) position;
+
+        if (stop > numStops - 2)
+            stop = numStops - 2;
+
+        double proportion = position - stop;
+        double r = stops[stop].r + (stops[stop + 1].r - stops[stop].r) * proportion;
+        double g = stops[stop].g + (stops[stop + 1].g - stops[stop].g) * proportion;
+        double b = stops[stop].b + (stops[stop + 1].b - stops[stop].b) * proportion;
+
+        spectrogramPalette[i] = 0xFF000000 | ((uint32_t) (r * 255 + 0.5) << 16) | ((uint32_t) (g * 255 + 0.5) << 8) | (uint32_t) (b * 255 + 0.5);
+    }
+}
+
+/**
+ * Draw the columns of the spectrogram which lie in the current window as a band plotHeight pixels above and below
+ * the origin, with low frequencies at the bottom. No transforms are computed here, the precomputed magnitudes
+ * are just colour-mapped into a texture which is then stretched over the window.
+ */
+void drawSpectrogram(cairo_t *cr, const spectrogram_t *spectrogram, int64_t windowStartTime, int64_t windowWidthMicros, int plotHeight)
+{
+    int textureWidth = cairo_image_surface_get_width(spectrogramTexture);
+    int stride = cairo_image_surface_get_stride(spectrogramTexture);
+    uint8_t *pixels;
+    char label[32];
+
+    double columnWidth = (double) options.imageWidth * 1000000 / spectrogram->columnsPerSecond / windowWidthMicros;
+    int firstColumn = (int) floor((double) (windowStartTime - spectrogram->startTime) * spectrogram->columnsPerSecond / 1000000 - 0.5);
+    double firstColumnX = (double) (spectrogram->startTime - windowStartTime) / windowWidthMicros * options.imageWidth + (firstColumn - 0.5) * columnWidth;
+
+    PROFILE_BEGIN(draw_spectrogram);
+
+    cairo_surface_flush(spectrogramTexture);
+    pixels = cairo_image_surface_get_data(spectrogramTexture);
+
+    for (int x = 0; x < textureWidth; x++) {
+        const uint8_t *column = spectrogramGetColumn(spectrogram, firstColumn + x);
+
+        for (int bin = 0; bin < spectrogram->binCount; bin++) {
+            uint32_t *pixel = (uint32_t *) (pixels + (spectrogram->binCount - 1 - bin) * stride) + x;
+
+            // Columns outside the log are left transparent
+            *pixel = column ? spectrogramPalette[column[bin]] : 0;
+        }
+    }
+
+    cairo_surface_mark_dirty(spectrogramTexture);
+
+    cairo_save(cr);
+    {
+        cairo_rectangle(cr, 0, -plotHeight, options.imageWidth, plotHeight * 2);
+        cairo_clip(cr);
+
+        cairo_translate(cr, firstColumnX, -plotHeight);
+        cairo_scale(cr, columnWidth, (double) plotHeight * 2 / spectrogram->binCount);
+
+        cairo_set_source_surface(cr, spectrogramTexture, 0, 0);
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
+        cairo_paint_with_alpha(cr, 0.6);
+    }
+    cairo_restore(cr);
+
+    // Label the frequency at the top of the band
+    snprintf(label, sizeof(label), "%d Hz", (int) spectrogram->maxFrequency);
+
+    cairo_set_font_size(cr, FONTSIZE_FRAME_LABEL);
+    cairo_set_source_rgba(cr, 1, 1, 1, 0.65);
+    cairo_move_to(cr, X_POS_LABEL, -plotHeight + FONTSIZE_FRAME_LABEL);
+    cairo_show_text(cr, label);
+
+    PROFILE_END(draw_spectrogram, &drawSpectrogramProbe);
+}
+
+/**
+ * Build the filename for the given frame, with the output size in the name if frames are being written at several
+ * sizes (size is NULL otherwise).
+ */
+static void frameFilename(char *filename, size_t filenameSize, const imageSize_t *size, int logIndex, int frameIndex)
+{
+    if (size) {
+        snprintf(filename, filenameSize, "%s.%dx%d.%02d.%06d.%s", options.outputPrefix, size->width, size->height,
+            logIndex + 1, frameIndex, IMAGE_FORMAT_NAME[options.imageFormat]);
+    } else {
+        snprintf(filename, filenameSize, "%s.%02d.%06d.%s", options.outputPrefix, logIndex + 1, frameIndex,
+            IMAGE_FORMAT_NAME[options.imageFormat]);
+    }
+}
+
+/**
+ * Make the file newName a copy of the existing one, as a hardlink if the filesystem allows it. Returns false on
+ * failure.
+ */
+static bool linkOrCopyFile(const char *existingName, const char *newName)
+{
+    char buffer[64 * 1024];
+    FILE *input, *output;
+    size_t length;
+    bool success = true;
+
+    // Replace frames left over from an earlier render rather than failing
+    remove(newName);
+
+    if (file_hardlink(existingName, newName)) {
+        return true;
+    }
+
+    input = fopen(existingName, "rb");
+
+    if (!input) {
+        return false;
+    }
+
+    output = fopen(newName, "wb");
+
+    if (!output) {
+        fclose(input);
+        return false;
+    }
+
+    while ((length = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+        if (fwrite(buffer, 1, length, output) != length) {
+            success = false;
+            break;
+        }
+    }
+
+    if (ferror(input)) {
+        success = false;
+    }
 
-    //Release our slot in the rendering pool, we're done
-    semaphore_signal(&pngRenderingSem);
+    fclose(input);
+
+    if (fclose(output) != 0) {
+        success = false;
+    }
+
+    return success;
+}
+
+/**
+ * Write the image surface to a file in the chosen output format, followed by links to it for the next repeatCount
+ * frames.
+ */
+static void writeFrame(cairo_surface_t *surface, const imageSize_t *size, int logIndex, int frameIndex, int repeatCount)
+{
+    char filename[256], repeatFilename[256];
+
+    frameFilename(filename, sizeof(filename), size, logIndex, frameIndex);
+
+    /*
+     * An earlier render may have left this name hardlinked to other frames, so unlink it rather than writing through
+     * the shared inode
+     */
+    remove(filename);
+
+    if (options.imageFormat == IMAGE_FORMAT_QOI) {
+        PROFILE_BEGIN(qoi);
+
+        cairo_surface_flush(surface);
+
+        if (!qoiWriteARGB32(filename, cairo_image_surface_get_data(surface), cairo_image_surface_get_width(surface),
+                cairo_image_surface_get_height(surface), cairo_image_surface_get_stride(surface))) {
+            fprintf(stderr, "Failed to write frame to '%s'\n", filename);
+        }
+
+        PROFILE_END(qoi, &qoiProbe);
+    } else {
+        PROFILE_BEGIN(png);
+        cairo_surface_write_to_png (surface, filename);
+        PROFILE_END(png, &pngProbe);
+    }
+
+    for (int i = 1; i <= repeatCount; i++) {
+        frameFilename(repeatFilename, sizeof(repeatFilename), size, logIndex, frameIndex + i);
+
+        if (!linkOrCopyFile(filename, repeatFilename)) {
+            fprintf(stderr, "Failed to write frame to '%s'\n", repeatFilename);
+        }
+    }
+}
+
+static void saveTask(pngRenderingTask_t *task)
+{
+
+    if (options.outputSizeCount > 0) {
+        // The frame was recorded rather than drawn, so play it back at each size in turn
+        for (int i = 0; i < options.outputSizeCount; i++) {
+            const imageSize_t *size = &options.outputSizes[i];
+
+            PROFILE_BEGIN(replay);
+
+            cairo_surface_t *image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size->width, size->height);
+            cairo_t *cr = cairo_create(image);
+
+            cairo_scale(cr, (double) size->width / options.imageWidth, (double) size->height / options.imageHeight);
+            cairo_set_source_surface(cr, task->surface, 0, 0);
+            cairo_paint(cr);
+            cairo_destroy(cr);
+
+            PROFILE_END(replay, &replayProbe);
+
+            writeFrame(image, size, task->outputLogIndex, task->outputFrameIndex, task->repeatCount);
+
+            cairo_surface_destroy(image);
+        }
+    } else {
+        writeFrame(task->surface, NULL, task->outputLogIndex, task->outputFrameIndex, task->repeatCount);
+    }
+
+    cairo_surface_destroy (task->surface);
 
     free(task);
+}
+
+void* pngRenderThread(void *arg)
+{
+    pngRenderingTask_t *task;
+
+    (void) arg;
+
+    while (1) {
+        semaphore_wait(&pngTaskQueuedSem);
+
+        semaphore_wait(&pngTaskQueueLock);
+        task = pngTaskQueue[pngTaskQueueHead];
+        pngTaskQueueHead = (pngTaskQueueHead + 1) % options.threads;
+        semaphore_signal(&pngTaskQueueLock);
+
+        saveTask(task);
+
+        //Release our slot in the rendering pool, we're done
+        semaphore_signal(&pngRenderingSem);
+    }
 
     return 0;
 }
@@ -1070,12 +1388,22 @@ void* pngRenderThread(void *arg)
  * PNG encoding is so slow and so easily run in parallel, so save the frames using this function
  * (which'll use extra threads to do the work). Be sure to call waitForFramesToSave() before
  * the program ends.
+ *
+ * The next repeatCount frames are saved as links to this one.
  */
-void saveSurfaceAsync(cairo_surface_t *surface, int logIndex, int outputFrameIndex)
+void saveSurfaceAsync(cairo_surface_t *surface, int logIndex, int outputFrameIndex, int repeatCount)
 {
-    if (!pngRenderingSemCreated) {
+    if (!pngRenderingPoolCreated) {
         semaphore_create(&pngRenderingSem, options.threads);
-        pngRenderingSemCreated = true;
+        semaphore_create(&pngTaskQueuedSem, 0);
+        semaphore_create(&pngTaskQueueLock, 1);
+        pngTaskQueue = malloc(options.threads * sizeof(*pngTaskQueue));
+
+        for (int i = 0; i < options.threads; i++) {
+            thread_create_detached(pngRenderThread, NULL);
+        }
+
+        pngRenderingPoolCreated = true;
     }
 
     pngRenderingTask_t *task = (pngRenderingTask_t*) malloc(sizeof(*task));
@@ -1083,24 +1411,139 @@ void saveSurfaceAsync(cairo_surface_t *surface, int logIndex, int outputFrameInd
     task->surface = surface;
     task->outputLogIndex = logIndex;
     task->outputFrameIndex = outputFrameIndex;
+    task->repeatCount = repeatCount;
 
     // Reserve a slot in the rendering pool...
     semaphore_wait(&pngRenderingSem);
 
-    thread_create_detached(pngRenderThread, task);
+    semaphore_wait(&pngTaskQueueLock);
+    pngTaskQueue[pngTaskQueueTail] = task;
+    pngTaskQueueTail = (pngTaskQueueTail + 1) % options.threads;
+    semaphore_signal(&pngTaskQueueLock);
+
+    semaphore_signal(&pngTaskQueuedSem);
 }
 
 void waitForFramesToSave()
 {
     int i;
 
-    if (pngRenderingSemCreated) {
+    if (pngRenderingPoolCreated) {
         for (i = 0; i < options.threads; i++) {
             semaphore_wait(&pngRenderingSem);
         }
     }
 }
 
+// Lines and gap markers centred this far outside the graph window can still reach into it
+#define GRAPH_WINDOW_MARGIN_PX 32
+
+/**
+ * Would plotLine() leave the window empty, because it falls before the start of the log, after the end, or inside a
+ * gap? Then the graphs look the same whatever time the window is showing.
+ */
+static bool graphWindowIsEmpty(int64_t windowStartTime, int64_t windowEndTime, int firstFrameIndex)
+{
+    int64_t margin = (windowEndTime - windowStartTime) * GRAPH_WINDOW_MARGIN_PX / options.imageWidth;
+    int64_t frameTime;
+
+    // A line of just one point draws nothing
+    if (!datapointsGetTimeAtIndex(points, firstFrameIndex, &frameTime) || frameTime >= windowEndTime) {
+        return true;
+    }
+
+    if (frameTime >= windowStartTime - margin) {
+        return false;
+    }
+
+    if (!datapointsGetTimeAtIndex(points, firstFrameIndex + 1, &frameTime)) {
+        return true;
+    }
+
+    // The line to the next point crosses the window, unless there's a gap between them (which is only marked at its ends)
+    return frameTime > windowEndTime + margin && !options.gapless && datapointsGetGapStartsAtIndex(points, firstFrameIndex);
+}
+
+static void hashFrameKey(hash128_t *key, const void *data, size_t length)
+{
+    *key = hash128(data, length, key->low ^ key->high);
+}
+
+/**
+ * Hash everything that goes into drawing this frame (including the state carried over from earlier frames, like the
+ * stick trails), so that a frame which would come out identical to the one before can be spotted without drawing it.
+ *
+ * Returns false if the frame has moving parts that the hash doesn't cover (like graph lines scrolling through the
+ * window) so it always needs to be drawn.
+ */
+static bool computeFrameKey(hash128_t *key, int64_t windowStartTime, int64_t windowEndTime, int firstFrameIndex,
+        bool haveCenterFrame, int64_t *frameValues, craft_parameters_t *craftParameters)
+{
+    key->low = 0;
+    key->high = 0;
+
+    if (!options.linkDuplicates) {
+        return false;
+    }
+
+    if ((options.plotMotors || options.plotPids || options.plotGyros)
+            && (gyroSpectrogramCount > 0 || !graphWindowIsEmpty(windowStartTime, windowEndTime, firstFrameIndex))) {
+        return false;
+    }
+
+    if (syncBeepTime >= windowStartTime && syncBeepTime < windowEndTime) {
+        return false;
+    }
+
+    hashFrameKey(key, &haveCenterFrame, sizeof(haveCenterFrame));
+
+    if (!haveCenterFrame) {
+        return true;
+    }
+
+    // The time label is different on every frame
+    if (options.drawTime) {
+        return false;
+    }
+
+    hashFrameKey(key, frameValues, points->fieldCount * sizeof(*frameValues));
+
+    if (options.drawSticks) {
+        for (int i = 0; i < 2; i++) {
+            hashFrameKey(key, &stickTrailCurrent[i], sizeof(stickTrailCurrent[i]));
+            hashFrameKey(key, stickTrails[i], stickTrailCurrent[i] * sizeof(*stickTrails[i]));
+        }
+    }
+
+    // Spinning propellers are drawn at a new angle on every frame
+    if (options.drawCraft && options.propStyle == PROP_STYLE_BLADES) {
+        for (int i = 0; i < craftParameters->numMotors; i++) {
+            if (flightLog->mainFieldIndexes.motor[i] > -1
+                    && frameValues[flightLog->mainFieldIndexes.motor[i]] > (int32_t) flightLog->sysConfig.motorOutputLow) {
+                return false;
+            }
+        }
+    }
+
+    if (options.drawAcc) {
+        hashFrameKey(key, &lastAccel, sizeof(lastAccel));
+        hashFrameKey(key, &lastVoltage, sizeof(lastVoltage));
+        hashFrameKey(key, &lastCurrent, sizeof(lastCurrent));
+        hashFrameKey(key, &lastAlt, sizeof(lastAlt));
+    }
+
+    return true;
+}
+
+static void printRenderProgress(uint32_t frameWrittenCount, uint32_t outputFrames)
+{
+    if (frameWrittenCount % 500 == 0 || frameWrittenCount == outputFrames) {
+        fprintf(stderr, "Rendered %d frames (%.1f%%)%s\n",
+            frameWrittenCount, (double)frameWrittenCount / outputFrames * 100,
+            frameWrittenCount < outputFrames ? "..." : ".");
+    }
+}
+
 void renderAnimation(uint32_t startFrame, uint32_t endFrame)
 {
     //Change how much data is displayed at one time
@@ -1126,6 +1569,14 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
 
     struct craftDrawingParameters_t craftParameters;
 
+    // The last frame drawn is held back until we know how many identical frames follow it
+    cairo_surface_t *heldSurface = NULL;
+    uint32_t heldFrameIndex = 0;
+    int heldRepeatCount = 0;
+    hash128_t heldFrameKey = {0, 0};
+    bool heldFrameKeyValid = false;
+    uint32_t duplicateFrameCount = 0;
+
     //If sync beep time looks reasonable, start the log there instead of at the first frame
     if (abs((int) ((int64_t)syncBeepTime - logStartTime)) < 1000000) //Expected to be well within 1 second of the start
         logStartTime = syncBeepTime;
@@ -1165,13 +1616,18 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
     fprintf(stderr, "%d frames to be rendered at %d FPS [%d:%02d]\n", outputFrames, options.fps, durationMins, durationSecs);
     fprintf(stderr, "\n");
 
+    if (gyroSpectrogramCount > 0) {
+        // Wide enough to hold every column which can be partially visible in the window
+        spectrogramTexture = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+            (int) ((int64_t) options.fps * windowWidthMicros / 1000000) + 2, gyroSpectrograms[0]->binCount);
+    }
+
     for (uint32_t outputFrameIndex = startFrame; outputFrameIndex < endFrame; outputFrameIndex++) {
         int64_t windowCenterTime = logStartTime + ((int64_t) outputFrameIndex * 1000000) / options.fps;
         int64_t windowStartTime = windowCenterTime - startXTimeOffset;
         int64_t windowEndTime = windowStartTime + windowWidthMicros;
-
-        cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, options.imageWidth, options.imageHeight);
-        cairo_t *cr = cairo_create(surface);
+        hash128_t frameKey;
+        bool frameKeyValid;
 
         // Find the frame just to the left of the first pixel so we can start drawing lines from there
         int firstFrameIndex = datapointsFindFrameAtTime(points, windowStartTime - 1);
@@ -1180,6 +1636,38 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
             firstFrameIndex = 0;
         }
 
+        int centerFrameIndex = datapointsFindFrameAtTime(points, windowCenterTime);
+        bool haveCenterFrame = datapointsGetFrameAtIndex(points, centerFrameIndex, &frameTime, frameValues);
+
+        frameKeyValid = computeFrameKey(&frameKey, windowStartTime, windowEndTime, firstFrameIndex, haveCenterFrame, frameValues,
+            &craftParameters);
+
+        if (frameKeyValid && heldFrameKeyValid && frameKey.low == heldFrameKey.low && frameKey.high == heldFrameKey.high) {
+            // This frame would look just like the last one, so save it as a link to that instead of drawing it
+            heldRepeatCount++;
+            duplicateFrameCount++;
+
+            lastCenterTime = windowCenterTime;
+
+            printRenderProgress(outputFrameIndex - startFrame + 1, outputFrames);
+            continue;
+        }
+
+        PROFILE_BEGIN(frame);
+
+        cairo_surface_t *surface;
+
+        if (options.outputSizeCount > 0) {
+            // Record the drawing so the worker threads can rasterise it at each of the output sizes
+            cairo_rectangle_t extents = {0, 0, options.imageWidth, options.imageHeight};
+
+            surface = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &extents);
+        } else {
+            surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, options.imageWidth, options.imageHeight);
+        }
+
+        cairo_t *cr = cairo_create(surface);
+
         cairo_set_font_face(cr, cairo_face);
 
         //Plot the upper motor graph
@@ -1229,6 +1717,10 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
 
                     cairo_translate(cr, 0, options.imageHeight * 0.2 * (axis - 1));
 
+                    if (gyroSpectrogramCount == 3) {
+                        drawSpectrogram(cr, gyroSpectrograms[axis], windowStartTime, windowWidthMicros, (int) (options.imageHeight * 0.1));
+                    }
+
                     drawAxisLine(cr);
 
                     for (int pidType = PID_D; pidType >= PID_P; pidType--) {
@@ -1299,6 +1791,10 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
                 //Plot three gyro axes on one graph
                 cairo_translate(cr, 0, options.imageHeight * 0.70);
 
+                if (gyroSpectrogramCount == 1) {
+                    drawSpectrogram(cr, gyroSpectrograms[0], windowStartTime, windowWidthMicros, (int) (options.imageHeight * 0.2));
+                }
+
                 drawAxisLine(cr);
 
                 for (int axis = 0; axis < 3; axis++) {
@@ -1323,10 +1819,8 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
             cairo_stroke(cr);
         }
 
-        int centerFrameIndex = datapointsFindFrameAtTime(points, windowCenterTime);
-
         //Draw the command stick positions from the centered frame
-        if (datapointsGetFrameAtIndex(points, centerFrameIndex, &frameTime, frameValues)) {
+        if (haveCenterFrame) {
             if (options.drawSticks) {
                 cairo_save(cr);
                 {
@@ -1341,7 +1835,9 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
                       cairo_translate(cr, 0.75 * options.imageWidth, 0.20 * options.imageHeight);
                     }
 
+                    PROFILE_BEGIN(draw_sticks);
                     drawCommandSticks(frameValues, options.imageWidth, options.imageHeight, cr);
+                    PROFILE_END(draw_sticks, &drawSticksProbe);
                 }
                 cairo_restore(cr);
             }
@@ -1350,7 +1846,9 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
                 cairo_save(cr);
                 {
                     cairo_translate(cr, 0.25 * options.imageWidth, 0.75 * options.imageHeight);
+                    PROFILE_BEGIN(draw_pid_table);
                     drawPIDTable(cr, frameValues);
+                    PROFILE_END(draw_pid_table, &drawPIDTableProbe);
                 }
                 cairo_restore(cr);
             }
@@ -1368,17 +1866,24 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
                       cairo_translate(cr, 0.75 * options.imageWidth, 0.20 * options.imageHeight);
                     }
 
+                    PROFILE_BEGIN(draw_craft);
                     drawCraft(cr, frameValues, outputFrameIndex > 0 ? windowCenterTime - lastCenterTime : 0, &craftParameters);
+                    PROFILE_END(draw_craft, &drawCraftProbe);
                 }
                 cairo_restore(cr);
             }
 
             if (options.drawAcc) {
+              PROFILE_BEGIN(draw_accelerometer);
               drawAccelerometerData(cr, frameValues);
+              PROFILE_END(draw_accelerometer, &drawAccelerometerProbe);
             }
 
-            if (options.drawTime)
+            if (options.drawTime) {
+                PROFILE_BEGIN(draw_frame_label);
                 drawFrameLabel(cr, frameValues[FLIGHT_LOG_FIELD_INDEX_ITERATION], (uint32_t) ((windowCenterTime - flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].min) / 1000));
+                PROFILE_END(draw_frame_label, &drawFrameLabelProbe);
+            }
         }
 
         // Draw a synchronisation line
@@ -1395,19 +1900,37 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
 
         cairo_destroy(cr);
 
-        lastCenterTime = windowCenterTime;
+        PROFILE_END(frame, &frameProbe);
 
-        saveSurfaceAsync(surface, selectedLogIndex, outputFrameIndex);
+        lastCenterTime = windowCenterTime;
 
-        uint32_t frameWrittenCount = outputFrameIndex - startFrame + 1;
-        if (frameWrittenCount % 500 == 0 || frameWrittenCount == outputFrames) {
-            fprintf(stderr, "Rendered %d frames (%.1f%%)%s\n",
-                frameWrittenCount, (double)frameWrittenCount / outputFrames * 100,
-                frameWrittenCount < outputFrames ? "..." : ".");
+        if (heldSurface) {
+            saveSurfaceAsync(heldSurface, selectedLogIndex, heldFrameIndex, heldRepeatCount);
         }
+
+        heldSurface = surface;
+        heldFrameIndex = outputFrameIndex;
+        heldRepeatCount = 0;
+        heldFrameKey = frameKey;
+        heldFrameKeyValid = frameKeyValid;
+
+        printRenderProgress(outputFrameIndex - startFrame + 1, outputFrames);
+    }
+
+    if (heldSurface) {
+        saveSurfaceAsync(heldSurface, selectedLogIndex, heldFrameIndex, heldRepeatCount);
     }
 
     waitForFramesToSave();
+
+    if (duplicateFrameCount > 0) {
+        fprintf(stderr, "%u frames were identical to the frame before them, so were linked to it rather than drawn.\n", duplicateFrameCount);
+    }
+
+    if (spectrogramTexture) {
+        cairo_surface_destroy(spectrogramTexture);
+        spectrogramTexture = NULL;
+    }
 }
 
 void printUsage(const char *argv0)
@@ -1425,9 +1948,12 @@ void printUsage(const char *argv0)
         "   --index <num>          Choose which log from the file should be rendered\n"
         "   --width <px>           Choose the width of the image (default %d)\n"
         "   --height <px>          Choose the height of the image (default %d)\n"
+        "   --sizes <list>         Write the frames at each of these sizes instead (e.g. 3840x2160,640x360), which\n"
+        "                          must have the same aspect ratio as --width and --height\n"
         "   --fps                  FPS of the resulting video (default %d)\n"
         "   --threads              Number of threads to use to render frames (default %d)\n"
         "   --prefix <filename>    Set the prefix of the output frame filenames\n"
+        "   --format <name>        Image format of the frames (png/qoi, default %s)\n"
         "   --start <x:xx>         Begin the log at this time offset (default 0:00)\n"
         "   --end <x:xx>           End the log at this time offset\n"
         "   --[no-]draw-pid-table  Show table with PIDs and gyros (default on)\n"
@@ -1435,6 +1961,7 @@ void printUsage(const char *argv0)
         "   --[no-]draw-sticks     Show RC command sticks (default on)\n"
         "   --[no-]draw-time       Show frame number and time in bottom right (default on)\n"
         "   --[no-]draw-acc        Show accelerometer data and amperage in bottom left (default on)\n"
+        "   --[no-]draw-spectrogram Show a gyro noise spectrogram behind the lower graph (default off)\n"
         "   --[no-]plot-motor      Draw motors on the upper graph (default on)\n"
         "   --[no-]plot-pid        Draw PIDs on the lower graph (default off)\n"
         "   --[no-]plot-gyro       Draw gyroscopes on the lower graph (default on)\n"
@@ -1452,15 +1979,23 @@ void printUsage(const char *argv0)
         "   --prop-style <name>    Style of propeller display (pie/blades, default %s)\n"
         "   --gapless              Fill in gaps in the log with straight lines\n"
         "   --raw-amperage         Print the current sensor ADC value along with computed amperage\n"
+        "   --imu-parallel         Compute the attitude in segments on --threads threads\n"
+        "   --imu-warmup <frames>  Frames to run the attitude filter for before each segment (default %d)\n"
+        "   --imu-validate         Report how far the segmented attitude is from computing it in one piece\n"
+        "   --[no-]link-duplicates Save frames identical to the one before as links to it (default on)\n"
         "   --sticks-text-color    Set the RGBA text color (default 1.0,1.0,1.0,1.0)\n"
         "   --sticks-color         Set the RGBA sticks color (default 1.0,0.4,0.4,1.0)\n"
         "   --sticks-area-color    Set the RGBA sticks area color (default 0.3,0.3,0.3,0.8)\n"
         "   --sticks-cross-color   Set the RGBA sticks area color (default 0.75,0.75,0.75,0.5)\n"
         "   --sticks-trail-length <px> Length of the stick trails (default %d)\n"
         "   --sticks-trail-color   Set the RGBA stick trail color (default 1.0,1.0,1.0,1.0)\n"
+        "   --profile              Print a breakdown of the time spent in each stage of rendering\n"
+        "   --profile-json <file>  Also write the --profile breakdown to this file as JSON\n"
         "\n", argv0, defaultOptions.imageWidth, defaultOptions.imageHeight, defaultOptions.fps, defaultOptions.threads,
+            IMAGE_FORMAT_NAME[defaultOptions.imageFormat],
             defaultOptions.pidSmoothing, defaultOptions.gyroSmoothing, defaultOptions.motorSmoothing,
-            UNIT_NAME[defaultOptions.gyroUnit], PROP_STYLE_NAME[defaultOptions.propStyle], defaultOptions.stickTrailLength
+            UNIT_NAME[defaultOptions.gyroUnit], PROP_STYLE_NAME[defaultOptions.propStyle], defaultOptions.imuWarmupFrames,
+            defaultOptions.stickTrailLength
     );
 }
 
@@ -1532,6 +2067,43 @@ bool parseTextColor(const char *text, colorAlpha_t *color) {
   return true;
 }
 
+/**
+ * Parse a list of image sizes like "3840x2160,1920x1080" into options.outputSizes.
+ */
+bool parseOutputSizes(const char *text)
+{
+    const char *cur = text;
+
+    options.outputSizeCount = 0;
+
+    while (*cur) {
+        imageSize_t size;
+        char *end;
+
+        if (options.outputSizeCount == MAX_OUTPUT_SIZES) {
+            return false;
+        }
+
+        size.width = strtol(cur, &end, 10);
+
+        if (*end != 'x') {
+            return false;
+        }
+
+        size.height = strtol(end + 1, &end, 10);
+
+        if (size.width <= 0 || size.height <= 0 || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+
+        options.outputSizes[options.outputSizeCount++] = size;
+
+        cur = *end == ',' ? end + 1 : end;
+    }
+
+    return options.outputSizeCount > 0;
+}
+
 Unit parseUnit(const char *s)
 {
     if (strcmp(s, "degree") == 0 || strcmp(s, "degrees") == 0)
@@ -1571,6 +2143,10 @@ void parseCommandlineOptions(int argc, char **argv)
         SETTING_CRAFT_WIDTH,
         SETTING_STICK_RADIUS,
         SETTING_STICK_TRAIL_RADIUS,
+        SETTING_PROFILE_JSON,
+        SETTING_FORMAT,
+        SETTING_SIZES,
+        SETTING_IMU_WARMUP,
     };
 
     memcpy(&options, &defaultOptions, sizeof(options));
@@ -1597,11 +2173,13 @@ void parseCommandlineOptions(int argc, char **argv)
             {"draw-sticks", no_argument, &options.drawSticks, 1},
             {"draw-time", no_argument, &options.drawTime, 1},
             {"draw-acc", no_argument, &options.drawAcc, 1},
+            {"draw-spectrogram", no_argument, &options.drawSpectrogram, 1},
             {"no-draw-pid-table", no_argument, &options.drawPidTable, 0},
             {"no-draw-craft", no_argument, &options.drawCraft, 0},
             {"no-draw-sticks", no_argument, &options.drawSticks, 0},
             {"no-draw-time", no_argument, &options.drawTime, 0},
             {"no-draw-acc", no_argument, &options.drawAcc, 0},
+            {"no-draw-spectrogram", no_argument, &options.drawSpectrogram, 0},
             {"smoothing-pid", required_argument, 0, SETTING_SMOOTHING_PID},
             {"smoothing-gyro", required_argument, 0, SETTING_SMOOTHING_GYRO},
             {"smoothing-motor", required_argument, 0, SETTING_SMOOTHING_MOTOR},
@@ -1609,7 +2187,12 @@ void parseCommandlineOptions(int argc, char **argv)
             {"prop-style", required_argument, 0, SETTING_PROP_STYLE},
             {"threads", required_argument, 0, SETTING_THREADS},
             {"gapless", no_argument, &options.gapless, 1},
+            {"imu-parallel", no_argument, &options.imuParallel, 1},
+            {"imu-warmup", required_argument, 0, SETTING_IMU_WARMUP},
+            {"imu-validate", no_argument, &options.imuValidate, 1},
             {"raw-amperage", no_argument, &options.rawAmperage, 1},
+            {"link-duplicates", no_argument, &options.linkDuplicates, 1},
+            {"no-link-duplicates", no_argument, &options.linkDuplicates, 0},
             {"sticks-top", required_argument, 0, SETTING_STICKS_TOP},
             {"sticks-right", required_argument, 0, SETTING_STICKS_RIGHT},
             {"sticks-width", required_argument, 0, SETTING_STICKS_WIDTH},
@@ -1624,6 +2207,10 @@ void parseCommandlineOptions(int argc, char **argv)
             {"craft-width", required_argument, 0, SETTING_CRAFT_WIDTH},
             {"sticks-radius", required_argument, 0, SETTING_STICK_RADIUS},
             {"sticks-trail-radius", required_argument, 0, SETTING_STICK_TRAIL_RADIUS},
+            {"profile", no_argument, &options.profile, 1},
+            {"profile-json", required_argument, 0, SETTING_PROFILE_JSON},
+            {"format", required_argument, 0, SETTING_FORMAT},
+            {"sizes", required_argument, 0, SETTING_SIZES},
             {0, 0, 0, 0}
         };
 
@@ -1683,6 +2270,12 @@ void parseCommandlineOptions(int argc, char **argv)
             case SETTING_HEIGHT:
                 options.imageHeight = atoi(optarg);
             break;
+            case SETTING_SIZES:
+                if (!parseOutputSizes(optarg)) {
+                    fprintf(stderr, "Bad --sizes list \"%s\", expected up to %d sizes like 3840x2160,1920x1080\n", optarg, MAX_OUTPUT_SIZES);
+                    exit(-1);
+                }
+            break;
             case SETTING_FPS:
                 options.fps = atoi(optarg);
             break;
@@ -1707,6 +2300,12 @@ void parseCommandlineOptions(int argc, char **argv)
                     options.threads = 1;
                 }
             break;
+            case SETTING_IMU_WARMUP:
+                options.imuWarmupFrames = atoi(optarg);
+                if (options.imuWarmupFrames < 0) {
+                    options.imuWarmupFrames = 0;
+                }
+            break;
             case SETTING_INDEX:
                 options.logNumber = atoi(optarg);
             break;
@@ -1732,6 +2331,20 @@ void parseCommandlineOptions(int argc, char **argv)
             case SETTING_STICK_TRAIL_RADIUS:
                 options.stickTrailRadius = atoi(optarg);
             break;
+            case SETTING_PROFILE_JSON:
+                options.profile = 1;
+                options.profileJSONFilename = optarg;
+            break;
+            case SETTING_FORMAT:
+                if (strcmp(optarg, "qoi") == 0) {
+                    options.imageFormat = IMAGE_FORMAT_QOI;
+                } else if (strcmp(optarg, "png") == 0) {
+                    options.imageFormat = IMAGE_FORMAT_PNG;
+                } else {
+                    fprintf(stderr, "Unknown image format \"%s\", expected png or qoi\n", optarg);
+                    exit(-1);
+                }
+            break;
             case SETTING_STICK_TRAIL_LENGTH:
                 options.stickTrailLength = atoi(optarg);
             break;
@@ -1762,6 +2375,19 @@ void parseCommandlineOptions(int argc, char **argv)
         }
     }
 
+    // Frames are drawn at --width x --height and scaled to each size, so a different shape would stretch them
+    for (int i = 0; i < options.outputSizeCount; i++) {
+        const imageSize_t *size = &options.outputSizes[i];
+        // Allow the sizes to be a pixel off, since the exact size might not be a whole number of pixels
+        int64_t mismatch = llabs((int64_t) size->width * options.imageHeight - (int64_t) size->height * options.imageWidth);
+
+        if (mismatch > options.imageWidth && mismatch > options.imageHeight) {
+            fprintf(stderr, "Size %dx%d in --sizes doesn't have the same aspect ratio as the %dx%d frame (set with --width and --height)\n",
+                size->width, size->height, options.imageWidth, options.imageHeight);
+            exit(-1);
+        }
+    }
+
     if (optind < argc) {
         options.filename = argv[optind];
     }
@@ -1790,39 +2416,41 @@ static void applySmoothing() {
     }
 }
 
+static void getAttitudeSettings(attitudeFields_t *fields, attitudeSettings_t *settings)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        fields->gyroADC[axis] = flightLog->mainFieldIndexes.gyroADC[axis];
+        fields->accSmooth[axis] = flightLog->mainFieldIndexes.accSmooth[axis];
+        fields->magADC[axis] = fieldMeta.hasMagADC ? flightLog->mainFieldIndexes.magADC[axis] : -1;
+    }
+
+    fields->roll = fieldMeta.roll;
+    fields->pitch = fieldMeta.pitch;
+    fields->heading = fieldMeta.heading;
+
+    settings->acc_1G = flightLog->sysConfig.acc_1G;
+    settings->gyroScale = flightLog->sysConfig.gyroScale;
+    // The attitude is only used to draw the craft, so it doesn't need to be exact
+    settings->fastMath = true;
+    settings->warmupFrames = options.imuWarmupFrames;
+}
+
 void computeExtraFields(void) {
-    int16_t accSmooth[3], gyroADC[3], magADC[3];
     int64_t frameTime, lastFrameTime = 0;
     int32_t frameIndex;
     int64_t frame[FLIGHT_LOG_MAX_FIELDS];
     double cumulativeCurrent = 0.0; // in milliamp-hours
-    attitude_t attitude;
-    bool calculateAttitude = fieldMeta.hasGyros && fieldMeta.hasAccs && flightLog->sysConfig.acc_1G;
 
-    imuInit();
+    if (fieldMeta.hasGyros && fieldMeta.hasAccs && flightLog->sysConfig.acc_1G) {
+        attitudeFields_t fields;
+        attitudeSettings_t settings;
+
+        getAttitudeSettings(&fields, &settings);
+        attitudeCompute(points, &fields, &settings, options.imuParallel ? options.threads : 1);
+    }
 
     for (frameIndex = 0; frameIndex < points->frameCount; frameIndex++) {
         if (datapointsGetFrameAtIndex(points, frameIndex, &frameTime, frame)) {
-            if (calculateAttitude) {
-                for (int axis = 0; axis < 3; axis++) {
-                    accSmooth[axis] = frame[flightLog->mainFieldIndexes.accSmooth[axis]];
-                    gyroADC[axis] = frame[flightLog->mainFieldIndexes.gyroADC[axis]];
-                }
-
-                if (fieldMeta.hasMagADC) {
-                    for (int axis = 0; axis < 3; axis++) {
-                        magADC[axis] = frame[flightLog->mainFieldIndexes.magADC[axis]];
-                    }
-                }
-
-                updateEstimatedAttitude(gyroADC, accSmooth, fieldMeta.hasMagADC ? magADC : 0, (uint32_t) frameTime, flightLog->sysConfig.acc_1G, flightLog->sysConfig.gyroScale, &attitude);
-
-                //Pack those floats into signed ints to store into the datapoints array:
-                datapointsSetFieldAtIndex(points, frameIndex, fieldMeta.roll, floatToInt(attitude.roll));
-                datapointsSetFieldAtIndex(points, frameIndex, fieldMeta.pitch, floatToInt(attitude.pitch));
-                datapointsSetFieldAtIndex(points, frameIndex, fieldMeta.heading, floatToInt(attitude.heading));
-            }
-
             if (fieldMeta.hasPIDs) {
                 for (int axis = 0; axis < 3; axis++) {
                     int32_t pidSum = frame[flightLog->mainFieldIndexes.pid[PID_P][axis]] + frame[flightLog->mainFieldIndexes.pid[PID_I][axis]] + frame[flightLog->mainFieldIndexes.pid[PID_D][axis]];
@@ -1845,6 +2473,67 @@ void computeExtraFields(void) {
     }
 }
 
+/**
+ * Print the largest difference between the segmented attitude and the attitude computed in one piece.
+ */
+static void validateAttitude(void)
+{
+    attitudeFields_t fields;
+    attitudeSettings_t settings;
+    attitude_t divergence;
+
+    if (!(fieldMeta.hasGyros && fieldMeta.hasAccs && flightLog->sysConfig.acc_1G)) {
+        fprintf(stderr, "This log has no attitude to validate\n");
+        return;
+    }
+
+    getAttitudeSettings(&fields, &settings);
+    attitudeMaxDivergence(points, &fields, &settings, &divergence);
+
+    fprintf(stderr, "Segmented attitude differs by at most roll %.2e, pitch %.2e, heading %.2e radians%s\n",
+        divergence.roll, divergence.pitch, divergence.heading,
+        fieldMeta.hasMagADC ? "" : " (no magnetometer, so heading is relative to each segment)");
+}
+
+/**
+ * Precompute the gyro spectrograms for the whole log, with one column per output video frame, so that rendering a
+ * frame doesn't require any transforms.
+ */
+void computeSpectrograms(void)
+{
+    // Allow for the window extending half a second either side of the log
+    int64_t startTime = flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].min - 500000;
+    int64_t endTime = flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].max + 500000;
+
+    if (options.bottomGraphSplitAxes) {
+        for (int axis = 0; axis < 3; axis++) {
+            gyroSpectrograms[axis] = spectrogramCreate(points, &flightLog->mainFieldIndexes.gyroADC[axis], 1, startTime, endTime,
+                options.fps, SPECTROGRAM_FFT_SIZE, options.threads);
+        }
+        gyroSpectrogramCount = 3;
+    } else {
+        gyroSpectrograms[0] = spectrogramCreate(points, flightLog->mainFieldIndexes.gyroADC, 3, startTime, endTime,
+            options.fps, SPECTROGRAM_FFT_SIZE, options.threads);
+        gyroSpectrogramCount = 1;
+    }
+
+    for (int i = 0; i < gyroSpectrogramCount; i++) {
+        if (!gyroSpectrograms[i]) {
+            fprintf(stderr, "This log is too short to compute a gyro spectrogram from, so it won't be drawn.\n");
+
+            for (int j = 0; j < gyroSpectrogramCount; j++) {
+                spectrogramDestroy(gyroSpectrograms[j]);
+                gyroSpectrograms[j] = NULL;
+            }
+            gyroSpectrogramCount = 0;
+
+            return;
+        }
+    }
+
+    buildSpectrogramPalette();
+}
+
 int chooseLog(flightLog_t *log)
 {
     if (!log || log->logCount == 0) {
@@ -1868,13 +2557,30 @@ int chooseLog(flightLog_t *log)
 
         fprintf(stderr, "Index  Start offset  Size (bytes)\n");
         for (int i = 0; i < log->logCount; i++) {
-            fprintf(stderr, "%5d %13d %13d\n", i + 1, (int) (log->logBegin[i] - log->logBegin[0]), (int) (log->logBegin[i + 1] - log->logBegin[i]));
+            fprintf(stderr, "%5d %13" PRId64 " %13" PRId64 "\n", i + 1, (int64_t) (log->logBegin[i] - log->logBegin[0]), (int64_t) (log->logBegin[i + 1] - log->logBegin[i]));
         }
 
         return -1;
     }
 }
 
+/**
+ * Ask cairo to give each thread its own cache of fonts and glyphs, so that the threads playing frames back at several
+ * --sizes don't take turns to draw their text. Only a cairo built from lib/cairo-1.14 can do this, so look the call up
+ * at runtime and carry on with the shared caches otherwise.
+ */
+static void enablePerThreadFontCaches(void)
+{
+    typedef cairo_bool_t (*setPerThreadCaches_t)(cairo_bool_t enabled);
+
+    setPerThreadCaches_t setPerThreadCaches = (setPerThreadCaches_t) library_function("libcairo-2.dll",
+        "cairo_scaled_font_set_per_thread_caches");
+
+    if (setPerThreadCaches) {
+        setPerThreadCaches(1);
+    }
+}
+
 int main(int argc, char **argv)
 {
     struct stat directoryStat;
@@ -1894,6 +2600,14 @@ int main(int argc, char **argv)
 
     options.bottomGraphSplitAxes = options.plotPids;
 
+    if (options.threads > 1) {
+        enablePerThreadFontCaches();
+    }
+
+    if (options.profile) {
+        profileEnable();
+    }
+
     stickTrails[0] = malloc(options.stickTrailLength * sizeof(struct point_t));
     stickTrails[1] = malloc(options.stickTrailLength * sizeof(struct point_t));
 
@@ -1943,6 +2657,8 @@ int main(int argc, char **argv)
         snprintf(options.outputPrefix, 256, "%s/%.*s", outputDirectory, (int) (logNameEnd - logNameStart), logNameStart);
     }
 
+    PROFILE_BEGIN(parse);
+
     //First check out how many frames we need to store so we can pre-allocate (parsing will update the flightlog stats which contain that info)
     flightLogParse(flightLog, selectedLogIndex, NULL, NULL, NULL, false);
 
@@ -1990,11 +2706,28 @@ int main(int argc, char **argv)
     //Now decode the flight log into the points array
     flightLogParse(flightLog, selectedLogIndex, 0, loadFrameIntoPoints, onLogEvent, false);
 
+    PROFILE_END(parse, &parseProbe);
+
     updateFieldMetadata();
 
+    PROFILE_BEGIN(imu);
     computeExtraFields();
+    PROFILE_END(imu, &imuProbe);
+
+    if (options.imuValidate) {
+        validateAttitude();
+    }
+
+    // Compute the spectrum before smoothing, since smoothing would filter out the noise we want to see
+    if (options.drawSpectrogram && fieldMeta.hasGyros) {
+        PROFILE_BEGIN(spectrogram);
+        computeSpectrograms();
+        PROFILE_END(spectrogram, &spectrogramProbe);
+    }
 
+    PROFILE_BEGIN(smoothing);
     applySmoothing();
+    PROFILE_END(smoothing, &smoothingProbe);
 
     frameStart = options.timeStart * options.fps;
 
@@ -2011,5 +2744,14 @@ int main(int argc, char **argv)
 
     renderAnimation(frameStart, frameEnd);
 
+    if (options.profile) {
+        profilePrintReport(stderr);
+
+        if (options.profileJSONFilename && !profileWriteJSON(options.profileJSONFilename)) {
+            fprintf(stderr, "Failed to write profile to '%s'\n", options.profileJSONFilename);
+            return -1;
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,237 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+    #include "getopt.h"
+#else
+    #include <getopt.h>
+#endif
+
+#include "parser.h"
+#include "platform.h"
+#include "tools.h"
+#include "logrepair.h"
+
+#ifndef O_BINARY
+    #define O_BINARY 0
+#endif
+
+typedef struct repairOptions_t {
+    int help;
+    const char *outputFilename;
+} repairOptions_t;
+
+static repairOptions_t options = {
+    .help = 0,
+    .outputFilename = NULL,
+};
+
+static void onGap(flightLog_t *log, const logRepairGap_t *gap)
+{
+    char where[128];
+
+    (void) log;
+
+    if (gap->atEnd) {
+        if (gap->haveFrameBefore && gap->haveFrameAfter) {
+            snprintf(where, sizeof(where), "End of the log, iterations %u to at least %u", gap->iterationBefore + 1, gap->iterationAfter);
+        } else if (gap->haveFrameBefore) {
+            snprintf(where, sizeof(where), "End of the log, after iteration %u", gap->iterationBefore);
+        } else if (gap->haveFrameAfter) {
+            snprintf(where, sizeof(where), "End of the log, up to at least iteration %u", gap->iterationAfter);
+        } else {
+            snprintf(where, sizeof(where), "End of the log");
+        }
+    } else if (gap->haveFrameBefore) {
+        if (gap->iterationAfter > gap->iterationBefore + 1) {
+            snprintf(where, sizeof(where), "Iterations %u to %u (%.3f seconds)", gap->iterationBefore + 1, gap->iterationAfter - 1,
+                (gap->timeAfter - gap->timeBefore) / 1000000.0);
+        } else {
+            snprintf(where, sizeof(where), "After iteration %u", gap->iterationBefore);
+        }
+    } else {
+        snprintf(where, sizeof(where), "Before iteration %u", gap->iterationAfter);
+    }
+
+    fprintf(stderr, "  %s: dropped %u main frames, %u corrupt frames and %u GPS frames (%" PRId64 " bytes)\n",
+        where, gap->dropped.mainFrames, gap->dropped.corruptFrames, gap->dropped.gpsFrames, gap->dropped.bytes);
+}
+
+void printUsage(const char *argv0)
+{
+    fprintf(stderr,
+        "Blackbox flight log repair tool by Nicholas Sherlock ("
+#ifdef BLACKBOX_VERSION
+            "v" STR(BLACKBOX_VERSION) ", "
+#endif
+            __DATE__ " " __TIME__ ")\n\n"
+        "Usage:\n"
+        "     %s [options] <input log>\n\n"
+        "Decodes each flight log in the file and writes out what survived without the damaged parts, with a fresh\n"
+        "I-frame after every gap, so the result decodes without any resynchronisation.\n\n"
+        "Options:\n"
+        "   --help                   This page\n"
+        "   --output <file>          Write the repaired logs here (default is <input>.repaired.<extension>)\n"
+        "\n", argv0
+    );
+}
+
+void parseCommandlineOptions(int argc, char **argv)
+{
+    int c;
+
+    enum {
+        SETTING_OUTPUT = 1,
+    };
+
+    while (1)
+    {
+        static struct option long_options[] = {
+            {"help", no_argument, &options.help, 1},
+            {"output", required_argument, 0, SETTING_OUTPUT},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+
+        opterr = 0;
+
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case SETTING_OUTPUT:
+                options.outputFilename = optarg;
+            break;
+            case '\0':
+                //Longopt which has set a flag
+            break;
+            case ':':
+                fprintf(stderr, "%s: option '%s' requires an argument\n", argv[0], argv[optind-1]);
+                exit(-1);
+            break;
+            default:
+                if (optopt == 0)
+                    fprintf(stderr, "%s: option '%s' is invalid\n", argv[0], argv[optind-1]);
+                else
+                    fprintf(stderr, "%s: option '-%c' is invalid\n", argv[0], optopt);
+
+                exit(-1);
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    flightLog_t *log;
+    logRepairStats_t stats;
+    const char *filename, *extension, *outputFilename;
+    char *defaultOutputFilename = NULL;
+    FILE *output;
+    int fd, prefixLen, repairedCount = 0;
+    bool writeFailed;
+
+    platform_init();
+
+    parseCommandlineOptions(argc, argv);
+
+    if (options.help || argc - optind != 1) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    filename = argv[optind];
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open log file '%s': %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    log = flightLogCreateWithIOBackend(fd, IO_BACKEND_MMAP, false);
+
+    if (!log) {
+        fprintf(stderr, "Failed to read log file '%s'\n", filename);
+        return -1;
+    }
+
+    if (log->logCount == 0) {
+        fprintf(stderr, "Couldn't find the header of a flight log in the file '%s', is this the right kind of file?\n", filename);
+        return -1;
+    }
+
+    if (options.outputFilename) {
+        outputFilename = options.outputFilename;
+    } else {
+        // Keep the input's extension, since other tools often recognise logs by it
+        extension = strrchr(filename, '.');
+
+        if (extension && strpbrk(extension, "/\\")) {
+            extension = NULL;
+        }
+
+        prefixLen = extension ? extension - filename : (int) strlen(filename);
+
+        defaultOutputFilename = malloc(strlen(filename) + strlen(".repaired.bbl") + 1);
+        sprintf(defaultOutputFilename, "%.*s.repaired%s", prefixLen, filename, extension ? extension : ".bbl");
+
+        outputFilename = defaultOutputFilename;
+    }
+
+    output = fopen(outputFilename, "wb");
+
+    if (!output) {
+        fprintf(stderr, "Failed to create output file '%s': %s\n", outputFilename, strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < log->logCount; i++) {
+        fprintf(stderr, "Log %d of %d:\n", i + 1, log->logCount);
+
+        if (!logRepairWrite(log, i, output, onGap, &stats)) {
+            // Better to keep the log as it was than lose it (nothing has been written for it yet)
+            fprintf(stderr, "  Can't encode this log's frames, copying it unrepaired\n");
+
+            fwrite(log->logBegin[i], 1, log->logBegin[i + 1] - log->logBegin[i], output);
+            continue;
+        }
+
+        fprintf(stderr, "  Kept %u main frames, dropped %u main frames, %u corrupt frames and %u GPS frames (%" PRId64 " bytes) in %u gaps, inserted %u resume events\n",
+            stats.mainFramesWritten, stats.dropped.mainFrames, stats.dropped.corruptFrames, stats.dropped.gpsFrames,
+            stats.dropped.bytes, stats.gaps, stats.resumesInserted);
+
+        repairedCount++;
+    }
+
+    writeFailed = ferror(output) != 0;
+
+    if (fclose(output) != 0 || writeFailed) {
+        fprintf(stderr, "Failed to write to '%s': %s\n", outputFilename, strerror(errno));
+        return -1;
+    }
+
+    fprintf(stderr, "Repaired %d of %d logs from '%s' into '%s'\n", repairedCount, log->logCount, filename, outputFilename);
+
+    free(defaultOutputFilename);
+
+    flightLogDestroy(log);
+
+    return 0;
+}
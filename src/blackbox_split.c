@@ -0,0 +1,426 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+    #include <sys/syscall.h>
+    #include <sys/sendfile.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef WIN32
+    #include "getopt.h"
+#else
+    #include <getopt.h>
+#endif
+
+#include "parser.h"
+#include "platform.h"
+#include "tools.h"
+
+#ifndef O_BINARY
+    #define O_BINARY 0
+#endif
+
+// Largest chunk to ask the kernel to copy at once (copy_file_range and sendfile copy at most about 2GB per call anyway)
+#define SPLIT_COPY_CHUNK (1024 * 1024 * 1024)
+
+typedef struct splitOptions_t {
+    int help;
+    const char *indexes;
+    const char *outputPrefix;
+    const char *manifestFilename;
+} splitOptions_t;
+
+static splitOptions_t options = {
+    .help = 0,
+    .indexes = NULL,
+    .outputPrefix = NULL,
+    .manifestFilename = NULL,
+};
+
+/**
+ * Copy `length` bytes at `offset` in the input file to the end of the output file using our own buffer, for when the
+ * kernel can't do the copy for us.
+ */
+static bool copyRangeBuffered(int inFD, int64_t offset, int64_t length, int outFD)
+{
+    const size_t bufferSize = 1024 * 1024;
+    char *buffer = malloc(bufferSize);
+    bool success = true;
+
+#ifdef WIN32
+    if (_lseeki64(inFD, offset, SEEK_SET) != offset) {
+        free(buffer);
+        return false;
+    }
+#endif
+
+    while (length > 0 && success) {
+        size_t chunk = length < (int64_t) bufferSize ? (size_t) length : bufferSize;
+#ifdef WIN32
+        int bytesRead = read(inFD, buffer, chunk);
+#else
+        ssize_t bytesRead = pread(inFD, buffer, chunk, offset);
+#endif
+
+        if (bytesRead <= 0) {
+            success = false;
+            break;
+        }
+
+        for (char *pos = buffer; pos < buffer + bytesRead; ) {
+            int written = write(outFD, pos, buffer + bytesRead - pos);
+
+            if (written <= 0) {
+                success = false;
+                break;
+            }
+
+            pos += written;
+        }
+
+        offset += bytesRead;
+        length -= bytesRead;
+    }
+
+    free(buffer);
+
+    return success;
+}
+
+/**
+ * Copy `length` bytes at `offset` in the input file to the (empty) output file.
+ *
+ * Where we can, we have the kernel copy the data without it passing through our address space. On Linux
+ * copy_file_range() reflinks the data on filesystems which share extents (btrfs, XFS) and does a server-side copy on
+ * NFS 4.2 and SMB, otherwise it copies within the page cache. sendfile() is used instead on kernels which don't allow
+ * copy_file_range() between these two files.
+ */
+static bool copyRange(int inFD, int64_t offset, int64_t length, int outFD)
+{
+#if defined(__linux__)
+    #ifdef SYS_copy_file_range
+    while (length > 0) {
+        int64_t inOffset = offset;
+        ssize_t copied = syscall(SYS_copy_file_range, inFD, &inOffset, outFD, NULL,
+            (size_t) (length < SPLIT_COPY_CHUNK ? length : SPLIT_COPY_CHUNK), 0);
+
+        if (copied <= 0)
+            break;
+
+        offset += copied;
+        length -= copied;
+    }
+    #endif
+
+    while (length > 0) {
+        off_t inOffset = offset;
+        ssize_t copied = sendfile(outFD, inFD, &inOffset, (size_t) (length < SPLIT_COPY_CHUNK ? length : SPLIT_COPY_CHUNK));
+
+        if (copied <= 0)
+            break;
+
+        offset += copied;
+        length -= copied;
+    }
+#endif
+
+    return length == 0 || copyRangeBuffered(inFD, offset, length, outFD);
+}
+
+/**
+ * Parse a list of log numbers like "1,3-5" into the `selected` array (indexed from zero). Returns false if the list is
+ * malformed.
+ */
+static bool parseIndexList(const char *list, bool *selected, int logCount)
+{
+    const char *pos = list;
+
+    while (*pos) {
+        char *end;
+        long first = strtol(pos, &end, 10), last;
+
+        if (end == pos)
+            return false;
+
+        pos = end;
+        last = first;
+
+        if (*pos == '-') {
+            pos++;
+            last = strtol(pos, &end, 10);
+
+            if (end == pos)
+                return false;
+
+            pos = end;
+        }
+
+        if (first < 1 || last < first) {
+            return false;
+        }
+
+        for (long i = first; i <= last && i <= logCount; i++) {
+            selected[i - 1] = true;
+        }
+
+        if (last > logCount) {
+            fprintf(stderr, "Warning: There are only %d logs in this file, so log %ld can't be split out\n", logCount, last);
+        }
+
+        if (*pos == ',') {
+            pos++;
+        } else if (*pos) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void printUsage(const char *argv0)
+{
+    fprintf(stderr,
+        "Blackbox flight log splitter by Nicholas Sherlock ("
+#ifdef BLACKBOX_VERSION
+            "v" STR(BLACKBOX_VERSION) ", "
+#endif
+            __DATE__ " " __TIME__ ")\n\n"
+        "Usage:\n"
+        "     %s [options] <input log>\n\n"
+        "Writes each flight log in the file to its own file, along with a JSON manifest of their offsets, sizes and\n"
+        "headers.\n\n"
+        "Options:\n"
+        "   --help                   This page\n"
+        "   --index <list>           Only split out these logs (e.g. \"1,3-5\"), default is all of them\n"
+        "   --prefix <name>          Begin the output filenames with this (default is the input filename)\n"
+        "   --manifest <file>        Write the manifest here instead of <prefix>.json (\"-\" for stdout)\n"
+        "\n", argv0
+    );
+}
+
+void parseCommandlineOptions(int argc, char **argv)
+{
+    int c;
+
+    enum {
+        SETTING_PREFIX = 1,
+        SETTING_INDEX,
+        SETTING_MANIFEST,
+    };
+
+    while (1)
+    {
+        static struct option long_options[] = {
+            {"help", no_argument, &options.help, 1},
+            {"index", required_argument, 0, SETTING_INDEX},
+            {"prefix", required_argument, 0, SETTING_PREFIX},
+            {"manifest", required_argument, 0, SETTING_MANIFEST},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+
+        opterr = 0;
+
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case SETTING_INDEX:
+                options.indexes = optarg;
+            break;
+            case SETTING_PREFIX:
+                options.outputPrefix = optarg;
+            break;
+            case SETTING_MANIFEST:
+                options.manifestFilename = optarg;
+            break;
+            case '\0':
+                //Longopt which has set a flag
+            break;
+            case ':':
+                fprintf(stderr, "%s: option '%s' requires an argument\n", argv[0], argv[optind-1]);
+                exit(-1);
+            break;
+            default:
+                if (optopt == 0)
+                    fprintf(stderr, "%s: option '%s' is invalid\n", argv[0], argv[optind-1]);
+                else
+                    fprintf(stderr, "%s: option '-%c' is invalid\n", argv[0], optopt);
+
+                exit(-1);
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    flightLog_t *log;
+    mmapStream_t *stream;
+    const char *filename, *extension;
+    char *outputFilename, *manifestFilename = NULL;
+    int outputPrefixLen, filenameLen;
+    FILE *manifest;
+    bool selected[FLIGHT_LOG_MAX_LOGS_IN_FILE];
+    bool firstLog = true;
+    int fd, splitCount = 0;
+
+    platform_init();
+
+    parseCommandlineOptions(argc, argv);
+
+    if (options.help || argc - optind != 1) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    filename = argv[optind];
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open log file '%s': %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    // We only need to map the file to find the logs, the data is copied straight from the file
+    log = flightLogCreateWithIOBackend(fd, IO_BACKEND_MMAP, false);
+
+    if (!log) {
+        fprintf(stderr, "Failed to read log file '%s'\n", filename);
+        return -1;
+    }
+
+    stream = log->private->stream;
+
+    if ((stream->mapping.stats.st_mode & S_IFMT) != S_IFREG) {
+        fprintf(stderr, "Only regular files can be split\n");
+        return -1;
+    }
+
+    if (log->logCount == 0) {
+        fprintf(stderr, "Couldn't find the header of a flight log in the file '%s', is this the right kind of file?\n", filename);
+        return -1;
+    }
+
+    memset(selected, options.indexes ? 0 : 1, sizeof(selected));
+
+    if (options.indexes && !parseIndexList(options.indexes, selected, log->logCount)) {
+        fprintf(stderr, "Bad log index list \"%s\" (it should look like \"1,3-5\")\n", options.indexes);
+        return -1;
+    }
+
+    // Output files keep the input's extension, since other tools often recognise logs by it
+    extension = strrchr(filename, '.');
+
+    if (extension && strpbrk(extension, "/\\")) {
+        extension = NULL;
+    }
+
+    if (options.outputPrefix) {
+        outputPrefixLen = strlen(options.outputPrefix);
+    } else {
+        outputPrefixLen = extension ? extension - filename : (int) strlen(filename);
+    }
+
+    if (!extension) {
+        extension = ".bbl";
+    }
+
+    filenameLen = outputPrefixLen + strlen(".000") + strlen(extension) + strlen(".json") + 1;
+    outputFilename = malloc(filenameLen);
+
+    if (options.manifestFilename && strcmp(options.manifestFilename, "-") == 0) {
+        manifest = stdout;
+    } else {
+        if (!options.manifestFilename) {
+            manifestFilename = malloc(filenameLen);
+            snprintf(manifestFilename, filenameLen, "%.*s.json", outputPrefixLen, options.outputPrefix ? options.outputPrefix : filename);
+        }
+
+        manifest = fopen(manifestFilename ? manifestFilename : options.manifestFilename, "wb");
+
+        if (!manifest) {
+            fprintf(stderr, "Failed to create manifest file %s\n", manifestFilename ? manifestFilename : options.manifestFilename);
+            return -1;
+        }
+    }
+
+    fprintf(manifest, "{\n  \"file\": ");
+    fprintJSONString(manifest, filename, strlen(filename));
+    fprintf(manifest, ",\n  \"size\": %" PRIu64 ",\n  \"logCount\": %d,\n  \"logs\": [", (uint64_t) stream->size, log->logCount);
+
+    for (int i = 0; i < log->logCount; i++) {
+        int64_t offset = log->logBegin[i] - stream->data;
+        int64_t size = log->logBegin[i + 1] - log->logBegin[i];
+        int outFD;
+
+        if (!selected[i])
+            continue;
+
+        snprintf(outputFilename, filenameLen, "%.*s.%02d%s", outputPrefixLen, options.outputPrefix ? options.outputPrefix : filename,
+            i + 1, extension);
+
+        outFD = open(outputFilename, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+
+        if (outFD < 0) {
+            fprintf(stderr, "Failed to create output file %s: %s\n", outputFilename, strerror(errno));
+            return -1;
+        }
+
+        fprintf(stderr, "Writing log %d (%" PRId64 " bytes) to '%s'...\n", i + 1, size, outputFilename);
+
+        if (!copyRange(fd, offset, size, outFD)) {
+            fprintf(stderr, "Failed to write log %d to %s: %s\n", i + 1, outputFilename, strerror(errno));
+            return -1;
+        }
+
+        if (close(outFD) != 0) {
+            fprintf(stderr, "Failed to write log %d to %s: %s\n", i + 1, outputFilename, strerror(errno));
+            return -1;
+        }
+
+        fprintf(manifest, "%s\n    {\n      \"index\": %d,\n      \"offset\": %" PRId64 ",\n      \"size\": %" PRId64 ",\n      \"output\": ",
+            firstLog ? "" : ",", i + 1, offset, size);
+        fprintJSONString(manifest, outputFilename, strlen(outputFilename));
+        fprintf(manifest, ",\n      \"headers\": ");
+        fprintHeaderLinesJSON(manifest, log->logBegin[i], log->logBegin[i + 1], 8);
+        fprintf(manifest, "\n    }");
+
+        firstLog = false;
+        splitCount++;
+    }
+
+    fprintf(manifest, "\n  ]\n}\n");
+
+    if (manifest != stdout && fclose(manifest) != 0) {
+        fprintf(stderr, "Failed to write the manifest\n");
+        return -1;
+    }
+
+    fprintf(stderr, "Split %d of %d logs from '%s'\n", splitCount, log->logCount, filename);
+
+    free(outputFilename);
+    free(manifestFilename);
+
+    flightLogDestroy(log);
+
+    return 0;
+}
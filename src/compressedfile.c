@@ -0,0 +1,426 @@
+// For fopencookie()
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+    #include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+    #include <zstd.h>
+#endif
+
+#include "platform.h"
+#include "compressedfile.h"
+
+/*
+ * Compressed output files are written as a series of independently compressed blocks, each of which is a complete gzip
+ * member or zstd frame (a file made of these concatenated together is still a valid .gz or .zst file). This lets a pool
+ * of threads compress several blocks at once while the caller carries on writing, and the compressed blocks are
+ * written out in order by the caller's thread as it needs their buffers back.
+ *
+ * The caller gets an ordinary stdio FILE (using fopencookie() or funopen()) so it can fprintf() to it as usual, and
+ * fclose() finishes the file.
+ */
+
+#if defined(__GLIBC__)
+    #define HAVE_FOPENCOOKIE
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+    #define HAVE_FUNOPEN
+#endif
+
+// Size of the uncompressed blocks
+#define COMPRESSED_FILE_BLOCK_LENGTH (1024 * 1024)
+
+// Size of the stdio buffer in front of our writer, so that we're called with large writes
+#define COMPRESSED_FILE_STDIO_BUFFER_LENGTH (64 * 1024)
+
+#define GZIP_LEVEL 6
+#define ZSTD_LEVEL 3
+
+static const char* const COMPRESSION_FORMAT_NAME[] = {
+    "none",
+    "gzip",
+    "zstd"
+};
+
+static const char* const COMPRESSION_FORMAT_EXTENSION[] = {
+    "",
+    ".gz",
+    ".zst"
+};
+
+bool compressionFormatFromName(const char *name, compressionFormat_e *format)
+{
+    for (int i = 0; i < (int) (sizeof(COMPRESSION_FORMAT_NAME) / sizeof(COMPRESSION_FORMAT_NAME[0])); i++) {
+        if (strcmp(name, COMPRESSION_FORMAT_NAME[i]) == 0) {
+            *format = (compressionFormat_e) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* compressionFormatName(compressionFormat_e format)
+{
+    return COMPRESSION_FORMAT_NAME[format];
+}
+
+/**
+ * Get the extension which is added to the names of files written in this format.
+ */
+const char* compressionFormatExtension(compressionFormat_e format)
+{
+    return COMPRESSION_FORMAT_EXTENSION[format];
+}
+
+/**
+ * Was this program built with support for writing files in the given format?
+ */
+bool compressionFormatAvailable(compressionFormat_e format)
+{
+    switch (format) {
+        case COMPRESSION_NONE:
+            return true;
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+    #ifdef HAVE_ZLIB
+        case COMPRESSION_GZIP:
+            return true;
+    #endif
+    #ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD:
+            return true;
+    #endif
+#endif
+        default:
+            return false;
+    }
+}
+
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+
+typedef struct compressedBlock_t {
+    compressionFormat_e format;
+
+    char *input;
+    size_t inputLength;
+
+    char *output;
+    size_t outputCapacity, outputLength;
+
+    bool failed;
+
+    // The worker thread waits on "ready" for a block to compress, and signals "done" when it has compressed it
+    semaphore_t ready, done;
+    bool quit;
+
+    // True if the block was handed to the worker and hasn't been written out yet
+    bool busy;
+} compressedBlock_t;
+
+typedef struct compressedFile_t {
+    FILE *file;
+    compressionFormat_e format;
+
+    // One block per worker thread, used round-robin so the next block to reuse is always the oldest one
+    compressedBlock_t *blocks;
+    int blockCount;
+    int nextBlock;
+    bool anyBlocksWritten;
+
+    // The data being collected for the next block
+    char *pending;
+    size_t pendingLength;
+
+    bool failed;
+} compressedFile_t;
+
+static void ensureOutputCapacity(compressedBlock_t *block, size_t capacity)
+{
+    if (block->outputCapacity < capacity) {
+        free(block->output);
+
+        block->output = malloc(capacity);
+        block->outputCapacity = capacity;
+    }
+}
+
+static bool compressBlock(compressedBlock_t *block)
+{
+    switch (block->format) {
+#ifdef HAVE_ZLIB
+        case COMPRESSION_GZIP: {
+            z_stream stream;
+            bool success;
+
+            memset(&stream, 0, sizeof(stream));
+
+            // 16 + the window size asks for a gzip header and trailer around the deflate stream
+            if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                return false;
+            }
+
+            ensureOutputCapacity(block, deflateBound(&stream, block->inputLength));
+
+            stream.next_in = (Bytef *) block->input;
+            stream.avail_in = block->inputLength;
+            stream.next_out = (Bytef *) block->output;
+            stream.avail_out = block->outputCapacity;
+
+            success = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+            block->outputLength = stream.total_out;
+
+            deflateEnd(&stream);
+
+            return success;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD: {
+            size_t result;
+
+            ensureOutputCapacity(block, ZSTD_compressBound(block->inputLength));
+
+            result = ZSTD_compress(block->output, block->outputCapacity, block->input, block->inputLength, ZSTD_LEVEL);
+
+            if (ZSTD_isError(result)) {
+                return false;
+            }
+
+            block->outputLength = result;
+
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+static void* compressionWorkerThread(void *arg)
+{
+    compressedBlock_t *block = (compressedBlock_t *) arg;
+
+    while (1) {
+        semaphore_wait(&block->ready);
+
+        if (block->quit) {
+            semaphore_signal(&block->done);
+            return NULL;
+        }
+
+        block->failed = !compressBlock(block);
+
+        semaphore_signal(&block->done);
+    }
+}
+
+/**
+ * Wait for the given block to be compressed and write it to the file.
+ */
+static void writeBlock(compressedFile_t *compressed, compressedBlock_t *block)
+{
+    if (!block->busy) {
+        return;
+    }
+
+    semaphore_wait(&block->done);
+    block->busy = false;
+
+    if (block->failed || fwrite(block->output, 1, block->outputLength, compressed->file) != block->outputLength) {
+        compressed->failed = true;
+    }
+}
+
+/**
+ * Hand the pending data to the next worker to compress (after writing out the block that worker had before).
+ */
+static void submitPendingBlock(compressedFile_t *compressed)
+{
+    compressedBlock_t *block = &compressed->blocks[compressed->nextBlock];
+    char *emptyBuffer;
+
+    writeBlock(compressed, block);
+
+    // Swap buffers with the block rather than copying
+    emptyBuffer = block->input;
+
+    block->input = compressed->pending;
+    block->inputLength = compressed->pendingLength;
+    block->busy = true;
+
+    compressed->pending = emptyBuffer;
+    compressed->pendingLength = 0;
+
+    compressed->nextBlock = (compressed->nextBlock + 1) % compressed->blockCount;
+    compressed->anyBlocksWritten = true;
+
+    semaphore_signal(&block->ready);
+}
+
+static size_t compressedFileWrite(compressedFile_t *compressed, const char *data, size_t length)
+{
+    size_t remaining = length;
+
+    while (remaining > 0) {
+        size_t chunk = COMPRESSED_FILE_BLOCK_LENGTH - compressed->pendingLength;
+
+        if (chunk > remaining) {
+            chunk = remaining;
+        }
+
+        memcpy(compressed->pending + compressed->pendingLength, data, chunk);
+
+        compressed->pendingLength += chunk;
+        data += chunk;
+        remaining -= chunk;
+
+        if (compressed->pendingLength == COMPRESSED_FILE_BLOCK_LENGTH) {
+            submitPendingBlock(compressed);
+        }
+    }
+
+    return compressed->failed ? 0 : length;
+}
+
+static int compressedFileClose(compressedFile_t *compressed)
+{
+    bool success;
+
+    // An empty file still needs one (empty) member to be a valid compressed file
+    if (compressed->pendingLength > 0 || !compressed->anyBlocksWritten) {
+        submitPendingBlock(compressed);
+    }
+
+    // Write out the remaining blocks, oldest first
+    for (int i = 0; i < compressed->blockCount; i++) {
+        writeBlock(compressed, &compressed->blocks[(compressed->nextBlock + i) % compressed->blockCount]);
+    }
+
+    for (int i = 0; i < compressed->blockCount; i++) {
+        compressedBlock_t *block = &compressed->blocks[i];
+
+        block->quit = true;
+        semaphore_signal(&block->ready);
+        semaphore_wait(&block->done);
+
+        semaphore_destroy(&block->ready);
+        semaphore_destroy(&block->done);
+
+        free(block->input);
+        free(block->output);
+    }
+
+    success = !compressed->failed;
+
+    if (fclose(compressed->file) != 0) {
+        success = false;
+    }
+
+    free(compressed->blocks);
+    free(compressed->pending);
+    free(compressed);
+
+    return success ? 0 : EOF;
+}
+
+#ifdef HAVE_FOPENCOOKIE
+static ssize_t cookieWrite(void *cookie, const char *data, size_t length)
+{
+    return compressedFileWrite((compressedFile_t *) cookie, data, length);
+}
+
+static int cookieClose(void *cookie)
+{
+    return compressedFileClose((compressedFile_t *) cookie);
+}
+#else
+static int cookieWrite(void *cookie, const char *data, int length)
+{
+    return compressedFileWrite((compressedFile_t *) cookie, data, length);
+}
+
+static int cookieClose(void *cookie)
+{
+    return compressedFileClose((compressedFile_t *) cookie);
+}
+#endif
+
+/**
+ * Create a file with the given name which compresses everything written to it in the given format, using the given
+ * number of threads to compress. Returns NULL if the file couldn't be created.
+ */
+FILE* compressedFileOpen(const char *filename, compressionFormat_e format, int threads)
+{
+    compressedFile_t *compressed;
+    FILE *result;
+
+    if (!compressionFormatAvailable(format) || format == COMPRESSION_NONE) {
+        return NULL;
+    }
+
+    compressed = calloc(1, sizeof(*compressed));
+    compressed->format = format;
+    compressed->file = fopen(filename, "wb");
+
+    if (!compressed->file) {
+        free(compressed);
+        return NULL;
+    }
+
+    compressed->blockCount = threads < 1 ? 1 : threads;
+    compressed->blocks = calloc(compressed->blockCount, sizeof(*compressed->blocks));
+    compressed->pending = malloc(COMPRESSED_FILE_BLOCK_LENGTH);
+
+    for (int i = 0; i < compressed->blockCount; i++) {
+        compressedBlock_t *block = &compressed->blocks[i];
+
+        block->format = format;
+        block->input = malloc(COMPRESSED_FILE_BLOCK_LENGTH);
+
+        semaphore_create(&block->ready, 0);
+        semaphore_create(&block->done, 0);
+
+        thread_create_detached(compressionWorkerThread, block);
+    }
+
+#ifdef HAVE_FOPENCOOKIE
+    cookie_io_functions_t functions = {
+        .read = NULL,
+        .write = cookieWrite,
+        .seek = NULL,
+        .close = cookieClose
+    };
+
+    result = fopencookie(compressed, "w", functions);
+#else
+    result = funopen(compressed, NULL, cookieWrite, NULL, cookieClose);
+#endif
+
+    if (!result) {
+        compressedFileClose(compressed);
+        remove(filename);
+        return NULL;
+    }
+
+    setvbuf(result, NULL, _IOFBF, COMPRESSED_FILE_STDIO_BUFFER_LENGTH);
+
+    return result;
+}
+
+#else
+
+FILE* compressedFileOpen(const char *filename, compressionFormat_e format, int threads)
+{
+    (void) filename;
+    (void) format;
+    (void) threads;
+
+    return NULL;
+}
+
+#endif
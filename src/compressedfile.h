@@ -0,0 +1,20 @@
+#ifndef COMPRESSEDFILE_H_
+#define COMPRESSEDFILE_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD
+} compressionFormat_e;
+
+bool compressionFormatFromName(const char *name, compressionFormat_e *format);
+const char* compressionFormatName(compressionFormat_e format);
+const char* compressionFormatExtension(compressionFormat_e format);
+bool compressionFormatAvailable(compressionFormat_e format);
+
+FILE* compressedFileOpen(const char *filename, compressionFormat_e format, int threads);
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define rmdir _rmdir
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+#include "platform.h"
+#include "hash.h"
+#include "decodecache.h"
+
+/*
+ * The decode cache stores the outputs of decoding each log in a directory named by a hash of the log's data and the
+ * options it was decoded with:
+ *
+ *   <cacheDir>/<key>/csv, event, gps.csv, gps.gpx, stats
+ *
+ * Entries are never modified once stored, so outputs are restored by hard-linking them where we can (the decoder
+ * removes its output files before rewriting them, so it never writes through one of these links).
+ */
+
+#define DECODE_CACHE_STATS_NAME "stats"
+#define DECODE_CACHE_PATH_LENGTH 1024
+// Room for an entry's directory name plus the name of one of its files
+#define DECODE_CACHE_FILE_PATH_LENGTH (DECODE_CACHE_PATH_LENGTH + 16)
+
+void decodeCacheMakeKey(char *key, const void *section, size_t sectionLength, const char *options)
+{
+    hash128_t sectionHash = hash128(section, sectionLength, 0);
+    hash128_t optionsHash = hash128(options, strlen(options), 0);
+
+    snprintf(key, DECODE_CACHE_KEY_LENGTH + 1, "%016" PRIx64 "%016" PRIx64 "-%016" PRIx64, sectionHash.high, sectionHash.low,
+        optionsHash.low);
+}
+
+static bool copyFileContents(FILE *source, FILE *dest)
+{
+    char buffer[64 * 1024];
+    size_t length;
+
+    while ((length = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+        if (fwrite(buffer, 1, length, dest) != length) {
+            return false;
+        }
+    }
+
+    return !ferror(source);
+}
+
+static bool fileExists(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+
+    if (file) {
+        fclose(file);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Make `dest` a copy of `source`, as a hard link if possible. Any existing file at `dest` is replaced.
+ */
+static bool linkOrCopyFile(const char *source, const char *dest)
+{
+    FILE *in, *out;
+    bool success;
+
+    remove(dest);
+
+#ifndef WIN32
+    if (link(source, dest) == 0) {
+        return true;
+    }
+#endif
+
+    in = fopen(source, "rb");
+
+    if (!in) {
+        return false;
+    }
+
+    out = fopen(dest, "wb");
+
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    success = copyFileContents(in, out);
+
+    fclose(in);
+
+    if (fclose(out) != 0) {
+        success = false;
+    }
+
+    return success;
+}
+
+/**
+ * If the cache has an entry for the given key, restore its outputs to their filenames, copy its statistics to statsFile
+ * and return true.
+ */
+bool decodeCacheRestore(const char *cacheDir, const char *key, const decodeCacheOutput_t *outputs, int outputCount, FILE *statsFile)
+{
+    char path[DECODE_CACHE_PATH_LENGTH];
+    FILE *stats;
+
+    snprintf(path, sizeof(path), "%s/%s/" DECODE_CACHE_STATS_NAME, cacheDir, key);
+
+    stats = fopen(path, "rb");
+
+    if (!stats) {
+        return false;
+    }
+
+    for (int i = 0; i < outputCount; i++) {
+        snprintf(path, sizeof(path), "%s/%s/%s", cacheDir, key, outputs[i].name);
+
+        // Outputs which weren't written by the original decode (e.g. no GPS in this log) aren't in the entry
+        if (fileExists(path) && !linkOrCopyFile(path, outputs[i].filename)) {
+            fprintf(stderr, "Failed to restore \"%s\" from the decode cache\n", outputs[i].filename);
+            fclose(stats);
+            return false;
+        }
+    }
+
+    copyFileContents(stats, statsFile);
+    fclose(stats);
+
+    return true;
+}
+
+/**
+ * Save the outputs marked as written, along with the statistics text printed while decoding them, as the entry for the
+ * given key. Failures are reported but not fatal, the decode itself has already succeeded.
+ */
+void decodeCacheStore(const char *cacheDir, const char *key, const decodeCacheOutput_t *outputs, int outputCount, const char *stats, size_t statsLength)
+{
+    char tempDir[DECODE_CACHE_PATH_LENGTH], entryDir[DECODE_CACHE_PATH_LENGTH], path[DECODE_CACHE_FILE_PATH_LENGTH];
+    FILE *statsFile;
+    bool success = true;
+
+    directory_create(cacheDir);
+
+    /*
+     * Build the entry under a temporary name and rename it into place, so other decoders sharing the cache never see a
+     * partial entry.
+     */
+    snprintf(tempDir, sizeof(tempDir), "%s/%s.tmp%d", cacheDir, key, (int) getpid());
+    snprintf(entryDir, sizeof(entryDir), "%s/%s", cacheDir, key);
+
+    if (!directory_create(tempDir)) {
+        fprintf(stderr, "Failed to create decode cache entry \"%s\"\n", tempDir);
+        return;
+    }
+
+    for (int i = 0; i < outputCount && success; i++) {
+        if (outputs[i].written) {
+            snprintf(path, sizeof(path), "%s/%s", tempDir, outputs[i].name);
+
+            success = linkOrCopyFile(outputs[i].filename, path);
+        }
+    }
+
+    if (success) {
+        snprintf(path, sizeof(path), "%s/" DECODE_CACHE_STATS_NAME, tempDir);
+
+        statsFile = fopen(path, "wb");
+
+        success = statsFile && fwrite(stats, 1, statsLength, statsFile) == statsLength;
+
+        if (statsFile && fclose(statsFile) != 0) {
+            success = false;
+        }
+    }
+
+    // If the rename fails, another decoder stored the same entry before us and we can throw ours away
+    if (!success || rename(tempDir, entryDir) != 0) {
+        if (!success) {
+            fprintf(stderr, "Failed to store decode cache entry \"%s\"\n", entryDir);
+        }
+
+        for (int i = 0; i < outputCount; i++) {
+            snprintf(path, sizeof(path), "%s/%s", tempDir, outputs[i].name);
+            remove(path);
+        }
+
+        snprintf(path, sizeof(path), "%s/" DECODE_CACHE_STATS_NAME, tempDir);
+        remove(path);
+
+        rmdir(tempDir);
+    }
+}
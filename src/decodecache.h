@@ -0,0 +1,25 @@
+#ifndef DECODECACHE_H_
+#define DECODECACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Entry names are the 128-bit hash of the log section and the 64-bit hash of the decode options, in hex
+#define DECODE_CACHE_KEY_LENGTH (32 + 1 + 16)
+
+typedef struct decodeCacheOutput_t {
+    // Name of this output within a cache entry
+    const char *name;
+
+    // Where the decoder writes this output, and whether it was written by the decode being stored
+    const char *filename;
+    bool written;
+} decodeCacheOutput_t;
+
+void decodeCacheMakeKey(char *key, const void *section, size_t sectionLength, const char *options);
+
+bool decodeCacheRestore(const char *cacheDir, const char *key, const decodeCacheOutput_t *outputs, int outputCount, FILE *statsFile);
+void decodeCacheStore(const char *cacheDir, const char *key, const decodeCacheOutput_t *outputs, int outputCount, const char *stats, size_t statsLength);
+
+#endif
@@ -1,7 +1,185 @@
+#include <string.h>
+
 #include "decoders.h"
 #include "tools.h"
 
-void streamReadTag2_3S32(mmapStream_t *stream, int64_t *values)
+/*
+ * The selector at the start of each TAG2_3S32 and TAG8_4S16 group determines where all of the group's fields are, so
+ * we look their positions up in these tables instead of walking the selector. When the stream has enough bytes left to
+ * load the largest possible group, a group is decoded with one bounds check, one or two unaligned loads, and a
+ * shift/mask/sign-extend per field that doesn't depend on the field's size. Near the end of the stream we fall back to
+ * decoding byte by byte, so that truncated groups behave exactly as they always have.
+ *
+ * The tables are built at compile time by the macros below, with one entry for every selector byte.
+ */
+
+// Mask and sign bit for a field of the given number of bits (zero-bit fields always decode to zero)
+#define FIELD_MASK(bits) ((1ULL << (bits)) - 1)
+#define FIELD_SIGN(bits) ((1ULL << (bits)) >> 1)
+
+#define FIELD(shift, bits) {(shift), FIELD_MASK(bits), FIELD_SIGN(bits)}
+
+// Expand ENTRY(selector) for all 256 selectors
+#define ENTRIES_4(ENTRY, s) ENTRY(s), ENTRY((s) + 1), ENTRY((s) + 2), ENTRY((s) + 3)
+#define ENTRIES_16(ENTRY, s) ENTRIES_4(ENTRY, s), ENTRIES_4(ENTRY, (s) + 4), ENTRIES_4(ENTRY, (s) + 8), ENTRIES_4(ENTRY, (s) + 12)
+#define ENTRIES_64(ENTRY, s) ENTRIES_16(ENTRY, s), ENTRIES_16(ENTRY, (s) + 16), ENTRIES_16(ENTRY, (s) + 32), ENTRIES_16(ENTRY, (s) + 48)
+#define ENTRIES_256(ENTRY) ENTRIES_64(ENTRY, 0), ENTRIES_64(ENTRY, 64), ENTRIES_64(ENTRY, 128), ENTRIES_64(ENTRY, 192)
+
+// The 2-bit field of the selector that describes field i
+#define SELECTOR_FIELD(s, i) (((s) >> (2 * (i))) & 0x03)
+
+typedef struct tagField_t {
+    uint8_t shift;
+    uint64_t mask, sign;
+} tagField_t;
+
+/*
+ * TAG2_3S32: The fields are found by loading 32 bits (little-endian) from `offset` bytes after the lead byte, then
+ * shifting. The longest group is 13 bytes, and the furthest load reads up to the same place.
+ */
+#define TAG2_3S32_MAX_LENGTH 13
+
+typedef struct tag2_3S32Layout_t {
+    uint8_t length; // Including the lead byte
+    uint8_t offset[3];
+    tagField_t field[3];
+} tag2_3S32Layout_t;
+
+// When the top two bits of the lead byte are set, the fields are 8, 16, 24 or 32 bits long, one after the other
+#define T2_BYTES(s, i) (SELECTOR_FIELD(s, i) + 1)
+
+#define T2_BYTES_BEFORE(s, i) (((i) > 0 ? T2_BYTES(s, 0) : 0) + ((i) > 1 ? T2_BYTES(s, 1) : 0))
+
+/*
+ * Otherwise they're packed into the bottom of the lead byte (2-bit fields), the lead byte's low nibble and then the two
+ * nibbles of the next byte (4-bit fields), or the bottom 6 bits of the lead byte and the next two bytes (6-bit fields).
+ */
+#define T2_LENGTH(s) ((s) < 0x40 ? 1 : (s) < 0x80 ? 2 : (s) < 0xC0 ? 3 : 1 + T2_BYTES_BEFORE(s, 2) + T2_BYTES(s, 2))
+#define T2_OFFSET(s, i) ((s) < 0x40 ? 0 : (s) < 0x80 ? ((i) > 0) : (s) < 0xC0 ? (i) : 1 + T2_BYTES_BEFORE(s, i))
+#define T2_SHIFT(s, i) ((s) < 0x40 ? 4 - 2 * (i) : (s) < 0x80 ? 4 * ((i) == 1) : 0)
+#define T2_BITS(s, i) ((s) < 0x40 ? 2 : (s) < 0x80 ? 4 : (s) < 0xC0 ? 6 : 8 * T2_BYTES(s, i))
+
+#define T2_FIELD(s, i) FIELD(T2_SHIFT(s, i), T2_BITS(s, i))
+
+#define TAG2_3S32_ENTRY(s) { \
+    T2_LENGTH(s), {T2_OFFSET(s, 0), T2_OFFSET(s, 1), T2_OFFSET(s, 2)}, {T2_FIELD(s, 0), T2_FIELD(s, 1), T2_FIELD(s, 2)} \
+}
+
+static const tag2_3S32Layout_t tag2_3S32Layouts[256] = {
+    ENTRIES_256(TAG2_3S32_ENTRY)
+};
+
+/*
+ * TAG8_4S16 v2: Fields are 0, 1, 2 or 4 nibbles long and packed one after the other (most significant nibble first)
+ * into the bytes after the selector, so we load the 8 bytes after the selector big-endian and shift each field down
+ * from its nibble offset. Fields are found at `shift` bits from the bottom of that load.
+ */
+#define TAG8_4S16_MAX_LENGTH 9
+
+typedef struct tag8_4S16Layout_t {
+    uint8_t length; // Including the selector
+    uint8_t valueCount;
+    tagField_t field[5];
+} tag8_4S16Layout_t;
+
+#define T8V2_NIBBLES(s, i) ((0x4210 >> (4 * SELECTOR_FIELD(s, i))) & 0x0F)
+#define T8V2_OFFSET(s, i) ( \
+    ((i) > 0 ? T8V2_NIBBLES(s, 0) : 0) + ((i) > 1 ? T8V2_NIBBLES(s, 1) : 0) + ((i) > 2 ? T8V2_NIBBLES(s, 2) : 0) \
+)
+#define T8V2_FIELD(s, i) \
+    FIELD(T8V2_NIBBLES(s, i) ? 64 - 4 * (T8V2_OFFSET(s, i) + T8V2_NIBBLES(s, i)) : 0, 4 * T8V2_NIBBLES(s, i))
+
+#define TAG8_4S16_V2_ENTRY(s) { \
+    1 + (T8V2_OFFSET(s, 3) + T8V2_NIBBLES(s, 3) + 1) / 2, 4, \
+    {T8V2_FIELD(s, 0), T8V2_FIELD(s, 1), T8V2_FIELD(s, 2), T8V2_FIELD(s, 3), FIELD(0, 0)} \
+}
+
+static const tag8_4S16Layout_t tag8_4S16V2Layouts[256] = {
+    ENTRIES_256(TAG8_4S16_V2_ENTRY)
+};
+
+/*
+ * TAG8_4S16 v1: Fields are 0, 1 or 2 bytes (little-endian), except that a 4-bit field shares its byte with the
+ * following field, whose own selector bits are ignored. The low nibble is the 4-bit field and the high nibble the
+ * following one (if the 4-bit field is the last field, the high nibble becomes a fifth value). Fields are found at
+ * `shift` bits from the bottom of a little-endian load of the 8 bytes after the selector.
+ */
+
+// Is field i the high nibble of a preceding 4-bit field?
+#define T8V1_SHARED_1(s) (SELECTOR_FIELD(s, 0) == 1)
+#define T8V1_SHARED_2(s) (SELECTOR_FIELD(s, 1) == 1 && !T8V1_SHARED_1(s))
+#define T8V1_SHARED_3(s) (SELECTOR_FIELD(s, 2) == 1 && !T8V1_SHARED_2(s))
+#define T8V1_SHARED_4(s) (SELECTOR_FIELD(s, 3) == 1 && !T8V1_SHARED_3(s))
+#define T8V1_SHARED(s, i) ((i) == 1 ? T8V1_SHARED_1(s) : (i) == 2 ? T8V1_SHARED_2(s) : (i) == 3 ? T8V1_SHARED_3(s) : 0)
+
+#define T8V1_BYTES(s, i) (T8V1_SHARED(s, i) ? 0 : (0x2110 >> (4 * SELECTOR_FIELD(s, i))) & 0x0F)
+#define T8V1_OFFSET(s, i) ( \
+    ((i) > 0 ? T8V1_BYTES(s, 0) : 0) + ((i) > 1 ? T8V1_BYTES(s, 1) : 0) + ((i) > 2 ? T8V1_BYTES(s, 2) : 0) \
+)
+#define T8V1_BITS(s, i) (T8V1_SHARED(s, i) ? 4 : (0x82080 >> (5 * SELECTOR_FIELD(s, i))) & 0x1F)
+#define T8V1_FIELD(s, i) \
+    FIELD(T8V1_SHARED(s, i) ? 8 * T8V1_OFFSET(s, (i) - 1) + 4 : 8 * T8V1_OFFSET(s, i), T8V1_BITS(s, i))
+
+#define TAG8_4S16_V1_ENTRY(s) { \
+    1 + T8V1_OFFSET(s, 3) + T8V1_BYTES(s, 3), T8V1_SHARED_4(s) ? 5 : 4, \
+    {T8V1_FIELD(s, 0), T8V1_FIELD(s, 1), T8V1_FIELD(s, 2), T8V1_FIELD(s, 3), FIELD(8 * T8V1_OFFSET(s, 3) + 4, 4)} \
+}
+
+static const tag8_4S16Layout_t tag8_4S16V1Layouts[256] = {
+    ENTRIES_256(TAG8_4S16_V1_ENTRY)
+};
+
+static inline uint32_t readLittleEndian32(const char *data)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static inline uint64_t readLittleEndian64(const char *data)
+{
+    return readLittleEndian32(data) | ((uint64_t) readLittleEndian32(data + 4) << 32);
+}
+
+static inline uint64_t readBigEndian64(const char *data)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint64_t result = 0;
+
+    for (int i = 0; i < 8; i++) {
+        result = (result << 8) | bytes[i];
+    }
+
+    return result;
+}
+
+static inline int64_t extractField(uint64_t bits, const tagField_t *field)
+{
+    uint64_t value = (bits >> field->shift) & field->mask;
+
+    // Sign-extend from the field's top bit
+    return (int64_t) ((value ^ field->sign) - field->sign);
+}
+
+/**
+ * Decode a TAG8_4S16 group whose selector is at `data` using its layout, and return the length of the group.
+ */
+static inline int decodeTag8_4S16(const tag8_4S16Layout_t *layouts, uint64_t bits, const char *data, int64_t *values)
+{
+    const tag8_4S16Layout_t *layout = &layouts[(uint8_t) data[0]];
+
+    for (int i = 0; i < 4; i++) {
+        values[i] = extractField(bits, &layout->field[i]);
+    }
+
+    if (layout->valueCount > 4) {
+        values[4] = extractField(bits, &layout->field[4]);
+    }
+
+    return layout->length;
+}
+
+static void streamReadTag2_3S32Bytewise(mmapStream_t *stream, int64_t *values)
 {
     uint8_t leadByte;
     uint8_t byte1, byte2, byte3, byte4;
@@ -78,7 +256,22 @@ void streamReadTag2_3S32(mmapStream_t *stream, int64_t *values)
     }
 }
 
-void streamReadTag8_4S16_v1(mmapStream_t *stream, int64_t *values)
+void streamReadTag2_3S32(mmapStream_t *stream, int64_t *values)
+{
+    if (stream->end - stream->pos >= TAG2_3S32_MAX_LENGTH) {
+        const tag2_3S32Layout_t *layout = &tag2_3S32Layouts[(uint8_t) *stream->pos];
+
+        for (int i = 0; i < 3; i++) {
+            values[i] = extractField(readLittleEndian32(stream->pos + layout->offset[i]), &layout->field[i]);
+        }
+
+        stream->pos += layout->length;
+    } else {
+        streamReadTag2_3S32Bytewise(stream, values);
+    }
+}
+
+static void streamReadTag8_4S16_v1Bytewise(mmapStream_t *stream, int64_t *values)
 {
     uint8_t selector, combinedChar;
     uint8_t char1, char2;
@@ -126,7 +319,16 @@ void streamReadTag8_4S16_v1(mmapStream_t *stream, int64_t *values)
     }
 }
 
-void streamReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
+void streamReadTag8_4S16_v1(mmapStream_t *stream, int64_t *values)
+{
+    if (stream->end - stream->pos >= TAG8_4S16_MAX_LENGTH) {
+        stream->pos += decodeTag8_4S16(tag8_4S16V1Layouts, readLittleEndian64(stream->pos + 1), stream->pos, values);
+    } else {
+        streamReadTag8_4S16_v1Bytewise(stream, values);
+    }
+}
+
+static void streamReadTag8_4S16_v2Bytewise(mmapStream_t *stream, int64_t *values)
 {
     uint8_t selector;
     uint8_t char1, char2;
@@ -199,6 +401,15 @@ void streamReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
     }
 }
 
+void streamReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
+{
+    if (stream->end - stream->pos >= TAG8_4S16_MAX_LENGTH) {
+        stream->pos += decodeTag8_4S16(tag8_4S16V2Layouts, readBigEndian64(stream->pos + 1), stream->pos, values);
+    } else {
+        streamReadTag8_4S16_v2Bytewise(stream, values);
+    }
+}
+
 void streamReadTag8_8SVB(mmapStream_t *stream, int64_t *values, int valueCount)
 {
     uint8_t header;
@@ -0,0 +1,775 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+
+#include "tools.h"
+#include "encoder.h"
+
+void encoderBufferInit(encoderBuffer_t *buffer, uint8_t *data, size_t capacity)
+{
+    buffer->data = data;
+    buffer->pos = data;
+    buffer->end = data + capacity;
+    buffer->bits = 0;
+    buffer->bitCount = 0;
+}
+
+/**
+ * The number of whole bytes written to the buffer so far (not counting bits waiting in the accumulator).
+ */
+size_t encoderBufferLength(const encoderBuffer_t *buffer)
+{
+    return buffer->pos - buffer->data;
+}
+
+size_t encoderBufferRemaining(const encoderBuffer_t *buffer)
+{
+    return buffer->end - buffer->pos;
+}
+
+void encoderWriteByte(encoderBuffer_t *buffer, uint8_t value)
+{
+    *buffer->pos++ = value;
+}
+
+/**
+ * Write an unsigned integer using variable byte encoding.
+ */
+void encoderWriteUnsignedVB(encoderBuffer_t *buffer, uint32_t value)
+{
+    uint8_t *pos = buffer->pos;
+
+    //While this isn't the final byte (we can only write 7 bits at a time)
+    while (value > 127) {
+        *pos++ = (uint8_t) (value | 0x80); // Set the high bit to mean "more bytes follow"
+        value >>= 7;
+    }
+    *pos++ = (uint8_t) value;
+
+    buffer->pos = pos;
+}
+
+/**
+ * Write a signed integer using ZigZig and variable byte encoding.
+ */
+void encoderWriteSignedVB(encoderBuffer_t *buffer, int32_t value)
+{
+    //ZigZag encode to make the value always positive
+    encoderWriteUnsignedVB(buffer, zigzagEncode(value));
+}
+
+void encoderWriteS16(encoderBuffer_t *buffer, int16_t value)
+{
+    buffer->pos[0] = value & 0xFF;
+    buffer->pos[1] = (value >> 8) & 0xFF;
+    buffer->pos += 2;
+}
+
+/**
+ * Write three signed values packed into as few bytes as the largest of them allows. The top two bits of the lead byte
+ * pick the layout:
+ *
+ * 2 bits per field  ss11 2233
+ * 4 bits per field  ss00 1111 2222 3333
+ * 6 bits per field  ss11 1111 0022 2222 0033 3333
+ * 8-32 bits per field  ss33 2211, then each field in 1-4 bytes (little-endian) as picked by its 2-bit size code
+ */
+void encoderWriteTag2_3S32(encoderBuffer_t *buffer, const int32_t *values)
+{
+    enum { BITS_2 = 0, BITS_4 = 1, BITS_6 = 2, BITS_32 = 3 };
+    enum { BYTES_1 = 0, BYTES_2 = 1, BYTES_3 = 2, BYTES_4 = 3 };
+
+    uint8_t *pos = buffer->pos;
+    int selector = BITS_2, selector2;
+
+    for (int x = 0; x < 3; x++) {
+        //Require more than 6 bits?
+        if (values[x] >= 32 || values[x] < -32) {
+            selector = BITS_32;
+            break;
+        }
+
+        //Require more than 4 bits?
+        if (values[x] >= 8 || values[x] < -8) {
+            if (selector < BITS_6)
+                selector = BITS_6;
+        } else if (values[x] >= 2 || values[x] < -2) {
+            if (selector < BITS_4)
+                selector = BITS_4;
+        }
+    }
+
+    switch (selector) {
+        case BITS_2:
+            *pos++ = (selector << 6) | ((values[0] & 0x03) << 4) | ((values[1] & 0x03) << 2) | (values[2] & 0x03);
+        break;
+        case BITS_4:
+            *pos++ = (selector << 6) | (values[0] & 0x0F);
+            *pos++ = (values[1] << 4) | (values[2] & 0x0F);
+        break;
+        case BITS_6:
+            *pos++ = (selector << 6) | (values[0] & 0x3F);
+            *pos++ = (uint8_t) values[1];
+            *pos++ = (uint8_t) values[2];
+        break;
+        case BITS_32:
+            selector2 = 0;
+
+            //Encode in reverse order so the first field is in the low bits:
+            for (int x = 2; x >= 0; x--) {
+                selector2 <<= 2;
+
+                if (values[x] < 128 && values[x] >= -128)
+                    selector2 |= BYTES_1;
+                else if (values[x] < 32768 && values[x] >= -32768)
+                    selector2 |= BYTES_2;
+                else if (values[x] < 8388608 && values[x] >= -8388608)
+                    selector2 |= BYTES_3;
+                else
+                    selector2 |= BYTES_4;
+            }
+
+            *pos++ = (selector << 6) | selector2;
+
+            for (int x = 0; x < 3; x++, selector2 >>= 2) {
+                uint32_t value = (uint32_t) values[x];
+
+                for (int byte = 0; byte <= (selector2 & 0x03); byte++, value >>= 8)
+                    *pos++ = (uint8_t) value;
+            }
+        break;
+    }
+
+    buffer->pos = pos;
+}
+
+/**
+ * Write four signed values, each 0, 4, 8 or 16 bits long as picked by its 2-bit code in the lead byte (first field in
+ * the low bits). The fields are packed one after the other, most significant nibble first, and padded out to a whole
+ * byte.
+ */
+void encoderWriteTag8_4S16(encoderBuffer_t *buffer, const int32_t *values)
+{
+    enum { FIELD_ZERO = 0, FIELD_4BIT = 1, FIELD_8BIT = 2, FIELD_16BIT = 3 };
+    static const int FIELD_BITS[] = {0, 4, 8, 16};
+
+    uint8_t *pos = buffer->pos;
+    uint8_t selector = 0;
+    // All four fields fit in here at once (at most 64 bits)
+    uint64_t packed = 0;
+    int packedBits = 0;
+
+    //Encode in reverse order so the first field is in the low bits:
+    for (int x = 3; x >= 0; x--) {
+        selector <<= 2;
+
+        if (values[x] == 0)
+            selector |= FIELD_ZERO;
+        else if (values[x] < 8 && values[x] >= -8)
+            selector |= FIELD_4BIT;
+        else if (values[x] < 128 && values[x] >= -128)
+            selector |= FIELD_8BIT;
+        else
+            selector |= FIELD_16BIT;
+    }
+
+    for (int x = 0; x < 4; x++) {
+        int bits = FIELD_BITS[(selector >> (x * 2)) & 0x03];
+
+        if (bits) {
+            packed = (packed << bits) | ((uint32_t) values[x] & ((1U << bits) - 1));
+            packedBits += bits;
+        }
+    }
+
+    // Pad a leftover nibble out to a byte
+    if (packedBits % 8) {
+        packed <<= 4;
+        packedBits += 4;
+    }
+
+    *pos++ = selector;
+
+    for (int shift = packedBits - 8; shift >= 0; shift -= 8)
+        *pos++ = (uint8_t) (packed >> shift);
+
+    buffer->pos = pos;
+}
+
+/**
+ * Write up to 8 signed values, led by a byte with a bit set for each non-zero value (first field in the low bit), and
+ * then the non-zero values as signed VBs. A single value is written without the lead byte.
+ */
+void encoderWriteTag8_8SVB(encoderBuffer_t *buffer, const int32_t *values, int valueCount)
+{
+    uint8_t header;
+
+    if (valueCount <= 0)
+        return;
+
+    if (valueCount == 1) {
+        encoderWriteSignedVB(buffer, values[0]);
+    } else {
+        header = 0;
+
+        for (int i = valueCount - 1; i >= 0; i--) {
+            header <<= 1;
+
+            if (values[i] != 0)
+                header |= 0x01;
+        }
+
+        encoderWriteByte(buffer, header);
+
+        for (int i = 0; i < valueCount; i++)
+            if (values[i] != 0)
+                encoderWriteSignedVB(buffer, values[i]);
+    }
+}
+
+/**
+ * Append the low bitCount bits of `bits` (up to 32) to the stream, most significant bit first. Whole 32-bit words are
+ * moved out of the accumulator as they fill up.
+ */
+void encoderWriteBits(encoderBuffer_t *buffer, uint32_t bits, unsigned int bitCount)
+{
+    if (bitCount == 0)
+        return;
+
+    if (bitCount < 32)
+        bits &= (1U << bitCount) - 1;
+
+    // There are fewer than 32 bits in the accumulator, so this always fits
+    buffer->bits |= (uint64_t) bits << (64 - buffer->bitCount - bitCount);
+    buffer->bitCount += bitCount;
+
+    if (buffer->bitCount >= 32) {
+        uint32_t word = (uint32_t) (buffer->bits >> 32);
+
+        buffer->pos[0] = (uint8_t) (word >> 24);
+        buffer->pos[1] = (uint8_t) (word >> 16);
+        buffer->pos[2] = (uint8_t) (word >> 8);
+        buffer->pos[3] = (uint8_t) word;
+        buffer->pos += 4;
+
+        buffer->bits <<= 32;
+        buffer->bitCount -= 32;
+    }
+}
+
+/**
+ * Write out any bits left in the accumulator, padding the last byte with zeros, to align the stream to a byte boundary.
+ */
+void encoderFlushBits(encoderBuffer_t *buffer)
+{
+    while (buffer->bitCount > 0) {
+        *buffer->pos++ = (uint8_t) (buffer->bits >> 56);
+
+        buffer->bits <<= 8;
+        buffer->bitCount -= 8;
+    }
+
+    buffer->bits = 0;
+    buffer->bitCount = 0;
+}
+
+/**
+ * How many bits would be required to fit the given integer? `i` must not be zero.
+ */
+static int numBitsToStoreInteger(uint32_t i)
+{
+    return sizeof(i) * CHAR_BIT - __builtin_clz(i);
+}
+
+void encoderWriteU32EliasDelta(encoderBuffer_t *buffer, uint32_t value)
+{
+    unsigned int valueLen, lengthOfValueLen;
+
+    /* We can't encode value=0, so we need to add 1 to the value before encoding
+     *
+     * That would make it impossible to encode MAXINT, so instead use MAXINT-1 as an escape code which can mean
+     * either MAXINT-1 or MAXINT
+     */
+    if (value == 0xFFFFFFFF) {
+        // Write the escape code of MAXINT - 1
+        encoderWriteU32EliasDelta(buffer, 0xFFFFFFFF - 1);
+        // Add a one bit after the escape code to mean "MAXINT"
+        encoderWriteBits(buffer, 1, 1);
+        return;
+    }
+
+    value += 1;
+
+    valueLen = numBitsToStoreInteger(value);
+    lengthOfValueLen = numBitsToStoreInteger(valueLen);
+
+    // Use unary to encode the number of bits we'll need to write the length of the `value`
+    encoderWriteBits(buffer, 0, lengthOfValueLen - 1);
+    // Now write the length of the `value`
+    encoderWriteBits(buffer, valueLen, lengthOfValueLen);
+    // Having now encoded the position of the top bit of `value`, write its remaining bits
+    encoderWriteBits(buffer, value, valueLen - 1);
+
+    // Did this end up being an escape code? We must have been trying to write MAXINT - 1
+    if (value == 0xFFFFFFFF) {
+        // Add a zero bit after the escape code to mean "MAXINT - 1"
+        encoderWriteBits(buffer, 0, 1);
+    }
+}
+
+void encoderWriteS32EliasDelta(encoderBuffer_t *buffer, int32_t value)
+{
+    encoderWriteU32EliasDelta(buffer, zigzagEncode(value));
+}
+
+void encoderWriteU32EliasGamma(encoderBuffer_t *buffer, uint32_t value)
+{
+    unsigned int lengthOfValue;
+
+    // Use MAXINT-1 as an escape code for MAXINT and MAXINT-1, as with Elias delta
+    if (value == 0xFFFFFFFF) {
+        encoderWriteU32EliasGamma(buffer, 0xFFFFFFFF - 1);
+        encoderWriteBits(buffer, 1, 1);
+        return;
+    }
+
+    value += 1;
+
+    lengthOfValue = numBitsToStoreInteger(value);
+
+    // Use unary to encode the number of bits we'll need to write `value`
+    encoderWriteBits(buffer, 0, lengthOfValue);
+
+    // Now the bits of value
+    encoderWriteBits(buffer, value, lengthOfValue);
+
+    if (value == 0xFFFFFFFF) {
+        encoderWriteBits(buffer, 0, 1);
+    }
+}
+
+void encoderWriteS32EliasGamma(encoderBuffer_t *buffer, int32_t value)
+{
+    encoderWriteU32EliasGamma(buffer, zigzagEncode(value));
+}
+
+bool encoderPrint(encoderBuffer_t *buffer, const char *s)
+{
+    size_t length = strlen(s);
+
+    if (length > encoderBufferRemaining(buffer))
+        return false;
+
+    memcpy(buffer->pos, s, length);
+    buffer->pos += length;
+
+    return true;
+}
+
+bool encoderPrintf(encoderBuffer_t *buffer, const char *format, ...)
+{
+    size_t remaining = encoderBufferRemaining(buffer);
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf((char *) buffer->pos, remaining, format, args);
+    va_end(args);
+
+    // vsnprintf() needs room for a terminator too, which we don't keep
+    if (length < 0 || (size_t) length >= remaining)
+        return false;
+
+    buffer->pos += length;
+
+    return true;
+}
+
+static bool isPredictorSupported(FlightLogFieldPredictor predictor, bool intraframe)
+{
+    switch (predictor) {
+        case FLIGHT_LOG_FIELD_PREDICTOR_0:
+        case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+        case FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0:
+        case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+        case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINMOTOR:
+            return true;
+
+        // These need two previous frames, which I frames don't have
+        case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+        case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+        case FLIGHT_LOG_FIELD_PREDICTOR_INC:
+            return !intraframe;
+
+        // The GPS predictors don't apply to the main frames
+        default:
+            return false;
+    }
+}
+
+static bool isEncodingSupported(FlightLogFieldEncoding encoding)
+{
+    switch (encoding) {
+        case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+        case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
+        case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+        case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_U32:
+        case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_S32:
+        case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
+        case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
+        case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
+        case FLIGHT_LOG_FIELD_ENCODING_NULL:
+        case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_U32:
+        case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_S32:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Set up an encoder for the main frames described by the field table (which must outlive the encoder). Set the
+ * predictor constants (minthrottle etc) afterwards if the table uses them.
+ *
+ * Returns false if the table has too many fields, or uses a predictor or encoding that can't be encoded.
+ */
+bool frameEncoderInit(frameEncoder_t *encoder, const encoderField_t *fields, int fieldCount, int iInterval)
+{
+    memset(encoder, 0, sizeof(*encoder));
+
+    if (fieldCount < 1 || fieldCount > ENCODER_MAX_FIELDS || iInterval < 1)
+        return false;
+
+    encoder->fields = fields;
+    encoder->fieldCount = fieldCount;
+    encoder->iInterval = iInterval;
+    encoder->pIntervalNum = 1;
+    encoder->pIntervalDenom = 1;
+    encoder->motor0Index = -1;
+    encoder->iterationIndex = -1;
+
+    for (int i = 0; i < fieldCount; i++) {
+        if (strcmp(fields[i].name, "motor[0]") == 0)
+            encoder->motor0Index = i;
+
+        if (fields[i].Ppredict == FLIGHT_LOG_FIELD_PREDICTOR_INC && encoder->iterationIndex == -1)
+            encoder->iterationIndex = i;
+    }
+
+    for (int i = 0; i < fieldCount; i++) {
+        if (!isPredictorSupported(fields[i].Ipredict, true) || !isPredictorSupported(fields[i].Ppredict, false)
+                || !isEncodingSupported(fields[i].Iencode) || !isEncodingSupported(fields[i].Pencode))
+            return false;
+
+        if ((fields[i].Ipredict == FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0 || fields[i].Ppredict == FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0)
+                && encoder->motor0Index == -1)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * The most room that encoding one frame could take. A group encoding which starts at the last field can run past the
+ * end of the frame by up to 3 fields.
+ */
+size_t frameEncoderMaxFrameLength(const frameEncoder_t *encoder)
+{
+    return 1 + (size_t) (encoder->fieldCount + 3) * ENCODER_MAX_FIELD_LENGTH;
+}
+
+/**
+ * Write the "H Field I ..." and "H Field P ..." header lines which describe the frames to the decoder. Returns false
+ * (and writes nothing) if the buffer is too small.
+ */
+bool frameEncoderWriteFieldHeaders(const frameEncoder_t *encoder, encoderBuffer_t *buffer)
+{
+    static const char* const HEADER_NAMES[] = {
+        "I name", "I signed", "I predictor", "I encoding", "P predictor", "P encoding"
+    };
+    uint8_t *start = buffer->pos;
+
+    for (unsigned int header = 0; header < sizeof(HEADER_NAMES) / sizeof(HEADER_NAMES[0]); header++) {
+        if (!encoderPrintf(buffer, "H Field %s:", HEADER_NAMES[header]))
+            goto overflow;
+
+        for (int i = 0; i < encoder->fieldCount; i++) {
+            const encoderField_t *field = &encoder->fields[i];
+            const char *separator = i > 0 ? "," : "";
+            bool fits;
+
+            switch (header) {
+                case 0:
+                    fits = encoderPrintf(buffer, "%s%s", separator, field->name);
+                break;
+                case 1:
+                    fits = encoderPrintf(buffer, "%s%d", separator, field->isSigned ? 1 : 0);
+                break;
+                case 2:
+                    fits = encoderPrintf(buffer, "%s%d", separator, field->Ipredict);
+                break;
+                case 3:
+                    fits = encoderPrintf(buffer, "%s%d", separator, field->Iencode);
+                break;
+                case 4:
+                    fits = encoderPrintf(buffer, "%s%d", separator, field->Ppredict);
+                break;
+                default:
+                    fits = encoderPrintf(buffer, "%s%d", separator, field->Pencode);
+            }
+
+            if (!fits)
+                goto overflow;
+        }
+
+        if (!encoderPrint(buffer, "\n"))
+            goto overflow;
+    }
+
+    return true;
+
+overflow:
+    buffer->pos = start;
+    return false;
+}
+
+/**
+ * The value that the decoder will add to the field's encoded value to get back to the field's value.
+ */
+static int64_t predictField(const frameEncoder_t *encoder, int fieldIndex, FlightLogFieldPredictor predictor,
+    const int64_t *frame, const int64_t *previous, const int64_t *previous2)
+{
+    switch (predictor) {
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+            return encoder->minthrottle;
+        case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+            return 1500;
+        case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+            return encoder->vbatref;
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINMOTOR:
+            return encoder->motorOutputLow;
+        case FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0:
+            return frame[encoder->motor0Index];
+        case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+            return previous ? previous[fieldIndex] : 0;
+        case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+            return previous ? 2 * previous[fieldIndex] - previous2[fieldIndex] : 0;
+        case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+            return previous ? (previous[fieldIndex] + previous2[fieldIndex]) / 2 : 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Write the frame with the I or P field definitions, then remember it as the newest frame of history.
+ */
+static void writeFrame(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frame, bool intraframe)
+{
+    const encoderField_t *fields = encoder->fields;
+    int fieldCount = encoder->fieldCount;
+    const int64_t *previous = encoder->historyCount > 0 ? encoder->history[encoder->historyNewest] : NULL;
+    // After an I frame, it serves as both of the previous frames
+    const int64_t *previous2 = encoder->historyCount > 1 ? encoder->history[encoder->historyNewest ^ 1] : previous;
+    // Room for a group which runs past the last field
+    int32_t residual[ENCODER_MAX_FIELDS + 8];
+    int i;
+
+    // Work out all the values to encode first, so that groups can be written in one go
+    for (i = 0; i < fieldCount; i++) {
+        FlightLogFieldPredictor predictor = intraframe ? fields[i].Ipredict : fields[i].Ppredict;
+
+        if (predictor == FLIGHT_LOG_FIELD_PREDICTOR_INC)
+            residual[i] = 0;
+        else
+            residual[i] = (int32_t) (frame[i] - predictField(encoder, i, predictor, frame, previous, previous2));
+    }
+
+    for (; i < fieldCount + 8; i++)
+        residual[i] = 0;
+
+    encoderWriteByte(buffer, intraframe ? 'I' : 'P');
+
+    i = 0;
+    while (i < fieldCount) {
+        FlightLogFieldEncoding encoding = intraframe ? fields[i].Iencode : fields[i].Pencode;
+        FlightLogFieldPredictor predictor = intraframe ? fields[i].Ipredict : fields[i].Ppredict;
+        int groupCount;
+
+        // The decoder works these out from the previous frame without reading anything
+        if (predictor == FLIGHT_LOG_FIELD_PREDICTOR_INC) {
+            i++;
+            continue;
+        }
+
+        switch (encoding) {
+            case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+                encoderFlushBits(buffer);
+                encoderWriteSignedVB(buffer, residual[i]);
+                i++;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
+                encoderFlushBits(buffer);
+                encoderWriteUnsignedVB(buffer, (uint32_t) residual[i]);
+                i++;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+                encoderFlushBits(buffer);
+                encoderWriteUnsignedVB(buffer, (uint32_t) -residual[i] & 0x3FFF);
+                i++;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
+                encoderFlushBits(buffer);
+                encoderWriteTag8_4S16(buffer, &residual[i]);
+                i += 4;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
+                encoderFlushBits(buffer);
+                encoderWriteTag2_3S32(buffer, &residual[i]);
+                i += 3;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
+                encoderFlushBits(buffer);
+
+                // The group carries on through the following fields with this encoding, up to 8 of them
+                for (groupCount = 1; groupCount < 8 && i + groupCount < fieldCount; groupCount++) {
+                    if ((intraframe ? fields[i + groupCount].Iencode : fields[i + groupCount].Pencode) != FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB)
+                        break;
+                }
+
+                encoderWriteTag8_8SVB(buffer, &residual[i], groupCount);
+                i += groupCount;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_U32:
+                encoderWriteU32EliasDelta(buffer, (uint32_t) residual[i]);
+                i++;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_S32:
+                encoderWriteS32EliasDelta(buffer, residual[i]);
+                i++;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_U32:
+                encoderWriteU32EliasGamma(buffer, (uint32_t) residual[i]);
+                i++;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_S32:
+                encoderWriteS32EliasGamma(buffer, residual[i]);
+                i++;
+            break;
+            default:
+                // FLIGHT_LOG_FIELD_ENCODING_NULL: nothing is written
+                i++;
+        }
+    }
+
+    // Align the stream to a byte boundary for the next frame
+    encoderFlushBits(buffer);
+
+    if (intraframe) {
+        encoder->historyNewest = 0;
+        encoder->historyCount = 1;
+    } else {
+        encoder->historyNewest ^= 1;
+        encoder->historyCount = 2;
+    }
+
+    memcpy(encoder->history[encoder->historyNewest], frame, fieldCount * sizeof(*frame));
+
+    encoder->frameIndex++;
+}
+
+/**
+ * Write the frame as an I frame. The buffer must have room for frameEncoderMaxFrameLength() bytes.
+ */
+void frameEncoderWriteIntraframe(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frame)
+{
+    writeFrame(encoder, buffer, frame, true);
+}
+
+/**
+ * Write the frame as a P frame, predicted from the frames written before it. The buffer must have room for
+ * frameEncoderMaxFrameLength() bytes.
+ */
+void frameEncoderWriteInterframe(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frame)
+{
+    writeFrame(encoder, buffer, frame, false);
+}
+
+/**
+ * Should a frame with the given loop iteration be in the log (based on the P interval)? This matches the decoder.
+ */
+static bool shouldHaveFrame(const frameEncoder_t *encoder, int32_t iteration)
+{
+    return (iteration % encoder->iInterval + encoder->pIntervalNum - 1) % encoder->pIntervalDenom < encoder->pIntervalNum;
+}
+
+/**
+ * P frames can't express a gap in the loop iteration, since the decoder predicts it to be the next iteration that the
+ * P interval says should be logged after the previous frame.
+ */
+static bool frameFollowsOn(const frameEncoder_t *encoder, const int64_t *frame)
+{
+    const int64_t *previous = encoder->history[encoder->historyNewest];
+    int64_t expected;
+    int skipped;
+
+    if (encoder->historyCount == 0)
+        return false;
+
+    if (encoder->iterationIndex == -1)
+        return true;
+
+    expected = previous[encoder->iterationIndex] + 1;
+
+    for (skipped = 0; skipped < encoder->iInterval && !shouldHaveFrame(encoder, (int32_t) expected); skipped++)
+        expected++;
+
+    for (int i = 0; i < encoder->fieldCount; i++) {
+        if (encoder->fields[i].Ppredict == FLIGHT_LOG_FIELD_PREDICTOR_INC && frame[i] != previous[i] + 1 + skipped)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Would frameEncoderWriteFrames() write this frame as an I frame?
+ */
+bool frameEncoderIsIntraframe(const frameEncoder_t *encoder, const int64_t *frame)
+{
+    bool intervalDue;
+
+    if (encoder->iterationIndex != -1)
+        intervalDue = (uint32_t) frame[encoder->iterationIndex] % encoder->iInterval == 0;
+    else
+        intervalDue = encoder->frameIndex % encoder->iInterval == 0;
+
+    return intervalDue || !frameFollowsOn(encoder, frame);
+}
+
+/**
+ * Encode an array of frames (frameCount frames of fieldCount fields each), with an I frame every iInterval iterations
+ * and P frames in between. A frame which doesn't follow on from the one before is written as an I frame too. Stops
+ * early when the buffer runs out of room for another frame.
+ *
+ * Returns the number of frames written. Call again with the remaining frames once the buffer has been emptied.
+ */
+int frameEncoderWriteFrames(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frames, int frameCount)
+{
+    size_t maxFrameLength = frameEncoderMaxFrameLength(encoder);
+    int written;
+
+    for (written = 0; written < frameCount; written++) {
+        const int64_t *frame = frames + (size_t) written * encoder->fieldCount;
+
+        if (encoderBufferRemaining(buffer) < maxFrameLength)
+            break;
+
+        writeFrame(encoder, buffer, frame, frameEncoderIsIntraframe(encoder, frame));
+    }
+
+    return written;
+}
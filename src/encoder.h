@@ -0,0 +1,106 @@
+#ifndef ENCODER_H_
+#define ENCODER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "blackbox_fielddefs.h"
+
+/*
+ * An encoder for blackbox logs which writes into buffers supplied by the caller. All of its state lives in the structs
+ * below, so any number of logs can be encoded at once on different threads.
+ */
+
+#define ENCODER_MAX_FIELDS 128
+
+// The longest any single field can be once encoded (an Elias gamma code for 0xFFFFFFFF is 66 bits)
+#define ENCODER_MAX_FIELD_LENGTH 10
+
+typedef struct encoderBuffer_t {
+    uint8_t *data, *pos, *end;
+
+    // Bits waiting to be written by encoderWriteBits(), aligned to the top of the accumulator
+    uint64_t bits;
+    int bitCount;
+} encoderBuffer_t;
+
+/*
+ * One row of a frame's field table: the same things the log header describes for each field in the "H Field I/P"
+ * lines.
+ */
+typedef struct encoderField_t {
+    const char *name;
+    bool isSigned;
+
+    FlightLogFieldPredictor Ipredict, Ppredict;
+    FlightLogFieldEncoding Iencode, Pencode;
+} encoderField_t;
+
+/*
+ * Encodes the main I and P frames of a log from its field table, keeping the last two frames to base the P-frame
+ * predictions on.
+ */
+typedef struct frameEncoder_t {
+    const encoderField_t *fields;
+    int fieldCount;
+
+    // Constants from the log header that the MINTHROTTLE, VBATREF and MINMOTOR predictors use
+    int32_t minthrottle, vbatref, motorOutputLow;
+
+    /*
+     * frameEncoderWriteFrames() writes an I frame on every iInterval'th loop iteration (or every iInterval'th frame, if
+     * the frames have no field with the INC predictor).
+     */
+    int iInterval;
+    uint32_t frameIndex;
+
+    // The P interval from the log header (1/1 unless changed after init), which says which iterations have frames
+    int pIntervalNum, pIntervalDenom;
+
+    // The fields that the MOTOR_0 predictor ("motor[0]") and INC predictor (the loop iteration) refer to, or -1
+    int motor0Index, iterationIndex;
+
+    int64_t history[2][ENCODER_MAX_FIELDS];
+    // The number of frames in history[] (up to 2) and the index of the newest
+    int historyCount, historyNewest;
+} frameEncoder_t;
+
+void encoderBufferInit(encoderBuffer_t *buffer, uint8_t *data, size_t capacity);
+size_t encoderBufferLength(const encoderBuffer_t *buffer);
+size_t encoderBufferRemaining(const encoderBuffer_t *buffer);
+
+/*
+ * These don't check for room in the buffer, it's up to the caller to reserve it first (with encoderBufferRemaining()).
+ * Call encoderFlushBits() before writing bytes after bits.
+ */
+void encoderWriteByte(encoderBuffer_t *buffer, uint8_t value);
+void encoderWriteUnsignedVB(encoderBuffer_t *buffer, uint32_t value);
+void encoderWriteSignedVB(encoderBuffer_t *buffer, int32_t value);
+void encoderWriteS16(encoderBuffer_t *buffer, int16_t value);
+void encoderWriteTag2_3S32(encoderBuffer_t *buffer, const int32_t *values);
+void encoderWriteTag8_4S16(encoderBuffer_t *buffer, const int32_t *values);
+void encoderWriteTag8_8SVB(encoderBuffer_t *buffer, const int32_t *values, int valueCount);
+
+void encoderWriteBits(encoderBuffer_t *buffer, uint32_t bits, unsigned int bitCount);
+void encoderFlushBits(encoderBuffer_t *buffer);
+
+void encoderWriteU32EliasDelta(encoderBuffer_t *buffer, uint32_t value);
+void encoderWriteS32EliasDelta(encoderBuffer_t *buffer, int32_t value);
+void encoderWriteU32EliasGamma(encoderBuffer_t *buffer, uint32_t value);
+void encoderWriteS32EliasGamma(encoderBuffer_t *buffer, int32_t value);
+
+// These check for room, and write nothing and return false if there isn't enough
+bool encoderPrint(encoderBuffer_t *buffer, const char *s);
+bool encoderPrintf(encoderBuffer_t *buffer, const char *format, ...);
+
+bool frameEncoderInit(frameEncoder_t *encoder, const encoderField_t *fields, int fieldCount, int iInterval);
+size_t frameEncoderMaxFrameLength(const frameEncoder_t *encoder);
+bool frameEncoderWriteFieldHeaders(const frameEncoder_t *encoder, encoderBuffer_t *buffer);
+
+bool frameEncoderIsIntraframe(const frameEncoder_t *encoder, const int64_t *frame);
+void frameEncoderWriteIntraframe(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frame);
+void frameEncoderWriteInterframe(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frame);
+int frameEncoderWriteFrames(frameEncoder_t *encoder, encoderBuffer_t *buffer, const int64_t *frames, int frameCount);
+
+#endif
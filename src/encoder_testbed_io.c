@@ -1,18 +1,54 @@
 #include <stdio.h>
 #include <stdarg.h>
-#include <limits.h>
 
-#include "tools.h"
+#include "encoder.h"
 
 #include "encoder_testbed_io.h"
 
 uint32_t blackboxWrittenBytes;
 
-void blackboxWrite(uint8_t ch)
+/*
+ * The encoding itself is done by the encoder library into this buffer, which is emptied to stdout whenever it gets
+ * too full for the next write.
+ */
+#define BLACKBOX_DEVICE_BUFFER_SIZE 65536
+
+// Enough for any one write below apart from blackboxPrint()
+#define BLACKBOX_MAX_WRITE_LENGTH 64
+
+static uint8_t blackboxDeviceBuffer[BLACKBOX_DEVICE_BUFFER_SIZE];
+static encoderBuffer_t blackboxBuffer = {blackboxDeviceBuffer, blackboxDeviceBuffer, blackboxDeviceBuffer + BLACKBOX_DEVICE_BUFFER_SIZE, 0, 0};
+static uint32_t blackboxFlushedBytes;
+
+/**
+ * Write the contents of the buffer to stdout. Bits waiting in the bit accumulator stay there.
+ */
+void blackboxDeviceFlush(void)
 {
-    putc(ch, stdout);
+    size_t length = encoderBufferLength(&blackboxBuffer);
 
-    blackboxWrittenBytes++;
+    fwrite(blackboxBuffer.data, 1, length, stdout);
+
+    blackboxFlushedBytes += length;
+    blackboxBuffer.pos = blackboxBuffer.data;
+}
+
+static void blackboxReserve(size_t bytes)
+{
+    if (encoderBufferRemaining(&blackboxBuffer) < bytes)
+        blackboxDeviceFlush();
+}
+
+static void blackboxUpdateWrittenBytes(void)
+{
+    blackboxWrittenBytes = blackboxFlushedBytes + encoderBufferLength(&blackboxBuffer);
+}
+
+void blackboxWrite(uint8_t ch)
+{
+    blackboxReserve(1);
+    encoderWriteByte(&blackboxBuffer, ch);
+    blackboxUpdateWrittenBytes();
 }
 
 // Print the null-terminated string 's' to the serial port and return the number of bytes written
@@ -49,12 +85,9 @@ int blackboxPrintf(const char *format, ...)
  */
 void blackboxWriteUnsignedVB(uint32_t value)
 {
-    //While this isn't the final byte (we can only write 7 bits at a time)
-    while (value > 127) {
-        blackboxWrite((uint8_t) (value | 0x80)); // Set the high bit to mean "more bytes follow"
-        value >>= 7;
-    }
-    blackboxWrite(value);
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteUnsignedVB(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
 /**
@@ -62,160 +95,79 @@ void blackboxWriteUnsignedVB(uint32_t value)
  */
 void blackboxWriteSignedVB(int32_t value)
 {
-    //ZigZag encode to make the value always positive
-    blackboxWriteUnsignedVB(zigzagEncode(value));
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteSignedVB(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
 void blackboxWriteS16(int16_t value)
 {
-    blackboxWrite(value & 0xFF);
-    blackboxWrite((value >> 8) & 0xFF);
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteS16(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
-static uint8_t blackboxBitBuffer = 0;
-static uint8_t blackboxBitBufferCount = 0;
-
-#define BLACKBOX_BIT_BUFFER_CAPACITY (sizeof(blackboxBitBuffer) * CHAR_BIT)
-
-void blackboxWriteBits(uint32_t bits, unsigned int bitCount) {
-    if (bitCount == 0)
-        return; // Nothing to write! (return now to avoid shifting left by 32 on the next line, which is undefined)
-
-    // Align the bits to be written to the top of that variable:
-    bits <<= sizeof(bits) * CHAR_BIT - bitCount;
-
-    do {
-        uint8_t availableCapacity = BLACKBOX_BIT_BUFFER_CAPACITY - blackboxBitBufferCount;
-        uint8_t numBitsToWrite = bitCount <= availableCapacity ? bitCount : availableCapacity;
-
-        // Align the bits to be written to the correct part of the buffer and insert them
-        blackboxBitBuffer |= bits >> ((sizeof(bits) - sizeof(blackboxBitBuffer)) * CHAR_BIT + blackboxBitBufferCount);
-        blackboxBitBufferCount += numBitsToWrite;
-
-        // Did we fill the buffer? If so write the whole thing out
-        if (blackboxBitBufferCount == BLACKBOX_BIT_BUFFER_CAPACITY) {
-            for (int i = sizeof(blackboxBitBuffer) - 1; i >= 0; i--) {
-                blackboxWrite(blackboxBitBuffer >> (CHAR_BIT * i));
-            }
-            blackboxBitBuffer = 0;
-            blackboxBitBufferCount = 0;
-        }
-
-        bitCount -= numBitsToWrite;
-        bits <<= numBitsToWrite;
-    } while (bitCount > 0);
+void blackboxWriteTag2_3S32(int32_t *values)
+{
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteTag2_3S32(&blackboxBuffer, values);
+    blackboxUpdateWrittenBytes();
 }
 
-void blackboxFlushBits() {
-    if (sizeof(blackboxBitBuffer) > 1) {
-        // Round up the bits to get the number of occupied bytes
-        int numBytes = (blackboxBitBufferCount + CHAR_BIT - 1) / CHAR_BIT;
-
-        for (int i = 0; i < numBytes; i++) {
-            // Write the top byte
-            blackboxWrite(blackboxBitBuffer >> ((sizeof(blackboxBitBuffer) - 1) * CHAR_BIT));
+void blackboxWriteTag8_4S16(int32_t *values)
+{
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteTag8_4S16(&blackboxBuffer, values);
+    blackboxUpdateWrittenBytes();
+}
 
-            // And shift the remaining bits up to fill that space
-            blackboxBitBuffer <<= CHAR_BIT;
-        }
+void blackboxWriteTag8_8SVB(int32_t *values, int valueCount)
+{
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteTag8_8SVB(&blackboxBuffer, values, valueCount);
+    blackboxUpdateWrittenBytes();
+}
 
-        blackboxBitBufferCount = 0;
-    } else {
-        if (blackboxBitBufferCount > 0) {
-            blackboxWrite(blackboxBitBuffer);
-            blackboxBitBuffer = 0;
-            blackboxBitBufferCount = 0;
-        }
-    }
+void blackboxWriteBits(uint32_t bits, unsigned int bitCount)
+{
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteBits(&blackboxBuffer, bits, bitCount);
+    blackboxUpdateWrittenBytes();
 }
 
-/**
- * How many bits would be required to fit the given integer? `i` must not be zero.
- */
-static int numBitsToStoreInteger(uint32_t i)
+void blackboxFlushBits()
 {
-    return sizeof(i) * CHAR_BIT - __builtin_clz(i);
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderFlushBits(&blackboxBuffer);
+    blackboxUpdateWrittenBytes();
 }
 
 void blackboxWriteU32EliasDelta(uint32_t value)
 {
-    unsigned int valueLen, lengthOfValueLen;
-
-    /* We can't encode value=0, so we need to add 1 to the value before encoding
-     *
-     * That would make it impossible to encode MAXINT, so instead use MAXINT-1 as an escape code which can mean
-     * either MAXINT-1 or MAXINT
-     */
-    if (value == 0xFFFFFFFF) {
-        // Write the escape code of MAXINT - 1
-        blackboxWriteU32EliasDelta(0xFFFFFFFF - 1);
-        // Add a one bit after the escape code to mean "MAXINT"
-        blackboxWriteBits(1, 1);
-        return;
-    }
-
-    value += 1;
-
-    valueLen = numBitsToStoreInteger(value);
-    lengthOfValueLen = numBitsToStoreInteger(valueLen);
-
-    // Use unary to encode the number of bits we'll need to write the length of the `value`
-    blackboxWriteBits(0, lengthOfValueLen - 1);
-    // Now write the length of the `value`
-    blackboxWriteBits(valueLen, lengthOfValueLen);
-    // Having now encoded the position of the top bit of `value`, write its remaining bits
-    blackboxWriteBits(value, valueLen - 1);
-
-    // Did this end up being an escape code? We must have been trying to write MAXINT - 1
-    if (value == 0xFFFFFFFF) {
-        // Add a zero bit after the escape code to mean "MAXINT - 1"
-        blackboxWriteBits(0, 1);
-    }
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteU32EliasDelta(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
 void blackboxWriteS32EliasDelta(int32_t value)
 {
-    blackboxWriteU32EliasDelta(zigzagEncode(value));
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteS32EliasDelta(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
 void blackboxWriteU32EliasGamma(uint32_t value)
 {
-    unsigned int lengthOfValue;
-
-    /*
-     * We can't encode value=0, so we need to add 1 to the value before encoding
-     *
-     * That would make it impossible to encode MAXINT, so instead use MAXINT-1 as an escape code which can mean
-     * either MAXINT-1 or MAXINT
-     */
-    if (value == 0xFFFFFFFF) {
-        // Write the escape code of MAXINT - 1
-        blackboxWriteU32EliasGamma(0xFFFFFFFF - 1);
-        // Add a one bit after the escape code to mean "MAXINT"
-        blackboxWriteBits(1, 1);
-        return;
-    }
-
-    value += 1;
-
-    lengthOfValue = numBitsToStoreInteger(value);
-
-    // Use unary to encode the number of bits we'll need to write `value`
-    blackboxWriteBits(0, lengthOfValue);
-
-    // Now the bits of value
-    blackboxWriteBits(value, lengthOfValue);
-
-    // Did this end up being an escape code? We must have been trying to write MAXINT - 1
-    if (value == 0xFFFFFFFF) {
-        // Add a zero bit after the escape code to mean "MAXINT - 1"
-        blackboxWriteBits(0, 1);
-    }
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteU32EliasGamma(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
 void blackboxWriteS32EliasGamma(int32_t value)
 {
-    blackboxWriteU32EliasGamma(zigzagEncode(value));
+    blackboxReserve(BLACKBOX_MAX_WRITE_LENGTH);
+    encoderWriteS32EliasGamma(&blackboxBuffer, value);
+    blackboxUpdateWrittenBytes();
 }
 
 /**
@@ -53,5 +53,6 @@ void blackboxWriteU32EliasGamma(uint32_t value);
 void blackboxWriteS32EliasGamma(int32_t value);
 
 blackboxBufferReserveStatus_e blackboxDeviceReserveBufferSpace(uint32_t bytes);
+void blackboxDeviceFlush(void);
 
 extern uint32_t blackboxWrittenBytes;
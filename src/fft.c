@@ -0,0 +1,152 @@
+#include <stdlib.h>
+
+//For msvcrt to define M_PI:
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "platform.h"
+#include "fft.h"
+
+/*
+ * A plain iterative radix-2 complex FFT. The plan holds the twiddle factors and bit-reversal permutation
+ * so that it can be built once and then shared (read-only) between any number of threads.
+ */
+struct fftPlan_t {
+    int size;
+    int *bitReverse;
+    double *cosTable, *sinTable;
+};
+
+bool fftIsPowerOfTwo(int size)
+{
+    return size > 0 && (size & (size - 1)) == 0;
+}
+
+/**
+ * Create a plan for transforms of the given size, which must be a power of two. Returns NULL if the
+ * size is unsupported.
+ */
+fftPlan_t *fftPlanCreate(int size)
+{
+    fftPlan_t *plan;
+    int bits = 0;
+
+    if (!fftIsPowerOfTwo(size))
+        return NULL;
+
+    while ((1 << bits) < size)
+        bits++;
+
+    plan = malloc(sizeof(*plan));
+    plan->size = size;
+    plan->bitReverse = malloc(size * sizeof(*plan->bitReverse));
+    plan->cosTable = malloc((size / 2 + 1) * sizeof(*plan->cosTable));
+    plan->sinTable = malloc((size / 2 + 1) * sizeof(*plan->sinTable));
+
+    for (int i = 0; i < size; i++) {
+        int reversed = 0;
+
+        for (int bit = 0; bit < bits; bit++) {
+            if (i & (1 << bit))
+                reversed |= 1 << (bits - 1 - bit);
+        }
+
+        plan->bitReverse[i] = reversed;
+    }
+
+    for (int i = 0; i <= size / 2; i++) {
+        plan->cosTable[i] = cos(2 * M_PI * i / size);
+        plan->sinTable[i] = sin(2 * M_PI * i / size);
+    }
+
+    return plan;
+}
+
+void fftPlanDestroy(fftPlan_t *plan)
+{
+    if (plan) {
+        free(plan->bitReverse);
+        free(plan->cosTable);
+        free(plan->sinTable);
+        free(plan);
+    }
+}
+
+int fftPlanGetSize(const fftPlan_t *plan)
+{
+    return plan->size;
+}
+
+static CPU_DISPATCH void fftTransform(const fftPlan_t *plan, double *re, double *im, double direction)
+{
+    int size = plan->size;
+
+    for (int i = 0; i < size; i++) {
+        int j = plan->bitReverse[i];
+
+        if (j > i) {
+            double t;
+
+            t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (int span = 2; span <= size; span *= 2) {
+        int half = span / 2;
+        int tableStep = size / span;
+
+        for (int start = 0; start < size; start += span) {
+            for (int k = 0; k < half; k++) {
+                double wr = plan->cosTable[k * tableStep];
+                double wi = direction * plan->sinTable[k * tableStep];
+
+                int even = start + k, odd = start + k + half;
+
+                double tr = re[odd] * wr - im[odd] * wi;
+                double ti = re[odd] * wi + im[odd] * wr;
+
+                re[odd] = re[even] - tr;
+                im[odd] = im[even] - ti;
+                re[even] += tr;
+                im[even] += ti;
+            }
+        }
+    }
+}
+
+/**
+ * Transform the complex signal (re, im) into the frequency domain in-place.
+ */
+void fftForward(const fftPlan_t *plan, double *re, double *im)
+{
+    fftTransform(plan, re, im, -1);
+}
+
+/**
+ * Transform the spectrum (re, im) back into the time domain in-place, including the 1/N scaling so that
+ * fftInverse(fftForward(x)) == x.
+ */
+void fftInverse(const fftPlan_t *plan, double *re, double *im)
+{
+    double scale = 1.0 / plan->size;
+
+    fftTransform(plan, re, im, 1);
+
+    for (int i = 0; i < plan->size; i++) {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
+
+void fftHannWindow(double *window, int size)
+{
+    for (int i = 0; i < size; i++) {
+        window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / (size - 1));
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef FFT_H_
+#define FFT_H_
+
+#include <stdbool.h>
+
+typedef struct fftPlan_t fftPlan_t;
+
+fftPlan_t *fftPlanCreate(int size);
+void fftPlanDestroy(fftPlan_t *plan);
+int fftPlanGetSize(const fftPlan_t *plan);
+
+void fftForward(const fftPlan_t *plan, double *re, double *im);
+void fftInverse(const fftPlan_t *plan, double *re, double *im);
+
+void fftHannWindow(double *window, int size);
+
+bool fftIsPowerOfTwo(int size);
+
+#endif
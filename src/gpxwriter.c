@@ -17,6 +17,7 @@ static const char GPX_FILE_TRAILER[] =
 
 void gpxWriterAddPreamble(gpxWriter_t *gpx)
 {
+    remove(gpx->filename);
     gpx->file = fopen(gpx->filename, "wb");
 
     fprintf(gpx->file, GPX_FILE_HEADER);
@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "platform.h"
+#include "hash.h"
+
+/*
+ * A fast non-cryptographic 128-bit hash for recognising log data we've seen before (not for anything adversarial).
+ *
+ * This follows the design of XXH3's long-input loop: the input is consumed in 64-byte stripes by 8 independent 64-bit
+ * accumulators, each of which takes a 32x32->64 bit multiply of its keyed input. Since the lanes don't depend on each
+ * other, the compiler vectorises the stripe loop (pmuludq on SSE2/AVX2, umull on NEON) and the hash runs at memory
+ * bandwidth. The accumulators are scrambled after every block of stripes so that the multiplies can't cancel out.
+ */
+
+#define HASH_LANES 8
+#define HASH_STRIPE_LENGTH (HASH_LANES * sizeof(uint64_t))
+#define HASH_STRIPES_PER_BLOCK 16
+#define HASH_BLOCK_LENGTH (HASH_STRIPE_LENGTH * HASH_STRIPES_PER_BLOCK)
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+// Each stripe of a block is keyed with the window of this table that begins at the stripe's index
+static const uint64_t HASH_KEYS[HASH_LANES + HASH_STRIPES_PER_BLOCK] = {
+    0xDAEB8EBD244A330CULL, 0x685BD8519D0023DBULL, 0x959EF8713231C2CAULL, 0xD1EA2FA4DD9AF44CULL,
+    0xA402CBA46B82BDDDULL, 0x4F7580CD7B17A39EULL, 0xC8B045B99D6FB286ULL, 0xCECA0CA0C351E0A7ULL,
+    0x38987F53584DF3C8ULL, 0xBB74476EE0B6E30FULL, 0x9474C83868219521ULL, 0xA309F5FBA2117B34ULL,
+    0xF901131499F29AADULL, 0x6568525F65BE34AEULL, 0xE61C980E7426B628ULL, 0xF330A10B9EFE9904ULL,
+    0x39381640553D574DULL, 0x0E6C783BD0D3AAC1ULL, 0x992877185800058AULL, 0xE2B445A3CB88BB30ULL,
+    0x42381838BF9D61AFULL, 0x475B2AF9C112B40FULL, 0x9D73761A2479742FULL, 0xA5869770CC27FDBAULL,
+};
+
+static uint64_t readLittleEndian64(const uint8_t *data)
+{
+    uint64_t result;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    result = 0;
+
+    for (int i = 7; i >= 0; i--) {
+        result = (result << 8) | data[i];
+    }
+#else
+    memcpy(&result, data, sizeof(result));
+#endif
+
+    return result;
+}
+
+static void accumulateStripe(uint64_t *acc, const uint8_t *stripe, const uint64_t *keys)
+{
+    for (int i = 0; i < HASH_LANES; i++) {
+        uint64_t data = readLittleEndian64(stripe + i * sizeof(uint64_t));
+        uint64_t keyed = data ^ keys[i];
+
+        acc[i ^ 1] += data;
+        acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+    }
+}
+
+static void scrambleAccumulators(uint64_t *acc)
+{
+    for (int i = 0; i < HASH_LANES; i++) {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= HASH_KEYS[HASH_STRIPES_PER_BLOCK + i];
+        acc[i] *= PRIME32_1;
+    }
+}
+
+/**
+ * Multiply two 64-bit values and fold the 128-bit product back into 64 bits.
+ */
+static uint64_t multiplyFold(uint64_t a, uint64_t b)
+{
+    uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32;
+    uint64_t bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+
+    uint64_t lowLow = aLow * bLow;
+    uint64_t highLow = aHigh * bLow;
+    uint64_t lowHigh = aLow * bHigh;
+    uint64_t highHigh = aHigh * bHigh;
+
+    uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+    uint64_t productHigh = (highLow >> 32) + (cross >> 32) + highHigh;
+    uint64_t productLow = (cross << 32) | (lowLow & 0xFFFFFFFF);
+
+    return productHigh ^ productLow;
+}
+
+static uint64_t avalanche(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+static uint64_t mergeAccumulators(const uint64_t *acc, uint64_t start, int keyOffset)
+{
+    uint64_t result = start;
+
+    for (int i = 0; i < HASH_LANES; i += 2) {
+        result += multiplyFold(acc[i] ^ HASH_KEYS[keyOffset + i], acc[i + 1] ^ HASH_KEYS[keyOffset + i + 1]);
+    }
+
+    return avalanche(result);
+}
+
+CPU_DISPATCH hash128_t hash128(const void *data, size_t length, uint64_t seed)
+{
+    const uint8_t *input = (const uint8_t *) data;
+    uint64_t acc[HASH_LANES] = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+    size_t remaining = length;
+    hash128_t result;
+
+    for (int i = 0; i < HASH_LANES; i++) {
+        acc[i] += (i & 1) ? -seed : seed;
+    }
+
+    while (remaining >= HASH_BLOCK_LENGTH) {
+        for (int stripe = 0; stripe < HASH_STRIPES_PER_BLOCK; stripe++) {
+            accumulateStripe(acc, input + stripe * HASH_STRIPE_LENGTH, HASH_KEYS + stripe);
+        }
+
+        scrambleAccumulators(acc);
+
+        input += HASH_BLOCK_LENGTH;
+        remaining -= HASH_BLOCK_LENGTH;
+    }
+
+    // The final partial block, with its last partial stripe padded out with zeros (the length is mixed in below)
+    for (int stripe = 0; remaining > 0; stripe++) {
+        uint8_t padded[HASH_STRIPE_LENGTH];
+        size_t stripeLength = remaining < HASH_STRIPE_LENGTH ? remaining : HASH_STRIPE_LENGTH;
+
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, input, stripeLength);
+
+        accumulateStripe(acc, padded, HASH_KEYS + stripe);
+
+        input += stripeLength;
+        remaining -= stripeLength;
+    }
+
+    result.low = mergeAccumulators(acc, (uint64_t) length * PRIME64_1, 0);
+    result.high = mergeAccumulators(acc, ~((uint64_t) length * PRIME64_2), HASH_STRIPES_PER_BLOCK - HASH_LANES);
+
+    return result;
+}
@@ -0,0 +1,13 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct hash128_t {
+    uint64_t low, high;
+} hash128_t;
+
+hash128_t hash128(const void *data, size_t length, uint64_t seed);
+
+#endif
@@ -2,6 +2,7 @@
  * This IMU code is used for attitude estimation, and is directly derived from Baseflight's imu.c.
  */
 #include <stdint.h>
+#include <stdbool.h>
 
 //For msvcrt to define M_PI:
 #define _USE_MATH_DEFINES
@@ -28,6 +29,19 @@ typedef enum {
 
 #define abs(x) ((x) > 0 ? (x) : -(x))
 
+/*
+ * Below this gyro delta (in radians, on every axis) the fast path builds the rotation matrix from sin(x) ~= x and
+ * cos(x) ~= 1 - x^2/2, which are out by less than 2e-7 here (about one float ULP). At 8kHz even a 2000 deg/s spin is
+ * only 0.0044 radians per frame.
+ */
+#define IMU_SMALL_ANGLE 0.01f
+
+/*
+ * Beyond this the polynomial sin/cos's range reduction loses accuracy (quadrant * PIO2_2 below stops being exact), so
+ * the library functions are used instead
+ */
+#define IMU_FAST_TRIG_MAX_ANGLE 1000.0f
+
 //Settings that would normally be set by the user in MW config:
 static const uint16_t gyro_cmpf_factor = 600;
 static const float accz_lpf_cutoff = 5.0f;
@@ -36,11 +50,30 @@ static float magneticDeclination = 0.0f;
 
 //IMU fields:
 static float fc_acc;
-static float invGyroComplimentaryFilter_M_Factor;
 
-static t_fp_vector EstM;
-static t_fp_vector EstN;
-static uint32_t previousTime;
+// The state used by imuInit() and updateEstimatedAttitude()
+static imuState_t globalState;
+
+/**
+ * Reset the filter's estimate, ready for the first frame of a log.
+ */
+void imuStateInit(imuState_t *state, bool fastMath)
+{
+    state->EstG.V.X = 0.0f;
+    state->EstG.V.Y = 0.0f;
+    state->EstG.V.Z = 0.0f;
+
+    state->EstM.V.X = 1.0f;
+    state->EstM.V.Y = 0.0f;
+    state->EstM.V.Z = 0.0f;
+
+    state->EstN.V.X = 1.0f;
+    state->EstN.V.Y = 0.0f;
+    state->EstN.V.Z = 0.0f;
+
+    state->previousTime = 0;
+    state->fastMath = fastMath;
+}
 
 /**
  * Call before any other routines in order to set up IMU constants and such.
@@ -48,17 +81,8 @@ static uint32_t previousTime;
 void imuInit(void)
 {
     fc_acc = (float) (0.5f / (M_PI * accz_lpf_cutoff)); // calculate RC time constant used in the accZ lpf
-    invGyroComplimentaryFilter_M_Factor = (1.0f / (gyro_cmpfm_factor + 1.0f));
-
-    EstM.V.X = 1.0f;
-    EstM.V.Y = 0.0f;
-    EstM.V.Z = 0.0f;
-
-    EstN.V.X = 1.0f;
-    EstN.V.Y = 0.0f;
-    EstN.V.Z = 0.0f;
 
-    previousTime = 0;
+    imuStateInit(&globalState, globalState.fastMath);
 }
 
 /**
@@ -70,6 +94,109 @@ void imuSetMagneticDeclination(double declination)
     magneticDeclination = (float) (declination * RAD);
 }
 
+/**
+ * Use polynomial approximations for trig functions (and the small-angle approximation for tiny gyro deltas) instead of
+ * the C library's, which is several times faster. On flight logs the attitude then differs from the exact calculation
+ * by less than 0.0001 radians (see test/test_imu.c).
+ */
+void imuSetFastMath(bool fast)
+{
+    globalState.fastMath = fast;
+}
+
+/*
+ * Sine and cosine of x with a maximum error of about 2e-7 (Cephes' sinf/cosf polynomials, after reducing x to
+ * [-pi/4, pi/4]).
+ */
+static void fastSinCos(float x, float *sine, float *cosine)
+{
+    /*
+     * pi/2 split into three floats (Cody-Waite), the first two short enough that multiplying them by the quadrant is
+     * exact, so that x - quadrant * pi/2 stays accurate
+     */
+    const float PIO2_1 = 1.5703125f;
+    const float PIO2_2 = 4.837512969970703125e-4f;
+    const float PIO2_3 = 7.54978995489188216e-8f;
+
+    int quadrant;
+    float r, r2, s, c;
+
+    // NaN and infinity mustn't reach the conversion of the quadrant to int
+    if (!isfinite(x) || abs(x) > IMU_FAST_TRIG_MAX_ANGLE) {
+        *sine = sinf(x);
+        *cosine = cosf(x);
+        return;
+    }
+
+    quadrant = (int) (x * (float) (2 / M_PI) + (x >= 0 ? 0.5f : -0.5f));
+    r = ((x - quadrant * PIO2_1) - quadrant * PIO2_2) - quadrant * PIO2_3;
+    r2 = r * r;
+
+    s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    c = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+    switch (quadrant & 3) {
+        case 0:
+            *sine = s;
+            *cosine = c;
+        break;
+        case 1:
+            *sine = c;
+            *cosine = -s;
+        break;
+        case 2:
+            *sine = -s;
+            *cosine = -c;
+        break;
+        default:
+            *sine = -c;
+            *cosine = s;
+    }
+}
+
+/*
+ * atan2(y, x) with a maximum error of about 1e-5 radians (a minimax polynomial for atan on [0, 1], with the octant
+ * sorted out afterwards).
+ */
+static float fastAtan2(float y, float x)
+{
+    float absX = abs(x), absY = abs(y);
+    float a, a2, result;
+
+    if (absX == 0 && absY == 0) {
+        return 0;
+    }
+
+    a = absX > absY ? absY / absX : absX / absY;
+    a2 = a * a;
+
+    result = a * (0.99997726f + a2 * (-0.33262347f + a2 * (0.19354346f + a2 * (-0.11643287f + a2 * (0.05265332f + a2 * -0.01172120f)))));
+
+    if (absY > absX)
+        result = (float) M_PI_2 - result;
+    if (x < 0)
+        result = (float) M_PI - result;
+    if (y < 0)
+        result = -result;
+
+    return result;
+}
+
+static float imuAtan2(float y, float x, bool fastMath)
+{
+    return fastMath ? fastAtan2(y, x) : atan2f(y, x);
+}
+
+static void imuSinCos(float x, float *sine, float *cosine, bool fastMath)
+{
+    if (fastMath) {
+        fastSinCos(x, sine, cosine);
+    } else {
+        *sine = sinf(x);
+        *cosine = cosf(x);
+    }
+}
+
 // **************************************************
 // Simplified IMU based on "Complementary Filter"
 // Inspired by http://starlino.com/imu_guide.html
@@ -85,8 +212,7 @@ void imuSetMagneticDeclination(double declination)
 // **************************************************
 
 #define INV_GYR_CMPF_FACTOR   (1.0f / ((float)gyro_cmpf_factor + 1.0f))
-
-static t_fp_vector EstG;
+#define INV_GYR_CMPFM_FACTOR  (1.0f / (gyro_cmpfm_factor + 1.0f))
 
 static void normalizeVector(struct fp_vector *src, struct fp_vector *dest)
 {
@@ -100,21 +226,24 @@ static void normalizeVector(struct fp_vector *src, struct fp_vector *dest)
     }
 }
 
-static void rotateVector(struct fp_vector *v, float *delta)
+static void computeRotationMatrix(float mat[3][3], float *delta, bool fastMath)
 {
-    struct fp_vector v_tmp = *v;
-
     // This does a  "proper" matrix rotation using gyro deltas without small-angle approximation
-    float mat[3][3];
     float cosx, sinx, cosy, siny, cosz, sinz;
     float coszcosx, sinzcosx, coszsinx, sinzsinx;
 
-    cosx = cosf(delta[ROLL]);
-    sinx = sinf(delta[ROLL]);
-    cosy = cosf(delta[PITCH]);
-    siny = sinf(delta[PITCH]);
-    cosz = cosf(delta[YAW]);
-    sinz = sinf(delta[YAW]);
+    if (fastMath && fabsf(delta[ROLL]) < IMU_SMALL_ANGLE && fabsf(delta[PITCH]) < IMU_SMALL_ANGLE && fabsf(delta[YAW]) < IMU_SMALL_ANGLE) {
+        sinx = delta[ROLL];
+        cosx = 1.0f - 0.5f * delta[ROLL] * delta[ROLL];
+        siny = delta[PITCH];
+        cosy = 1.0f - 0.5f * delta[PITCH] * delta[PITCH];
+        sinz = delta[YAW];
+        cosz = 1.0f - 0.5f * delta[YAW] * delta[YAW];
+    } else {
+        imuSinCos(delta[ROLL], &sinx, &cosx, fastMath);
+        imuSinCos(delta[PITCH], &siny, &cosy, fastMath);
+        imuSinCos(delta[YAW], &sinz, &cosz, fastMath);
+    }
 
     coszcosx = cosz * cosx;
     sinzcosx = sinz * cosx;
@@ -130,12 +259,25 @@ static void rotateVector(struct fp_vector *v, float *delta)
     mat[2][0] = (sinzsinx) - (coszcosx * siny);
     mat[2][1] = (coszsinx) + (sinzcosx * siny);
     mat[2][2] = cosy * cosx;
+}
+
+static void applyRotationMatrix(struct fp_vector *v, float mat[3][3])
+{
+    struct fp_vector v_tmp = *v;
 
     v->X = v_tmp.X * mat[0][0] + v_tmp.Y * mat[1][0] + v_tmp.Z * mat[2][0];
     v->Y = v_tmp.X * mat[0][1] + v_tmp.Y * mat[1][1] + v_tmp.Z * mat[2][1];
     v->Z = v_tmp.X * mat[0][2] + v_tmp.Y * mat[1][2] + v_tmp.Z * mat[2][2];
 }
 
+static void rotateVector(struct fp_vector *v, float *delta, bool fastMath)
+{
+    float mat[3][3];
+
+    computeRotationMatrix(mat, delta, fastMath);
+    applyRotationMatrix(v, mat);
+}
+
 t_fp_vector calculateAccelerationInEarthFrame(int16_t accSmooth[3], attitude_t *attitude, uint16_t acc_1G)
 {
     float rpy[3];
@@ -150,7 +292,7 @@ t_fp_vector calculateAccelerationInEarthFrame(int16_t accSmooth[3], attitude_t *
     result.V.Y = accSmooth[1];
     result.V.Z = accSmooth[2];
 
-    rotateVector(&result.V, rpy);
+    rotateVector(&result.V, rpy, globalState.fastMath);
 
     result.V.Z -= acc_1G;
 
@@ -158,15 +300,16 @@ t_fp_vector calculateAccelerationInEarthFrame(int16_t accSmooth[3], attitude_t *
 }
 
 // baseflight calculation by Luggi09 originates from arducopter
-static float calculateHeading(t_fp_vector *vec, float angleradRoll, float angleradPitch)
+static float calculateHeading(t_fp_vector *vec, float angleradRoll, float angleradPitch, bool fastMath)
 {
-    float cosineRoll = cosf(angleradRoll);
-    float sineRoll = sinf(angleradRoll);
-    float cosinePitch = cosf(angleradPitch);
-    float sinePitch = sinf(angleradPitch);
+    float cosineRoll, sineRoll, cosinePitch, sinePitch;
+
+    imuSinCos(angleradRoll, &sineRoll, &cosineRoll, fastMath);
+    imuSinCos(angleradPitch, &sinePitch, &cosinePitch, fastMath);
+
     float Xh = vec->A[X] * cosinePitch + vec->A[Y] * sineRoll * sinePitch + vec->A[Z] * sinePitch * cosineRoll;
     float Yh = vec->A[Y] * cosineRoll - vec->A[Z] * sineRoll;
-    float hd = (float) (atan2f(Yh, Xh) + magneticDeclination);
+    float hd = (float) (imuAtan2(Yh, Xh, fastMath) + magneticDeclination);
 
     if (hd < 0)
         hd += (float) (2 * M_PI);
@@ -174,20 +317,22 @@ static float calculateHeading(t_fp_vector *vec, float angleradRoll, float angler
     return hd;
 }
 
-void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude)
+void imuStateUpdateAttitude(imuState_t *state, int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude)
 {
     int32_t accMag = 0;
     uint32_t deltaTime;
     float scale, deltaGyroAngle[3];
+    // The gravity vector and the mag (or north) vector are both rotated by the same gyro delta
+    float deltaRotation[3][3];
 
-    if (previousTime == 0) {
+    if (state->previousTime == 0) {
         deltaTime = 1;
     } else {
-        deltaTime = currentTime - previousTime;
+        deltaTime = currentTime - state->previousTime;
     }
 
     scale = deltaTime * gyroScale;
-    previousTime = currentTime;
+    state->previousTime = currentTime;
 
     // Initialization
     for (int axis = 0; axis < 3; axis++) {
@@ -197,30 +342,37 @@ void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t m
     }
     accMag = accMag * 100 / ((int32_t)acc_1G * acc_1G);
 
-    rotateVector(&EstG.V, deltaGyroAngle);
+    computeRotationMatrix(deltaRotation, deltaGyroAngle, state->fastMath);
+
+    applyRotationMatrix(&state->EstG.V, deltaRotation);
 
     // Apply complimentary filter (Gyro drift correction)
     // If accel magnitude >1.15G or <0.85G and  ACC vector outside of the limit range => we neutralize the effect of accelerometers in the angle estimation.
     // To do that, we just skip filter, as Est V already rotated by Gyro
     if (72 < (uint16_t)accMag && (uint16_t)accMag < 133) {
         for (int axis = 0; axis < 3; axis++)
-            EstG.A[axis] = (EstG.A[axis] * (float)gyro_cmpf_factor + accSmooth[axis]) * INV_GYR_CMPF_FACTOR;
+            state->EstG.A[axis] = (state->EstG.A[axis] * (float)gyro_cmpf_factor + accSmooth[axis]) * INV_GYR_CMPF_FACTOR;
     }
 
     // Attitude of the estimated vector
-    attitude->roll = atan2f(EstG.V.Y, EstG.V.Z);
-    attitude->pitch = atan2f(-EstG.V.X, sqrtf(EstG.V.Y * EstG.V.Y + EstG.V.Z * EstG.V.Z));
+    attitude->roll = imuAtan2(state->EstG.V.Y, state->EstG.V.Z, state->fastMath);
+    attitude->pitch = imuAtan2(-state->EstG.V.X, sqrtf(state->EstG.V.Y * state->EstG.V.Y + state->EstG.V.Z * state->EstG.V.Z), state->fastMath);
 
     if (magADC) {
-        rotateVector(&EstM.V, deltaGyroAngle);
-        
+        applyRotationMatrix(&state->EstM.V, deltaRotation);
+
         for (int axis = 0; axis < 3; axis++) {
-            EstM.A[axis] = (EstM.A[axis] * gyro_cmpfm_factor + magADC[axis]) * invGyroComplimentaryFilter_M_Factor;
+            state->EstM.A[axis] = (state->EstM.A[axis] * gyro_cmpfm_factor + magADC[axis]) * INV_GYR_CMPFM_FACTOR;
         }
-        attitude->heading = calculateHeading(&EstM, attitude->roll, attitude->pitch);
+        attitude->heading = calculateHeading(&state->EstM, attitude->roll, attitude->pitch, state->fastMath);
     } else {
-        rotateVector(&EstN.V, deltaGyroAngle);
-        normalizeVector(&EstN.V, &EstN.V);
-        attitude->heading = calculateHeading(&EstN, attitude->roll, attitude->pitch);
+        applyRotationMatrix(&state->EstN.V, deltaRotation);
+        normalizeVector(&state->EstN.V, &state->EstN.V);
+        attitude->heading = calculateHeading(&state->EstN, attitude->roll, attitude->pitch, state->fastMath);
     }
 }
+
+void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude)
+{
+    imuStateUpdateAttitude(&globalState, gyroADC, accSmooth, magADC, currentTime, acc_1G, gyroScale, attitude);
+}
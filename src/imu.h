@@ -1,6 +1,9 @@
 #ifndef IMU_H_
 #define IMU_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef struct fp_vector {
     float X;
     float Y;
@@ -19,8 +22,23 @@ typedef struct attitude_t {
     float heading;
 } attitude_t;
 
+/*
+ * The complementary filter's estimate, carried from one frame to the next. Separate states can be updated from
+ * separate threads.
+ */
+typedef struct imuState_t {
+    t_fp_vector EstG, EstM, EstN;
+    uint32_t previousTime;
+    bool fastMath;
+} imuState_t;
+
+void imuStateInit(imuState_t *state, bool fastMath);
+void imuStateUpdateAttitude(imuState_t *state, int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude);
+
+// These operate on a single global state:
 void imuInit(void);
 void imuSetMagneticDeclination(double declination);
+void imuSetFastMath(bool fast);
 
 void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude);
 t_fp_vector calculateAccelerationInEarthFrame(int16_t accSmooth[3], attitude_t *attitude, uint16_t acc_1G);
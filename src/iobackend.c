@@ -0,0 +1,719 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "iobackend.h"
+
+#ifndef WIN32
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+    #include <sys/vfs.h>
+    #include <sys/syscall.h>
+
+    #if defined(__has_include)
+        #if __has_include(<linux/io_uring.h>)
+            #include <linux/io_uring.h>
+            #define HAVE_IO_URING
+        #endif
+    #endif
+#elif defined(__APPLE__)
+    #include <sys/param.h>
+    #include <sys/mount.h>
+#endif
+
+// Files are read in chunks of this size (which is also the size of a huge page, so the chunks land on page boundaries)
+#define IO_CHUNK_SIZE (2 * 1024 * 1024)
+
+// Number of chunk reads the io_uring backend keeps in flight at once
+#define IO_URING_QUEUE_DEPTH 8
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#ifdef _MSC_VER
+    #define ATOMIC_LOAD(target) (*(volatile size_t *) (target))
+    #define ATOMIC_STORE(target, value) (*(volatile size_t *) (target) = (value))
+#else
+    #define ATOMIC_LOAD(target) __atomic_load_n((target), __ATOMIC_ACQUIRE)
+    #define ATOMIC_STORE(target, value) __atomic_store_n((target), (value), __ATOMIC_RELEASE)
+#endif
+
+static const char* const IO_BACKEND_NAME[] = {
+    "auto",
+    "mmap",
+    "pread",
+    "io_uring"
+};
+
+bool ioBackendFromName(const char *name, ioBackend_e *backend)
+{
+    for (int i = 0; i < (int) (sizeof(IO_BACKEND_NAME) / sizeof(IO_BACKEND_NAME[0])); i++) {
+        if (strcmp(name, IO_BACKEND_NAME[i]) == 0) {
+            *backend = (ioBackend_e) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* ioBackendName(ioBackend_e backend)
+{
+    return IO_BACKEND_NAME[backend];
+}
+
+/**
+ * Pick the backend for reading the given file: mmap for local filesystems, where the page cache's own read-ahead does
+ * a good job, and buffered reads for network and FUSE filesystems, where every page fault is a round trip.
+ */
+ioBackend_e ioBackendChoose(int fd)
+{
+#if defined(__linux__)
+    struct statfs fsStats;
+
+    if (fstatfs(fd, &fsStats) == 0) {
+        switch ((uint32_t) fsStats.f_type) {
+            case 0x6969:     // NFS
+            case 0x65735546: // FUSE
+            case 0xFF534D42: // CIFS
+            case 0xFE534D42: // SMB2
+            case 0x517B:     // SMB
+            case 0x01021997: // 9P
+            case 0x00C36400: // Ceph
+            case 0x0BD00BD0: // Lustre
+            case 0x47504653: // GPFS
+                #ifdef HAVE_IO_URING
+                    return IO_BACKEND_URING;
+                #else
+                    return IO_BACKEND_PREAD;
+                #endif
+        }
+    }
+#elif defined(__APPLE__)
+    struct statfs fsStats;
+
+    if (fstatfs(fd, &fsStats) == 0) {
+        static const char* const REMOTE_FILESYSTEMS[] = {"nfs", "smbfs", "afpfs", "webdav", "macfuse", "osxfuse"};
+
+        for (int i = 0; i < (int) (sizeof(REMOTE_FILESYSTEMS) / sizeof(REMOTE_FILESYSTEMS[0])); i++) {
+            if (strcmp(fsStats.f_fstypename, REMOTE_FILESYSTEMS[i]) == 0) {
+                return IO_BACKEND_PREAD;
+            }
+        }
+    }
+#else
+    (void) fd;
+#endif
+
+    return IO_BACKEND_MMAP;
+}
+
+#ifndef WIN32
+
+/**
+ * Reserve an address range of the given size which begins on a huge page boundary, returning NULL if that's not possible.
+ */
+static char* reserveHugePageAligned(size_t size)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t reserveSize;
+    char *reserved, *aligned;
+
+    // munmap() needs page-aligned lengths to trim the reservation
+    size = (size + pageSize - 1) & ~(pageSize - 1);
+    reserveSize = size + HUGE_PAGE_SIZE;
+
+    reserved = mmap(NULL, reserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (reserved == MAP_FAILED) {
+        return NULL;
+    }
+
+    aligned = (char *) (((uintptr_t) reserved + HUGE_PAGE_SIZE - 1) & ~((uintptr_t) HUGE_PAGE_SIZE - 1));
+
+    // Give back the parts of the reservation either side of the aligned region
+    if (aligned > reserved) {
+        munmap(reserved, aligned - reserved);
+    }
+    if (reserved + reserveSize > aligned + size) {
+        munmap(aligned + size, reserved + reserveSize - (aligned + size));
+    }
+
+    return aligned;
+}
+
+static void adviseHugePages(char *data, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+    madvise(data, size, MADV_HUGEPAGE);
+#else
+    (void) data;
+    (void) size;
+#endif
+}
+
+#endif
+
+/**
+ * Memory-map the file like mmap_file(), but tell the kernel that we'll be reading it from start to finish so it can
+ * read ahead aggressively. With hugePages, the mapping is aligned to a huge page boundary so the kernel is able to back
+ * it with huge pages (where the filesystem supports it).
+ */
+bool ioMapFile(fileMapping_t *mapping, int fd, bool hugePages)
+{
+#ifdef WIN32
+    (void) hugePages;
+
+    return mmap_file(mapping, fd);
+#else
+    mapping->data = NULL;
+
+    if (hugePages && fd >= 0 && fstat(fd, &mapping->stats) == 0 && (mapping->stats.st_mode & S_IFMT) == S_IFREG
+            && mapping->stats.st_size >= HUGE_PAGE_SIZE) {
+        size_t size = mapping->stats.st_size;
+        char *aligned = reserveHugePageAligned(size);
+
+        if (aligned) {
+            char *data = mmap(aligned, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+
+            if (data == MAP_FAILED) {
+                munmap(aligned, size);
+            } else {
+                mapping->fd = fd;
+                mapping->data = data;
+                mapping->size = size;
+
+                adviseHugePages(data, size);
+            }
+        }
+    }
+
+    if (!mapping->data && !mmap_file(mapping, fd)) {
+        return false;
+    }
+
+    if (mapping->data && (mapping->stats.st_mode & S_IFMT) == S_IFREG) {
+        madvise(mapping->data, mapping->size, MADV_SEQUENTIAL);
+        madvise(mapping->data, mapping->size, MADV_WILLNEED);
+    }
+
+    return true;
+#endif
+}
+
+#ifndef WIN32
+
+struct ioLoader_t {
+    int fd;
+    ioBackend_e backend;
+
+    char *buffer;
+    size_t bufferSize;
+
+    /*
+     * Set if the chunks must stay in the anonymous buffer rather than being handed over to the page cache once they've
+     * been read (because we were asked for huge pages, or the filesystem can't be mapped).
+     */
+    bool keepInBuffer;
+
+    // The length of the file, reduced to the length we managed to read if a read fails
+    size_t size;
+
+    // The buffer is valid from the beginning up to here
+    size_t loaded;
+
+    // Set once the loader thread won't be reading any more
+    size_t stopped;
+
+    // Set to ask the loader thread to give up early
+    size_t cancelled;
+
+    // Signalled whenever the loaded length grows (or the loader stops), and when the thread exits
+    semaphore_t progress, finished;
+
+#ifdef HAVE_IO_URING
+    int ringFD;
+
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize, sqesSize;
+#endif
+};
+
+static void publishLoaded(ioLoader_t *loader, size_t loaded)
+{
+    ATOMIC_STORE(&loader->loaded, loaded);
+    semaphore_signal(&loader->progress);
+}
+
+static void reportReadError(ioLoader_t *loader, size_t offset, int error)
+{
+    if (error) {
+        fprintf(stderr, "Failed to read log file at offset %llu: %s\n", (unsigned long long) offset, strerror(error));
+    } else {
+        fprintf(stderr, "Log file was truncated while reading it (at offset %llu)\n", (unsigned long long) offset);
+    }
+
+    ATOMIC_STORE(&loader->size, ATOMIC_LOAD(&loader->loaded));
+}
+
+/**
+ * Swap the part of the buffer that has just been read for a mapping of the same part of the file, which the read has
+ * just brought into the page cache. The contents don't change, but they're no longer anonymous memory which can only
+ * be freed by destroying the loader, so the kernel can reclaim them (and re-read them if they're needed again) like the
+ * pages of the mmap backend. Without this, reading a multi-GB log would need that much memory.
+ *
+ * Both the offset and the buffer are page-aligned (chunks begin on IO_CHUNK_SIZE boundaries).
+ */
+static void releaseToPageCache(ioLoader_t *loader, size_t offset, size_t length)
+{
+    if (loader->keepInBuffer || ATOMIC_LOAD(&loader->cancelled)) {
+        return;
+    }
+
+    if (mmap(loader->buffer + offset, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, loader->fd, offset) == MAP_FAILED) {
+        // Some FUSE filesystems don't support mmap, the mapping is left as it was so we can keep what we read
+        loader->keepInBuffer = true;
+    }
+}
+
+/**
+ * Read the rest of the file sequentially from the given offset using pread, making each chunk available as soon as it
+ * arrives so the consumer works on one chunk while we fetch the next.
+ */
+static void loadWithPread(ioLoader_t *loader, size_t offset)
+{
+    while (offset < loader->size && !ATOMIC_LOAD(&loader->cancelled)) {
+        size_t chunkStart = offset;
+        size_t chunkEnd = offset + IO_CHUNK_SIZE < loader->size ? offset + IO_CHUNK_SIZE : loader->size;
+
+        while (offset < chunkEnd) {
+            ssize_t result = pread(loader->fd, loader->buffer + offset, chunkEnd - offset, offset);
+
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (result <= 0) {
+                reportReadError(loader, offset, result < 0 ? errno : 0);
+                return;
+            }
+
+            offset += result;
+        }
+
+        releaseToPageCache(loader, chunkStart, chunkEnd - chunkStart);
+        publishLoaded(loader, offset);
+    }
+}
+
+#ifdef HAVE_IO_URING
+
+static bool uringSetup(ioLoader_t *loader)
+{
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+
+    loader->ringFD = (int) syscall(__NR_io_uring_setup, IO_URING_QUEUE_DEPTH, &params);
+
+    if (loader->ringFD < 0) {
+        return false;
+    }
+
+    loader->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    loader->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (loader->cqRingSize > loader->sqRingSize) {
+            loader->sqRingSize = loader->cqRingSize;
+        }
+        loader->cqRingSize = loader->sqRingSize;
+    }
+
+    loader->sqRing = mmap(NULL, loader->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loader->ringFD, IORING_OFF_SQ_RING);
+
+    if (loader->sqRing == MAP_FAILED) {
+        close(loader->ringFD);
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        loader->cqRing = loader->sqRing;
+    } else {
+        loader->cqRing = mmap(NULL, loader->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loader->ringFD, IORING_OFF_CQ_RING);
+
+        if (loader->cqRing == MAP_FAILED) {
+            munmap(loader->sqRing, loader->sqRingSize);
+            close(loader->ringFD);
+            return false;
+        }
+    }
+
+    loader->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    loader->sqes = mmap(NULL, loader->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loader->ringFD, IORING_OFF_SQES);
+
+    if (loader->sqes == MAP_FAILED) {
+        if (loader->cqRing != loader->sqRing) {
+            munmap(loader->cqRing, loader->cqRingSize);
+        }
+        munmap(loader->sqRing, loader->sqRingSize);
+        close(loader->ringFD);
+        return false;
+    }
+
+    loader->sqHead = (unsigned *) ((char *) loader->sqRing + params.sq_off.head);
+    loader->sqTail = (unsigned *) ((char *) loader->sqRing + params.sq_off.tail);
+    loader->sqMask = (unsigned *) ((char *) loader->sqRing + params.sq_off.ring_mask);
+    loader->sqArray = (unsigned *) ((char *) loader->sqRing + params.sq_off.array);
+
+    loader->cqHead = (unsigned *) ((char *) loader->cqRing + params.cq_off.head);
+    loader->cqTail = (unsigned *) ((char *) loader->cqRing + params.cq_off.tail);
+    loader->cqMask = (unsigned *) ((char *) loader->cqRing + params.cq_off.ring_mask);
+    loader->cqes = (struct io_uring_cqe *) ((char *) loader->cqRing + params.cq_off.cqes);
+
+    return true;
+}
+
+static void uringTeardown(ioLoader_t *loader)
+{
+    munmap(loader->sqes, loader->sqesSize);
+    if (loader->cqRing != loader->sqRing) {
+        munmap(loader->cqRing, loader->cqRingSize);
+    }
+    munmap(loader->sqRing, loader->sqRingSize);
+    close(loader->ringFD);
+}
+
+static void uringQueueRead(ioLoader_t *loader, size_t offset, size_t length, uint64_t chunk)
+{
+    unsigned tail = *loader->sqTail;
+    unsigned index = tail & *loader->sqMask;
+    struct io_uring_sqe *sqe = &loader->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = loader->fd;
+    sqe->addr = (uint64_t) (uintptr_t) (loader->buffer + offset);
+    sqe->len = (uint32_t) length;
+    sqe->off = offset;
+    sqe->user_data = chunk;
+
+    loader->sqArray[index] = index;
+
+    __atomic_store_n(loader->sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Read the file with up to IO_URING_QUEUE_DEPTH chunk reads in flight at once. Chunks can complete in any order, but
+ * only the contiguous run from the start of the file is published to the consumer.
+ *
+ * Returns false if io_uring stopped working (e.g. the kernel doesn't support IORING_OP_READ), in which case the caller
+ * should carry on from the loaded offset with pread.
+ */
+static bool loadWithUring(ioLoader_t *loader)
+{
+    size_t chunkCount = (loader->size + IO_CHUNK_SIZE - 1) / IO_CHUNK_SIZE;
+    // How many bytes of each chunk have been read so far
+    size_t *chunkDone = calloc(chunkCount, sizeof(*chunkDone));
+    size_t nextChunk = 0, contiguousChunks = 0;
+    int inFlight = 0, toSubmit = 0;
+    bool ok = true;
+
+    while (contiguousChunks < chunkCount) {
+        while (ok && inFlight < IO_URING_QUEUE_DEPTH && nextChunk < chunkCount && !ATOMIC_LOAD(&loader->cancelled)) {
+            size_t offset = nextChunk * IO_CHUNK_SIZE;
+            size_t length = offset + IO_CHUNK_SIZE < loader->size ? IO_CHUNK_SIZE : loader->size - offset;
+
+            uringQueueRead(loader, offset, length, nextChunk);
+
+            nextChunk++;
+            inFlight++;
+            toSubmit++;
+        }
+
+        if (inFlight == 0) {
+            break;
+        }
+
+        int result = (int) syscall(__NR_io_uring_enter, loader->ringFD, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if (result < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+
+            // We can't tell which reads are still in flight, so we can't safely go on using the buffer
+            fprintf(stderr, "Failed to read log file with io_uring: %s\n", strerror(errno));
+            exit(-1);
+        }
+
+        toSubmit -= result;
+
+        unsigned head = *loader->cqHead;
+        unsigned tail = __atomic_load_n(loader->cqTail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &loader->cqes[head & *loader->cqMask];
+            size_t chunk = (size_t) cqe->user_data;
+            size_t offset = chunk * IO_CHUNK_SIZE;
+            size_t length = offset + IO_CHUNK_SIZE < loader->size ? IO_CHUNK_SIZE : loader->size - offset;
+
+            inFlight--;
+
+            if (cqe->res > 0) {
+                chunkDone[chunk] += cqe->res;
+            } else if (cqe->res != -EAGAIN && cqe->res != -EINTR) {
+                // Give up on this ring, the caller will re-read the missing part with pread
+                ok = false;
+                continue;
+            }
+
+            if (ok && chunkDone[chunk] < length && !ATOMIC_LOAD(&loader->cancelled)) {
+                // Short read, ask for the rest of the chunk
+                uringQueueRead(loader, offset + chunkDone[chunk], length - chunkDone[chunk], chunk);
+                inFlight++;
+                toSubmit++;
+            } else if (chunkDone[chunk] == length) {
+                // No read into this chunk is in flight any more
+                releaseToPageCache(loader, offset, length);
+            }
+        }
+
+        __atomic_store_n(loader->cqHead, head, __ATOMIC_RELEASE);
+
+        size_t oldContiguous = contiguousChunks;
+
+        while (contiguousChunks < chunkCount) {
+            size_t offset = contiguousChunks * IO_CHUNK_SIZE;
+            size_t length = offset + IO_CHUNK_SIZE < loader->size ? IO_CHUNK_SIZE : loader->size - offset;
+
+            if (chunkDone[contiguousChunks] < length) {
+                break;
+            }
+
+            contiguousChunks++;
+        }
+
+        if (contiguousChunks > oldContiguous) {
+            size_t loaded = contiguousChunks * IO_CHUNK_SIZE;
+
+            publishLoaded(loader, loaded < loader->size ? loaded : loader->size);
+        }
+
+        if ((!ok || ATOMIC_LOAD(&loader->cancelled)) && inFlight == 0) {
+            break;
+        }
+    }
+
+    free(chunkDone);
+
+    return ok;
+}
+
+#endif
+
+static void* loaderThread(void *arg)
+{
+    ioLoader_t *loader = (ioLoader_t *) arg;
+
+#ifdef HAVE_IO_URING
+    if (loader->backend == IO_BACKEND_URING) {
+        if (!loadWithUring(loader)) {
+            loadWithPread(loader, ATOMIC_LOAD(&loader->loaded));
+        }
+
+        uringTeardown(loader);
+    } else
+#endif
+    {
+        loadWithPread(loader, 0);
+    }
+
+    ATOMIC_STORE(&loader->stopped, 1);
+
+    semaphore_signal(&loader->progress);
+    semaphore_signal(&loader->finished);
+
+    return NULL;
+}
+
+/**
+ * Begin reading the file of the given size into memory in the background using the pread or io_uring backend. If
+ * io_uring isn't available, pread is used instead.
+ *
+ * Each chunk is handed over to the page cache once it has been read (see releaseToPageCache()), so the loader only
+ * holds on to the chunks that are being read. With hugePages the whole file is kept in the buffer instead.
+ *
+ * Returns NULL if the buffer couldn't be allocated or the backend isn't supported on this platform.
+ */
+ioLoader_t* ioLoaderCreate(int fd, size_t size, ioBackend_e backend, bool hugePages)
+{
+    ioLoader_t *loader = calloc(1, sizeof(*loader));
+
+    loader->fd = fd;
+    loader->size = size;
+    loader->backend = backend;
+    // A huge page buffer stays as it is, that's what it was asked for
+    loader->keepInBuffer = hugePages;
+
+    if (hugePages && size >= HUGE_PAGE_SIZE) {
+        loader->bufferSize = (size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+        loader->buffer = reserveHugePageAligned(loader->bufferSize);
+
+        if (loader->buffer) {
+            if (mmap(loader->buffer, loader->bufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+                munmap(loader->buffer, loader->bufferSize);
+                loader->buffer = NULL;
+            } else {
+                adviseHugePages(loader->buffer, loader->bufferSize);
+            }
+        }
+    }
+
+    if (!loader->buffer) {
+        loader->bufferSize = size;
+        loader->buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (loader->buffer == MAP_FAILED) {
+            free(loader);
+            return NULL;
+        }
+    }
+
+#ifdef HAVE_IO_URING
+    if (loader->backend == IO_BACKEND_URING && !uringSetup(loader)) {
+        loader->backend = IO_BACKEND_PREAD;
+    }
+#else
+    if (loader->backend == IO_BACKEND_URING) {
+        loader->backend = IO_BACKEND_PREAD;
+    }
+#endif
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    semaphore_create(&loader->progress, 0);
+    semaphore_create(&loader->finished, 0);
+
+    thread_create_detached(loaderThread, loader);
+
+    return loader;
+}
+
+/**
+ * Stop reading (if the loader hasn't finished yet) and free the buffer.
+ */
+void ioLoaderDestroy(ioLoader_t *loader)
+{
+    if (loader) {
+        ATOMIC_STORE(&loader->cancelled, 1);
+
+        semaphore_wait(&loader->finished);
+
+        semaphore_destroy(&loader->progress);
+        semaphore_destroy(&loader->finished);
+
+        munmap(loader->buffer, loader->bufferSize);
+        free(loader);
+    }
+}
+
+/**
+ * Wait until at least the first `length` bytes of the file have been read (or the loader has given up), and return
+ * the number of bytes which are now available.
+ */
+size_t ioLoaderWait(ioLoader_t *loader, size_t length)
+{
+    while (true) {
+        size_t loaded = ATOMIC_LOAD(&loader->loaded);
+
+        if (loaded >= length) {
+            return loaded;
+        }
+
+        if (ATOMIC_LOAD(&loader->stopped)) {
+            return ATOMIC_LOAD(&loader->loaded);
+        }
+
+        semaphore_wait(&loader->progress);
+    }
+}
+
+char* ioLoaderBuffer(ioLoader_t *loader)
+{
+    return loader->buffer;
+}
+
+ioBackend_e ioLoaderBackend(ioLoader_t *loader)
+{
+    return loader->backend;
+}
+
+/**
+ * Get the length of the file, which is reduced to the length successfully read if the loader hit a read error.
+ */
+size_t ioLoaderSize(ioLoader_t *loader)
+{
+    return ATOMIC_LOAD(&loader->size);
+}
+
+#else
+
+// Windows has no pread, so the buffered backends aren't available there and the caller falls back to mmap
+ioLoader_t* ioLoaderCreate(int fd, size_t size, ioBackend_e backend, bool hugePages)
+{
+    (void) fd;
+    (void) size;
+    (void) backend;
+    (void) hugePages;
+
+    return NULL;
+}
+
+void ioLoaderDestroy(ioLoader_t *loader)
+{
+    (void) loader;
+}
+
+size_t ioLoaderWait(ioLoader_t *loader, size_t length)
+{
+    (void) loader;
+
+    return length;
+}
+
+char* ioLoaderBuffer(ioLoader_t *loader)
+{
+    (void) loader;
+
+    return NULL;
+}
+
+ioBackend_e ioLoaderBackend(ioLoader_t *loader)
+{
+    (void) loader;
+
+    return IO_BACKEND_MMAP;
+}
+
+size_t ioLoaderSize(ioLoader_t *loader)
+{
+    (void) loader;
+
+    return 0;
+}
+
+#endif
+
@@ -0,0 +1,38 @@
+#ifndef IOBACKEND_H_
+#define IOBACKEND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "platform.h"
+
+/*
+ * Ways of bringing a log file into memory. The parser wants the whole file as one contiguous buffer, so the buffered
+ * backends read it into memory from a background thread (in large sequential reads) while the caller consumes the
+ * part that has arrived so far, instead of page-faulting through an mmap 4kB at a time.
+ */
+typedef enum {
+    IO_BACKEND_AUTO = 0,
+    IO_BACKEND_MMAP,
+    IO_BACKEND_PREAD,
+    IO_BACKEND_URING
+} ioBackend_e;
+
+typedef struct ioLoader_t ioLoader_t;
+
+bool ioBackendFromName(const char *name, ioBackend_e *backend);
+const char* ioBackendName(ioBackend_e backend);
+ioBackend_e ioBackendChoose(int fd);
+
+bool ioMapFile(fileMapping_t *mapping, int fd, bool hugePages);
+
+ioLoader_t* ioLoaderCreate(int fd, size_t size, ioBackend_e backend, bool hugePages);
+void ioLoaderDestroy(ioLoader_t *loader);
+
+char* ioLoaderBuffer(ioLoader_t *loader);
+ioBackend_e ioLoaderBackend(ioLoader_t *loader);
+size_t ioLoaderWait(ioLoader_t *loader, size_t length);
+size_t ioLoaderSize(ioLoader_t *loader);
+
+#endif
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "platform.h"
+#include "iofollow.h"
+
+#ifndef WIN32
+    #include <unistd.h>
+    #include <poll.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+    #include <sys/inotify.h>
+    #define HAVE_INOTIFY
+#endif
+
+// Address space to reserve for the file to grow into
+#define IO_FOLLOW_RESERVE (sizeof(void*) >= 8 ? (size_t) 64 * 1024 * 1024 * 1024 : (size_t) 512 * 1024 * 1024)
+
+/*
+ * How often to check the size of the file while waiting for it to grow, in case no change notification arrives (e.g.
+ * for files written by another host over a network filesystem, or where inotify isn't available).
+ */
+#define IO_FOLLOW_POLL_MS 250
+
+#ifndef WIN32
+
+struct ioFollower_t {
+    int fd;
+
+    char *buffer;
+    size_t reserved;
+
+    // The length of the file we've seen so far, and the length of the mapping (rounded up to a page)
+    size_t size;
+    size_t mapped;
+
+    // Stop following after this long without the file growing (0 to wait forever)
+    int idleTimeoutMS;
+
+    // Set once the writer has closed the file, after which it won't grow any more
+    bool writerClosed;
+
+    // Set once we've stopped following the file, we don't wait for it again after that
+    bool finished;
+
+    // inotify instance watching the file, or -1 if we have to poll
+    int watchFD;
+};
+
+/**
+ * Map the file up to the given length into the reserved range.
+ */
+static bool extendMapping(ioFollower_t *follower, size_t size)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t mapped = (size + pageSize - 1) & ~(pageSize - 1);
+
+    if (mapped > follower->reserved) {
+        fprintf(stderr, "Log file has grown too large to follow (%llu bytes)\n", (unsigned long long) size);
+        return false;
+    }
+
+    if (mapped > follower->mapped) {
+        /*
+         * The page at the end of the old mapping is shared with the page cache, so it already shows whatever has been
+         * appended to it, we only need to map the pages after it.
+         */
+        if (mmap(follower->buffer + follower->mapped, mapped - follower->mapped, PROT_READ, MAP_SHARED | MAP_FIXED,
+                follower->fd, follower->mapped) == MAP_FAILED) {
+            fprintf(stderr, "Failed to map the new part of the log file: %s\n", strerror(errno));
+            return false;
+        }
+
+        follower->mapped = mapped;
+    }
+
+    follower->size = size;
+
+    return true;
+}
+
+/**
+ * Sleep until the file might have changed, or for at most timeoutMS.
+ */
+static void waitForChange(ioFollower_t *follower, int timeoutMS)
+{
+#ifdef HAVE_INOTIFY
+    if (follower->watchFD >= 0) {
+        struct pollfd pollFD = {.fd = follower->watchFD, .events = POLLIN};
+
+        if (poll(&pollFD, 1, timeoutMS) > 0) {
+            char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+            ssize_t length = read(follower->watchFD, events, sizeof(events));
+
+            for (char *pos = events; length > 0 && pos < events + length; ) {
+                struct inotify_event *event = (struct inotify_event *) pos;
+
+                if (event->mask & IN_CLOSE_WRITE) {
+                    follower->writerClosed = true;
+                }
+
+                pos += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        return;
+    }
+#endif
+
+    usleep(timeoutMS * 1000);
+}
+
+/**
+ * Map the part of the file `fd` which has been written so far. Returns NULL if the file isn't a regular file or the
+ * address range for it couldn't be reserved.
+ */
+ioFollower_t* ioFollowerCreate(int fd, int idleTimeoutMS)
+{
+    ioFollower_t *follower;
+    struct stat stats;
+
+    if (fd < 0 || fstat(fd, &stats) != 0 || (stats.st_mode & S_IFMT) != S_IFREG) {
+        return NULL;
+    }
+
+    follower = calloc(1, sizeof(*follower));
+
+    follower->fd = fd;
+    follower->idleTimeoutMS = idleTimeoutMS;
+    follower->reserved = IO_FOLLOW_RESERVE;
+    follower->buffer = mmap(NULL, follower->reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (follower->buffer == MAP_FAILED) {
+        free(follower);
+        return NULL;
+    }
+
+    if (!extendMapping(follower, stats.st_size)) {
+        munmap(follower->buffer, follower->reserved);
+        free(follower);
+        return NULL;
+    }
+
+    follower->watchFD = -1;
+
+#ifdef HAVE_INOTIFY
+    char path[64];
+
+    follower->watchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+
+    if (follower->watchFD >= 0 && inotify_add_watch(follower->watchFD, path, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+        close(follower->watchFD);
+        follower->watchFD = -1;
+    }
+#endif
+
+    return follower;
+}
+
+void ioFollowerDestroy(ioFollower_t *follower)
+{
+    if (follower) {
+        if (follower->watchFD >= 0) {
+            close(follower->watchFD);
+        }
+
+        munmap(follower->buffer, follower->reserved);
+        free(follower);
+    }
+}
+
+/**
+ * Wait for the file to grow and extend the mapping to cover the new data. Returns false once the writer closes the file
+ * (or the file has gone idleTimeoutMS without growing) without writing anything more, and from then on.
+ */
+static bool waitForGrowth(ioFollower_t *follower)
+{
+    uint64_t idleStart = monotonic_time_nanos();
+
+    while (true) {
+        struct stat stats;
+
+        if (fstat(follower->fd, &stats) != 0) {
+            return false;
+        }
+
+        if ((size_t) stats.st_size > follower->size) {
+            return extendMapping(follower, stats.st_size);
+        }
+
+        if ((size_t) stats.st_size < follower->size) {
+            fprintf(stderr, "Log file was truncated while following it\n");
+            return false;
+        }
+
+        if (follower->writerClosed) {
+            return false;
+        }
+
+        int timeoutMS = IO_FOLLOW_POLL_MS;
+
+        if (follower->idleTimeoutMS > 0) {
+            int idleMS = (int) ((monotonic_time_nanos() - idleStart) / 1000000);
+
+            if (idleMS >= follower->idleTimeoutMS) {
+                return false;
+            }
+
+            if (follower->idleTimeoutMS - idleMS < timeoutMS) {
+                timeoutMS = follower->idleTimeoutMS - idleMS;
+            }
+        }
+
+        waitForChange(follower, timeoutMS);
+    }
+}
+
+bool ioFollowerWait(ioFollower_t *follower)
+{
+    if (!follower->finished && !waitForGrowth(follower)) {
+        follower->finished = true;
+    }
+
+    return !follower->finished;
+}
+
+char* ioFollowerBuffer(ioFollower_t *follower)
+{
+    return follower->buffer;
+}
+
+size_t ioFollowerSize(ioFollower_t *follower)
+{
+    return follower->size;
+}
+
+#else
+
+// Following isn't supported on Windows (a mapping there can't be extended in place)
+ioFollower_t* ioFollowerCreate(int fd, int idleTimeoutMS)
+{
+    (void) fd;
+    (void) idleTimeoutMS;
+
+    return NULL;
+}
+
+void ioFollowerDestroy(ioFollower_t *follower)
+{
+    (void) follower;
+}
+
+bool ioFollowerWait(ioFollower_t *follower)
+{
+    (void) follower;
+
+    return false;
+}
+
+char* ioFollowerBuffer(ioFollower_t *follower)
+{
+    (void) follower;
+
+    return NULL;
+}
+
+size_t ioFollowerSize(ioFollower_t *follower)
+{
+    (void) follower;
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef IOFOLLOW_H_
+#define IOFOLLOW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Maps a log file which is still being written (e.g. while it is being copied off the craft, or by a ground station
+ * recorder) and extends the mapping as the file grows. The mapping is made at the beginning of a large reserved address
+ * range so that it can grow in place, and pointers into it stay valid.
+ */
+typedef struct ioFollower_t ioFollower_t;
+
+ioFollower_t* ioFollowerCreate(int fd, int idleTimeoutMS);
+void ioFollowerDestroy(ioFollower_t *follower);
+
+bool ioFollowerWait(ioFollower_t *follower);
+
+char* ioFollowerBuffer(ioFollower_t *follower);
+size_t ioFollowerSize(ioFollower_t *follower);
+
+#endif
@@ -0,0 +1,358 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "encoder.h"
+#include "logrepair.h"
+
+#define REPAIR_BUFFER_SIZE (1024 * 1024)
+
+// Room for any event frame, or for a LOGGING_RESUME event ahead of a main frame
+#define REPAIR_MAX_EVENT_LENGTH 32
+
+/*
+ * The log is decoded once, and everything the decoder accepted is written back out. Main frames are encoded again
+ * (with a fresh I-frame after every gap), event frames are rebuilt from the decoded events, and GPS and slow frames are
+ * copied as they were, since they don't depend on any frame that might have been dropped.
+ *
+ * Every byte of the log between two frames that were written out counts as dropped, so the report covers the frames
+ * the decoder gave up on, the bytes it skipped over to find the next frame, and anything after the last frame it read.
+ */
+
+typedef struct repairState_t {
+    FILE *output;
+    encoderBuffer_t buffer;
+
+    int logIndex;
+
+    // Is the log being encoded again, or (if we can't encode its frames) left for the caller to copy as it is?
+    bool reencode;
+
+    encoderField_t fields[ENCODER_MAX_FIELDS];
+    frameEncoder_t encoder;
+
+    // The last main frame that was written
+    bool haveMainFrame;
+    uint32_t lastIteration;
+    int64_t lastTime;
+
+    // The end of the last part of the log that was written out
+    const char *consumed;
+
+    logRepairDropped_t gap;
+
+    LogRepairGapReady onGap;
+    logRepairStats_t *stats;
+} repairState_t;
+
+static repairState_t repair;
+
+static void flushOutput(void)
+{
+    // Write errors are left in the stream for the caller to find with ferror()
+    fwrite(repair.buffer.data, 1, encoderBufferLength(&repair.buffer), repair.output);
+
+    repair.buffer.pos = repair.buffer.data;
+}
+
+static void reserveOutput(size_t bytes)
+{
+    if (encoderBufferRemaining(&repair.buffer) < bytes)
+        flushOutput();
+}
+
+static void writeRaw(const char *data, size_t length)
+{
+    if (length > REPAIR_BUFFER_SIZE) {
+        flushOutput();
+        fwrite(data, 1, length, repair.output);
+    } else {
+        reserveOutput(length);
+
+        memcpy(repair.buffer.pos, data, length);
+        repair.buffer.pos += length;
+    }
+}
+
+/**
+ * Note that the bytes of the log from start to end are being written out (in some form), and that everything since the
+ * last bytes written out was dropped.
+ */
+static void keepBytes(const char *start, const char *end)
+{
+    repair.gap.bytes += start - repair.consumed;
+    repair.stats->keptBytes += end - start;
+
+    repair.consumed = end;
+}
+
+/**
+ * Write an event frame in the form that parseEventFrame() reads. Times are written without the decoder's rollover
+ * accumulator, which it adds back on.
+ */
+static void writeEvent(const flightLogEvent_t *event)
+{
+    static const char END_OF_LOG_MESSAGE[] = "End of log";
+    encoderBuffer_t *buffer = &repair.buffer;
+    union {
+        float f;
+        uint8_t bytes[4];
+    } floatConvert;
+
+    reserveOutput(REPAIR_MAX_EVENT_LENGTH);
+
+    encoderWriteByte(buffer, 'E');
+    encoderWriteByte(buffer, event->event);
+
+    switch (event->event) {
+        case FLIGHT_LOG_EVENT_SYNC_BEEP:
+            encoderWriteUnsignedVB(buffer, (uint32_t) event->data.syncBeep.time);
+        break;
+        case FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT:
+            encoderWriteByte(buffer, event->data.inflightAdjustment.adjustmentFunction);
+
+            if (event->data.inflightAdjustment.adjustmentFunction > 127) {
+                floatConvert.f = event->data.inflightAdjustment.newFloatValue;
+
+                for (int i = 0; i < 4; i++)
+                    encoderWriteByte(buffer, floatConvert.bytes[i]);
+            } else {
+                encoderWriteSignedVB(buffer, event->data.inflightAdjustment.newValue);
+            }
+        break;
+        case FLIGHT_LOG_EVENT_LOGGING_RESUME:
+            encoderWriteUnsignedVB(buffer, event->data.loggingResume.logIteration);
+            encoderWriteUnsignedVB(buffer, (uint32_t) event->data.loggingResume.currentTime);
+        break;
+        case FLIGHT_LOG_EVENT_LOG_END:
+            // Including the null terminator
+            memcpy(buffer->pos, END_OF_LOG_MESSAGE, sizeof(END_OF_LOG_MESSAGE));
+            buffer->pos += sizeof(END_OF_LOG_MESSAGE);
+        break;
+        default:
+            ;
+    }
+}
+
+static bool haveGap(void)
+{
+    return repair.gap.mainFrames > 0 || repair.gap.corruptFrames > 0 || repair.gap.gpsFrames > 0 || repair.gap.bytes > 0;
+}
+
+static void reportGap(flightLog_t *log, logRepairGap_t *gap)
+{
+    logRepairDropped_t *total = &repair.stats->dropped;
+
+    gap->haveFrameBefore = repair.haveMainFrame;
+    gap->iterationBefore = repair.lastIteration;
+    gap->timeBefore = repair.lastTime;
+    gap->dropped = repair.gap;
+
+    if (repair.onGap) {
+        repair.onGap(log, gap);
+    }
+
+    total->mainFrames += repair.gap.mainFrames;
+    total->corruptFrames += repair.gap.corruptFrames;
+    total->gpsFrames += repair.gap.gpsFrames;
+    total->bytes += repair.gap.bytes;
+    repair.stats->gaps++;
+
+    memset(&repair.gap, 0, sizeof(repair.gap));
+}
+
+static void writeMainFrame(flightLog_t *log, const int64_t *frame)
+{
+    uint32_t iteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+    int64_t time = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+
+    reserveOutput(REPAIR_MAX_EVENT_LENGTH + frameEncoderMaxFrameLength(&repair.encoder));
+
+    if (haveGap()) {
+        logRepairGap_t gap = {
+            .haveFrameAfter = true,
+            .iterationAfter = iteration,
+            .timeAfter = time,
+            .atEnd = false
+        };
+
+        if (repair.haveMainFrame) {
+            flightLogEvent_t resume;
+
+            // So that the decoder accepts the jump from the last frame we wrote to this one
+            resume.event = FLIGHT_LOG_EVENT_LOGGING_RESUME;
+            resume.data.loggingResume.logIteration = iteration;
+            resume.data.loggingResume.currentTime = time;
+
+            writeEvent(&resume);
+            repair.stats->resumesInserted++;
+        }
+
+        reportGap(log, &gap);
+
+        frameEncoderWriteIntraframe(&repair.encoder, &repair.buffer, frame);
+    } else {
+        frameEncoderWriteFrames(&repair.encoder, &repair.buffer, frame, 1);
+    }
+
+    repair.haveMainFrame = true;
+    repair.lastIteration = iteration;
+    repair.lastTime = time;
+    repair.stats->mainFramesWritten++;
+}
+
+static void onMetadataReady(flightLog_t *log)
+{
+    flightLogFrameDef_t *frameDefI = &log->frameDefs['I'];
+    flightLogFrameDef_t *frameDefP = &log->frameDefs['P'];
+
+    repair.reencode = false;
+
+    // The TAG8_4S16 encoding was different before data version 2
+    if (log->private->dataVersion < 2 || frameDefI->fieldCount > ENCODER_MAX_FIELDS || frameDefP->fieldCount != frameDefI->fieldCount) {
+        return;
+    }
+
+    for (int i = 0; i < frameDefI->fieldCount; i++) {
+        repair.fields[i].name = frameDefI->fieldName[i];
+        repair.fields[i].isSigned = frameDefI->fieldSigned[i];
+        repair.fields[i].Ipredict = frameDefI->predictor[i];
+        repair.fields[i].Iencode = frameDefI->encoding[i];
+        repair.fields[i].Ppredict = frameDefP->predictor[i];
+        repair.fields[i].Pencode = frameDefP->encoding[i];
+    }
+
+    if (!frameEncoderInit(&repair.encoder, repair.fields, frameDefI->fieldCount, log->frameIntervalI)) {
+        return;
+    }
+
+    repair.encoder.pIntervalNum = log->frameIntervalPNum;
+    repair.encoder.pIntervalDenom = log->frameIntervalPDenom;
+    repair.encoder.minthrottle = log->sysConfig.minthrottle;
+    repair.encoder.vbatref = log->sysConfig.vbatref;
+    repair.encoder.motorOutputLow = log->sysConfig.motorOutputLow;
+
+    repair.reencode = true;
+
+    // The decoder has just reached the first frame, so everything before it is the header
+    keepBytes(log->logBegin[repair.logIndex], log->private->stream->pos);
+    writeRaw(log->logBegin[repair.logIndex], log->private->stream->pos - log->logBegin[repair.logIndex]);
+}
+
+static void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+    // The frame's marker byte comes just before it
+    const char *frameStart = log->private->stream->data + frameOffset - 1;
+    const char *frameEnd = frameStart + frameSize + 1;
+
+    (void) fieldCount;
+
+    if (!repair.reencode)
+        return;
+
+    // The bytes of frames that aren't kept are counted once the next frame is kept
+    if (!frame) {
+        repair.gap.corruptFrames++;
+        return;
+    }
+
+    switch (frameType) {
+        case 'I':
+        case 'P':
+            if (frameValid) {
+                keepBytes(frameStart, frameEnd);
+                writeMainFrame(log, frame);
+            } else {
+                repair.gap.mainFrames++;
+            }
+        break;
+        case 'G':
+            // GPS times are predicted from the last main frame, which the decoder forgets when a main frame is invalid
+            if (frameValid && log->private->mainHistory[1]) {
+                keepBytes(frameStart, frameEnd);
+                writeRaw(frameStart, frameEnd - frameStart);
+            } else {
+                repair.gap.gpsFrames++;
+            }
+        break;
+        default:
+            keepBytes(frameStart, frameEnd);
+            writeRaw(frameStart, frameEnd - frameStart);
+    }
+}
+
+static void onEvent(flightLog_t *log, flightLogEvent_t *event)
+{
+    if (repair.reencode) {
+        keepBytes(log->private->frameMarker, log->private->stream->pos);
+        writeEvent(event);
+    }
+}
+
+/**
+ * Decode the log with the given index and write out what the decoder accepted of it, so that it decodes again without
+ * any resynchronisation. onGap (if not NULL) is called for each run of dropped data, and stats is filled in with the
+ * totals.
+ *
+ * Returns false (having written nothing) if the log's frames can't be encoded again. Write errors are left in the
+ * output stream for the caller to check with ferror().
+ */
+bool logRepairWrite(flightLog_t *log, int logIndex, FILE *output, LogRepairGapReady onGap, logRepairStats_t *stats)
+{
+    uint8_t *bufferData = malloc(REPAIR_BUFFER_SIZE);
+    const char *logEnd;
+
+    memset(&repair, 0, sizeof(repair));
+    memset(stats, 0, sizeof(*stats));
+
+    repair.output = output;
+    repair.logIndex = logIndex;
+    repair.onGap = onGap;
+    repair.stats = stats;
+    repair.consumed = log->logBegin[logIndex];
+
+    encoderBufferInit(&repair.buffer, bufferData, REPAIR_BUFFER_SIZE);
+
+    if (!flightLogParse(log, logIndex, onMetadataReady, onFrameReady, onEvent, false) || !repair.reencode) {
+        free(bufferData);
+        return false;
+    }
+
+    flushOutput();
+    free(bufferData);
+
+    // Erased flash (0xFF) or zero fill after the log isn't part of it
+    logEnd = log->logBegin[logIndex + 1];
+
+    while (logEnd > repair.consumed && ((uint8_t) logEnd[-1] == 0xFF || logEnd[-1] == 0)) {
+        logEnd--;
+    }
+
+    stats->paddingBytes = log->logBegin[logIndex + 1] - logEnd;
+
+    // The decoder might have stopped reading before the end of the log
+    repair.gap.bytes += logEnd - repair.consumed;
+
+    if (haveGap()) {
+        flightLogInventory_t inventory;
+        logRepairGap_t gap = {
+            .haveFrameAfter = false,
+            .atEnd = true
+        };
+
+        // Find out how far the dropped data went
+        if (flightLogInventory(log, logIndex, &inventory) && inventory.haveLastFrame
+                && (!repair.haveMainFrame || inventory.lastIteration > repair.lastIteration)) {
+            gap.haveFrameAfter = true;
+            gap.iterationAfter = inventory.lastIteration;
+            gap.timeAfter = inventory.lastTime;
+        }
+
+        reportGap(log, &gap);
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef LOGREPAIR_H_
+#define LOGREPAIR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "parser.h"
+
+// What was dropped between two main frames that were kept, or in the whole log
+typedef struct logRepairDropped_t {
+    // Main frames that decoded, but not from a valid previous frame (so their values can't be trusted)
+    uint32_t mainFrames;
+    // Frames of any type that were cut off or garbled
+    uint32_t corruptFrames;
+    // GPS frames that were predicted from dropped main frames
+    uint32_t gpsFrames;
+
+    // Every byte of the log that wasn't written out: the frames above and anything the decoder skipped over
+    int64_t bytes;
+} logRepairDropped_t;
+
+typedef struct logRepairGap_t {
+    // The last main frame that was kept before the gap, if any
+    bool haveFrameBefore;
+    uint32_t iterationBefore;
+    int64_t timeBefore;
+
+    /*
+     * The first main frame that was kept after the gap. For the gap at the end of the log, this is instead the last
+     * I-frame that flightLogInventory() could find in the dropped data, if it found one.
+     */
+    bool haveFrameAfter;
+    uint32_t iterationAfter;
+    int64_t timeAfter;
+
+    // Is this the data after the last frame that was kept?
+    bool atEnd;
+
+    logRepairDropped_t dropped;
+} logRepairGap_t;
+
+typedef struct logRepairStats_t {
+    uint32_t mainFramesWritten, resumesInserted, gaps;
+
+    // Bytes of the log (including its header) that were written out
+    int64_t keptBytes;
+    // Erased flash (0xFF) or zero fill at the end of the log, which is left out (and not counted as dropped)
+    int64_t paddingBytes;
+
+    // keptBytes + paddingBytes + dropped.bytes is the length of the log
+    logRepairDropped_t dropped;
+} logRepairStats_t;
+
+typedef void (*LogRepairGapReady)(flightLog_t *log, const logRepairGap_t *gap);
+
+bool logRepairWrite(flightLog_t *log, int logIndex, FILE *output, LogRepairGapReady onGap, logRepairStats_t *stats);
+
+#endif
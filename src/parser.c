@@ -18,10 +18,12 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "parser.h"
 #include "tools.h"
 #include "decoders.h"
+#include "profile.h"
 
 #define LOG_START_MARKER "H Product:Blackbox flight data recorder by Nicholas Sherlock\n"
 
@@ -31,6 +33,19 @@
 //Likewise for iteration count
 #define MAXIMUM_ITERATION_JUMP_BETWEEN_FRAMES (500 * 10)
 
+// How far flightLogInventory() searches from each end of a log's data for an I-frame
+#define INVENTORY_SCAN_LENGTH (256 * 1024)
+
+// The range of loop times an I-frame found by flightLogInventory() must imply to be believed (microseconds per iteration)
+#define INVENTORY_MIN_LOOP_TIME 10
+#define INVENTORY_MAX_LOOP_TIME 100000
+
+#ifdef _MSC_VER
+    #define ALWAYS_INLINE __forceinline
+#else
+    #define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
 union {
     float f;
     uint32_t u;
@@ -43,6 +58,7 @@ typedef struct flightLogFrameType_t {
     uint8_t marker;
     FlightLogFrameParse parse;
     FlightLogFrameComplete complete;
+    profileProbe_t *parseProbe, *completeProbe;
 } flightLogFrameType_t;
 
 static void parseIntraframe(flightLog_t *log, mmapStream_t *stream, bool raw);
@@ -59,13 +75,35 @@ static bool completeGPSFrame(flightLog_t *log, mmapStream_t *stream, uint8_t fra
 static bool completeGPSHomeFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, const char *frameStart, const char *frameEnd, bool raw);
 static bool completeSlowFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, const char *frameStart, const char *frameEnd, bool raw);
 
+static profileProbe_t logScanProbe = PROFILE_PROBE_INIT("parser.logScan");
+static profileProbe_t headerProbe = PROFILE_PROBE_INIT("parser.header");
+
+static profileProbe_t frameParseProbes[] = {
+    PROFILE_PROBE_INIT("parser.parse.I"),
+    PROFILE_PROBE_INIT("parser.parse.P"),
+    PROFILE_PROBE_INIT("parser.parse.G"),
+    PROFILE_PROBE_INIT("parser.parse.H"),
+    PROFILE_PROBE_INIT("parser.parse.E"),
+    PROFILE_PROBE_INIT("parser.parse.S")
+};
+
+// Frame completion includes the time spent in the onFrameReady/onEvent callbacks
+static profileProbe_t frameCompleteProbes[] = {
+    PROFILE_PROBE_INIT("parser.complete.I"),
+    PROFILE_PROBE_INIT("parser.complete.P"),
+    PROFILE_PROBE_INIT("parser.complete.G"),
+    PROFILE_PROBE_INIT("parser.complete.H"),
+    PROFILE_PROBE_INIT("parser.complete.E"),
+    PROFILE_PROBE_INIT("parser.complete.S")
+};
+
 static const flightLogFrameType_t frameTypes[] = {
-    {.marker = 'I', .parse = parseIntraframe,   .complete = completeIntraframe},
-    {.marker = 'P', .parse = parseInterframe,   .complete = completeInterframe},
-    {.marker = 'G', .parse = parseGPSFrame,     .complete = completeGPSFrame},
-    {.marker = 'H', .parse = parseGPSHomeFrame, .complete = completeGPSHomeFrame},
-    {.marker = 'E', .parse = parseEventFrame,   .complete = completeEventFrame},
-    {.marker = 'S', .parse = parseSlowFrame,    .complete = completeSlowFrame}
+    {.marker = 'I', .parse = parseIntraframe,   .complete = completeIntraframe,   .parseProbe = &frameParseProbes[0], .completeProbe = &frameCompleteProbes[0]},
+    {.marker = 'P', .parse = parseInterframe,   .complete = completeInterframe,   .parseProbe = &frameParseProbes[1], .completeProbe = &frameCompleteProbes[1]},
+    {.marker = 'G', .parse = parseGPSFrame,     .complete = completeGPSFrame,     .parseProbe = &frameParseProbes[2], .completeProbe = &frameCompleteProbes[2]},
+    {.marker = 'H', .parse = parseGPSHomeFrame, .complete = completeGPSHomeFrame, .parseProbe = &frameParseProbes[3], .completeProbe = &frameCompleteProbes[3]},
+    {.marker = 'E', .parse = parseEventFrame,   .complete = completeEventFrame,   .parseProbe = &frameParseProbes[4], .completeProbe = &frameCompleteProbes[4]},
+    {.marker = 'S', .parse = parseSlowFrame,    .complete = completeSlowFrame,    .parseProbe = &frameParseProbes[5], .completeProbe = &frameCompleteProbes[5]}
 };
 
 /**
@@ -503,7 +541,8 @@ static int64_t applyPrediction(flightLog_t *log, int fieldIndex, int predictor,
             if (!previous)
                 break;
 
-            value += 2 * previous[fieldIndex] - previous2[fieldIndex];
+            // Unsigned, so that it wraps around instead of overflowing
+            value += (int64_t) (2 * (uint64_t) previous[fieldIndex] - (uint64_t) previous2[fieldIndex]);
         break;
         case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
             if (!previous)
@@ -542,21 +581,212 @@ static int64_t applyPrediction(flightLog_t *log, int fieldIndex, int predictor,
     return value;
 }
 
+/**
+ * Get the position of the stream's read pointer in bits from the start of the data.
+ */
+static inline size_t streamBitPosition(mmapStream_t *stream)
+{
+    return (size_t) (stream->pos - stream->data) * CHAR_BIT + (CHAR_BIT - 1 - stream->bitPos);
+}
+
+/**
+ * How many fields are decoded together with the field at `fieldIndex`, given its encoding.
+ */
+static int countFieldGroup(flightLogFrameDef_t *frameDef, int fieldIndex)
+{
+    int j;
+
+    switch (frameDef->encoding[fieldIndex]) {
+        case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
+            return 4;
+        case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
+            return 3;
+        case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
+            //How many fields are in this encoded group? Check the subsequent field encodings:
+            for (j = fieldIndex + 1; j < fieldIndex + 8 && j < frameDef->fieldCount; j++)
+                if (frameDef->encoding[j] != FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB)
+                    break;
+
+            return j - fieldIndex;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Work out how to apply the predictors of the given frame type (which must not change until the log is next reset).
+ */
+static flightLogPredictionPlan_t *buildPredictionPlan(flightLog_t *log, uint8_t frameType)
+{
+    flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
+    flightLogPredictionPlan_t *plan = calloc(1, sizeof(*plan));
+
+    int i = 0;
+
+    while (i < frameDef->fieldCount) {
+        /*
+         * Only fields decoded on their own are truncated to their field width, values from a group encoding and the
+         * INC predictor are stored as they are.
+         */
+        int groupSize = frameDef->predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_INC ? 1 : countFieldGroup(frameDef, i);
+        bool truncate = groupSize == 1 && frameDef->encoding[i] != FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB
+            && frameDef->predictor[i] != FLIGHT_LOG_FIELD_PREDICTOR_INC && frameDef->fieldWidth[i] != 8;
+
+        for (int j = 0; j < groupSize && i < frameDef->fieldCount; j++, i++) {
+            if (truncate) {
+                // Assume 32-bit...
+                plan->truncateMask[i] = 0xFFFFFFFF;
+                plan->truncateSign[i] = frameDef->fieldSigned[i] ? 0x80000000 : 0;
+            } else {
+                plan->truncateMask[i] = ~0ULL;
+                plan->truncateSign[i] = 0;
+            }
+
+            switch (frameDef->predictor[i]) {
+                case FLIGHT_LOG_FIELD_PREDICTOR_0:
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+                    plan->constant[i] = log->sysConfig.minthrottle;
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+                    plan->constant[i] = 1500;
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+                    plan->constant[i] = log->sysConfig.vbatref;
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_MINMOTOR:
+                    plan->constant[i] = log->sysConfig.motorOutputLow;
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+                    plan->previousMask[i] = -1;
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+                    plan->straightLineMask[i] = -1;
+                    plan->previous2Fields[plan->previous2Count++] = i;
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+                    plan->average2Mask[i] = -1;
+                    plan->previous2Fields[plan->previous2Count++] = i;
+                break;
+                default:
+                    // INC, MOTOR_0, HOME_COORD and LAST_MAIN_FRAME_TIME (and unsupported predictors, which we complain about then)
+                    plan->fixupFields[plan->fixupCount++] = i;
+            }
+        }
+    }
+
+    return plan;
+}
+
+static ALWAYS_INLINE int64_t truncateFieldValue(const flightLogPredictionPlan_t *plan, int fieldIndex, int64_t value)
+{
+    uint64_t bits = (uint64_t) value & plan->truncateMask[fieldIndex];
+
+    return (int64_t) ((bits ^ plan->truncateSign[fieldIndex]) - plan->truncateSign[fieldIndex]);
+}
+
+/**
+ * Apply the constant and previous-frame predictors to a frame which has two previous frames. This is the loop that
+ * decodes every P-frame.
+ */
+static CPU_DISPATCH void applyFramePredictions(const flightLogPredictionPlan_t *plan, int fieldCount, const int64_t *residual,
+    int64_t *frame, const int64_t *previous, const int64_t *previous2)
+{
+    for (int i = 0; i < fieldCount; i++) {
+        /*
+         * The previous values are masked before the arithmetic, so fields which don't use these predictors (which can be
+         * full 64-bit values) don't take part in it. The straight line is unsigned so that it wraps around rather than
+         * overflowing.
+         */
+        uint64_t straightLine = 2 * (uint64_t) (previous[i] & plan->straightLineMask[i]) - (uint64_t) (previous2[i] & plan->straightLineMask[i]);
+        int64_t average2 = ((previous[i] & plan->average2Mask[i]) + (previous2[i] & plan->average2Mask[i])) / 2;
+        int64_t value = residual[i] + plan->constant[i]
+            + (previous[i] & plan->previousMask[i])
+            + (int64_t) straightLine
+            + average2;
+
+        frame[i] = truncateFieldValue(plan, i, value);
+    }
+}
+
+/**
+ * Apply the predictors of the given frame type to the raw field values in `residual` to produce the `frame`.
+ *
+ * The predictors which are the same operation for every field they're used by are applied to the whole frame at once
+ * in one loop without branches (which the compiler vectorises), and then the remaining fields are fixed up one by one.
+ */
+static void applyPredictionPlan(flightLog_t *log, uint8_t frameType, const int64_t *residual, int64_t *frame,
+    int64_t *previous, int64_t *previous2, int skippedFrames, bool raw)
+{
+    flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
+    flightLogPredictionPlan_t *plan = log->private->predictionPlan[frameType];
+    int fieldCount = frameDef->fieldCount;
+
+    if (!plan) {
+        plan = log->private->predictionPlan[frameType] = buildPredictionPlan(log, frameType);
+    }
+
+    if (raw) {
+        for (int i = 0; i < fieldCount; i++) {
+            frame[i] = truncateFieldValue(plan, i, residual[i]);
+        }
+    } else if (!previous) {
+        for (int i = 0; i < fieldCount; i++) {
+            frame[i] = truncateFieldValue(plan, i, residual[i] + plan->constant[i]);
+        }
+    } else if (previous2) {
+        applyFramePredictions(plan, fieldCount, residual, frame, previous, previous2);
+    } else {
+        for (int i = 0; i < fieldCount; i++) {
+            frame[i] = truncateFieldValue(plan, i, residual[i] + plan->constant[i] + (previous[i] & plan->previousMask[i]));
+        }
+
+        for (int j = 0; j < plan->previous2Count; j++) {
+            int i = plan->previous2Fields[j];
+
+            frame[i] = truncateFieldValue(plan, i, applyPrediction(log, i, frameDef->predictor[i], residual[i], frame, previous, previous2));
+        }
+    }
+
+    for (int j = 0; j < plan->fixupCount; j++) {
+        int i = plan->fixupFields[j];
+
+        if (frameDef->predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_INC) {
+            frame[i] = skippedFrames + 1;
+
+            if (previous)
+                frame[i] += previous[i];
+        } else if (!raw) {
+            frame[i] = truncateFieldValue(plan, i, applyPrediction(log, i, frameDef->predictor[i], residual[i], frame, previous, previous2));
+        }
+    }
+}
+
 /**
  * Attempt to parse the frame of the given `frameType` into the supplied `frame` buffer using the encoding/predictor
  * definitions from log->frameDefs[`frameType`].
  *
+ * The fields' raw values are all read from the stream first, then the predictors are applied to the whole frame.
+ *
  * raw - Set to true to disable predictions (and so store raw values)
  * skippedFrames - Set to the number of field iterations that were skipped over by rate settings since the last frame.
+ * profile - Set to true to record the number of bits used by each field into log->private->frameFieldBits. This is
+ *     a constant in each of the two copies of this routine that parseFrame() uses, so it costs nothing when disabled.
  */
-static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, int64_t *frame, int64_t *previous, int64_t *previous2, int skippedFrames, bool raw)
+static ALWAYS_INLINE void parseFrameFields(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, int64_t *frame, int64_t *previous, int64_t *previous2,
+    int skippedFrames, bool raw, const bool profile)
 {
     flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
 
     int *predictor = frameDef->predictor;
     int *encoding = frameDef->encoding;
-    int *fieldSigned = frameDef->fieldSigned;
-    int *fieldWidth = frameDef->fieldWidth;
+
+    // Room for a group which runs past the last field
+    int64_t residual[FLIGHT_LOG_MAX_FIELDS + 8];
+
+    uint32_t *fieldBits = log->private->frameFieldBits;
+    uint8_t *fieldGroupSize = log->private->frameFieldGroupSize;
+    size_t fieldStart = 0;
 
     int i, j, groupCount;
 
@@ -566,13 +796,19 @@ static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType
         int64_t values[8];
 
         if (predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_INC) {
-            frame[i] = skippedFrames + 1;
+            // This is applied with the predictors
+            residual[i] = 0;
 
-            if (previous)
-                frame[i] += previous[i];
+            if (profile) {
+                fieldBits[i] = 0;
+                fieldGroupSize[i] = 1;
+            }
 
             i++;
         } else {
+            if (profile)
+                fieldStart = streamBitPosition(stream);
+
             switch (encoding[i]) {
                 case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
                     streamByteAlign(stream);
@@ -597,37 +833,39 @@ static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType
                     else
                         streamReadTag8_4S16_v2(stream, values);
 
-                    //Apply the predictors for the fields:
-                    for (j = 0; j < 4; j++, i++)
-                        frame[i] = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], values[j], frame, previous, previous2);
+                    groupCount = 4;
 
-                    continue;
+                    goto applyGroupPredictions;
                 break;
                 case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
                     streamByteAlign(stream);
 
                     streamReadTag2_3S32(stream, values);
 
-                    //Apply the predictors for the fields:
-                    for (j = 0; j < 3; j++, i++)
-                        frame[i] = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], values[j], frame, previous, previous2);
+                    groupCount = 3;
 
-                    continue;
+                    goto applyGroupPredictions;
                 break;
                 case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
                     streamByteAlign(stream);
 
-                    //How many fields are in this encoded group? Check the subsequent field encodings:
-                    for (j = i + 1; j < i + 8 && j < frameDef->fieldCount; j++)
-                        if (encoding[j] != FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB)
-                            break;
-
-                    groupCount = j - i;
+                    groupCount = countFieldGroup(frameDef, i);
 
                     streamReadTag8_8SVB(stream, values, groupCount);
 
+                    applyGroupPredictions:
+                    if (profile) {
+                        fieldBits[i] = streamBitPosition(stream) - fieldStart;
+                        fieldGroupSize[i] = groupCount;
+
+                        for (j = 1; j < groupCount; j++) {
+                            fieldBits[i + j] = 0;
+                            fieldGroupSize[i + j] = 0;
+                        }
+                    }
+
                     for (j = 0; j < groupCount; j++, i++)
-                        frame[i] = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], values[j], frame, previous, previous2);
+                        residual[i] = values[j];
 
                     continue;
                 break;
@@ -657,24 +895,61 @@ static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType
                     exit(-1);
             }
 
-            value = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], value, frame, previous, previous2);
-
-            if (fieldWidth[i] != 8) {
-                // Assume 32-bit...
-                if (fieldSigned[i]) {
-                    value = (int32_t) value; // Sign extend the lower 32-bits
-                } else {
-                    value = (uint32_t) value;
-                }
+            if (profile) {
+                fieldBits[i] = streamBitPosition(stream) - fieldStart;
+                fieldGroupSize[i] = 1;
             }
 
-            frame[i] = value;
+            residual[i] = value;
 
             i++;
         }
     }
 
     streamByteAlign(stream);
+
+    applyPredictionPlan(log, frameType, residual, frame, previous, previous2, skippedFrames, raw);
+}
+
+static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, int64_t *frame, int64_t *previous, int64_t *previous2, int skippedFrames, bool raw)
+{
+    if (log->private->fieldCostProfiling) {
+        parseFrameFields(log, stream, frameType, frame, previous, previous2, skippedFrames, raw, true);
+    } else {
+        parseFrameFields(log, stream, frameType, frame, previous, previous2, skippedFrames, raw, false);
+    }
+}
+
+/**
+ * Add the field costs recorded while parsing a frame that has now been accepted to the log's statistics.
+ */
+static void updateFieldCostStatistics(flightLog_t *log, uint8_t frameType, size_t frameSize)
+{
+    flightLogPrivate_t *private = log->private;
+    flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
+    flightLogFrameCost_t *frameCost = private->frameCost[frameType];
+    uint64_t fieldBitsTotal = 0;
+
+    if (!frameCost) {
+        frameCost = private->frameCost[frameType] = calloc(1, sizeof(*frameCost));
+    }
+
+    for (int i = 0; i < frameDef->fieldCount; i++) {
+        flightLogFieldCost_t *fieldCost = &frameCost->field[i];
+        uint32_t bits = private->frameFieldBits[i];
+
+        fieldCost->groupSize = private->frameFieldGroupSize[i];
+        fieldCost->totalBits += bits;
+        fieldCost->bitsCount[bits < FLIGHT_LOG_FIELD_COST_MAX_BITS ? bits : FLIGHT_LOG_FIELD_COST_MAX_BITS]++;
+
+        fieldBitsTotal += bits;
+    }
+
+    frameCost->frameCount++;
+
+    // The frame size doesn't include the frame type byte
+    frameCost->totalBits += (frameSize + 1) * CHAR_BIT;
+    frameCost->paddingBits += frameSize * CHAR_BIT - fieldBitsTotal;
 }
 
 /*
@@ -804,6 +1079,7 @@ static void parseEventFrame(flightLog_t *log, mmapStream_t *stream, bool raw)
             if (strncmp(endMessage, END_OF_LOG_MESSAGE, END_OF_LOG_MESSAGE_LEN) == 0) {
                 //Adjust the end of stream so we stop reading, this log is done
                 stream->end = stream->pos;
+                log->private->logEnded = true;
             } else {
                 /*
                  * This isn't the real end of log message, it's probably just some bytes that happened to look like
@@ -817,7 +1093,7 @@ static void parseEventFrame(flightLog_t *log, mmapStream_t *stream, bool raw)
     }
 }
 
-static void updateMainFieldStatistics(flightLog_t *log, int64_t *fields)
+static CPU_DISPATCH void updateMainFieldStatistics(flightLog_t *log, int64_t *fields)
 {
     int i;
     flightLogFrameDef_t *frameDef = &log->frameDefs['I'];
@@ -958,11 +1234,78 @@ void flightlogFailsafePhaseToString(uint8_t failsafePhase, char *dest, int destL
     flightlogDecodeEnumToString(failsafePhase, FLIGHT_LOG_FAILSAFE_PHASE_COUNT, FLIGHT_LOG_FAILSAFE_PHASE_NAME, dest, destLen);
 }
 
+/**
+ * Find the beginning of each flight log in the file (each time the FC is rearmed, a new log is appended), continuing
+ * the search for more logs from logSearchStart.
+ */
+static void flightLogFindLogs(flightLog_t *log, const char *logSearchStart)
+{
+    mmapStream_t *stream = log->private->stream;
+    int logIndex = log->logCount;
+
+    /*
+     * The file may still be arriving from a buffered IO backend, so search each part as it becomes available. A
+     * partially-arrived marker at the end of one part is found again by the next search.
+     */
+    size_t available = logSearchStart - stream->data;
+
+    do {
+        available = streamWaitForData(stream, available + 1);
+
+        const char *searchEnd = stream->data + available;
+
+        for (; logIndex < FLIGHT_LOG_MAX_LOGS_IN_FILE && logSearchStart < searchEnd; logIndex++) {
+            log->logBegin[logIndex] = memmem(logSearchStart, searchEnd - logSearchStart, LOG_START_MARKER, strlen(LOG_START_MARKER));
+
+            if (!log->logBegin[logIndex])
+                break; //No more logs found in the available part of the file
+
+            //Search for the next log after this header ends
+            logSearchStart = log->logBegin[logIndex] + strlen(LOG_START_MARKER);
+        }
+
+        if (logSearchStart + strlen(LOG_START_MARKER) - 1 < searchEnd) {
+            logSearchStart = searchEnd - (strlen(LOG_START_MARKER) - 1);
+        }
+    } while (logIndex < FLIGHT_LOG_MAX_LOGS_IN_FILE && available < stream->size);
+
+    log->logCount = logIndex;
+
+    /*
+     * Stick the end of the file as the beginning of the "one past end" log, so we can easily compute each log size.
+     *
+     * We have room for this because the logBegin array has an extra element on the end for it.
+     */
+    log->logBegin[log->logCount] = stream->data + stream->size;
+}
+
+/**
+ * Look for new logs in the part of a followed file which arrived since it was `oldSize` bytes long.
+ */
+static void flightLogFindNewLogs(flightLog_t *log, size_t oldSize)
+{
+    const char *data = log->private->stream->data;
+    const char *logSearchStart = oldSize >= strlen(LOG_START_MARKER) ? data + oldSize - (strlen(LOG_START_MARKER) - 1) : data;
+
+    // Don't find the marker of the last log we found again
+    if (log->logCount > 0 && logSearchStart < log->logBegin[log->logCount - 1] + strlen(LOG_START_MARKER)) {
+        logSearchStart = log->logBegin[log->logCount - 1] + strlen(LOG_START_MARKER);
+    }
+
+    flightLogFindLogs(log, logSearchStart);
+}
+
 flightLog_t * flightLogCreate(int fd)
 {
-    const char *logSearchStart;
-    int logIndex;
+    return flightLogCreateWithIOBackend(fd, IO_BACKEND_AUTO, false);
+}
 
+/**
+ * Open the log file `fd`, reading it with the given IO backend (see streamCreateWithBackend()), and find the flight
+ * logs within it.
+ */
+flightLog_t * flightLogCreateWithIOBackend(int fd, ioBackend_e backend, bool hugePages)
+{
     flightLog_t *log;
     flightLogPrivate_t *private;
 
@@ -972,7 +1315,7 @@ flightLog_t * flightLogCreate(int fd)
     memset(log, 0, sizeof(*log));
     memset(private, 0, sizeof(*private));
 
-    private->stream = streamCreate(fd);
+    private->stream = streamCreateWithBackend(fd, backend, hugePages);
 
     if (!private->stream) {
         free(log);
@@ -992,39 +1335,103 @@ flightLog_t * flightLogCreate(int fd)
         return 0;
     }
 
-    if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFREG) {
-    //First check how many logs are in this one file (each time the FC is rearmed, a new log is appended)
-    logSearchStart = private->stream->data;
-
-    for (logIndex = 0; logIndex < FLIGHT_LOG_MAX_LOGS_IN_FILE && logSearchStart < private->stream->data + private->stream->size; logIndex++) {
-        log->logBegin[logIndex] = memmem(logSearchStart, (private->stream->data + private->stream->size) - logSearchStart, LOG_START_MARKER, strlen(LOG_START_MARKER));
-
-        if (!log->logBegin[logIndex])
-            break; //No more logs found in the file
+    log->private = private;
 
-        //Search for the next log after this header ends
-        logSearchStart = log->logBegin[logIndex] + strlen(LOG_START_MARKER);
-    }
+    if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFREG) {
+    PROFILE_BEGIN(log_scan);
 
-    log->logCount = logIndex;
+    //First check how many logs are in this one file
+    flightLogFindLogs(log, private->stream->data);
 
-    /*
-     * Stick the end of the file as the beginning of the "one past end" log, so we can easily compute each log size.
-     *
-     * We have room for this because the logBegin array has an extra element on the end for it.
-     */
-    log->logBegin[log->logCount] = private->stream->data + private->stream->size;
+    PROFILE_END(log_scan, &logScanProbe);
     } else {
     log->logCount = 1; //one stream 1 log.
     log->logBegin[0] = private->stream->data;
     log->logBegin[1] = private->stream->end;
     }
 
+    return log;
+}
+
+/**
+ * Open the log file `fd` which is still being written. If the file doesn't contain the beginning of a log yet, this
+ * waits for one to arrive (or for the writer to finish).
+ *
+ * The last log in the file is followed as it grows when it's parsed, until the writer closes the file or it stops
+ * growing for idleTimeoutMS (0 to wait forever). Returns NULL if the file can't be followed (it isn't a regular file,
+ * or this platform doesn't support following).
+ *
+ * onWait (if not NULL) is called each time the parser has caught up with the writer and is about to wait for more data,
+ * so the caller can flush its output.
+ */
+flightLog_t * flightLogCreateFollowing(int fd, int idleTimeoutMS, FlightLogFollowWait onWait)
+{
+    flightLog_t *log;
+    flightLogPrivate_t *private;
+
+    log = (flightLog_t *) malloc(sizeof(*log));
+    private = (flightLogPrivate_t *) malloc(sizeof(*private));
+
+    memset(log, 0, sizeof(*log));
+    memset(private, 0, sizeof(*private));
+
+    private->stream = streamCreateFollowing(fd, idleTimeoutMS);
+
+    if (!private->stream) {
+        free(log);
+        free(private);
+
+        return 0;
+    }
+
+    private->onFollowWait = onWait;
     log->private = private;
 
+    flightLogFindLogs(log, private->stream->data);
+
+    while (log->logCount == 0) {
+        size_t oldSize = private->stream->size;
+
+        if (!streamFollow(private->stream))
+            break;
+
+        flightLogFindNewLogs(log, oldSize);
+    }
+
     return log;
 }
 
+/**
+ * When following a file that is still being written, wait for more of the log being parsed to arrive and extend the
+ * stream to cover it. Returns false if the log is complete: it has ended, another log has begun after it, or the
+ * writer has finished with the file.
+ */
+static bool flightLogWaitForMoreData(flightLog_t *log, int logIndex)
+{
+    flightLogPrivate_t *private = log->private;
+    size_t oldSize = private->stream->size;
+
+    if (!private->stream->follower || private->logEnded || logIndex != log->logCount - 1) {
+        return false;
+    }
+
+    if (private->onFollowWait) {
+        private->onFollowWait(log);
+    }
+
+    if (!streamFollow(private->stream)) {
+        return false;
+    }
+
+    // The craft may have been rearmed, which begins a new log that ends this one
+    flightLogFindNewLogs(log, oldSize);
+
+    private->stream->end = log->logBegin[logIndex + 1];
+    private->stream->eof = false;
+
+    return true;
+}
+
 static const flightLogFrameType_t* getFrameType(uint8_t c)
 {
     for (int i = 0; i < (int) ARRAY_LENGTH(frameTypes); i++)
@@ -1288,18 +1695,25 @@ static void resetSysConfigToDefaults(flightLogSysConfig_t *config)
     config->firmwareType = FIRMWARE_TYPE_UNKNOWN;
 }
 
-bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw) {
-    ParserState parserState = PARSER_STATE_HEADER;
-    const flightLogFrameType_t *frameType = 0;
-
+/**
+ * Forget everything we learned from parsing a log before, and point the stream at the beginning of the given log.
+ */
+static void flightLogResetParseState(flightLog_t *log, int logIndex)
+{
     flightLogPrivate_t *private = log->private;
 
-    if (logIndex < 0 || logIndex >= log->logCount)
-        return false;
-
     //Reset any parsed information from previous parses
     memset(&log->stats, 0, sizeof(log->stats));
 
+    for (int i = 0; i < 256; i++) {
+        free(private->frameCost[i]);
+        private->frameCost[i] = NULL;
+
+        // The plans depend on the frame definitions and system config from the headers
+        free(private->predictionPlan[i]);
+        private->predictionPlan[i] = NULL;
+    }
+
     for (int frameC = 0; frameC < 256; frameC++) {
         free(log->frameDefs[frameC].namesLine);
     }
@@ -1334,22 +1748,50 @@ bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMet
     private->lastSkippedFrames = 0;
     private->lastMainFrameIteration = (uint32_t) -1;
     private->lastMainFrameTime = -1;
-
-    private->onMetadataReady = onMetadataReady;
-    private->onFrameReady = onFrameReady;
-    private->onEvent = onEvent;
+    private->logEnded = false;
 
     //Set parsing ranges up for the log the caller selected
     private->stream->start = log->logBegin[logIndex];
     private->stream->pos = private->stream->start;
     private->stream->end = log->logBegin[logIndex + 1];
     private->stream->eof = false;
+}
+
+bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw) {
+    ParserState parserState = PARSER_STATE_HEADER;
+    const flightLogFrameType_t *frameType = 0;
+
+    flightLogPrivate_t *private = log->private;
+
+    if (logIndex < 0 || logIndex >= log->logCount)
+        return false;
+
+    flightLogResetParseState(log, logIndex);
+
+    private->onMetadataReady = onMetadataReady;
+    private->onFrameReady = onFrameReady;
+    private->onEvent = onEvent;
 
     while (1) {
         char command = streamPeekChar(private->stream);
+
+        // If we're following a log that is still being written, we might only have caught up with the writer
+        if (command == EOF && flightLogWaitForMoreData(log, logIndex)) {
+            continue;
+        }
         
             if (command == 'H' && parserState == PARSER_STATE_HEADER) {
+                const char *lineStart = private->stream->pos;
+
+                PROFILE_BEGIN(header);
                 size_t frameSize = parseHeaderLine(log, private->stream, &parserState);
+                PROFILE_END(header, &headerProbe);
+
+                if (private->stream->eof && flightLogWaitForMoreData(log, logIndex)) {
+                    // The rest of this header line hasn't been written yet, parse it again once it has
+                    private->stream->pos = lineStart;
+                    continue;
+                }
                 if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //Move on if in stream.
                     fillSerialBuffer(private->stream, frameSize, &parserState);
                 }
@@ -1389,13 +1831,21 @@ bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMet
                 goto done;
             }
 
+            const char *frameMarker = private->stream->pos;
+
             frameType = getFrameType((uint8_t) command);
             streamReadByte(private->stream);//Skip over initial frame letter
             size_t frameSize = 0;
 
             if (frameType) {
                 const char *frameStart = private->stream->pos;
+                uint64_t parseStart = profileBegin();
+
+                PROFILE_TRACEPOINT1(frame_parse_begin, frameType->marker);
                 frameType->parse(log, private->stream, raw);
+                PROFILE_TRACEPOINT1(frame_parse_end, frameType->marker);
+
+                profileEndBytes(frameType->parseProbe, parseStart, private->stream->pos - frameStart);
                 frameSize = private->stream->pos - frameStart;
             } else {
                 private->mainStreamIsValid = false;
@@ -1405,6 +1855,13 @@ bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMet
             bool prematureEof = false;
             if (private->stream->eof) {
                 prematureEof = true;
+
+                if (frameType && flightLogWaitForMoreData(log, logIndex)) {
+                    // Hold this frame back until the rest of it has been written, rather than calling it corrupt
+                    private->stream->pos = frameMarker;
+                    private->stream->bitPos = CHAR_BIT - 1;
+                    continue;
+                }
             }
 
             if (frameType) {
@@ -1417,7 +1874,15 @@ bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMet
                     bool frameAccepted = true;
 
                     if (frameType->complete) {
+                        uint64_t completeStart = profileBegin();
+
+                        private->frameMarker = frameMarker;
+
+                        PROFILE_TRACEPOINT1(frame_complete_begin, frameType->marker);
                         frameAccepted = frameType->complete(log, log->private->stream, frameType->marker, private->stream->pos - frameSize, private->stream->pos, raw);
+                        PROFILE_TRACEPOINT1(frame_complete_end, frameType->marker);
+
+                        profileEnd(frameType->completeProbe, completeStart);
                     }
 
                     if (frameAccepted) {
@@ -1425,6 +1890,11 @@ bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMet
                         log->stats.frame[frameType->marker].bytes += frameSize;
                         log->stats.frame[frameType->marker].sizeCount[frameSize]++;
                         log->stats.frame[frameType->marker].validCount++;
+
+                        if (private->fieldCostProfiling && log->frameDefs[frameType->marker].fieldCount > 0) {
+                            updateFieldCostStatistics(log, frameType->marker, frameSize);
+                        }
+
                         if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //fill data buffer with data
                             fillSerialBuffer(private->stream, frameSize+1, &parserState); //+1 as size includes the header letter.
                         }
@@ -1469,12 +1939,142 @@ bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMet
     return true;
 }
 
+/**
+ * Try to decode an I-frame whose marker byte is at `frameMarker` into `frame`. It's only accepted if it has a plausible
+ * length and is followed by the marker of another frame (or the end of the log), and it was logged on an iteration that
+ * we'd expect an I-frame on.
+ */
+static bool flightLogTryIntraframeAt(flightLog_t *log, const char *frameMarker, int64_t *frame)
+{
+    mmapStream_t *stream = log->private->stream;
+
+    stream->pos = frameMarker + 1;
+    stream->bitPos = CHAR_BIT - 1;
+    stream->eof = false;
+
+    parseFrame(log, stream, 'I', frame, NULL, NULL, 0, false);
+
+    if (stream->eof || stream->pos - (frameMarker + 1) > FLIGHT_LOG_MAX_FRAME_LENGTH
+            || (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] % log->frameIntervalI != 0) {
+        return false;
+    }
+
+    return stream->pos == stream->end || getFrameType((uint8_t) *stream->pos) != NULL;
+}
+
+/**
+ * Learn what we can about a log without decoding the whole thing: parse its header, then find the first I-frame by
+ * searching forward from the beginning of the data, and the last I-frame by searching backward from the end. Only
+ * INVENTORY_SCAN_LENGTH bytes at each end of the data are examined, so this costs about the same for any size of log.
+ *
+ * The header is applied to the log (frame definitions, sysConfig, frame intervals) like flightLogParse() would.
+ * Returns false if the log has no header.
+ */
+bool flightLogInventory(flightLog_t *log, int logIndex, flightLogInventory_t *inventory)
+{
+    flightLogPrivate_t *private = log->private;
+    mmapStream_t *stream = private->stream;
+    ParserState parserState = PARSER_STATE_HEADER;
+    int64_t frame[FLIGHT_LOG_MAX_FIELDS];
+    const char *dataStart, *scanEnd;
+
+    memset(inventory, 0, sizeof(*inventory));
+
+    if (logIndex < 0 || logIndex >= log->logCount)
+        return false;
+
+    flightLogResetParseState(log, logIndex);
+
+    // A buffered IO backend has to read the whole log before we can look at its end (the mmap backend only reads what we touch)
+    streamWaitForData(stream, stream->end - stream->data);
+
+    // Any following header lines after the "features" line are still part of the header
+    while (stream->end - stream->pos >= 2 && stream->pos[0] == 'H' && stream->pos[1] == ' ') {
+        parseHeaderLine(log, stream, &parserState);
+    }
+
+    dataStart = stream->pos;
+    inventory->headerBytes = dataStart - stream->start;
+
+    if (log->frameDefs['I'].fieldCount == 0) {
+        return false;
+    }
+
+    scanEnd = stream->end - dataStart > INVENTORY_SCAN_LENGTH ? dataStart + INVENTORY_SCAN_LENGTH : stream->end;
+
+    for (const char *marker = dataStart; marker < scanEnd; marker++) {
+        marker = memchr(marker, 'I', scanEnd - marker);
+
+        if (!marker)
+            break;
+
+        if (flightLogTryIntraframeAt(log, marker, frame)) {
+            inventory->haveFirstFrame = true;
+            inventory->firstIteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+            inventory->firstTime = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+
+            dataStart = marker + 1;
+            break;
+        }
+    }
+
+    if (inventory->haveFirstFrame) {
+        // Don't count erased flash (0xFF) or zero-filled space after the last log (e.g. in a flash chip image) as data
+        while (stream->end > dataStart && ((uint8_t) stream->end[-1] == 0xFF || stream->end[-1] == 0)) {
+            stream->end--;
+        }
+
+        scanEnd = stream->end - dataStart > INVENTORY_SCAN_LENGTH ? stream->end - INVENTORY_SCAN_LENGTH : dataStart;
+
+        for (const char *marker = stream->end; marker > scanEnd; ) {
+            marker--;
+
+            if (*marker == 'I' && flightLogTryIntraframeAt(log, marker, frame)) {
+                // Allow the 32-bit counters to have wrapped around since the first frame
+                uint32_t iterations = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] - inventory->firstIteration;
+                uint32_t duration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_TIME] - (uint32_t) inventory->firstTime;
+
+                // Make sure the timing is believable before we trust that this is a real frame
+                if (iterations > 0 && (uint64_t) duration >= (uint64_t) iterations * INVENTORY_MIN_LOOP_TIME
+                        && (uint64_t) duration <= (uint64_t) iterations * INVENTORY_MAX_LOOP_TIME) {
+                    inventory->haveLastFrame = true;
+                    inventory->lastIteration = inventory->firstIteration + iterations;
+                    inventory->lastTime = inventory->firstTime + duration;
+                    break;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Choose whether the parser should measure the number of bits used by each field, for flightLogGetFrameCost(). This
+ * should be set before calling flightLogParse().
+ */
+void flightLogSetFieldCostProfiling(flightLog_t *log, bool enabled)
+{
+    log->private->fieldCostProfiling = enabled;
+}
+
+/**
+ * Get the field costs of the given frame type measured during the last parse, or NULL if no frames of that type
+ * were profiled.
+ */
+const flightLogFrameCost_t *flightLogGetFrameCost(flightLog_t *log, uint8_t frameType)
+{
+    return log->private->frameCost[frameType];
+}
+
 void flightLogDestroy(flightLog_t *log)
 {
     streamDestroy(log->private->stream);
 
     for (int i = 0; i < 256; i++) {
         free(log->frameDefs[i].namesLine);
+        free(log->private->frameCost[i]);
+        free(log->private->predictionPlan[i]);
     }
 
     free(log->private);
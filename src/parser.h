@@ -26,31 +26,84 @@ typedef enum FirmwareType {
 } FirmwareType;
 
 typedef struct flightLogFrameStatistics_t {
-    uint32_t bytes;
+    uint64_t bytes;
     // Frames decoded to the right length and had reasonable data in them:
-    uint32_t validCount;
+    uint64_t validCount;
 
     // Frames decoded to the right length but the data looked bad so they were rejected, or stream was desynced from previous lost frames:
-    uint32_t desyncCount;
+    uint64_t desyncCount;
 
     // Frames didn't decode to the right length at all
-    uint32_t corruptCount;
+    uint64_t corruptCount;
 
-    uint32_t sizeCount[FLIGHT_LOG_MAX_FRAME_LENGTH + 1];
+    uint64_t sizeCount[FLIGHT_LOG_MAX_FRAME_LENGTH + 1];
 } flightLogFrameStatistics_t;
 
 typedef struct flightLogFieldStatistics_t {
     int64_t min, max;
 } flightLogFieldStatistics_t;
 
+// Field costs larger than this many bits are counted together in the last entry of the bitsCount histogram
+#define FLIGHT_LOG_FIELD_COST_MAX_BITS 512
+
+typedef struct flightLogFieldCost_t {
+    /*
+     * Fields which are encoded together as a group (TAG8_8SVB, TAG2_3S32, TAG8_4S16) are charged to the first field of the
+     * group, which records the size of the group here. The other fields in the group have a groupSize of 0.
+     */
+    int groupSize;
+
+    uint64_t totalBits;
+
+    // The number of frames in which the field took each number of bits
+    uint64_t bitsCount[FLIGHT_LOG_FIELD_COST_MAX_BITS + 1];
+} flightLogFieldCost_t;
+
+typedef struct flightLogFrameCost_t {
+    uint64_t frameCount;
+
+    // Bits spent on the whole frames (including the frame type byte) and on the byte-alignment at the end of each frame
+    uint64_t totalBits;
+    uint64_t paddingBits;
+
+    flightLogFieldCost_t field[FLIGHT_LOG_MAX_FIELDS];
+} flightLogFrameCost_t;
+
+/*
+ * How the predictors of a frame type are applied to the raw values decoded for its fields. Most predictors are the
+ * same element-wise operation for every field they apply to, so these are expressed as masks and constants over the
+ * whole frame.
+ */
+typedef struct flightLogPredictionPlan_t {
+    // Added to each field by the predictors which add a value from the log header
+    int64_t constant[FLIGHT_LOG_MAX_FIELDS];
+
+    // All-ones for the fields that use each of the predictors based on previous frames, zero for other fields
+    int64_t previousMask[FLIGHT_LOG_MAX_FIELDS];
+    int64_t straightLineMask[FLIGHT_LOG_MAX_FIELDS];
+    int64_t average2Mask[FLIGHT_LOG_MAX_FIELDS];
+
+    // Predicted values are truncated to 32 bits by keeping these bits and then sign-extending from this bit
+    uint64_t truncateMask[FLIGHT_LOG_MAX_FIELDS];
+    uint64_t truncateSign[FLIGHT_LOG_MAX_FIELDS];
+
+    // Fields whose predictions depend on values outside the previous frames, applied in order after the others
+    int fixupCount;
+    uint8_t fixupFields[FLIGHT_LOG_MAX_FIELDS];
+
+    // Fields based on the previous two frames, for when only one previous frame is available
+    int previous2Count;
+    uint8_t previous2Fields[FLIGHT_LOG_MAX_FIELDS];
+} flightLogPredictionPlan_t;
+
 typedef struct flightLogStatistics_t {
-    uint32_t totalBytes;
+    uint64_t totalBytes;
 
     // Number of frames that failed to decode:
-    uint32_t totalCorruptFrames;
+    uint64_t totalCorruptFrames;
 
     //If our sampling rate is less than 1, we won't log every loop iteration, and that is accounted for here:
-    uint32_t intentionallyAbsentIterations;
+    uint64_t intentionallyAbsentIterations;
 
     bool haveFieldStats;
     flightLogFieldStatistics_t field[FLIGHT_LOG_MAX_FIELDS];
@@ -169,9 +222,23 @@ typedef struct flightLog_t {
 
 
 
+/**
+ * What flightLogInventory() learned about a log from its header and the I-frames nearest to its beginning and end.
+ */
+typedef struct flightLogInventory_t {
+    // Length of the header lines at the beginning of the log
+    int64_t headerBytes;
+
+    // Whether a valid I-frame was found near each end of the log, and the iteration and time it was logged at
+    bool haveFirstFrame, haveLastFrame;
+    uint32_t firstIteration, lastIteration;
+    int64_t firstTime, lastTime;
+} flightLogInventory_t;
+
 typedef void (*FlightLogMetadataReady)(flightLog_t *log);
-typedef void (*FlightLogFrameReady)(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize);
+typedef void (*FlightLogFrameReady)(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize);
 typedef void (*FlightLogEventReady)(flightLog_t *log, flightLogEvent_t *event);
+typedef void (*FlightLogFollowWait)(flightLog_t *log);
 
 typedef struct flightLogPrivate_t
 {
@@ -212,11 +279,33 @@ typedef struct flightLogPrivate_t
     FlightLogMetadataReady onMetadataReady;
     FlightLogFrameReady onFrameReady;
     FlightLogEventReady onEvent;
+    FlightLogFollowWait onFollowWait;
 
     mmapStream_t *stream;
+
+    // The marker byte of the frame that is being completed, so handlers can find its bytes in the stream
+    const char *frameMarker;
+
+    // Set once the end-of-log event has been read, so a log that is being followed won't be waited on any longer
+    bool logEnded;
+
+    // Bits used by each field in the frame that was just parsed, only recorded if field cost profiling is enabled
+    bool fieldCostProfiling;
+    uint32_t frameFieldBits[FLIGHT_LOG_MAX_FIELDS];
+    uint8_t frameFieldGroupSize[FLIGHT_LOG_MAX_FIELDS];
+
+    flightLogFrameCost_t *frameCost[256];
+
+    // Built for each frame type when its first frame is parsed
+    flightLogPredictionPlan_t *predictionPlan[256];
 } flightLogPrivate_t;
 
 flightLog_t* flightLogCreate(int fd);
+flightLog_t* flightLogCreateWithIOBackend(int fd, ioBackend_e backend, bool hugePages);
+flightLog_t* flightLogCreateFollowing(int fd, int idleTimeoutMS, FlightLogFollowWait onWait);
+
+void flightLogSetFieldCostProfiling(flightLog_t *log, bool enabled);
+const flightLogFrameCost_t *flightLogGetFrameCost(flightLog_t *log, uint8_t frameType);
 
 int flightLogEstimateNumCells(flightLog_t *log);
 
@@ -229,6 +318,7 @@ void flightlogFlightStateToString(uint32_t flightState, char *dest, int destLen)
 void flightlogFailsafePhaseToString(uint8_t failsafePhase, char *dest, int destLen);
 
 bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw);
+bool flightLogInventory(flightLog_t *log, int logIndex, flightLogInventory_t *inventory);
 void flightLogDestroy(flightLog_t *log);
 
 #endif
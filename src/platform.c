@@ -1,11 +1,22 @@
+// For RTLD_DEFAULT
+#define _GNU_SOURCE
+
 #include "platform.h"
 
+#if defined(__APPLE__)
+    #include <mach/mach_time.h>
+#endif
+
 #ifdef WIN32
     #include <direct.h>
 #else
     #include <sys/stat.h>
+    #include <unistd.h>
     #include <stdlib.h>
     #include <stdint.h>
+    #include <string.h>
+    #include <time.h>
+    #include <dlfcn.h>
 #endif
 
 
@@ -113,6 +124,79 @@ bool directory_create(const char *name)
 #endif
 }
 
+/**
+ * Give the existing file a second name (on the same filesystem), returning false if that isn't possible.
+ */
+bool file_hardlink(const char *existingName, const char *newName)
+{
+#if defined(WIN32)
+    return CreateHardLinkA(newName, existingName, NULL) != 0;
+#else
+    return link(existingName, newName) == 0;
+#endif
+}
+
+/**
+ * Find a function exported by a library that's already loaded into the process, or NULL if it doesn't have one by
+ * that name (e.g. because it's an older version). `library` is the DLL to look in on Windows, elsewhere every loaded
+ * library is searched.
+ */
+libraryFunction_t library_function(const char *library, const char *name)
+{
+#if defined(WIN32)
+    HMODULE module = GetModuleHandleA(library);
+
+    return module ? (libraryFunction_t) GetProcAddress(module, name) : NULL;
+#else
+    void *symbol = dlsym(RTLD_DEFAULT, name);
+    libraryFunction_t function = NULL;
+
+    (void) library;
+
+    // ISO C won't cast an object pointer to a function pointer, so copy it across instead
+    if (symbol) {
+        memcpy(&function, &symbol, sizeof(function));
+    }
+
+    return function;
+#endif
+}
+
+/**
+ * Read a clock which only ever moves forwards (unaffected by changes to the wall clock), in nanoseconds from some
+ * arbitrary starting point.
+ */
+uint64_t monotonic_time_nanos()
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000ULL
+        + (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
 /**
  * Map the open file with the given file handle `fd` into memory. Store the details about the mapping into `mapping`.
  *
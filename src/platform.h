@@ -2,6 +2,7 @@
 #define PLATFORM_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH 1024
 #define FLIGHT_LOG_MAX_FRAME_LENGTH 256
@@ -45,6 +46,21 @@
     #define snprintf _snprintf
 #endif
 
+/*
+ * Hot loops that the compiler can vectorise are marked with this to build them for both the baseline instruction set
+ * and AVX2, with the version for the CPU we're running on picked when the program is loaded (using GNU ifuncs). Where
+ * ifuncs aren't available they're only built for the baseline.
+ */
+#if defined(__x86_64__) && defined(__ELF__) && defined(__GLIBC__) && defined(__has_attribute)
+    #if __has_attribute(target_clones)
+        #define CPU_DISPATCH __attribute__((target_clones("avx2", "default")))
+    #endif
+#endif
+
+#ifndef CPU_DISPATCH
+    #define CPU_DISPATCH
+#endif
+
 typedef struct fileMapping_t {
 #if defined(WIN32)
     HANDLE mapping;
@@ -57,6 +73,7 @@ typedef struct fileMapping_t {
 } fileMapping_t;
 
 typedef void*(*threadRoutine_t)(void *data);
+typedef void (*libraryFunction_t)(void);
 
 void thread_create_detached(threadRoutine_t threadFunc, void *data);
 
@@ -69,6 +86,11 @@ void semaphore_wait(semaphore_t *sem);
 void semaphore_signal(semaphore_t *sem);
 
 bool directory_create(const char *name);
+bool file_hardlink(const char *existingName, const char *newName);
+
+libraryFunction_t library_function(const char *library, const char *name);
+
+uint64_t monotonic_time_nanos();
 
 void platform_init();
 
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "profile.h"
+
+// Probes may be hit from the renderer's PNG threads, so their totals are updated atomically
+#ifdef _MSC_VER
+    #define ATOMIC_ADD_U64(target, value) InterlockedExchangeAdd64((volatile LONG64 *) (target), (LONG64) (value))
+    #define ATOMIC_CLAIM(target) (InterlockedCompareExchange((volatile LONG *) (target), 1, 0) == 0)
+    #define ATOMIC_CAS_PTR(target, expected, desired) (InterlockedCompareExchangePointer((volatile PVOID *) (target), (desired), (expected)) == (expected))
+#else
+    #define ATOMIC_ADD_U64(target, value) __sync_fetch_and_add((target), (value))
+    #define ATOMIC_CLAIM(target) __sync_bool_compare_and_swap((target), 0, 1)
+    #define ATOMIC_CAS_PTR(target, expected, desired) __sync_bool_compare_and_swap((target), (expected), (desired))
+#endif
+
+bool profileEnabled = false;
+
+// Probes are added to this list the first time they record a measurement
+static profileProbe_t *probeList = NULL;
+
+static uint64_t profileStartTime;
+
+void profileEnable()
+{
+    profileEnabled = true;
+    profileStartTime = monotonic_time_nanos();
+}
+
+void profileRecord(profileProbe_t *probe, uint64_t start, uint64_t bytes)
+{
+    uint64_t elapsed = monotonic_time_nanos() - start;
+
+    if (!probe->registered && ATOMIC_CLAIM(&probe->registered)) {
+        profileProbe_t *head;
+
+        do {
+            head = probeList;
+            probe->next = head;
+        } while (!ATOMIC_CAS_PTR(&probeList, head, probe));
+    }
+
+    ATOMIC_ADD_U64(&probe->count, 1);
+    ATOMIC_ADD_U64(&probe->nanos, elapsed);
+
+    if (bytes) {
+        ATOMIC_ADD_U64(&probe->bytes, bytes);
+    }
+}
+
+static int compareProbeNames(const void *a, const void *b)
+{
+    return strcmp((*(const profileProbe_t **) a)->name, (*(const profileProbe_t **) b)->name);
+}
+
+/**
+ * Get the recorded probes sorted by name (so stages of the same component are listed together). The caller must free
+ * the returned array.
+ */
+static profileProbe_t **getSortedProbes(int *count)
+{
+    profileProbe_t **probes;
+    int probeCount = 0;
+
+    for (profileProbe_t *probe = probeList; probe; probe = probe->next) {
+        probeCount++;
+    }
+
+    probes = malloc((probeCount + 1) * sizeof(*probes));
+
+    probeCount = 0;
+    for (profileProbe_t *probe = probeList; probe; probe = probe->next) {
+        probes[probeCount++] = probe;
+    }
+
+    qsort(probes, probeCount, sizeof(*probes), compareProbeNames);
+
+    *count = probeCount;
+
+    return probes;
+}
+
+/**
+ * Print a table of the time spent in each probed stage. Stages nest (e.g. the parser's frame completion includes the
+ * time spent in the caller's frame callback), so the percentages don't sum to 100.
+ */
+void profilePrintReport(FILE *file)
+{
+    int probeCount;
+    profileProbe_t **probes = getSortedProbes(&probeCount);
+    double wallMsec = (monotonic_time_nanos() - profileStartTime) / 1000000.0;
+
+    fprintf(file, "\nProfile (%.1f ms elapsed):\n", wallMsec);
+    fprintf(file, "%-28s %12s %12s %10s %7s %12s\n", "Stage", "Calls", "Total ms", "Avg us", "% wall", "MB/s");
+
+    for (int i = 0; i < probeCount; i++) {
+        profileProbe_t *probe = probes[i];
+        double totalMsec = probe->nanos / 1000000.0;
+
+        fprintf(file, "%-28s %12" PRIu64 " %12.2f %10.3f %6.1f%%", probe->name, probe->count, totalMsec,
+            probe->nanos / 1000.0 / probe->count, wallMsec > 0 ? totalMsec / wallMsec * 100 : 0.0);
+
+        if (probe->bytes > 0 && probe->nanos > 0) {
+            fprintf(file, " %12.1f", probe->bytes / 1048576.0 / (probe->nanos / 1000000000.0));
+        }
+
+        fprintf(file, "\n");
+    }
+
+    free(probes);
+}
+
+/**
+ * Write the probe totals to the given file as JSON. Returns false if the file couldn't be written.
+ */
+bool profileWriteJSON(const char *filename)
+{
+    int probeCount;
+    profileProbe_t **probes;
+    FILE *file = fopen(filename, "wb");
+
+    if (!file) {
+        return false;
+    }
+
+    probes = getSortedProbes(&probeCount);
+
+    fprintf(file, "{\n  \"elapsedNanos\": %" PRIu64 ",\n  \"stages\": [", monotonic_time_nanos() - profileStartTime);
+
+    for (int i = 0; i < probeCount; i++) {
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"calls\": %" PRIu64 ", \"nanos\": %" PRIu64 ", \"bytes\": %" PRIu64 "}",
+            i > 0 ? "," : "", probes[i]->name, probes[i]->count, probes[i]->nanos, probes[i]->bytes);
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+
+    free(probes);
+
+    return fclose(file) == 0;
+}
@@ -0,0 +1,87 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "platform.h"
+
+/*
+ * Probes are always compiled in, but only read the clock once profiling has been switched on with profileEnable(), so
+ * a disabled probe costs a single predictable branch.
+ *
+ * Each probe is also exported as a static tracepoint (provider "blackbox", named after the stage with _begin/_end
+ * suffixes) when <sys/sdt.h> is available, so perf, bpftrace or SystemTap can attach to them without --profile.
+ */
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+        #include <sys/sdt.h>
+
+        #define PROFILE_TRACEPOINT(name) DTRACE_PROBE(blackbox, name)
+        #define PROFILE_TRACEPOINT1(name, arg) DTRACE_PROBE1(blackbox, name, arg)
+    #endif
+#endif
+
+#ifndef PROFILE_TRACEPOINT
+    #define PROFILE_TRACEPOINT(name) do {} while (0)
+    #define PROFILE_TRACEPOINT1(name, arg) do {} while (0)
+#endif
+
+typedef struct profileProbe_t {
+    const char *name;
+
+    uint64_t count;
+    uint64_t nanos;
+    // Optional throughput counter (e.g. bytes written), zero if the probe doesn't measure one
+    uint64_t bytes;
+
+    int registered;
+    struct profileProbe_t *next;
+} profileProbe_t;
+
+#define PROFILE_PROBE_INIT(name) {(name), 0, 0, 0, 0, NULL}
+
+extern bool profileEnabled;
+
+void profileEnable();
+
+void profileRecord(profileProbe_t *probe, uint64_t start, uint64_t bytes);
+
+static inline uint64_t profileBegin()
+{
+    return profileEnabled ? monotonic_time_nanos() : 0;
+}
+
+static inline void profileEnd(profileProbe_t *probe, uint64_t start)
+{
+    if (profileEnabled) {
+        profileRecord(probe, start, 0);
+    }
+}
+
+static inline void profileEndBytes(profileProbe_t *probe, uint64_t start, uint64_t bytes)
+{
+    if (profileEnabled) {
+        profileRecord(probe, start, bytes);
+    }
+}
+
+/*
+ * Time the code between PROFILE_BEGIN(stage) and PROFILE_END(stage, probe) in the same scope, firing the stage's
+ * tracepoints on either side.
+ */
+#define PROFILE_BEGIN(stage) \
+    uint64_t stage##_profileStart = profileBegin(); \
+    PROFILE_TRACEPOINT(stage##_begin)
+
+#define PROFILE_END(stage, probe) \
+    do { \
+        PROFILE_TRACEPOINT(stage##_end); \
+        profileEnd((probe), stage##_profileStart); \
+    } while (0)
+
+void profilePrintReport(FILE *file);
+bool profileWriteJSON(const char *filename);
+
+#endif
@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "qoi.h"
+
+/*
+ * An encoder for the "Quite OK Image" format (https://qoiformat.org/), a lossless RGBA format which is far quicker
+ * to encode than PNG and compresses our flat-coloured overlays about as well. FFmpeg reads it natively.
+ *
+ * The input is Cairo's ARGB32 format: native-endian 32-bit pixels with premultiplied alpha. QOI stores straight alpha,
+ * so each pixel is unpremultiplied as it is encoded (the same way Cairo does it when writing PNGs).
+ */
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xC0
+#define QOI_OP_RGB   0xFE
+#define QOI_OP_RGBA  0xFF
+
+#define QOI_HEADER_LENGTH 14
+#define QOI_MAX_RUN 62
+
+static const uint8_t QOI_END_MARKER[] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+typedef struct qoiPixel_t {
+    uint8_t r, g, b, a;
+} qoiPixel_t;
+
+static inline bool pixelsEqual(qoiPixel_t a, qoiPixel_t b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static inline int pixelHash(qoiPixel_t pixel)
+{
+    return (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+}
+
+static inline uint8_t unpremultiply(uint32_t component, uint32_t alpha)
+{
+    return (component * 255 + alpha / 2) / alpha;
+}
+
+static inline qoiPixel_t unpremultiplyARGB32(uint32_t argb)
+{
+    qoiPixel_t result;
+
+    result.a = argb >> 24;
+
+    if (result.a == 0) {
+        result.r = result.g = result.b = 0;
+    } else if (result.a == 255) {
+        result.r = (argb >> 16) & 0xFF;
+        result.g = (argb >> 8) & 0xFF;
+        result.b = argb & 0xFF;
+    } else {
+        result.r = unpremultiply((argb >> 16) & 0xFF, result.a);
+        result.g = unpremultiply((argb >> 8) & 0xFF, result.a);
+        result.b = unpremultiply(argb & 0xFF, result.a);
+    }
+
+    return result;
+}
+
+static uint8_t* writeBigEndian32(uint8_t *output, uint32_t value)
+{
+    *output++ = value >> 24;
+    *output++ = value >> 16;
+    *output++ = value >> 8;
+    *output++ = value;
+
+    return output;
+}
+
+/**
+ * The largest number of bytes an image of the given size could take to encode (every pixel as QOI_OP_RGBA).
+ */
+size_t qoiMaxEncodedLength(int width, int height)
+{
+    return QOI_HEADER_LENGTH + (size_t) width * height * 5 + sizeof(QOI_END_MARKER);
+}
+
+/**
+ * Encode the ARGB32 image into the output buffer (which must have room for qoiMaxEncodedLength() bytes), and return the
+ * length of the encoded image.
+ */
+size_t qoiEncodeARGB32(const uint8_t *pixels, int width, int height, int stride, uint8_t *output)
+{
+    uint8_t *out = output;
+    qoiPixel_t index[64];
+    qoiPixel_t previous = {0, 0, 0, 255};
+    /*
+     * The unpremultiplied pixel is reused while the input pixels repeat, to avoid the divisions. Overlay frames are mostly
+     * runs of one colour, so this beats converting whole rows with vector instructions (which measured about 3x slower).
+     */
+    uint32_t previousARGB = 0xFF000000;
+    int run = 0;
+
+    memset(index, 0, sizeof(index));
+
+    memcpy(out, "qoif", 4);
+    out += 4;
+    out = writeBigEndian32(out, width);
+    out = writeBigEndian32(out, height);
+    *out++ = 4; // RGBA
+    *out++ = 0; // sRGB with linear alpha
+
+    for (int y = 0; y < height; y++) {
+        const uint32_t *row = (const uint32_t *) (pixels + (size_t) y * stride);
+
+        for (int x = 0; x < width; x++) {
+            qoiPixel_t pixel;
+
+            if (row[x] == previousARGB) {
+                pixel = previous;
+            } else {
+                pixel = unpremultiplyARGB32(row[x]);
+                previousARGB = row[x];
+            }
+
+            if (pixelsEqual(pixel, previous)) {
+                run++;
+
+                if (run == QOI_MAX_RUN) {
+                    *out++ = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+
+                continue;
+            }
+
+            if (run > 0) {
+                *out++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            int hash = pixelHash(pixel);
+
+            if (pixelsEqual(index[hash], pixel)) {
+                *out++ = QOI_OP_INDEX | hash;
+            } else {
+                index[hash] = pixel;
+
+                if (pixel.a == previous.a) {
+                    int8_t dr = pixel.r - previous.r;
+                    int8_t dg = pixel.g - previous.g;
+                    int8_t db = pixel.b - previous.b;
+
+                    int8_t drg = dr - dg;
+                    int8_t dbg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        *out++ = QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+                    } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+                        *out++ = QOI_OP_LUMA | (dg + 32);
+                        *out++ = (drg + 8) << 4 | (dbg + 8);
+                    } else {
+                        *out++ = QOI_OP_RGB;
+                        *out++ = pixel.r;
+                        *out++ = pixel.g;
+                        *out++ = pixel.b;
+                    }
+                } else {
+                    *out++ = QOI_OP_RGBA;
+                    *out++ = pixel.r;
+                    *out++ = pixel.g;
+                    *out++ = pixel.b;
+                    *out++ = pixel.a;
+                }
+            }
+
+            previous = pixel;
+        }
+    }
+
+    if (run > 0) {
+        *out++ = QOI_OP_RUN | (run - 1);
+    }
+
+    memcpy(out, QOI_END_MARKER, sizeof(QOI_END_MARKER));
+    out += sizeof(QOI_END_MARKER);
+
+    return out - output;
+}
+
+/**
+ * Write the ARGB32 image to a QOI file with the given name, returning true on success.
+ */
+bool qoiWriteARGB32(const char *filename, const uint8_t *pixels, int width, int height, int stride)
+{
+    uint8_t *encoded = malloc(qoiMaxEncodedLength(width, height));
+    size_t length;
+    FILE *file;
+    bool success;
+
+    if (!encoded) {
+        return false;
+    }
+
+    length = qoiEncodeARGB32(pixels, width, height, stride, encoded);
+
+    file = fopen(filename, "wb");
+
+    success = file && fwrite(encoded, 1, length, file) == length;
+
+    if (file && fclose(file) != 0) {
+        success = false;
+    }
+
+    free(encoded);
+
+    return success;
+}
@@ -0,0 +1,13 @@
+#ifndef QOI_H_
+#define QOI_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+size_t qoiMaxEncodedLength(int width, int height);
+size_t qoiEncodeARGB32(const uint8_t *pixels, int width, int height, int stride, uint8_t *output);
+
+bool qoiWriteARGB32(const char *filename, const uint8_t *pixels, int width, int height, int stride);
+
+#endif
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+
+//For msvcrt to define M_PI:
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "resample.h"
+
+/*
+ * Each output row is computed from the input frames within RESAMPLE_HALF_WIDTH_PERIODS output periods either side of
+ * it, weighted by a Blackman-windowed sinc low-pass filter which is evaluated at the actual frame timestamps (so jitter
+ * in the looptime or gaps left by the P-frame interval don't upset it). With this window length the response is flat
+ * to about a quarter of the output rate, and anything which would alias (above half the output rate) is attenuated by
+ * around 70dB.
+ */
+#define RESAMPLE_HALF_WIDTH_PERIODS 12
+#define RESAMPLE_CUTOFF 0.385 // As a fraction of the output rate
+#define RESAMPLE_KERNEL_TABLE_SIZE 2048
+
+struct resampler_t {
+    int fieldCount;
+    double outputRate;
+
+    // Frames further than this from an output row (in microseconds) don't contribute to it
+    int64_t halfWidth;
+
+    // The filter kernel sampled over [0...halfWidth], with a trailing zero so we can interpolate up to the end
+    double kernel[RESAMPLE_KERNEL_TABLE_SIZE + 2];
+
+    // Buffered input frames [start...start + count), with values stored in rows of fieldCount
+    int64_t *times;
+    double *values;
+    int start, count, capacity;
+
+    double *sum;
+
+    // Index of the next output row on the grid, its time is nextRow / outputRate seconds
+    int64_t nextRow;
+    bool haveNextRow;
+
+    // Once the segment has ended, rows can be produced up to the last frame without waiting for more to arrive
+    bool segmentEnded;
+
+    // A frame which begins a new segment, held until the rows from the previous one have been collected
+    bool havePending;
+    int64_t pendingTime;
+    double *pendingValues;
+};
+
+static int64_t rowTime(resampler_t *resampler, int64_t row)
+{
+    return (int64_t) llround(row * 1000000.0 / resampler->outputRate);
+}
+
+static double kernelWeight(resampler_t *resampler, int64_t offset)
+{
+    double position;
+    int index;
+
+    if (offset < 0)
+        offset = -offset;
+
+    if (offset >= resampler->halfWidth)
+        return 0;
+
+    position = (double) offset * RESAMPLE_KERNEL_TABLE_SIZE / resampler->halfWidth;
+    index = (int) position;
+
+    return resampler->kernel[index] + (resampler->kernel[index + 1] - resampler->kernel[index]) * (position - index);
+}
+
+static void appendFrame(resampler_t *resampler, int64_t time, const double *values)
+{
+    if (resampler->count == 0) {
+        resampler->start = 0;
+        resampler->haveNextRow = false;
+    }
+
+    if (resampler->start + resampler->count == resampler->capacity) {
+        if (resampler->start > 0) {
+            memmove(resampler->times, resampler->times + resampler->start, resampler->count * sizeof(*resampler->times));
+            memmove(resampler->values, resampler->values + (size_t) resampler->start * resampler->fieldCount,
+                (size_t) resampler->count * resampler->fieldCount * sizeof(*resampler->values));
+            resampler->start = 0;
+        } else {
+            resampler->capacity *= 2;
+            resampler->times = realloc(resampler->times, resampler->capacity * sizeof(*resampler->times));
+            resampler->values = realloc(resampler->values, (size_t) resampler->capacity * resampler->fieldCount * sizeof(*resampler->values));
+        }
+    }
+
+    int index = resampler->start + resampler->count;
+
+    resampler->times[index] = time;
+    memcpy(resampler->values + (size_t) index * resampler->fieldCount, values, resampler->fieldCount * sizeof(*values));
+
+    resampler->count++;
+}
+
+/**
+ * Create a resampler which low-pass filters frames of fieldCount fields and produces rows on a uniform grid of
+ * outputRate rows per second.
+ */
+resampler_t *resamplerCreate(int fieldCount, double outputRate)
+{
+    resampler_t *resampler = calloc(1, sizeof(*resampler));
+    double halfWidthSeconds = RESAMPLE_HALF_WIDTH_PERIODS / outputRate;
+    double cutoff = RESAMPLE_CUTOFF * outputRate;
+
+    resampler->fieldCount = fieldCount;
+    resampler->outputRate = outputRate;
+    resampler->halfWidth = (int64_t) ceil(halfWidthSeconds * 1000000);
+
+    for (int i = 0; i <= RESAMPLE_KERNEL_TABLE_SIZE; i++) {
+        double x = (double) i / RESAMPLE_KERNEL_TABLE_SIZE;
+        double t = x * halfWidthSeconds;
+        double sinc = i == 0 ? 1.0 : sin(2 * M_PI * cutoff * t) / (2 * M_PI * cutoff * t);
+        double window = 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);
+
+        resampler->kernel[i] = sinc * window;
+    }
+    resampler->kernel[RESAMPLE_KERNEL_TABLE_SIZE + 1] = 0;
+
+    resampler->capacity = 256;
+    resampler->times = malloc(resampler->capacity * sizeof(*resampler->times));
+    resampler->values = malloc((size_t) resampler->capacity * fieldCount * sizeof(*resampler->values));
+    resampler->sum = malloc(fieldCount * sizeof(*resampler->sum));
+    resampler->pendingValues = malloc(fieldCount * sizeof(*resampler->pendingValues));
+
+    return resampler;
+}
+
+void resamplerDestroy(resampler_t *resampler)
+{
+    if (resampler) {
+        free(resampler->times);
+        free(resampler->values);
+        free(resampler->sum);
+        free(resampler->pendingValues);
+        free(resampler);
+    }
+}
+
+/**
+ * Add a frame to the resampler. If the frame's time isn't after the previous frame's, or there's a pause in the log
+ * longer than the filter's reach, it begins a new segment rather than being filtered together with the previous frames.
+ */
+void resamplerAddFrame(resampler_t *resampler, int64_t time, const int64_t *frame)
+{
+    double *values = resampler->pendingValues;
+
+    for (int i = 0; i < resampler->fieldCount; i++) {
+        values[i] = (double) frame[i];
+    }
+
+    if (resampler->count > 0 && !resampler->segmentEnded) {
+        int64_t lastTime = resampler->times[resampler->start + resampler->count - 1];
+
+        if (time <= lastTime || time - lastTime > resampler->halfWidth) {
+            resampler->segmentEnded = true;
+        }
+    }
+
+    if (resampler->segmentEnded && resampler->count > 0) {
+        resampler->havePending = true;
+        resampler->pendingTime = time;
+    } else {
+        resampler->segmentEnded = false;
+        appendFrame(resampler, time, values);
+    }
+}
+
+/**
+ * Mark the end of a run of contiguous frames (e.g. because the next frame is corrupt), so that the rows up to the last
+ * frame can be collected and the filter won't bridge the gap.
+ */
+void resamplerEndSegment(resampler_t *resampler)
+{
+    if (resampler->count > 0) {
+        resampler->segmentEnded = true;
+    }
+}
+
+/**
+ * Get the next output row if all the frames that contribute to it have arrived. The frame's time field is left as
+ * filtered, the caller should use the returned row time instead.
+ */
+bool resamplerGetRow(resampler_t *resampler, int64_t *time, int64_t *frame)
+{
+    while (true) {
+        if (resampler->count == 0) {
+            return false;
+        }
+
+        int64_t firstTime = resampler->times[resampler->start];
+        int64_t lastTime = resampler->times[resampler->start + resampler->count - 1];
+
+        if (!resampler->haveNextRow) {
+            resampler->nextRow = (int64_t) floor(firstTime * resampler->outputRate / 1000000);
+
+            while (rowTime(resampler, resampler->nextRow) < firstTime) {
+                resampler->nextRow++;
+            }
+
+            resampler->haveNextRow = true;
+        }
+
+        int64_t time0 = rowTime(resampler, resampler->nextRow);
+
+        if (time0 > lastTime) {
+            if (!resampler->segmentEnded) {
+                return false;
+            }
+
+            // This segment is finished, start on the next one if it has begun
+            resampler->count = 0;
+            resampler->segmentEnded = false;
+
+            if (resampler->havePending) {
+                resampler->havePending = false;
+                appendFrame(resampler, resampler->pendingTime, resampler->pendingValues);
+                continue;
+            }
+
+            return false;
+        }
+
+        if (!resampler->segmentEnded && lastTime < time0 + resampler->halfWidth) {
+            return false;
+        }
+
+        double totalWeight = 0;
+
+        memset(resampler->sum, 0, resampler->fieldCount * sizeof(*resampler->sum));
+
+        for (int i = resampler->start; i < resampler->start + resampler->count; i++) {
+            double weight = kernelWeight(resampler, resampler->times[i] - time0);
+
+            if (weight != 0) {
+                const double *values = resampler->values + (size_t) i * resampler->fieldCount;
+
+                totalWeight += weight;
+
+                for (int j = 0; j < resampler->fieldCount; j++) {
+                    resampler->sum[j] += weight * values[j];
+                }
+            }
+        }
+
+        if (totalWeight > 1e-6) {
+            for (int j = 0; j < resampler->fieldCount; j++) {
+                frame[j] = (int64_t) llround(resampler->sum[j] / totalWeight);
+            }
+        } else {
+            // Too few frames nearby to filter (at the edge of a sparse segment), so just use the closest one
+            int nearest = resampler->start;
+
+            for (int i = resampler->start + 1; i < resampler->start + resampler->count; i++) {
+                if (llabs(resampler->times[i] - time0) < llabs(resampler->times[nearest] - time0)) {
+                    nearest = i;
+                }
+            }
+
+            const double *values = resampler->values + (size_t) nearest * resampler->fieldCount;
+
+            for (int j = 0; j < resampler->fieldCount; j++) {
+                frame[j] = (int64_t) llround(values[j]);
+            }
+        }
+
+        *time = time0;
+
+        resampler->nextRow++;
+
+        // Frames which are too old to contribute to the next row can be discarded (but keep the last one for gap detection)
+        int64_t oldest = rowTime(resampler, resampler->nextRow) - resampler->halfWidth;
+
+        while (resampler->count > 1 && resampler->times[resampler->start] <= oldest) {
+            resampler->start++;
+            resampler->count--;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef RESAMPLE_H_
+#define RESAMPLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct resampler_t resampler_t;
+
+resampler_t *resamplerCreate(int fieldCount, double outputRate);
+void resamplerDestroy(resampler_t *resampler);
+
+void resamplerAddFrame(resampler_t *resampler, int64_t time, const int64_t *frame);
+void resamplerEndSegment(resampler_t *resampler);
+
+bool resamplerGetRow(resampler_t *resampler, int64_t *time, int64_t *frame);
+
+#endif
@@ -0,0 +1,841 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "blackbox_fielddefs.h"
+#include "rowfilter.h"
+
+/*
+ * Row filters are small expressions like "motor[*] > 1950 || flightModeFlags & ANGLE_MODE" which are compiled once
+ * against the field names of a log into a program for a little stack machine, so that testing each decoded frame
+ * doesn't involve any string handling.
+ *
+ * The grammar, from lowest to highest precedence:
+ *
+ *     ||
+ *     &&
+ *     !                         (logical not, unlike C this negates a whole comparison)
+ *     == != < <= > >=           (these don't chain, "a > b == 1" is an error)
+ *     |                         (bitwise, unlike C these bind tighter than comparisons)
+ *     &
+ *     + -
+ *     * / %
+ *     - ~ !                     (unary)
+ *     (expr), numbers, field names, flag names
+ *
+ * A field name of the form "name[*]" matches every field "name[0]", "name[1]"... and the comparison it appears in is
+ * true if it is true for any of those fields. Several wildcards in the same comparison are expanded together, so
+ * "axisP[*] > axisD[*]" compares each axis with its own D term.
+ */
+
+// Expressions that need a deeper evaluation stack than this are rejected when they're compiled
+#define ROW_FILTER_MAX_STACK 32
+#define ROW_FILTER_MAX_NODES 512
+#define ROW_FILTER_MAX_WILDCARD_FIELDS 1024
+#define ROW_FILTER_MAX_NAME_LENGTH 128
+
+typedef enum {
+    FILTER_OP_CONST = 0,
+    FILTER_OP_LOAD_MAIN,
+    FILTER_OP_LOAD_SLOW,
+
+    FILTER_OP_NEGATE,
+    FILTER_OP_NOT,
+    FILTER_OP_BIT_NOT,
+    FILTER_OP_BOOL,
+
+    FILTER_OP_ADD,
+    FILTER_OP_SUB,
+    FILTER_OP_MUL,
+    FILTER_OP_DIV,
+    FILTER_OP_MOD,
+    FILTER_OP_BIT_AND,
+    FILTER_OP_BIT_OR,
+    FILTER_OP_EQ,
+    FILTER_OP_NE,
+    FILTER_OP_LT,
+    FILTER_OP_LE,
+    FILTER_OP_GT,
+    FILTER_OP_GE,
+
+    // Short-circuit for && and ||: jump to the operand if the top of the stack decides the result, otherwise pop it
+    FILTER_OP_JUMP_IF_FALSE_OR_POP,
+    FILTER_OP_JUMP_IF_TRUE_OR_POP,
+
+    // These only appear in the syntax tree, never in a compiled program
+    FILTER_NODE_WILDCARD,
+    FILTER_NODE_AND,
+    FILTER_NODE_OR
+} filterOp_e;
+
+typedef struct rowFilterInstruction_t {
+    filterOp_e op;
+    int64_t operand;
+} rowFilterInstruction_t;
+
+struct rowFilter_t {
+    rowFilterInstruction_t *code;
+    int length;
+};
+
+typedef struct filterNode_t {
+    filterOp_e op;
+
+    // Constant value, field index, or for wildcards the index of the first field in wildcardFields[]
+    int64_t value;
+
+    // For wildcards, the number of fields matched and which frame they come from
+    int count;
+    bool slow;
+
+    // Operand nodes, -1 if absent
+    int left, right;
+} filterNode_t;
+
+typedef struct filterCompiler_t {
+    const char *expression, *pos;
+    const flightLogFrameDef_t *mainDef, *slowDef;
+
+    filterNode_t nodes[ROW_FILTER_MAX_NODES];
+    int nodeCount;
+
+    int wildcardFields[ROW_FILTER_MAX_WILDCARD_FIELDS];
+    int wildcardFieldCount;
+
+    rowFilterInstruction_t *code;
+    int length, capacity;
+    int depth, maxDepth;
+
+    char *error;
+    int errorLen;
+    bool failed;
+} filterCompiler_t;
+
+static int parseOr(filterCompiler_t *compiler);
+
+static inline int64_t applyUnary(filterOp_e op, int64_t a)
+{
+    switch (op) {
+        case FILTER_OP_NEGATE:
+            return -a;
+        case FILTER_OP_NOT:
+            return !a;
+        case FILTER_OP_BIT_NOT:
+            return ~a;
+        case FILTER_OP_BOOL:
+            return a != 0;
+        default:
+            return 0;
+    }
+}
+
+static inline int64_t applyBinary(filterOp_e op, int64_t a, int64_t b)
+{
+    switch (op) {
+        case FILTER_OP_ADD:
+            return a + b;
+        case FILTER_OP_SUB:
+            return a - b;
+        case FILTER_OP_MUL:
+            return a * b;
+        case FILTER_OP_DIV:
+            return b == 0 ? 0 : a / b;
+        case FILTER_OP_MOD:
+            return b == 0 ? 0 : a % b;
+        case FILTER_OP_BIT_AND:
+            return a & b;
+        case FILTER_OP_BIT_OR:
+            return a | b;
+        case FILTER_OP_EQ:
+            return a == b;
+        case FILTER_OP_NE:
+            return a != b;
+        case FILTER_OP_LT:
+            return a < b;
+        case FILTER_OP_LE:
+            return a <= b;
+        case FILTER_OP_GT:
+            return a > b;
+        case FILTER_OP_GE:
+            return a >= b;
+        case FILTER_NODE_AND:
+            return a && b;
+        case FILTER_NODE_OR:
+            return a || b;
+        default:
+            return 0;
+    }
+}
+
+static void compileError(filterCompiler_t *compiler, const char *format, ...)
+{
+    va_list args;
+    int written;
+
+    // Only the first error is interesting, the rest are usually a consequence of it
+    if (compiler->failed)
+        return;
+
+    compiler->failed = true;
+
+    if (!compiler->error || compiler->errorLen <= 0)
+        return;
+
+    va_start(args, format);
+    written = vsnprintf(compiler->error, compiler->errorLen, format, args);
+    va_end(args);
+
+    if (written >= 0 && written < compiler->errorLen) {
+        snprintf(compiler->error + written, compiler->errorLen - written, " (at column %d)", (int) (compiler->pos - compiler->expression) + 1);
+    }
+}
+
+static void skipSpace(filterCompiler_t *compiler)
+{
+    while (isspace((unsigned char) *compiler->pos))
+        compiler->pos++;
+}
+
+/**
+ * Consume the given operator if it's next in the input. Single-character operators won't match the start of a
+ * longer one ("&" doesn't match "&&", "<" doesn't match "<=").
+ */
+static bool acceptToken(filterCompiler_t *compiler, const char *token)
+{
+    size_t len = strlen(token);
+
+    skipSpace(compiler);
+
+    if (strncmp(compiler->pos, token, len) != 0)
+        return false;
+
+    if (len == 1 && strchr("&|<>!", token[0])
+            && (compiler->pos[1] == '=' || ((token[0] == '&' || token[0] == '|') && compiler->pos[1] == token[0])))
+        return false;
+
+    compiler->pos += len;
+
+    return true;
+}
+
+static int newNode(filterCompiler_t *compiler, filterOp_e op, int64_t value, int left, int right)
+{
+    filterNode_t *node;
+
+    if (compiler->nodeCount >= ROW_FILTER_MAX_NODES) {
+        compileError(compiler, "Expression is too long");
+        return -1;
+    }
+
+    node = &compiler->nodes[compiler->nodeCount];
+
+    node->op = op;
+    node->value = value;
+    node->count = 0;
+    node->slow = false;
+    node->left = left;
+    node->right = right;
+
+    return compiler->nodeCount++;
+}
+
+static int unaryNode(filterCompiler_t *compiler, filterOp_e op, int operand)
+{
+    if (operand < 0)
+        return -1;
+
+    if (compiler->nodes[operand].op == FILTER_OP_CONST) {
+        compiler->nodes[operand].value = applyUnary(op, compiler->nodes[operand].value);
+        return operand;
+    }
+
+    return newNode(compiler, op, 0, operand, -1);
+}
+
+static int binaryNode(filterCompiler_t *compiler, filterOp_e op, int left, int right)
+{
+    if (left < 0 || right < 0)
+        return -1;
+
+    if (compiler->nodes[left].op == FILTER_OP_CONST && compiler->nodes[right].op == FILTER_OP_CONST) {
+        compiler->nodes[left].value = applyBinary(op, compiler->nodes[left].value, compiler->nodes[right].value);
+        return left;
+    }
+
+    return newNode(compiler, op, 0, left, right);
+}
+
+static int findField(const flightLogFrameDef_t *frameDef, const char *name)
+{
+    if (frameDef) {
+        for (int i = 0; i < frameDef->fieldCount; i++) {
+            if (strcmp(frameDef->fieldName[i], name) == 0)
+                return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Add the indexes of all the fields in the frame which are called "base[<number>]" to the wildcard field list,
+ * returning the number of fields found.
+ */
+static int collectWildcardFields(filterCompiler_t *compiler, const flightLogFrameDef_t *frameDef, const char *base)
+{
+    size_t baseLen = strlen(base);
+    int count = 0;
+
+    if (!frameDef)
+        return 0;
+
+    for (int i = 0; i < frameDef->fieldCount; i++) {
+        const char *name = frameDef->fieldName[i];
+        const char *c;
+
+        if (strncmp(name, base, baseLen) != 0 || name[baseLen] != '[' || !isdigit((unsigned char) name[baseLen + 1]))
+            continue;
+
+        for (c = name + baseLen + 1; isdigit((unsigned char) *c); c++)
+            ;
+
+        if (strcmp(c, "]") != 0)
+            continue;
+
+        if (compiler->wildcardFieldCount >= ROW_FILTER_MAX_WILDCARD_FIELDS) {
+            compileError(compiler, "Too many wildcard fields");
+            return 0;
+        }
+
+        compiler->wildcardFields[compiler->wildcardFieldCount++] = i;
+        count++;
+    }
+
+    return count;
+}
+
+static bool findFlagConstant(const char *name, int64_t *value)
+{
+    for (int i = 0; i < FLIGHT_LOG_FLIGHT_MODE_COUNT; i++) {
+        if (strcmp(FLIGHT_LOG_FLIGHT_MODE_NAME[i], name) == 0) {
+            *value = 1 << i;
+            return true;
+        }
+    }
+
+    for (int i = 0; i < FLIGHT_LOG_FLIGHT_STATE_COUNT; i++) {
+        if (strcmp(FLIGHT_LOG_FLIGHT_STATE_NAME[i], name) == 0) {
+            *value = 1 << i;
+            return true;
+        }
+    }
+
+    for (int i = 0; i < FLIGHT_LOG_FAILSAFE_PHASE_COUNT; i++) {
+        if (strcmp(FLIGHT_LOG_FAILSAFE_PHASE_NAME[i], name) == 0) {
+            *value = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int parseName(filterCompiler_t *compiler)
+{
+    char name[ROW_FILTER_MAX_NAME_LENGTH];
+    const char *start = compiler->pos;
+    int len, fieldIndex;
+    int64_t value;
+
+    while (isalnum((unsigned char) *compiler->pos) || *compiler->pos == '_')
+        compiler->pos++;
+
+    len = compiler->pos - start;
+
+    if (len >= ROW_FILTER_MAX_NAME_LENGTH - 16) {
+        compileError(compiler, "Name is too long");
+        return -1;
+    }
+
+    memcpy(name, start, len);
+    name[len] = '\0';
+
+    if (acceptToken(compiler, "[")) {
+        if (acceptToken(compiler, "*")) {
+            int first = compiler->wildcardFieldCount;
+            int count;
+            bool slow = false;
+
+            if (!acceptToken(compiler, "]")) {
+                compileError(compiler, "Expected ']'");
+                return -1;
+            }
+
+            count = collectWildcardFields(compiler, compiler->mainDef, name);
+
+            if (count == 0) {
+                count = collectWildcardFields(compiler, compiler->slowDef, name);
+                slow = true;
+            }
+
+            if (count == 0) {
+                compileError(compiler, "No fields in this log match '%s[*]'", name);
+                return -1;
+            }
+
+            int node = newNode(compiler, FILTER_NODE_WILDCARD, first, -1, -1);
+
+            if (node >= 0) {
+                compiler->nodes[node].count = count;
+                compiler->nodes[node].slow = slow;
+            }
+
+            return node;
+        } else {
+            char *end;
+            long index;
+
+            skipSpace(compiler);
+            index = strtol(compiler->pos, &end, 10);
+
+            if (end == compiler->pos || index < 0) {
+                compileError(compiler, "Expected a field index or '*'");
+                return -1;
+            }
+
+            compiler->pos = end;
+
+            if (!acceptToken(compiler, "]")) {
+                compileError(compiler, "Expected ']'");
+                return -1;
+            }
+
+            snprintf(name + len, sizeof(name) - len, "[%ld]", index);
+        }
+    }
+
+    fieldIndex = findField(compiler->mainDef, name);
+
+    if (fieldIndex != -1)
+        return newNode(compiler, FILTER_OP_LOAD_MAIN, fieldIndex, -1, -1);
+
+    fieldIndex = findField(compiler->slowDef, name);
+
+    if (fieldIndex != -1)
+        return newNode(compiler, FILTER_OP_LOAD_SLOW, fieldIndex, -1, -1);
+
+    if (findFlagConstant(name, &value))
+        return newNode(compiler, FILTER_OP_CONST, value, -1, -1);
+
+    compiler->pos = start;
+    compileError(compiler, "Unknown field '%s'", name);
+
+    return -1;
+}
+
+static int parsePrimary(filterCompiler_t *compiler)
+{
+    skipSpace(compiler);
+
+    if (acceptToken(compiler, "(")) {
+        int node = parseOr(compiler);
+
+        if (node >= 0 && !acceptToken(compiler, ")")) {
+            compileError(compiler, "Expected ')'");
+            return -1;
+        }
+
+        return node;
+    }
+
+    if (isdigit((unsigned char) *compiler->pos)) {
+        char *end;
+        long long value = strtoll(compiler->pos, &end, 0);
+
+        compiler->pos = end;
+
+        return newNode(compiler, FILTER_OP_CONST, value, -1, -1);
+    }
+
+    if (isalpha((unsigned char) *compiler->pos) || *compiler->pos == '_')
+        return parseName(compiler);
+
+    if (*compiler->pos == '\0')
+        compileError(compiler, "Unexpected end of expression");
+    else
+        compileError(compiler, "Unexpected '%c'", *compiler->pos);
+
+    return -1;
+}
+
+static int parseUnary(filterCompiler_t *compiler)
+{
+    if (acceptToken(compiler, "-"))
+        return unaryNode(compiler, FILTER_OP_NEGATE, parseUnary(compiler));
+    if (acceptToken(compiler, "~"))
+        return unaryNode(compiler, FILTER_OP_BIT_NOT, parseUnary(compiler));
+    if (acceptToken(compiler, "!"))
+        return unaryNode(compiler, FILTER_OP_NOT, parseUnary(compiler));
+
+    return parsePrimary(compiler);
+}
+
+static int parseMultiplicative(filterCompiler_t *compiler)
+{
+    int node = parseUnary(compiler);
+
+    while (node >= 0) {
+        if (acceptToken(compiler, "*"))
+            node = binaryNode(compiler, FILTER_OP_MUL, node, parseUnary(compiler));
+        else if (acceptToken(compiler, "/"))
+            node = binaryNode(compiler, FILTER_OP_DIV, node, parseUnary(compiler));
+        else if (acceptToken(compiler, "%"))
+            node = binaryNode(compiler, FILTER_OP_MOD, node, parseUnary(compiler));
+        else
+            break;
+    }
+
+    return node;
+}
+
+static int parseAdditive(filterCompiler_t *compiler)
+{
+    int node = parseMultiplicative(compiler);
+
+    while (node >= 0) {
+        if (acceptToken(compiler, "+"))
+            node = binaryNode(compiler, FILTER_OP_ADD, node, parseMultiplicative(compiler));
+        else if (acceptToken(compiler, "-"))
+            node = binaryNode(compiler, FILTER_OP_SUB, node, parseMultiplicative(compiler));
+        else
+            break;
+    }
+
+    return node;
+}
+
+static int parseBitAnd(filterCompiler_t *compiler)
+{
+    int node = parseAdditive(compiler);
+
+    while (node >= 0 && acceptToken(compiler, "&"))
+        node = binaryNode(compiler, FILTER_OP_BIT_AND, node, parseAdditive(compiler));
+
+    return node;
+}
+
+static int parseBitOr(filterCompiler_t *compiler)
+{
+    int node = parseBitAnd(compiler);
+
+    while (node >= 0 && acceptToken(compiler, "|"))
+        node = binaryNode(compiler, FILTER_OP_BIT_OR, node, parseBitAnd(compiler));
+
+    return node;
+}
+
+static int parseComparison(filterCompiler_t *compiler)
+{
+    static const struct {
+        const char *token;
+        filterOp_e op;
+    } comparisons[] = {
+        {"==", FILTER_OP_EQ},
+        {"!=", FILTER_OP_NE},
+        {"<=", FILTER_OP_LE},
+        {">=", FILTER_OP_GE},
+        {"<", FILTER_OP_LT},
+        {">", FILTER_OP_GT}
+    };
+
+    int node = parseBitOr(compiler);
+
+    if (node < 0)
+        return -1;
+
+    for (unsigned i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]); i++) {
+        if (acceptToken(compiler, comparisons[i].token))
+            return binaryNode(compiler, comparisons[i].op, node, parseBitOr(compiler));
+    }
+
+    return node;
+}
+
+static int parseNot(filterCompiler_t *compiler)
+{
+    if (acceptToken(compiler, "!"))
+        return unaryNode(compiler, FILTER_OP_NOT, parseNot(compiler));
+
+    return parseComparison(compiler);
+}
+
+static int parseAnd(filterCompiler_t *compiler)
+{
+    int node = parseNot(compiler);
+
+    while (node >= 0 && acceptToken(compiler, "&&"))
+        node = binaryNode(compiler, FILTER_NODE_AND, node, parseNot(compiler));
+
+    return node;
+}
+
+static int parseOr(filterCompiler_t *compiler)
+{
+    int node = parseAnd(compiler);
+
+    while (node >= 0 && acceptToken(compiler, "||"))
+        node = binaryNode(compiler, FILTER_NODE_OR, node, parseAnd(compiler));
+
+    return node;
+}
+
+static int emit(filterCompiler_t *compiler, filterOp_e op, int64_t operand)
+{
+    if (compiler->length >= compiler->capacity) {
+        compiler->capacity = compiler->capacity ? compiler->capacity * 2 : 32;
+        compiler->code = realloc(compiler->code, compiler->capacity * sizeof(*compiler->code));
+    }
+
+    compiler->code[compiler->length].op = op;
+    compiler->code[compiler->length].operand = operand;
+
+    switch (op) {
+        case FILTER_OP_CONST:
+        case FILTER_OP_LOAD_MAIN:
+        case FILTER_OP_LOAD_SLOW:
+            compiler->depth++;
+        break;
+        case FILTER_OP_NEGATE:
+        case FILTER_OP_NOT:
+        case FILTER_OP_BIT_NOT:
+        case FILTER_OP_BOOL:
+        break;
+        default:
+            // Binary operators, and the fall-through path of the conditional jumps
+            compiler->depth--;
+    }
+
+    if (compiler->depth > compiler->maxDepth)
+        compiler->maxDepth = compiler->depth;
+
+    return compiler->length++;
+}
+
+static bool isLogicalNode(const filterNode_t *node)
+{
+    return node->op == FILTER_NODE_AND || node->op == FILTER_NODE_OR || node->op == FILTER_OP_NOT;
+}
+
+/**
+ * Find the number of fields matched by the wildcards in this expression (stopping at logical operators, which
+ * expand their own operands). Returns 0 if there are no wildcards.
+ */
+static int countWildcards(filterCompiler_t *compiler, int nodeIndex)
+{
+    const filterNode_t *node;
+    int left, right;
+
+    if (nodeIndex < 0)
+        return 0;
+
+    node = &compiler->nodes[nodeIndex];
+
+    if (node->op == FILTER_NODE_WILDCARD)
+        return node->count;
+
+    if (isLogicalNode(node))
+        return 0;
+
+    left = countWildcards(compiler, node->left);
+    right = countWildcards(compiler, node->right);
+
+    if (left && right && left != right) {
+        compileError(compiler, "Wildcards in the same comparison must match the same number of fields");
+    }
+
+    return left ? left : right;
+}
+
+static void generateCondition(filterCompiler_t *compiler, int nodeIndex);
+
+/**
+ * Generate code to push the value of the given node, substituting the wildcardIndex-th field for any wildcards.
+ */
+static void generateValue(filterCompiler_t *compiler, int nodeIndex, int wildcardIndex)
+{
+    const filterNode_t *node = &compiler->nodes[nodeIndex];
+    int jump;
+
+    switch (node->op) {
+        case FILTER_OP_CONST:
+        case FILTER_OP_LOAD_MAIN:
+        case FILTER_OP_LOAD_SLOW:
+            emit(compiler, node->op, node->value);
+        break;
+        case FILTER_NODE_WILDCARD:
+            emit(compiler, node->slow ? FILTER_OP_LOAD_SLOW : FILTER_OP_LOAD_MAIN, compiler->wildcardFields[node->value + wildcardIndex]);
+        break;
+        case FILTER_OP_NOT:
+            generateCondition(compiler, node->left);
+            emit(compiler, FILTER_OP_NOT, 0);
+        break;
+        case FILTER_OP_NEGATE:
+        case FILTER_OP_BIT_NOT:
+            generateValue(compiler, node->left, wildcardIndex);
+            emit(compiler, node->op, 0);
+        break;
+        case FILTER_NODE_AND:
+        case FILTER_NODE_OR:
+            generateCondition(compiler, node->left);
+            jump = emit(compiler, node->op == FILTER_NODE_AND ? FILTER_OP_JUMP_IF_FALSE_OR_POP : FILTER_OP_JUMP_IF_TRUE_OR_POP, 0);
+            generateCondition(compiler, node->right);
+            compiler->code[jump].operand = compiler->length;
+            emit(compiler, FILTER_OP_BOOL, 0);
+        break;
+        default:
+            generateValue(compiler, node->left, wildcardIndex);
+            generateValue(compiler, node->right, wildcardIndex);
+            emit(compiler, node->op, 0);
+    }
+}
+
+/**
+ * Generate code to push the truth value of the given node. If the node contains wildcards it's evaluated for each
+ * field they match until one is true.
+ */
+static void generateCondition(filterCompiler_t *compiler, int nodeIndex)
+{
+    int jumps[FLIGHT_LOG_MAX_FIELDS];
+    int count;
+
+    if (isLogicalNode(&compiler->nodes[nodeIndex])) {
+        generateValue(compiler, nodeIndex, -1);
+        return;
+    }
+
+    count = countWildcards(compiler, nodeIndex);
+
+    if (count == 0) {
+        generateValue(compiler, nodeIndex, -1);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (i > 0)
+            jumps[i] = emit(compiler, FILTER_OP_JUMP_IF_TRUE_OR_POP, 0);
+
+        generateValue(compiler, nodeIndex, i);
+    }
+
+    for (int i = 1; i < count; i++) {
+        compiler->code[jumps[i]].operand = compiler->length;
+    }
+
+    emit(compiler, FILTER_OP_BOOL, 0);
+}
+
+/**
+ * Compile the filter expression against the field names of the given main and slow frame definitions (slowDef may be
+ * NULL). On failure NULL is returned and a description of the problem is written to error.
+ */
+rowFilter_t *rowFilterCompile(const char *expression, const flightLogFrameDef_t *mainDef, const flightLogFrameDef_t *slowDef,
+    char *error, int errorLen)
+{
+    filterCompiler_t *compiler = calloc(1, sizeof(*compiler));
+    rowFilter_t *filter = NULL;
+    int root;
+
+    compiler->expression = expression;
+    compiler->pos = expression;
+    compiler->mainDef = mainDef;
+    compiler->slowDef = slowDef;
+    compiler->error = error;
+    compiler->errorLen = errorLen;
+
+    root = parseOr(compiler);
+
+    if (root >= 0) {
+        skipSpace(compiler);
+
+        if (*compiler->pos != '\0') {
+            compileError(compiler, "Unexpected '%c'", *compiler->pos);
+        } else {
+            generateCondition(compiler, root);
+
+            if (compiler->maxDepth > ROW_FILTER_MAX_STACK) {
+                compileError(compiler, "Expression is too deeply nested");
+            }
+        }
+    }
+
+    if (!compiler->failed) {
+        filter = malloc(sizeof(*filter));
+
+        filter->code = compiler->code;
+        filter->length = compiler->length;
+    } else {
+        free(compiler->code);
+    }
+
+    free(compiler);
+
+    return filter;
+}
+
+void rowFilterDestroy(rowFilter_t *filter)
+{
+    if (filter) {
+        free(filter->code);
+        free(filter);
+    }
+}
+
+/**
+ * Test the decoded main frame (and the most recent slow frame) against the filter.
+ */
+bool rowFilterMatches(const rowFilter_t *filter, const int64_t *mainFrame, const int64_t *slowFrame)
+{
+    int64_t stack[ROW_FILTER_MAX_STACK];
+    int top = -1;
+
+    for (int pc = 0; pc < filter->length; pc++) {
+        const rowFilterInstruction_t *instruction = &filter->code[pc];
+
+        switch (instruction->op) {
+            case FILTER_OP_CONST:
+                stack[++top] = instruction->operand;
+            break;
+            case FILTER_OP_LOAD_MAIN:
+                stack[++top] = mainFrame[instruction->operand];
+            break;
+            case FILTER_OP_LOAD_SLOW:
+                stack[++top] = slowFrame[instruction->operand];
+            break;
+            case FILTER_OP_NEGATE:
+            case FILTER_OP_NOT:
+            case FILTER_OP_BIT_NOT:
+            case FILTER_OP_BOOL:
+                stack[top] = applyUnary(instruction->op, stack[top]);
+            break;
+            case FILTER_OP_JUMP_IF_FALSE_OR_POP:
+                if (!stack[top])
+                    pc = instruction->operand - 1;
+                else
+                    top--;
+            break;
+            case FILTER_OP_JUMP_IF_TRUE_OR_POP:
+                if (stack[top])
+                    pc = instruction->operand - 1;
+                else
+                    top--;
+            break;
+            default:
+                top--;
+                stack[top] = applyBinary(instruction->op, stack[top], stack[top + 1]);
+        }
+    }
+
+    return stack[0] != 0;
+}
@@ -0,0 +1,17 @@
+#ifndef ROWFILTER_H_
+#define ROWFILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "parser.h"
+
+typedef struct rowFilter_t rowFilter_t;
+
+rowFilter_t *rowFilterCompile(const char *expression, const flightLogFrameDef_t *mainDef, const flightLogFrameDef_t *slowDef,
+    char *error, int errorLen);
+void rowFilterDestroy(rowFilter_t *filter);
+
+bool rowFilterMatches(const rowFilter_t *filter, const int64_t *mainFrame, const int64_t *slowFrame);
+
+#endif
@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "platform.h"
+#include "fft.h"
+#include "spectrogram.h"
+
+// Magnitudes this far below the loudest bin in the log are drawn as silence
+#define SPECTROGRAM_DYNAMIC_RANGE_DB 60.0
+
+typedef struct spectrogramTask_t {
+    spectrogram_t *spectrogram;
+    datapoints_t *points;
+
+    int fieldIndexes[SPECTROGRAM_MAX_FIELDS];
+    int fieldCount;
+
+    const fftPlan_t *plan;
+    const double *window;
+
+    // Range of columns [firstColumn...lastColumn) for this worker to fill
+    int firstColumn, lastColumn;
+
+    // Output power in dB, or NAN for columns which couldn't be computed
+    float *power;
+
+    semaphore_t *done;
+} spectrogramTask_t;
+
+/**
+ * Estimate the average interval between frames in microseconds, ignoring any gaps in the log.
+ */
+static double estimateFrameInterval(datapoints_t *points)
+{
+    int64_t total = 0;
+    int count = 0;
+
+    for (int i = 1; i < points->frameCount; i++) {
+        int64_t interval = points->frameTime[i] - points->frameTime[i - 1];
+
+        if (!points->frameGap[i - 1] && interval > 0) {
+            total += interval;
+            count++;
+        }
+    }
+
+    return count > 0 ? (double) total / count : 0;
+}
+
+/**
+ * Load the samples for one field centered around the given frame into re[]. Returns false if the window would cross
+ * a gap in the log or run off either end of it.
+ */
+static bool loadWindow(datapoints_t *points, int fieldIndex, int centerFrame, int size, const double *window, double *re, double *im)
+{
+    int firstFrame = centerFrame - size / 2;
+    double mean = 0;
+
+    if (firstFrame < 0 || firstFrame + size > points->frameCount)
+        return false;
+
+    for (int i = 0; i < size; i++) {
+        int frameIndex = firstFrame + i;
+
+        if (i < size - 1 && points->frameGap[frameIndex])
+            return false;
+
+        re[i] = (double) points->frames[points->fieldCount * frameIndex + fieldIndex];
+        mean += re[i];
+    }
+
+    mean /= size;
+
+    // Remove the DC offset so it doesn't leak into the low frequency bins
+    for (int i = 0; i < size; i++) {
+        re[i] = (re[i] - mean) * window[i];
+        im[i] = 0;
+    }
+
+    return true;
+}
+
+static void* spectrogramWorkerThread(void *arg)
+{
+    spectrogramTask_t *task = (spectrogramTask_t *) arg;
+    spectrogram_t *spectrogram = task->spectrogram;
+    datapoints_t *points = task->points;
+    int size = fftPlanGetSize(task->plan);
+
+    double *re = malloc(size * sizeof(*re));
+    double *im = malloc(size * sizeof(*im));
+    double *sum = malloc(spectrogram->binCount * sizeof(*sum));
+
+    // Columns are visited in increasing time order, so we only need to march this cursor forwards
+    int frameIndex = 0;
+
+    for (int column = task->firstColumn; column < task->lastColumn; column++) {
+        int64_t columnTime = spectrogram->startTime + (int64_t) column * 1000000 / spectrogram->columnsPerSecond;
+        float *columnPower = task->power + (size_t) column * spectrogram->binCount;
+        bool valid = true;
+
+        while (frameIndex + 1 < points->frameCount && points->frameTime[frameIndex + 1] <= columnTime)
+            frameIndex++;
+
+        memset(sum, 0, spectrogram->binCount * sizeof(*sum));
+
+        for (int field = 0; field < task->fieldCount && valid; field++) {
+            valid = loadWindow(points, task->fieldIndexes[field], frameIndex, size, task->window, re, im);
+
+            if (valid) {
+                fftForward(task->plan, re, im);
+
+                for (int bin = 0; bin < spectrogram->binCount; bin++) {
+                    sum[bin] += re[bin] * re[bin] + im[bin] * im[bin];
+                }
+            }
+        }
+
+        for (int bin = 0; bin < spectrogram->binCount; bin++) {
+            columnPower[bin] = valid ? (float) (10 * log10(sum[bin] + 1e-9)) : NAN;
+        }
+    }
+
+    free(re);
+    free(im);
+    free(sum);
+
+    semaphore_signal(task->done);
+
+    return 0;
+}
+
+/**
+ * Compute the spectrogram of the sum of the power spectra of the given fields, with one column every
+ * 1/columnsPerSecond seconds over the period [startTime...endTime]. fftSize must be a power of two. The
+ * columns are divided between the given number of threads.
+ *
+ * Returns NULL if the log is too short or sparse to compute a spectrum from.
+ */
+spectrogram_t *spectrogramCreate(datapoints_t *points, const int *fieldIndexes, int fieldCount, int64_t startTime, int64_t endTime,
+    int columnsPerSecond, int fftSize, int threads)
+{
+    spectrogram_t *spectrogram;
+    spectrogramTask_t *tasks;
+    fftPlan_t *plan;
+    double *window;
+    float *power;
+    semaphore_t done;
+    double frameInterval = estimateFrameInterval(points);
+    float maxPower = -INFINITY;
+
+    if (fieldCount < 1 || fieldCount > SPECTROGRAM_MAX_FIELDS || frameInterval <= 0 || columnsPerSecond <= 0
+            || endTime <= startTime || points->frameCount < fftSize)
+        return NULL;
+
+    plan = fftPlanCreate(fftSize);
+
+    if (!plan)
+        return NULL;
+
+    if (threads < 1)
+        threads = 1;
+
+    spectrogram = malloc(sizeof(*spectrogram));
+    spectrogram->startTime = startTime;
+    spectrogram->columnsPerSecond = columnsPerSecond;
+    spectrogram->columnCount = (int) ((endTime - startTime) * columnsPerSecond / 1000000) + 1;
+    spectrogram->binCount = fftSize / 2;
+    spectrogram->maxFrequency = 1000000.0 / frameInterval / 2;
+    spectrogram->magnitude = malloc((size_t) spectrogram->columnCount * spectrogram->binCount);
+
+    window = malloc(fftSize * sizeof(*window));
+    fftHannWindow(window, fftSize);
+
+    power = malloc((size_t) spectrogram->columnCount * spectrogram->binCount * sizeof(*power));
+
+    semaphore_create(&done, 0);
+
+    tasks = malloc(threads * sizeof(*tasks));
+
+    for (int i = 0; i < threads; i++) {
+        spectrogramTask_t *task = &tasks[i];
+
+        task->spectrogram = spectrogram;
+        task->points = points;
+        memcpy(task->fieldIndexes, fieldIndexes, fieldCount * sizeof(*fieldIndexes));
+        task->fieldCount = fieldCount;
+        task->plan = plan;
+        task->window = window;
+        task->firstColumn = (int) ((int64_t) spectrogram->columnCount * i / threads);
+        task->lastColumn = (int) ((int64_t) spectrogram->columnCount * (i + 1) / threads);
+        task->power = power;
+        task->done = &done;
+
+        thread_create_detached(spectrogramWorkerThread, task);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        semaphore_wait(&done);
+    }
+
+    semaphore_destroy(&done);
+
+    // Quantise relative to the loudest bin in the whole log so that colours are comparable between frames
+    for (size_t i = 0; i < (size_t) spectrogram->columnCount * spectrogram->binCount; i++) {
+        if (!isnan(power[i]) && power[i] > maxPower)
+            maxPower = power[i];
+    }
+
+    for (size_t i = 0; i < (size_t) spectrogram->columnCount * spectrogram->binCount; i++) {
+        if (isnan(power[i])) {
+            spectrogram->magnitude[i] = 0;
+        } else {
+            double level = (power[i] - (maxPower - SPECTROGRAM_DYNAMIC_RANGE_DB)) / SPECTROGRAM_DYNAMIC_RANGE_DB;
+
+            if (level < 0)
+                level = 0;
+            else if (level > 1)
+                level = 1;
+
+            spectrogram->magnitude[i] = (uint8_t) (level * 255 + 0.5);
+        }
+    }
+
+    free(tasks);
+    free(power);
+    free(window);
+    fftPlanDestroy(plan);
+
+    return spectrogram;
+}
+
+void spectrogramDestroy(spectrogram_t *spectrogram)
+{
+    if (spectrogram) {
+        free(spectrogram->magnitude);
+        free(spectrogram);
+    }
+}
+
+/**
+ * Get the quantised magnitudes for the given column, or NULL if the column lies outside the spectrogram.
+ */
+const uint8_t *spectrogramGetColumn(const spectrogram_t *spectrogram, int column)
+{
+    if (column < 0 || column >= spectrogram->columnCount)
+        return NULL;
+
+    return spectrogram->magnitude + (size_t) column * spectrogram->binCount;
+}
@@ -0,0 +1,35 @@
+#ifndef SPECTROGRAM_H_
+#define SPECTROGRAM_H_
+
+#include <stdint.h>
+
+#include "datapoints.h"
+
+#define SPECTROGRAM_MAX_FIELDS 3
+
+/*
+ * A short-time Fourier transform of one or more fields, computed up-front with one column per output video frame.
+ * Magnitudes are stored quantised to 8 bits (0 = quietest, 255 = loudest) so each video frame only needs to look up
+ * the columns in its window.
+ */
+typedef struct spectrogram_t {
+    int columnCount, binCount;
+
+    // Time of the center of the first column, and the spacing between columns
+    int64_t startTime;
+    int columnsPerSecond;
+
+    // Frequency represented by the top bin (the Nyquist frequency of the field's sample rate)
+    double maxFrequency;
+
+    // columnCount columns of binCount bins each, with bin 0 (DC) first
+    uint8_t *magnitude;
+} spectrogram_t;
+
+spectrogram_t *spectrogramCreate(datapoints_t *points, const int *fieldIndexes, int fieldCount, int64_t startTime, int64_t endTime,
+    int columnsPerSecond, int fftSize, int threads);
+void spectrogramDestroy(spectrogram_t *spectrogram);
+
+const uint8_t *spectrogramGetColumn(const spectrogram_t *spectrogram, int column);
+
+#endif
@@ -0,0 +1,452 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "platform.h"
+#include "fft.h"
+#include "stepresponse.h"
+
+// Length of each analysis window, and the spacing between the starts of successive (overlapping) windows
+#define STEP_RESPONSE_WINDOW_MICROS 2000000
+#define STEP_RESPONSE_HOP_MICROS    1000000
+
+// Length of the step response curve we compute, and the portion at its end we treat as the steady-state
+#define STEP_RESPONSE_LENGTH_MICROS       500000
+#define STEP_RESPONSE_STEADY_STATE_MICROS 200000
+
+// Windows where the sticks never move further than this from center (in rcCommand units) are skipped
+#define STEP_RESPONSE_MIN_SETPOINT 20
+
+// Logs faster than this are averaged down to it, since the response doesn't need finer resolution
+#define STEP_RESPONSE_MIN_SAMPLE_INTERVAL_MICROS 500
+
+// Wiener deconvolution noise floor, relative to the mean power of the setpoint spectrum
+#define STEP_RESPONSE_REGULARISATION 0.0001
+
+/*
+ * Samples are stored as STEP_RESPONSE_AXES setpoints followed by STEP_RESPONSE_AXES gyro values. Gaps in the log
+ * split the samples into segments which no window is allowed to cross.
+ */
+#define STEP_RESPONSE_SAMPLE_STRIDE (STEP_RESPONSE_AXES * 2)
+
+struct stepResponseLog_t {
+    float *samples;
+    int sampleCount, sampleCapacity;
+
+    int *segmentStart;
+    int segmentCount, segmentCapacity;
+
+    bool gapPending;
+
+    int64_t lastTime;
+    int64_t intervalTotal;
+    int intervalCount;
+};
+
+typedef struct stepResponseTask_t {
+    const stepResponseLog_t *log;
+
+    const int *windowStart;
+    int firstWindow, lastWindow;
+
+    // Lengths are counted in decimated samples, each of which is the average of 'decimation' logged samples
+    int decimation;
+    int windowLength, responseLength;
+    const fftPlan_t *plan;
+    const double *hann;
+
+    // Weighted sums of the step responses we computed, and the total weights
+    double *sum[STEP_RESPONSE_AXES];
+    double weight[STEP_RESPONSE_AXES];
+    int windowCount[STEP_RESPONSE_AXES];
+
+    semaphore_t *done;
+} stepResponseTask_t;
+
+stepResponseLog_t *stepResponseLogCreate(void)
+{
+    stepResponseLog_t *log = calloc(1, sizeof(*log));
+
+    log->gapPending = true;
+
+    return log;
+}
+
+void stepResponseLogDestroy(stepResponseLog_t *log)
+{
+    if (log) {
+        free(log->samples);
+        free(log->segmentStart);
+        free(log);
+    }
+}
+
+/**
+ * Mark a discontinuity in the log (e.g. a corrupt frame), so the next sample begins a new segment.
+ */
+void stepResponseLogAddGap(stepResponseLog_t *log)
+{
+    log->gapPending = true;
+}
+
+void stepResponseLogAddSample(stepResponseLog_t *log, int64_t time, const double setpoint[STEP_RESPONSE_AXES], const double gyro[STEP_RESPONSE_AXES])
+{
+    float *sample;
+
+    // Time going backwards can't be analysed as a continuation of the previous segment
+    if (!log->gapPending && time <= log->lastTime) {
+        log->gapPending = true;
+    }
+
+    if (log->gapPending) {
+        if (log->segmentCount == log->segmentCapacity) {
+            log->segmentCapacity = log->segmentCapacity ? log->segmentCapacity * 2 : 16;
+            log->segmentStart = realloc(log->segmentStart, log->segmentCapacity * sizeof(*log->segmentStart));
+        }
+
+        log->segmentStart[log->segmentCount++] = log->sampleCount;
+        log->gapPending = false;
+    } else {
+        log->intervalTotal += time - log->lastTime;
+        log->intervalCount++;
+    }
+
+    log->lastTime = time;
+
+    if (log->sampleCount == log->sampleCapacity) {
+        log->sampleCapacity = log->sampleCapacity ? log->sampleCapacity * 2 : 65536;
+        log->samples = realloc(log->samples, (size_t) log->sampleCapacity * STEP_RESPONSE_SAMPLE_STRIDE * sizeof(*log->samples));
+    }
+
+    sample = log->samples + (size_t) log->sampleCount * STEP_RESPONSE_SAMPLE_STRIDE;
+
+    for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+        sample[axis] = (float) setpoint[axis];
+        sample[STEP_RESPONSE_AXES + axis] = (float) gyro[axis];
+    }
+
+    log->sampleCount++;
+}
+
+static double readDecimated(const float *samples, int decimation, int index, int field)
+{
+    double total = 0;
+
+    samples += (size_t) index * decimation * STEP_RESPONSE_SAMPLE_STRIDE + field;
+
+    for (int i = 0; i < decimation; i++) {
+        total += samples[i * STEP_RESPONSE_SAMPLE_STRIDE];
+    }
+
+    return total / decimation;
+}
+
+/**
+ * Estimate the impulse response from setpoint to gyro for one axis of one window by Wiener deconvolution, and
+ * integrate it to get the step response. Returns false if the sticks didn't move enough during the window to
+ * excite the system, otherwise sets *weight to the amount of stick activity.
+ */
+static bool computeWindowResponse(stepResponseTask_t *task, int start, int axis, double *zr, double *zi, double *hr, double *hi,
+    double *step, double *weight)
+{
+    int size = fftPlanGetSize(task->plan);
+    const float *samples = task->log->samples + (size_t) start * STEP_RESPONSE_SAMPLE_STRIDE;
+    double mean = 0, variance = 0, peak = 0, power = 0, regularisation, accumulator;
+
+    for (int i = 0; i < task->windowLength; i++) {
+        double setpoint = readDecimated(samples, task->decimation, i, axis);
+
+        mean += setpoint;
+
+        if (fabs(setpoint) > peak)
+            peak = fabs(setpoint);
+    }
+
+    if (peak < STEP_RESPONSE_MIN_SETPOINT)
+        return false;
+
+    mean /= task->windowLength;
+
+    for (int i = 0; i < task->windowLength; i++) {
+        double setpoint = readDecimated(samples, task->decimation, i, axis);
+
+        variance += (setpoint - mean) * (setpoint - mean);
+
+        // Pack the setpoint and gyro into one complex signal so a single transform does the work of two
+        zr[i] = setpoint * task->hann[i];
+        zi[i] = readDecimated(samples, task->decimation, i, STEP_RESPONSE_AXES + axis) * task->hann[i];
+    }
+
+    if (variance <= 0)
+        return false;
+
+    // Zero-pad so that the part of the response we keep isn't polluted by circular wrap-around
+    for (int i = task->windowLength; i < size; i++) {
+        zr[i] = 0;
+        zi[i] = 0;
+    }
+
+    fftForward(task->plan, zr, zi);
+
+    /*
+     * Since both signals are real, the setpoint spectrum is X[k] = (Z[k] + conj(Z[N-k])) / 2 and the gyro spectrum
+     * is Y[k] = (Z[k] - conj(Z[N-k])) / 2i.
+     */
+    for (int i = 0; i < size; i++) {
+        int mirror = (size - i) & (size - 1);
+        double xr = (zr[i] + zr[mirror]) / 2, xi = (zi[i] - zi[mirror]) / 2;
+
+        power += xr * xr + xi * xi;
+    }
+
+    regularisation = STEP_RESPONSE_REGULARISATION * power / size;
+
+    // H = Y * conj(X) / (|X|^2 + noise)
+    for (int i = 0; i < size; i++) {
+        int mirror = (size - i) & (size - 1);
+        double xr = (zr[i] + zr[mirror]) / 2, xi = (zi[i] - zi[mirror]) / 2;
+        double yr = (zi[i] + zi[mirror]) / 2, yi = (zr[mirror] - zr[i]) / 2;
+        double denominator = xr * xr + xi * xi + regularisation;
+
+        hr[i] = (yr * xr + yi * xi) / denominator;
+        hi[i] = (yi * xr - yr * xi) / denominator;
+    }
+
+    fftInverse(task->plan, hr, hi);
+
+    accumulator = 0;
+    for (int i = 0; i < task->responseLength; i++) {
+        accumulator += hr[i];
+        step[i] = accumulator;
+    }
+
+    *weight = sqrt(variance / task->windowLength);
+
+    return true;
+}
+
+static void* stepResponseWorkerThread(void *arg)
+{
+    stepResponseTask_t *task = (stepResponseTask_t *) arg;
+    int size = fftPlanGetSize(task->plan);
+
+    double *zr = malloc(size * sizeof(*zr));
+    double *zi = malloc(size * sizeof(*zi));
+    double *hr = malloc(size * sizeof(*hr));
+    double *hi = malloc(size * sizeof(*hi));
+    double *step = malloc(task->responseLength * sizeof(*step));
+
+    for (int window = task->firstWindow; window < task->lastWindow; window++) {
+        for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+            double weight;
+
+            if (computeWindowResponse(task, task->windowStart[window], axis, zr, zi, hr, hi, step, &weight)) {
+                for (int i = 0; i < task->responseLength; i++) {
+                    task->sum[axis][i] += step[i] * weight;
+                }
+
+                task->weight[axis] += weight;
+                task->windowCount[axis]++;
+            }
+        }
+    }
+
+    free(zr);
+    free(zi);
+    free(hr);
+    free(hi);
+    free(step);
+
+    semaphore_signal(task->done);
+
+    return 0;
+}
+
+/**
+ * Normalise the response so its steady-state is 1.0 and measure its rise time and overshoot.
+ */
+static void analyseResponse(stepResponseAxis_t *axis, int length, int steadyStateStart, double sampleIntervalMs)
+{
+    double steadyState = 0, peak;
+    int peakIndex = 0, riseStart = -1, riseEnd = -1;
+
+    for (int i = steadyStateStart; i < length; i++) {
+        steadyState += axis->response[i];
+    }
+    steadyState /= length - steadyStateStart;
+
+    if (fabs(steadyState) < 1e-9) {
+        free(axis->response);
+        axis->response = NULL;
+        return;
+    }
+
+    // Also corrects the sign if the gyro's axis is oriented opposite to the stick
+    for (int i = 0; i < length; i++) {
+        axis->response[i] /= steadyState;
+    }
+
+    peak = axis->response[0];
+
+    for (int i = 0; i < length; i++) {
+        if (riseStart == -1 && axis->response[i] >= 0.1)
+            riseStart = i;
+        if (riseEnd == -1 && axis->response[i] >= 0.9)
+            riseEnd = i;
+
+        if (axis->response[i] > peak) {
+            peak = axis->response[i];
+            peakIndex = i;
+        }
+    }
+
+    axis->riseTimeMs = riseStart != -1 && riseEnd != -1 ? (riseEnd - riseStart) * sampleIntervalMs : NAN;
+    axis->peakTimeMs = peakIndex * sampleIntervalMs;
+    axis->overshootPercent = peak > 1 ? (peak - 1) * 100 : 0;
+}
+
+/**
+ * Estimate the step response of each axis from the samples collected so far, dividing the work between the given
+ * number of threads. Returns false if the log doesn't contain enough regularly-timed data to analyse.
+ *
+ * Free the result with stepResponseFree().
+ */
+bool stepResponseCompute(stepResponseLog_t *log, int threads, stepResponse_t *result)
+{
+    double sampleInterval;
+    int decimation, windowLength, windowHop, responseLength, steadyStateStart, fftSize;
+    int *windowStart, windowCount = 0;
+    fftPlan_t *plan;
+    double *hann;
+    stepResponseTask_t *tasks;
+    semaphore_t done;
+
+    memset(result, 0, sizeof(*result));
+
+    if (log->intervalCount == 0)
+        return false;
+
+    sampleInterval = (double) log->intervalTotal / log->intervalCount;
+
+    decimation = (int) (STEP_RESPONSE_MIN_SAMPLE_INTERVAL_MICROS / sampleInterval);
+    if (decimation < 1)
+        decimation = 1;
+
+    // The window hop is in logged samples, the other lengths are in decimated samples
+    windowHop = (int) (STEP_RESPONSE_HOP_MICROS / sampleInterval);
+
+    sampleInterval *= decimation;
+
+    windowLength = (int) (STEP_RESPONSE_WINDOW_MICROS / sampleInterval);
+    responseLength = (int) (STEP_RESPONSE_LENGTH_MICROS / sampleInterval);
+    steadyStateStart = (int) ((STEP_RESPONSE_LENGTH_MICROS - STEP_RESPONSE_STEADY_STATE_MICROS) / sampleInterval);
+
+    if (windowHop < 1 || responseLength <= steadyStateStart)
+        return false;
+
+    for (fftSize = 1; fftSize < windowLength + responseLength; fftSize *= 2)
+        ;
+
+    // Carve each segment of the log into overlapping windows
+    windowStart = malloc((log->sampleCount / windowHop + log->segmentCount + 1) * sizeof(*windowStart));
+
+    for (int segment = 0; segment < log->segmentCount; segment++) {
+        int segmentEnd = segment + 1 < log->segmentCount ? log->segmentStart[segment + 1] : log->sampleCount;
+
+        for (int start = log->segmentStart[segment]; start + windowLength * decimation <= segmentEnd; start += windowHop) {
+            windowStart[windowCount++] = start;
+        }
+    }
+
+    if (windowCount == 0) {
+        free(windowStart);
+        return false;
+    }
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > windowCount)
+        threads = windowCount;
+
+    plan = fftPlanCreate(fftSize);
+
+    hann = malloc(windowLength * sizeof(*hann));
+    fftHannWindow(hann, windowLength);
+
+    semaphore_create(&done, 0);
+
+    tasks = calloc(threads, sizeof(*tasks));
+
+    for (int i = 0; i < threads; i++) {
+        stepResponseTask_t *task = &tasks[i];
+
+        task->log = log;
+        task->windowStart = windowStart;
+        task->firstWindow = (int) ((int64_t) windowCount * i / threads);
+        task->lastWindow = (int) ((int64_t) windowCount * (i + 1) / threads);
+        task->decimation = decimation;
+        task->windowLength = windowLength;
+        task->responseLength = responseLength;
+        task->plan = plan;
+        task->hann = hann;
+        task->done = &done;
+
+        for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+            task->sum[axis] = calloc(responseLength, sizeof(*task->sum[axis]));
+        }
+
+        thread_create_detached(stepResponseWorkerThread, task);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        semaphore_wait(&done);
+    }
+
+    semaphore_destroy(&done);
+
+    result->length = responseLength;
+    result->sampleIntervalMs = sampleInterval / 1000;
+
+    for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+        stepResponseAxis_t *axisResult = &result->axis[axis];
+        double weight = 0;
+
+        for (int i = 0; i < threads; i++) {
+            axisResult->windowCount += tasks[i].windowCount[axis];
+            weight += tasks[i].weight[axis];
+        }
+
+        if (axisResult->windowCount > 0) {
+            axisResult->response = calloc(responseLength, sizeof(*axisResult->response));
+
+            for (int i = 0; i < threads; i++) {
+                for (int j = 0; j < responseLength; j++) {
+                    axisResult->response[j] += tasks[i].sum[axis][j] / weight;
+                }
+            }
+
+            analyseResponse(axisResult, responseLength, steadyStateStart, result->sampleIntervalMs);
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+            free(tasks[i].sum[axis]);
+        }
+    }
+
+    free(tasks);
+    free(hann);
+    free(windowStart);
+    fftPlanDestroy(plan);
+
+    return true;
+}
+
+void stepResponseFree(stepResponse_t *result)
+{
+    for (int axis = 0; axis < STEP_RESPONSE_AXES; axis++) {
+        free(result->axis[axis].response);
+        result->axis[axis].response = NULL;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef STEPRESPONSE_H_
+#define STEPRESPONSE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STEP_RESPONSE_AXES 3
+
+typedef struct stepResponseLog_t stepResponseLog_t;
+
+typedef struct stepResponseAxis_t {
+    // Number of windows that had enough stick activity to contribute to the response
+    int windowCount;
+
+    // Step response normalised so that 1.0 is the steady-state, or NULL if no windows were usable
+    double *response;
+
+    // Time to go from 10% to 90% of the steady-state, time of the peak, and size of the peak above steady-state
+    double riseTimeMs, peakTimeMs, overshootPercent;
+} stepResponseAxis_t;
+
+typedef struct stepResponse_t {
+    // Number of points in each response curve, and the time between them
+    int length;
+    double sampleIntervalMs;
+
+    stepResponseAxis_t axis[STEP_RESPONSE_AXES];
+} stepResponse_t;
+
+stepResponseLog_t *stepResponseLogCreate(void);
+void stepResponseLogDestroy(stepResponseLog_t *log);
+
+void stepResponseLogAddSample(stepResponseLog_t *log, int64_t time, const double setpoint[STEP_RESPONSE_AXES], const double gyro[STEP_RESPONSE_AXES]);
+void stepResponseLogAddGap(stepResponseLog_t *log);
+
+bool stepResponseCompute(stepResponseLog_t *log, int threads, stepResponse_t *result);
+void stepResponseFree(stepResponse_t *result);
+
+#endif
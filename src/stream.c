@@ -210,14 +210,85 @@ void streamByteAlign(mmapStream_t *stream)
 }
 
 mmapStream_t* streamCreate(int fd)
+{
+    return streamCreateWithBackend(fd, IO_BACKEND_AUTO, false);
+}
+
+/**
+ * Create a stream for the file `fd`, bringing it into memory using the given backend (or one chosen to suit the
+ * filesystem for IO_BACKEND_AUTO). Devices and empty files are always mapped.
+ *
+ * With a buffered backend the file is still arriving after this returns, use streamWaitForData() before examining it.
+ */
+mmapStream_t* streamCreateWithBackend(int fd, ioBackend_e backend, bool hugePages)
 {
     mmapStream_t *result = malloc(sizeof(*result));
+    struct stat stats;
+
+    result->loader = NULL;
+    result->follower = NULL;
+
+    if (fd >= 0 && fstat(fd, &stats) == 0 && (stats.st_mode & S_IFMT) == S_IFREG && stats.st_size > 0) {
+        if (backend == IO_BACKEND_AUTO) {
+            backend = ioBackendChoose(fd);
+        }
+
+        if (backend != IO_BACKEND_MMAP) {
+            result->loader = ioLoaderCreate(fd, stats.st_size, backend, hugePages);
+        }
+    }
+
+    if (result->loader) {
+        result->backend = ioLoaderBackend(result->loader);
+
+        result->mapping.fd = fd;
+        result->mapping.stats = stats;
+        result->mapping.data = ioLoaderBuffer(result->loader);
+        result->mapping.size = stats.st_size;
+    } else {
+        result->backend = IO_BACKEND_MMAP;
+
+        if (!ioMapFile(&result->mapping, fd, hugePages)) {
+            free(result);
+            return 0;
+        }
+    }
+
+    result->data   = result->mapping.data;
+    result->size   = result->mapping.size;
+    result->start  = result->mapping.data;
+    result->pos    = result->mapping.data;
+    result->bitPos = CHAR_BIT - 1;
+    result->end    = result->mapping.data + result->mapping.size;
+    result->eof    = false;
+
+    return result;
+}
+
+/**
+ * Create a stream for the file `fd` which is still being written, beginning with the part written so far. Use
+ * streamFollow() to wait for more of it to arrive.
+ */
+mmapStream_t* streamCreateFollowing(int fd, int idleTimeoutMS)
+{
+    mmapStream_t *result;
+    ioFollower_t *follower = ioFollowerCreate(fd, idleTimeoutMS);
 
-    if (!mmap_file(&result->mapping, fd)) {
-        free(result);
+    if (!follower) {
         return 0;
     }
 
+    result = malloc(sizeof(*result));
+
+    result->loader = NULL;
+    result->follower = follower;
+    result->backend = IO_BACKEND_MMAP;
+
+    result->mapping.fd = fd;
+    fstat(fd, &result->mapping.stats);
+    result->mapping.data = ioFollowerBuffer(follower);
+    result->mapping.size = ioFollowerSize(follower);
+
     result->data   = result->mapping.data;
     result->size   = result->mapping.size;
     result->start  = result->mapping.data;
@@ -229,8 +300,53 @@ mmapStream_t* streamCreate(int fd)
     return result;
 }
 
+/**
+ * Wait for the file being followed to grow, and extend the stream's data to cover the new part. The stream's end is
+ * left for the caller to move. Returns false if the file won't be growing any more.
+ */
+bool streamFollow(mmapStream_t *stream)
+{
+    if (!stream->follower || !ioFollowerWait(stream->follower)) {
+        return false;
+    }
+
+    stream->size = ioFollowerSize(stream->follower);
+    stream->mapping.size = stream->size;
+
+    return true;
+}
+
 void streamDestroy(mmapStream_t *stream)
 {
-    munmap_file(&stream->mapping);
+    if (stream->follower) {
+        ioFollowerDestroy(stream->follower);
+    } else if (stream->loader) {
+        ioLoaderDestroy(stream->loader);
+    } else {
+        munmap_file(&stream->mapping);
+    }
     free(stream);
 }
+
+/**
+ * Wait until at least the first `length` bytes of the stream's data are in memory, and return the number of bytes
+ * which are available. If the file couldn't be read completely, the stream's size is reduced to the part that could.
+ */
+size_t streamWaitForData(mmapStream_t *stream, size_t length)
+{
+    size_t available, size;
+
+    if (!stream->loader) {
+        return stream->size;
+    }
+
+    available = ioLoaderWait(stream->loader, length);
+    size = ioLoaderSize(stream->loader);
+
+    if (size < stream->size) {
+        stream->size = size;
+        stream->end = stream->data + size;
+    }
+
+    return available < stream->size ? available : stream->size;
+}
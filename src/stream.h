@@ -2,10 +2,19 @@
 #define STREAM_H_
 
 #include "platform.h"
+#include "iobackend.h"
+#include "iofollow.h"
 
 typedef struct mmapStream_t {
     fileMapping_t mapping;
 
+    //How the file is being brought into memory, and the loader which is reading it in the background (if any)
+    ioBackend_e backend;
+    ioLoader_t *loader;
+
+    //When following a file that is still being written, the follower which extends the data as the file grows
+    ioFollower_t *follower;
+
     //The start of the entire data block
     const char *data;
 
@@ -30,8 +39,13 @@ typedef enum ParserState {
 
 void fillSerialBuffer(mmapStream_t *stream,size_t bytesParsedDataSize, ParserState *parserState);
 mmapStream_t* streamCreate(int fd);
+mmapStream_t* streamCreateWithBackend(int fd, ioBackend_e backend, bool hugePages);
+mmapStream_t* streamCreateFollowing(int fd, int idleTimeoutMS);
 void streamDestroy(mmapStream_t *stream);
 
+size_t streamWaitForData(mmapStream_t *stream, size_t length);
+bool streamFollow(mmapStream_t *stream);
+
 int streamPeekChar(mmapStream_t *stream);
 char streamReadChar(mmapStream_t *stream);
 int streamReadByte(mmapStream_t *stream);
@@ -123,11 +123,86 @@ void* memmem(const void *haystack, size_t haystackLen, const void *needle, size_
         const char* c_haystack = (char*)haystack;
         const char* c_needle = (char*)needle;
 
-        for (const char *pos = c_haystack; pos <= c_haystack + haystackLen - needleLen; pos++) {
-            if (*pos == *c_needle && memcmp(pos, c_needle, needleLen) == 0)
+        const char *last = c_haystack + haystackLen - needleLen;
+
+        // Let memchr skip ahead to each candidate first byte, since logs can be gigabytes long
+        for (const char *pos = c_haystack; pos <= last; pos++) {
+            pos = memchr(pos, *c_needle, last - pos + 1);
+
+            if (!pos)
+                break;
+
+            if (memcmp(pos, c_needle, needleLen) == 0)
                 return (void*)pos;
         }
     }
 
     return NULL;
 }
+
+/**
+ * Print the first `length` bytes of the string as a quoted JSON string. Anything outside of printable ASCII is escaped
+ * as the Latin-1 character of the same value.
+ */
+void fprintJSONString(FILE *file, const char *string, size_t length)
+{
+    fputc('"', file);
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = string[i];
+
+        if (c == '"' || c == '\\') {
+            fprintf(file, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7F) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+
+    fputc('"', file);
+}
+
+/**
+ * Print the "H name:value" header lines at the beginning of a log as a JSON object, with its members indented by
+ * `indent` spaces.
+ */
+void fprintHeaderLinesJSON(FILE *file, const char *logStart, const char *logEnd, int indent)
+{
+    bool first = true;
+
+    fprintf(file, "{");
+
+    for (const char *line = logStart; logEnd - line >= 2 && line[0] == 'H' && line[1] == ' '; ) {
+        const char *lineEnd = memchr(line, '\n', logEnd - line);
+        const char *separator;
+
+        if (!lineEnd)
+            break;
+
+        separator = memchr(line + 2, ':', lineEnd - (line + 2));
+
+        if (separator) {
+            const char *valueEnd = lineEnd;
+
+            if (valueEnd > separator + 1 && valueEnd[-1] == '\r') {
+                valueEnd--;
+            }
+
+            fprintf(file, "%s\n%*s", first ? "" : ",", indent, "");
+            fprintJSONString(file, line + 2, separator - (line + 2));
+            fprintf(file, ": ");
+            fprintJSONString(file, separator + 1, valueEnd - (separator + 1));
+
+            first = false;
+        }
+
+        line = lineEnd + 1;
+    }
+
+    if (first) {
+        fprintf(file, "}");
+    } else {
+        fprintf(file, "\n%*s}", indent - 2, "");
+    }
+}
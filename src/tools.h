@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 #define ARRAY_LENGTH(x) (sizeof((x))/sizeof((x)[0]))
 
@@ -39,4 +41,7 @@ bool endsWith(const char *string, const char *checkEndsWith);
 
 void* memmem(const void *haystack, size_t haystackLen, const void *needle, size_t needleLen);
 
+void fprintJSONString(FILE *file, const char *string, size_t length);
+void fprintHeaderLinesJSON(FILE *file, const char *logStart, const char *logEnd, int indent);
+
 #endif
@@ -0,0 +1,315 @@
+#!/usr/bin/env python3
+"""
+Generates a synthetic Cleanflight-style blackbox log: a quad with four motors which flies a series of random setpoints,
+with a gyro that follows them through a second-order response plus noise and a 180Hz vibration.
+
+synthetic.bbl in this directory (used by the tests and as the training log for "make pgo") was made with the defaults:
+
+    python3 genlog.py synthetic.bbl
+"""
+import argparse
+import math
+import random
+
+MOTORS = 4
+MINTHROTTLE = 1150
+VBATREF = 3000
+I_INTERVAL = 32
+
+NAMES = (["loopIteration", "time"] + ["axisP[%d]" % i for i in range(3)] + ["axisI[%d]" % i for i in range(3)]
+         + ["axisD[%d]" % i for i in range(3)] + ["rcCommand[%d]" % i for i in range(4)] + ["vbatLatest"]
+         + ["gyroADC[%d]" % i for i in range(3)] + ["accSmooth[%d]" % i for i in range(3)]
+         + ["motor[%d]" % i for i in range(MOTORS)])
+SIGNED = [0, 0] + [1] * 9 + [1, 1, 1, 0] + [0] + [1] * 6 + [0] * MOTORS
+
+# Predictors: 0 none, 1 previous, 2 straight line, 3 average of two, 4 minthrottle, 5 motor[0], 6 increment, 9 vbatref
+I_PREDICTOR = [0, 0] + [0] * 9 + [0, 0, 0, 4] + [9] + [0] * 6 + [4] + [5] * (MOTORS - 1)
+P_PREDICTOR = [6, 2] + [1] * 9 + [1] * 4 + [1] + [3] * 6 + [3] * MOTORS
+
+# Encodings: 0 signed VB, 1 unsigned VB, 3 negative 14-bit, 6 TAG8_8SVB, 7 TAG2_3S32, 8 TAG8_4S16, 9 null
+I_ENCODING = [1, 1] + [0] * 9 + [0, 0, 0, 1] + [3] + [0] * 6 + [1] + [0] * (MOTORS - 1)
+P_ENCODING = [9, 0] + [0] * 3 + [7] * 3 + [6] * 3 + [8] * 4 + [0] + [0] * 6 + [0] * MOTORS
+
+
+def unsigned_vb(value):
+    value &= 0xFFFFFFFF
+    result = bytearray()
+
+    while value > 127:
+        result.append((value & 0x7F) | 0x80)
+        value >>= 7
+
+    result.append(value)
+
+    return bytes(result)
+
+
+def signed_vb(value):
+    # ZigZag encode the value so small negative numbers are small too
+    return unsigned_vb(((value << 1) ^ (value >> 31)) & 0xFFFFFFFF)
+
+
+def tag2_3s32(values):
+    if all(-2 <= v <= 1 for v in values):
+        return bytes([(0 << 6) | ((values[0] & 3) << 4) | ((values[1] & 3) << 2) | (values[2] & 3)])
+
+    if all(-8 <= v <= 7 for v in values):
+        return bytes([(1 << 6) | (values[0] & 0xF), ((values[1] & 0xF) << 4) | (values[2] & 0xF)])
+
+    if all(-32 <= v <= 31 for v in values):
+        return bytes([(2 << 6) | (values[0] & 0x3F), values[1] & 0x3F, values[2] & 0x3F])
+
+    selector = 0
+    body = bytearray()
+
+    for i, v in enumerate(values):
+        if -128 <= v <= 127:
+            size = 0
+        elif -32768 <= v <= 32767:
+            size = 1
+        elif -8388608 <= v <= 8388607:
+            size = 2
+        else:
+            size = 3
+
+        selector |= size << (i * 2)
+        body += (v & ((1 << (8 * (size + 1))) - 1)).to_bytes(size + 1, "little")
+
+    return bytes([(3 << 6) | selector]) + bytes(body)
+
+
+def tag8_4s16(values):
+    """The data version 2 layout, with the fields packed into nibbles."""
+    selector = 0
+    nibbles = []
+
+    for i, v in enumerate(values):
+        if v == 0:
+            size = 0
+        elif -8 <= v <= 7:
+            size = 1
+            nibbles.append(v & 0xF)
+        elif -128 <= v <= 127:
+            size = 2
+            nibbles += [(v >> 4) & 0xF, v & 0xF]
+        else:
+            size = 3
+            nibbles += [(v >> 12) & 0xF, (v >> 8) & 0xF, (v >> 4) & 0xF, v & 0xF]
+
+        selector |= size << (i * 2)
+
+    if len(nibbles) % 2:
+        nibbles.append(0)
+
+    return bytes([selector]) + bytes((nibbles[i] << 4) | nibbles[i + 1] for i in range(0, len(nibbles), 2))
+
+
+def tag8_8svb(values):
+    if len(values) == 1:
+        return signed_vb(values[0])
+
+    header = 0
+    body = bytearray()
+
+    for i, v in enumerate(values):
+        if v != 0:
+            header |= 1 << i
+            body += signed_vb(v)
+
+    return bytes([header]) + bytes(body)
+
+
+def log_header():
+    lines = [
+        "Product:Blackbox flight data recorder by Nicholas Sherlock",
+        "Data version:2",
+        "I interval:%d" % I_INTERVAL,
+        "P interval:1/1",
+        "Firmware type:Cleanflight",
+        "Firmware revision:synthetic",
+        "Field I name:" + ",".join(NAMES),
+        "Field I signed:" + ",".join(map(str, SIGNED)),
+        "Field I predictor:" + ",".join(map(str, I_PREDICTOR)),
+        "Field I encoding:" + ",".join(map(str, I_ENCODING)),
+        "Field P predictor:" + ",".join(map(str, P_PREDICTOR)),
+        "Field P encoding:" + ",".join(map(str, P_ENCODING)),
+        "Field S name:flightModeFlags,stateFlags,failsafePhase",
+        "Field S signed:0,0,0",
+        "Field S predictor:0,0,0",
+        "Field S encoding:1,1,1",
+        "minthrottle:%d" % MINTHROTTLE,
+        "maxthrottle:1850",
+        "rcRate:100",
+        "vbatscale:110",
+        "vbatref:%d" % VBATREF,
+        "vbatcellvoltage:33,35,43",
+        "gyro.scale:0x3c8f5c29",
+        "acc_1G:4096",
+        "features:0",
+    ]
+
+    return "".join("H " + line + "\n" for line in lines).encode()
+
+
+def average_of_two(a, b):
+    # Rounded towards zero, like the decoder's integer division
+    total = a + b
+
+    return total // 2 if total >= 0 else -(-total // 2)
+
+
+def encode_frame(frame_type, current, previous, previous2):
+    encoding = I_ENCODING if frame_type == "I" else P_ENCODING
+    predictor = I_PREDICTOR if frame_type == "I" else P_PREDICTOR
+    residuals = []
+
+    for i, value in enumerate(current):
+        p = predictor[i]
+
+        if p == 0:
+            residuals.append(value)
+        elif p == 1:
+            residuals.append(value - previous[i])
+        elif p == 2:
+            residuals.append(value - (2 * previous[i] - previous2[i]))
+        elif p == 3:
+            residuals.append(value - average_of_two(previous[i], previous2[i]))
+        elif p == 4:
+            residuals.append(value - MINTHROTTLE)
+        elif p == 5:
+            residuals.append(value - current[NAMES.index("motor[0]")])
+        elif p == 6:
+            residuals.append(None)
+        elif p == 9:
+            residuals.append(value - VBATREF)
+
+    result = bytearray(frame_type.encode())
+    i = 0
+
+    while i < len(current):
+        e = encoding[i]
+
+        if predictor[i] == 6 or e == 9:
+            # Not stored, the decoder works it out
+            i += 1
+        elif e == 0:
+            result += signed_vb(residuals[i])
+            i += 1
+        elif e == 1:
+            result += unsigned_vb(residuals[i])
+            i += 1
+        elif e == 3:
+            result += unsigned_vb((-residuals[i]) & 0x3FFF)
+            i += 1
+        elif e == 7:
+            result += tag2_3s32(residuals[i:i + 3])
+            i += 3
+        elif e == 8:
+            result += tag8_4s16(residuals[i:i + 4])
+            i += 4
+        elif e == 6:
+            group_end = i + 1
+
+            while group_end < i + 8 and group_end < len(current) and encoding[group_end] == 6:
+                group_end += 1
+
+            result += tag8_8svb(residuals[i:group_end])
+            i = group_end
+        else:
+            raise ValueError("Unsupported encoding %d" % e)
+
+    return bytes(result)
+
+
+def generate_log(data, log_index, rate, seconds, rnd):
+    frame_count = int(rate * seconds)
+    frame_interval = 1e6 / rate
+    start_time = 1000000 + log_index * 10000000
+
+    setpoint = [0, 0, 0]
+    next_setpoint = 0
+    # Position and velocity of the gyro's response to the setpoint on each axis
+    response = [0.0] * 3
+    velocity = [0.0] * 3
+    setpoint_history = [[0] * 64 for _ in range(3)]
+    integral = [0, 0, 0]
+    previous = previous2 = None
+
+    data += log_header()
+    data += b"S" + unsigned_vb(0) + unsigned_vb(0) + unsigned_vb(0)
+    data += b"E" + bytes([0]) + unsigned_vb(start_time + 500)
+
+    for iteration in range(frame_count):
+        time = int(start_time + iteration * frame_interval + rnd.randint(-3, 3))
+
+        if iteration >= next_setpoint:
+            setpoint = [rnd.randint(-300, 300), rnd.randint(-300, 300), rnd.randint(-200, 200)]
+            next_setpoint = iteration + int(rate * rnd.uniform(0.2, 0.5))
+
+        gyro = []
+
+        for axis in range(3):
+            setpoint_history[axis][iteration % 64] = setpoint[axis]
+
+            # The craft responds 4ms late, as a 12Hz damped spring
+            delay = int(0.004 * rate)
+            target = setpoint_history[axis][(iteration - delay) % 64] if iteration >= delay else 0
+            omega = 2 * math.pi * 12
+            damping = 0.5
+
+            acceleration = omega * omega * (target * 1.5 - response[axis]) - 2 * damping * omega * velocity[axis]
+            velocity[axis] += acceleration / rate
+            response[axis] += velocity[axis] / rate
+
+            gyro.append(int(response[axis] + rnd.gauss(0, 3) + 20 * math.sin(2 * math.pi * 180 * iteration / rate)))
+
+        throttle = 1400 + int(100 * math.sin(iteration / rate))
+        error = [setpoint[axis] - gyro[axis] for axis in range(3)]
+        integral = [max(-500, min(500, integral[axis] + error[axis] // 50)) for axis in range(3)]
+        pterm = [e // 2 for e in error]
+        dterm = [rnd.randint(-20, 20) for _ in range(3)]
+
+        motors = [throttle + pterm[0] - pterm[1], throttle - pterm[0] - pterm[1], throttle + pterm[0] + pterm[1],
+                  throttle - pterm[0] + pterm[1]]
+        motors = [max(MINTHROTTLE, min(1850, m)) for m in motors]
+
+        vbat = VBATREF - iteration // 1000
+        acc = [rnd.randint(-30, 30), rnd.randint(-30, 30), 4096 + rnd.randint(-30, 30)]
+
+        current = [iteration, time] + pterm + integral + dterm + setpoint + [throttle, vbat] + gyro + acc + motors[:MOTORS]
+
+        if iteration % I_INTERVAL == 0 or previous is None:
+            data += encode_frame("I", current, previous, previous2)
+            previous2 = current
+        else:
+            data += encode_frame("P", current, previous, previous2)
+            previous2 = previous
+
+        previous = current
+
+        if iteration % 5000 == 2500:
+            data += b"S" + unsigned_vb(1) + unsigned_vb(2) + unsigned_vb(0)
+
+    data += b"E" + bytes([255]) + b"End of log\0"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output")
+    parser.add_argument("--rate", type=float, default=1000, help="loop rate in Hz (default 1000)")
+    parser.add_argument("--seconds", type=float, default=5, help="length of each log (default 5)")
+    parser.add_argument("--logs", type=int, default=1, help="number of logs in the file (default 1)")
+    parser.add_argument("--seed", type=int, default=3, help="random seed (default 3)")
+    args = parser.parse_args()
+
+    rnd = random.Random(args.seed)
+    data = bytearray()
+
+    for log_index in range(args.logs):
+        generate_log(data, log_index, args.rate, args.seconds, rnd)
+
+    with open(args.output, "wb") as output:
+        output.write(data)
+
+
+main()
@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <zlib.h>
+
+#include "../src/platform.h"
+#include "../src/compressedfile.h"
+
+/*
+ * Write text through a gzip compressed file and check that it decompresses (as one stream made of many gzip members)
+ * back to exactly what was written.
+ */
+
+#define TEST_FILENAME "test_compressedfile.csv.gz"
+
+static char* makeText(size_t length)
+{
+	char *text = malloc(length);
+	uint32_t state = 1;
+
+	for (size_t i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		text[i] = (i % 80 == 79) ? '\n' : "0123456789, -"[(state >> 16) % 13];
+	}
+
+	return text;
+}
+
+static void checkRoundTrip(const char *text, size_t length, int threads, size_t writeLength)
+{
+	FILE *file = compressedFileOpen(TEST_FILENAME, COMPRESSION_GZIP, threads);
+	char *readBack = malloc(length + 1);
+	gzFile gz;
+	int readLength, result;
+	size_t written;
+
+	assert(file);
+
+	for (size_t i = 0; i < length; i += writeLength) {
+		size_t chunk = length - i < writeLength ? length - i : writeLength;
+
+		written = fwrite(text + i, 1, chunk, file);
+		assert(written == chunk);
+	}
+
+	result = fclose(file);
+	assert(result == 0);
+
+	gz = gzopen(TEST_FILENAME, "rb");
+	assert(gz);
+
+	readLength = gzread(gz, readBack, length + 1);
+
+	assert(readLength == (int) length);
+	assert(memcmp(readBack, text, length) == 0);
+	// The trailing member must be complete
+	result = gzclose(gz);
+	assert(result == Z_OK);
+	(void) result;
+	(void) written;
+
+	free(readBack);
+	remove(TEST_FILENAME);
+}
+
+int main(void)
+{
+	size_t length = 5 * 1024 * 1024 + 12345;
+	char *text = makeText(length);
+
+	platform_init();
+
+	assert(compressionFormatAvailable(COMPRESSION_GZIP));
+
+	checkRoundTrip(text, 0, 1, 1);
+	checkRoundTrip(text, 100, 1, 7);
+	checkRoundTrip(text, length, 1, 4096);
+	checkRoundTrip(text, length, 3, 100000);
+	checkRoundTrip(text, length, 8, 3 * 1024 * 1024);
+
+	free(text);
+
+	printf("Done\n");
+
+	return 0;
+}
@@ -0,0 +1,286 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/decoders.h"
+#include "../src/tools.h"
+
+/*
+ * The tag decoders look up each group's layout by its selector. Check them against straightforward byte-by-byte
+ * reference decoders for every selector, with random payloads, both far from the end of the stream and with the group
+ * cut short by the end of the stream.
+ */
+
+#define PAYLOADS_PER_SELECTOR 64
+#define BUFFER_LENGTH 32
+
+typedef void (*tagDecoder_t)(mmapStream_t *stream, int64_t *values);
+
+static uint32_t randomState = 1;
+
+static uint8_t randomByte(void)
+{
+	randomState = randomState * 1103515245 + 12345;
+	return randomState >> 16;
+}
+
+static void initStream(mmapStream_t *stream, const uint8_t *data, size_t length)
+{
+	memset(stream, 0, sizeof(*stream));
+
+	stream->data = stream->start = stream->pos = (const char *) data;
+	stream->size = length;
+	stream->end = stream->data + length;
+}
+
+static void referenceReadTag2_3S32(mmapStream_t *stream, int64_t *values)
+{
+	uint8_t leadByte;
+	uint8_t byte1, byte2, byte3, byte4;
+	int i;
+
+	leadByte = streamReadByte(stream);
+
+	// Check the selector in the top two bits to determine the field layout
+	switch (leadByte >> 6) {
+		case 0:
+			// 2-bit fields
+			values[0] = signExtend2Bit((leadByte >> 4) & 0x03);
+			values[1] = signExtend2Bit((leadByte >> 2) & 0x03);
+			values[2] = signExtend2Bit(leadByte & 0x03);
+		break;
+		case 1:
+			// 4-bit fields
+			values[0] = signExtend4Bit(leadByte & 0x0F);
+
+			leadByte = streamReadByte(stream);
+
+			values[1] = signExtend4Bit(leadByte >> 4);
+			values[2] = signExtend4Bit(leadByte & 0x0F);
+		break;
+		case 2:
+			// 6-bit fields
+			values[0] = signExtend6Bit(leadByte & 0x3F);
+
+			leadByte = streamReadByte(stream);
+			values[1] = signExtend6Bit(leadByte & 0x3F);
+
+			leadByte = streamReadByte(stream);
+			values[2] = signExtend6Bit(leadByte & 0x3F);
+		break;
+		case 3:
+			// Fields are 8, 16 or 24 bits, read selector to figure out which field is which size
+
+			for (i = 0; i < 3; i++) {
+				switch (leadByte & 0x03) {
+					case 0: // 8-bit
+						byte1 = streamReadByte(stream);
+
+						// Sign extend to 32 bits
+						values[i] = (int8_t) (byte1);
+					break;
+					case 1: // 16-bit
+						byte1 = streamReadByte(stream);
+						byte2 = streamReadByte(stream);
+
+						// Sign extend to 32 bits
+						values[i] = (int16_t) (byte1 | (byte2 << 8));
+					break;
+					case 2: // 24-bit
+						byte1 = streamReadByte(stream);
+						byte2 = streamReadByte(stream);
+						byte3 = streamReadByte(stream);
+
+						values[i] = signExtend24Bit(byte1 | (byte2 << 8) | (byte3 << 16));
+					break;
+					case 3: // 32-bit
+						byte1 = streamReadByte(stream);
+						byte2 = streamReadByte(stream);
+						byte3 = streamReadByte(stream);
+						byte4 = streamReadByte(stream);
+
+						// Sign-extend
+						values[i] = (int32_t) (byte1 | (byte2 << 8) | (byte3 << 16) | (byte4 << 24));
+					break;
+				}
+
+				leadByte >>= 2;
+			}
+		break;
+	}
+}
+
+static void referenceReadTag8_4S16_v1(mmapStream_t *stream, int64_t *values)
+{
+	uint8_t selector, combinedChar;
+	uint8_t char1, char2;
+	int i;
+
+	enum {
+		FIELD_ZERO  = 0,
+		FIELD_4BIT  = 1,
+		FIELD_8BIT  = 2,
+		FIELD_16BIT = 3
+	};
+
+	selector = streamReadByte(stream);
+
+	//Read the 4 values from the stream
+	for (i = 0; i < 4; i++) {
+		switch (selector & 0x03) {
+			case FIELD_ZERO:
+				values[i] = 0;
+			break;
+			case FIELD_4BIT: // Two 4-bit fields
+				combinedChar = (uint8_t) streamReadByte(stream);
+
+				values[i] = signExtend4Bit(combinedChar & 0x0F);
+
+				i++;
+				selector >>= 2;
+
+				values[i] = signExtend4Bit(combinedChar >> 4);
+			break;
+			case FIELD_8BIT: // 8-bit field
+				//Sign extend...
+				values[i] = (int8_t) streamReadByte(stream);
+			break;
+			case FIELD_16BIT: // 16-bit field
+				char1 = streamReadByte(stream);
+				char2 = streamReadByte(stream);
+
+				//Sign extend...
+				values[i] = (int16_t) (char1 | (char2 << 8));
+			break;
+		}
+
+		selector >>= 2;
+	}
+}
+
+static void referenceReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
+{
+	uint8_t selector;
+	uint8_t char1, char2;
+	uint8_t buffer;
+	int nibbleIndex;
+
+	int i;
+
+	enum {
+		FIELD_ZERO  = 0,
+		FIELD_4BIT  = 1,
+		FIELD_8BIT  = 2,
+		FIELD_16BIT = 3
+	};
+
+	selector = streamReadByte(stream);
+
+	//Read the 4 values from the stream
+	nibbleIndex = 0;
+	for (i = 0; i < 4; i++) {
+		switch (selector & 0x03) {
+			case FIELD_ZERO:
+				values[i] = 0;
+			break;
+			case FIELD_4BIT:
+				if (nibbleIndex == 0) {
+					buffer = (uint8_t) streamReadByte(stream);
+					values[i] = signExtend4Bit(buffer >> 4);
+					nibbleIndex = 1;
+				} else {
+					values[i] = signExtend4Bit(buffer & 0x0F);
+					nibbleIndex = 0;
+				}
+			break;
+			case FIELD_8BIT:
+				if (nibbleIndex == 0) {
+					//Sign extend...
+					values[i] = (int8_t) streamReadByte(stream);
+				} else {
+					char1 = buffer << 4;
+					buffer = (uint8_t) streamReadByte(stream);
+
+					char1 |= buffer >> 4;
+					values[i] = (int8_t) char1;
+				}
+			break;
+			case FIELD_16BIT:
+				if (nibbleIndex == 0) {
+					char1 = (uint8_t) streamReadByte(stream);
+					char2 = (uint8_t) streamReadByte(stream);
+
+					//Sign extend...
+					values[i] = (int16_t) (uint16_t) ((char1 << 8) | char2);
+				} else {
+					/*
+					 * We're in the low 4 bits of the current buffer, then one byte, then the high 4 bits of the next
+					 * buffer.
+					 */
+					char1 = (uint8_t) streamReadByte(stream);
+					char2 = (uint8_t) streamReadByte(stream);
+
+					values[i] = (int16_t) (uint16_t) ((buffer << 12) | (char1 << 4) | (char2 >> 4));
+
+					buffer = char2;
+				}
+			break;
+		}
+
+		selector >>= 2;
+	}
+}
+
+static void compareDecoders(tagDecoder_t decoder, tagDecoder_t reference, const uint8_t *data, size_t length)
+{
+	mmapStream_t stream, referenceStream;
+	int64_t values[5], referenceValues[5];
+
+	initStream(&stream, data, length);
+	initStream(&referenceStream, data, length);
+
+	// Unwritten values must stay unwritten (the v1 decoder writes a fifth value for some selectors)
+	for (int i = 0; i < 5; i++) {
+		values[i] = referenceValues[i] = 0x5A5A5A5A5A5A5A5ALL;
+	}
+
+	decoder(&stream, values);
+	reference(&referenceStream, referenceValues);
+
+	assert(memcmp(values, referenceValues, sizeof(values)) == 0);
+	assert(stream.pos == referenceStream.pos);
+	assert(stream.eof == referenceStream.eof);
+}
+
+static void testDecoder(tagDecoder_t decoder, tagDecoder_t reference)
+{
+	uint8_t buffer[BUFFER_LENGTH];
+
+	for (int selector = 0; selector < 256; selector++) {
+		for (int payload = 0; payload < PAYLOADS_PER_SELECTOR; payload++) {
+			buffer[0] = selector;
+
+			for (int i = 1; i < BUFFER_LENGTH; i++) {
+				buffer[i] = randomByte();
+			}
+
+			for (size_t length = 0; length <= BUFFER_LENGTH; length++) {
+				compareDecoders(decoder, reference, buffer, length);
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	testDecoder(streamReadTag2_3S32, referenceReadTag2_3S32);
+	testDecoder(streamReadTag8_4S16_v1, referenceReadTag8_4S16_v1);
+	testDecoder(streamReadTag8_4S16_v2, referenceReadTag8_4S16_v2);
+
+	printf("Done\n");
+
+	return 0;
+}
@@ -0,0 +1,320 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/parser.h"
+#include "../src/encoder.h"
+
+/*
+ * Decodes the main frames of a log, encodes them again with the encoder library and checks that they decode back to
+ * the same values. The frames are encoded once with the log's own field table, once with a table that puts the
+ * bit-level Elias encodings between the byte encodings, and once with a P interval of 1/2 and some frames missing, so
+ * the encoder has to write an I frame after each gap.
+ */
+
+#define MAX_FRAMES 100000
+
+// Small enough that frameEncoderWriteFrames() has to stop several times
+#define CHUNK_SIZE 4096
+
+// Runs of iterations left out of the 1/2 P interval round trip, as [first, last)
+static const int DROPPED_ITERATIONS[][2] = {
+	{100, 140}, // Includes an iteration which would have been an I frame
+	{1002, 1004},
+	{2010, 2012}
+};
+
+typedef struct decodedLog_t {
+	int fieldCount;
+	int frameCount;
+	int64_t *frames;
+	uint8_t *frameTypes;
+} decodedLog_t;
+
+static decodedLog_t *decoding;
+
+static void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+	(void) log;
+	(void) frameOffset;
+	(void) frameSize;
+
+	if (frameValid && (frameType == 'I' || frameType == 'P')) {
+		assert(decoding->frameCount < MAX_FRAMES);
+
+		decoding->fieldCount = fieldCount;
+		memcpy(decoding->frames + (size_t) decoding->frameCount * fieldCount, frame, fieldCount * sizeof(*frame));
+		decoding->frameTypes[decoding->frameCount] = frameType;
+		decoding->frameCount++;
+	}
+}
+
+static flightLog_t* decodeLog(FILE *file, decodedLog_t *decoded)
+{
+	flightLog_t *log = flightLogCreate(fileno(file));
+	bool parsed;
+
+	assert(log);
+	assert(log->logCount == 1);
+
+	decoded->frameCount = 0;
+	decoded->frames = malloc((size_t) MAX_FRAMES * FLIGHT_LOG_MAX_FIELDS * sizeof(*decoded->frames));
+	decoded->frameTypes = malloc(MAX_FRAMES * sizeof(*decoded->frameTypes));
+
+	decoding = decoded;
+
+	parsed = flightLogParse(log, 0, NULL, onFrameReady, NULL, false);
+	assert(parsed);
+	(void) parsed;
+
+	return log;
+}
+
+static void freeDecodedLog(decodedLog_t *decoded)
+{
+	free(decoded->frames);
+	free(decoded->frameTypes);
+}
+
+static void writeBuffer(encoderBuffer_t *buffer, FILE *file)
+{
+	size_t written = fwrite(buffer->data, 1, encoderBufferLength(buffer), file);
+
+	assert(written == encoderBufferLength(buffer));
+	(void) written;
+
+	buffer->pos = buffer->data;
+}
+
+/**
+ * Encode the frames with the given field table and P interval, and check that they decode to the same values. The
+ * frames that were decoded are left in `decoded`, for the caller to free.
+ */
+static void checkRoundTrip(const char *name, flightLog_t *original, const decodedLog_t *originalFrames, const encoderField_t *fields,
+	int pIntervalNum, int pIntervalDenom, decodedLog_t *decoded)
+{
+	uint8_t data[CHUNK_SIZE];
+	encoderBuffer_t buffer;
+	frameEncoder_t encoder;
+	flightLog_t *log;
+	FILE *file = tmpfile();
+	bool initialised, headerWritten;
+	int written;
+
+	assert(file);
+
+	initialised = frameEncoderInit(&encoder, fields, originalFrames->fieldCount, original->frameIntervalI);
+	assert(initialised);
+	(void) initialised;
+
+	encoder.pIntervalNum = pIntervalNum;
+	encoder.pIntervalDenom = pIntervalDenom;
+	encoder.minthrottle = original->sysConfig.minthrottle;
+	encoder.vbatref = original->sysConfig.vbatref;
+	encoder.motorOutputLow = original->sysConfig.motorOutputLow;
+
+	encoderBufferInit(&buffer, data, sizeof(data));
+
+	headerWritten = encoderPrint(&buffer, "H Product:Blackbox flight data recorder by Nicholas Sherlock\n")
+		&& encoderPrint(&buffer, "H Data version:2\n")
+		&& encoderPrintf(&buffer, "H I interval:%u\n", original->frameIntervalI)
+		&& encoderPrintf(&buffer, "H P interval:%d/%d\n", pIntervalNum, pIntervalDenom)
+		&& encoderPrint(&buffer, "H Firmware type:Cleanflight\n")
+		&& frameEncoderWriteFieldHeaders(&encoder, &buffer)
+		&& encoderPrintf(&buffer, "H minthrottle:%d\n", original->sysConfig.minthrottle)
+		&& encoderPrintf(&buffer, "H vbatref:%u\n", original->sysConfig.vbatref)
+		&& encoderPrint(&buffer, "H features:0\n");
+	assert(headerWritten);
+	(void) headerWritten;
+
+	written = 0;
+	while (written < originalFrames->frameCount) {
+		int chunk = frameEncoderWriteFrames(&encoder, &buffer,
+			originalFrames->frames + (size_t) written * originalFrames->fieldCount, originalFrames->frameCount - written);
+
+		assert(chunk > 0);
+		written += chunk;
+
+		writeBuffer(&buffer, file);
+	}
+
+	fflush(file);
+
+	log = decodeLog(file, decoded);
+
+	assert(log->stats.totalCorruptFrames == 0);
+	assert(decoded->fieldCount == originalFrames->fieldCount);
+	assert(decoded->frameCount == originalFrames->frameCount);
+	assert(memcmp(decoded->frames, originalFrames->frames, (size_t) decoded->frameCount * decoded->fieldCount * sizeof(*decoded->frames)) == 0);
+
+	printf("%s: %d frames\n", name, decoded->frameCount);
+
+	flightLogDestroy(log);
+	fclose(file);
+}
+
+static bool isDroppedIteration(int64_t iteration)
+{
+	for (unsigned int i = 0; i < sizeof(DROPPED_ITERATIONS) / sizeof(DROPPED_ITERATIONS[0]); i++) {
+		if (iteration >= DROPPED_ITERATIONS[i][0] && iteration < DROPPED_ITERATIONS[i][1])
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Encode only the even iterations (as logged with a P interval of 1/2) less the dropped ones, and check that the frame
+ * after each gap was written as an I frame, while the iterations that a 1/2 P interval skips anyway didn't force one.
+ */
+static void checkSkippedFrames(flightLog_t *original, const decodedLog_t *originalFrames, const encoderField_t *fields)
+{
+	int fieldCount = originalFrames->fieldCount;
+	decodedLog_t kept, decoded;
+	int64_t lastIteration = -1;
+	int forcedIntraframes = 0;
+
+	assert(original->frameIntervalI % 2 == 0);
+
+	kept.fieldCount = fieldCount;
+	kept.frameCount = 0;
+	kept.frames = malloc((size_t) originalFrames->frameCount * fieldCount * sizeof(*kept.frames));
+	kept.frameTypes = NULL;
+
+	for (int i = 0; i < originalFrames->frameCount; i++) {
+		const int64_t *frame = originalFrames->frames + (size_t) i * fieldCount;
+		int64_t iteration = frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+
+		if (iteration % 2 == 0 && !isDroppedIteration(iteration)) {
+			memcpy(kept.frames + (size_t) kept.frameCount * fieldCount, frame, fieldCount * sizeof(*frame));
+			kept.frameCount++;
+		}
+	}
+
+	checkRoundTrip("P interval 1/2 with gaps", original, &kept, fields, 1, 2, &decoded);
+
+	for (int i = 0; i < decoded.frameCount; i++) {
+		int64_t iteration = decoded.frames[(size_t) i * fieldCount + FLIGHT_LOG_FIELD_INDEX_ITERATION];
+		bool intervalDue = iteration % original->frameIntervalI == 0;
+		bool followsOn = lastIteration != -1 && iteration == lastIteration + 2;
+
+		assert(decoded.frameTypes[i] == (intervalDue || !followsOn ? 'I' : 'P'));
+
+		if (!intervalDue && !followsOn)
+			forcedIntraframes++;
+
+		lastIteration = iteration;
+	}
+
+	// The one after each gap is forced (and the first frame too, if its iteration isn't a multiple of the I interval)
+	assert(forcedIntraframes >= (int) (sizeof(DROPPED_ITERATIONS) / sizeof(DROPPED_ITERATIONS[0])));
+
+	freeDecodedLog(&decoded);
+	freeDecodedLog(&kept);
+}
+
+static void checkBits(void)
+{
+	uint8_t data[64];
+	encoderBuffer_t buffer;
+	bool printed;
+
+	encoderBufferInit(&buffer, data, sizeof(data));
+
+	// Writes that cross the 32-bit boundary of the accumulator
+	encoderWriteBits(&buffer, 0x5, 3);
+	encoderWriteBits(&buffer, 0xFFFFFFFF, 32);
+	encoderWriteBits(&buffer, 0x0, 5);
+	encoderFlushBits(&buffer);
+
+	assert(encoderBufferLength(&buffer) == 5);
+	assert(data[0] == 0xBF && data[1] == 0xFF && data[2] == 0xFF && data[3] == 0xFF && data[4] == 0xE0);
+
+	// Flushing an empty accumulator writes nothing
+	encoderFlushBits(&buffer);
+	assert(encoderBufferLength(&buffer) == 5);
+
+	// A buffer with no room left refuses text
+	encoderBufferInit(&buffer, data, 4);
+	printed = encoderPrintf(&buffer, "%d", 12345);
+	assert(!printed);
+	printed = encoderPrintf(&buffer, "%d", 123);
+	assert(printed);
+	(void) printed;
+	assert(encoderBufferLength(&buffer) == 3);
+}
+
+static void checkLogFile(const char *filename)
+{
+	FILE *file = fopen(filename, "rb");
+	flightLog_t *log;
+	flightLogFrameDef_t *frameDefI, *frameDefP;
+	decodedLog_t decoded, roundTrip;
+	encoderField_t fields[ENCODER_MAX_FIELDS];
+
+	if (!file) {
+		fprintf(stderr, "Failed to open %s\n", filename);
+		exit(-1);
+	}
+
+	log = decodeLog(file, &decoded);
+
+	frameDefI = &log->frameDefs['I'];
+	frameDefP = &log->frameDefs['P'];
+
+	assert(decoded.frameCount > 0);
+	assert(frameDefI->fieldCount <= ENCODER_MAX_FIELDS);
+
+	for (int i = 0; i < frameDefI->fieldCount; i++) {
+		fields[i].name = frameDefI->fieldName[i];
+		fields[i].isSigned = frameDefI->fieldSigned[i];
+		fields[i].Ipredict = frameDefI->predictor[i];
+		fields[i].Iencode = frameDefI->encoding[i];
+		fields[i].Ppredict = frameDefP->predictor[i];
+		fields[i].Pencode = frameDefP->encoding[i];
+	}
+
+	checkRoundTrip(filename, log, &decoded, fields, log->frameIntervalPNum, log->frameIntervalPDenom, &roundTrip);
+	freeDecodedLog(&roundTrip);
+
+	checkSkippedFrames(log, &decoded, fields);
+
+	// Swap the plain VB fields of the P frames for each of the Elias encodings in turn
+	for (int i = 0, swapped = 0; i < frameDefI->fieldCount; i++) {
+		static const FlightLogFieldEncoding ELIAS_ENCODINGS[] = {
+			FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_S32, FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_S32
+		};
+
+		if (fields[i].Pencode == FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB) {
+			fields[i].Pencode = ELIAS_ENCODINGS[swapped % 2];
+			swapped++;
+		}
+	}
+
+	checkRoundTrip("Elias encodings", log, &decoded, fields, log->frameIntervalPNum, log->frameIntervalPDenom, &roundTrip);
+	freeDecodedLog(&roundTrip);
+
+	freeDecodedLog(&decoded);
+	flightLogDestroy(log);
+	fclose(file);
+}
+
+int main(int argc, char **argv)
+{
+	checkBits();
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			checkLogFile(argv[i]);
+		}
+	} else {
+		checkLogFile("data/synthetic.bbl");
+	}
+
+	printf("Done\n");
+
+	return 0;
+}
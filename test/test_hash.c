@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/hash.h"
+
+#define BUFFER_LENGTH 5000
+
+static bool hashesEqual(hash128_t a, hash128_t b)
+{
+	return a.low == b.low && a.high == b.high;
+}
+
+static void fillBuffer(uint8_t *buffer, size_t length)
+{
+	uint32_t state = 12345;
+
+	for (size_t i = 0; i < length; i++) {
+		state = state * 1103515245 + 12345;
+		buffer[i] = state >> 16;
+	}
+}
+
+static void testDeterministic(const uint8_t *buffer)
+{
+	assert(hashesEqual(hash128(buffer, BUFFER_LENGTH, 0), hash128(buffer, BUFFER_LENGTH, 0)));
+	assert(!hashesEqual(hash128(buffer, BUFFER_LENGTH, 0), hash128(buffer, BUFFER_LENGTH, 1)));
+}
+
+/**
+ * Every length (across the stripe and block boundaries) should give a different hash, even when the extra bytes are
+ * zeros, since the tail is zero-padded.
+ */
+static void testLengths(void)
+{
+	uint8_t zeros[BUFFER_LENGTH];
+	static hash128_t hashes[BUFFER_LENGTH];
+
+	memset(zeros, 0, sizeof(zeros));
+
+	for (int length = 0; length < BUFFER_LENGTH; length++) {
+		hashes[length] = hash128(zeros, length, 0);
+
+		for (int i = 0; i < length; i++) {
+			assert(!hashesEqual(hashes[i], hashes[length]));
+		}
+	}
+}
+
+static void testBitFlips(uint8_t *buffer)
+{
+	hash128_t original = hash128(buffer, BUFFER_LENGTH, 0);
+
+	for (int i = 0; i < BUFFER_LENGTH; i += 7) {
+		for (int bit = 0; bit < 8; bit++) {
+			buffer[i] ^= 1 << bit;
+
+			hash128_t flipped = hash128(buffer, BUFFER_LENGTH, 0);
+
+			assert(!hashesEqual(original, flipped));
+			// Both halves should change
+			assert(original.low != flipped.low && original.high != flipped.high);
+
+			buffer[i] ^= 1 << bit;
+		}
+	}
+}
+
+static void testAlignment(const uint8_t *buffer)
+{
+	uint8_t *copy = malloc(BUFFER_LENGTH + 8);
+	hash128_t expected = hash128(buffer, BUFFER_LENGTH, 0);
+
+	for (int offset = 0; offset < 8; offset++) {
+		memcpy(copy + offset, buffer, BUFFER_LENGTH);
+
+		assert(hashesEqual(hash128(copy + offset, BUFFER_LENGTH, 0), expected));
+	}
+
+	free(copy);
+}
+
+int main(void)
+{
+	uint8_t buffer[BUFFER_LENGTH];
+
+	fillBuffer(buffer, sizeof(buffer));
+
+	testDeterministic(buffer);
+	testLengths();
+	testBitFlips(buffer);
+	testAlignment(buffer);
+
+	printf("Done\n");
+
+	return 0;
+}
@@ -0,0 +1,361 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+//For msvcrt to define M_PI:
+#define _USE_MATH_DEFINES
+
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/parser.h"
+#include "../src/imu.h"
+#include "../src/attitude.h"
+
+/*
+ * Checks that the attitude computed with imuSetFastMath(true) stays within IMU_TOLERANCE of the exact calculation,
+ * over the logs named on the command line (data/synthetic.bbl by default) and over a synthetic flight with gyro deltas
+ * large enough to miss the small-angle path. Also checks that computing the attitude in warmed-up segments on several
+ * threads matches computing it in one piece.
+ */
+
+// Radians (about 0.006 degrees, finer than the 0.01 degree resolution of the decoder's output)
+#define IMU_TOLERANCE 0.0001
+
+/*
+ * Roll and heading are undefined when the craft points straight up or down (gimbal lock), and any rounding difference
+ * swings them wildly there, so they're only compared when the pitch is further than this from vertical.
+ */
+#define GIMBAL_LOCK_MARGIN (5.0 * M_PI / 180)
+
+#define RANDOM_FLIGHT_FRAMES 2000
+
+// Enough frames for each segment to be as long as its warm-up
+#define SEGMENT_THREADS 4
+#define SEGMENT_WARMUP_FRAMES 10000
+#define SEGMENTED_FLIGHT_FRAMES (SEGMENT_THREADS * SEGMENT_WARMUP_FRAMES)
+
+typedef struct imuFrame_t {
+	int16_t gyroADC[3], accSmooth[3], magADC[3];
+	uint32_t time;
+} imuFrame_t;
+
+typedef struct imuFlight_t {
+	imuFrame_t *frames;
+	int frameCount, frameCapacity;
+	bool hasMag;
+	uint16_t acc_1G;
+	float gyroScale;
+} imuFlight_t;
+
+static imuFlight_t flight;
+
+static void addFrame(imuFrame_t *frame)
+{
+	if (flight.frameCount == flight.frameCapacity) {
+		flight.frameCapacity = flight.frameCapacity ? flight.frameCapacity * 2 : 1024;
+		flight.frames = realloc(flight.frames, flight.frameCapacity * sizeof(*flight.frames));
+	}
+
+	flight.frames[flight.frameCount++] = *frame;
+}
+
+static void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+	imuFrame_t imuFrame;
+
+	(void) fieldCount;
+	(void) frameOffset;
+	(void) frameSize;
+
+	if (!frameValid || (frameType != 'I' && frameType != 'P')) {
+		return;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		imuFrame.gyroADC[axis] = (int16_t) frame[log->mainFieldIndexes.gyroADC[axis]];
+		imuFrame.accSmooth[axis] = (int16_t) frame[log->mainFieldIndexes.accSmooth[axis]];
+		imuFrame.magADC[axis] = flight.hasMag ? (int16_t) frame[log->mainFieldIndexes.magADC[axis]] : 0;
+	}
+
+	imuFrame.time = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+
+	addFrame(&imuFrame);
+}
+
+static double angleError(float a, float b)
+{
+	double error = fabs((double) a - b);
+
+	// Heading wraps around at 2 pi
+	return fmin(error, 2 * M_PI - error);
+}
+
+static void runFlight(bool fast, attitude_t *attitudes)
+{
+	imuInit();
+	imuSetFastMath(fast);
+
+	for (int i = 0; i < flight.frameCount; i++) {
+		imuFrame_t *frame = &flight.frames[i];
+
+		updateEstimatedAttitude(frame->gyroADC, frame->accSmooth, flight.hasMag ? frame->magADC : NULL, frame->time,
+			flight.acc_1G, flight.gyroScale, &attitudes[i]);
+	}
+}
+
+/*
+ * Split the flight into SEGMENT_THREADS segments and check that the result matches the sequential calculation. Without
+ * a magnetometer the heading never forgets its starting point, so only roll and pitch are compared.
+ */
+static void checkSegments(const char *name)
+{
+	enum {
+		FIELD_GYRO = 0, FIELD_ACC = 3, FIELD_MAG = 6, FIELD_ROLL = 9, FIELD_PITCH, FIELD_HEADING, FIELD_COUNT
+	};
+	datapoints_t *points = datapointsCreate(FIELD_COUNT, NULL, flight.frameCount);
+	attitudeFields_t fields;
+	attitudeSettings_t settings = {flight.acc_1G, flight.gyroScale, false, SEGMENT_WARMUP_FRAMES};
+	attitude_t divergence;
+	bool added;
+
+	for (int axis = 0; axis < 3; axis++) {
+		fields.gyroADC[axis] = FIELD_GYRO + axis;
+		fields.accSmooth[axis] = FIELD_ACC + axis;
+		fields.magADC[axis] = flight.hasMag ? FIELD_MAG + axis : -1;
+	}
+	fields.roll = FIELD_ROLL;
+	fields.pitch = FIELD_PITCH;
+	fields.heading = FIELD_HEADING;
+
+	for (int i = 0; i < flight.frameCount; i++) {
+		int64_t frame[FIELD_COUNT] = {0};
+
+		for (int axis = 0; axis < 3; axis++) {
+			frame[FIELD_GYRO + axis] = flight.frames[i].gyroADC[axis];
+			frame[FIELD_ACC + axis] = flight.frames[i].accSmooth[axis];
+			frame[FIELD_MAG + axis] = flight.frames[i].magADC[axis];
+		}
+
+		added = datapointsAddFrame(points, flight.frames[i].time, frame);
+		assert(added);
+	}
+
+	(void) added;
+
+	// In one piece it should be the same calculation
+	attitudeCompute(points, &fields, &settings, 1);
+	attitudeMaxDivergence(points, &fields, &settings, &divergence);
+
+	assert(divergence.roll == 0 && divergence.pitch == 0 && divergence.heading == 0);
+
+	attitudeCompute(points, &fields, &settings, SEGMENT_THREADS);
+	attitudeMaxDivergence(points, &fields, &settings, &divergence);
+
+	if (flight.hasMag) {
+		printf("%s: %d segments differ by at most roll %.2e, pitch %.2e, heading %.2e radians\n", name,
+			SEGMENT_THREADS, divergence.roll, divergence.pitch, divergence.heading);
+
+		assert(divergence.heading < IMU_TOLERANCE);
+	} else {
+		printf("%s: %d segments differ by at most roll %.2e, pitch %.2e radians\n", name,
+			SEGMENT_THREADS, divergence.roll, divergence.pitch);
+	}
+
+	assert(divergence.roll < IMU_TOLERANCE);
+	assert(divergence.pitch < IMU_TOLERANCE);
+
+	datapointsDestroy(points);
+}
+
+static void checkFlight(const char *name)
+{
+	attitude_t *exact = malloc(flight.frameCount * sizeof(*exact));
+	attitude_t *fast = malloc(flight.frameCount * sizeof(*fast));
+	double maxError[3] = {0, 0, 0};
+	int gimbalLockFrames = 0;
+
+	assert(flight.frameCount > 0);
+
+	runFlight(false, exact);
+	runFlight(true, fast);
+
+	for (int i = 0; i < flight.frameCount; i++) {
+		maxError[1] = fmax(maxError[1], angleError(exact[i].pitch, fast[i].pitch));
+
+		if (fabs(exact[i].pitch) > M_PI / 2 - GIMBAL_LOCK_MARGIN) {
+			gimbalLockFrames++;
+		} else {
+			maxError[0] = fmax(maxError[0], angleError(exact[i].roll, fast[i].roll));
+			maxError[2] = fmax(maxError[2], angleError(exact[i].heading, fast[i].heading));
+		}
+	}
+
+	printf("%s: %d frames (%d near vertical), max error roll %.2e, pitch %.2e, heading %.2e radians\n", name,
+		flight.frameCount, gimbalLockFrames, maxError[0], maxError[1], maxError[2]);
+
+	for (int axis = 0; axis < 3; axis++) {
+		assert(maxError[axis] < IMU_TOLERANCE);
+	}
+
+	free(exact);
+	free(fast);
+
+	free(flight.frames);
+	flight.frames = NULL;
+	flight.frameCount = flight.frameCapacity = 0;
+}
+
+static void checkLogFile(const char *filename)
+{
+	int fd = open(filename, O_RDONLY);
+	flightLog_t *log;
+	bool parsed;
+
+	assert(fd >= 0);
+
+	log = flightLogCreate(fd);
+	assert(log);
+
+	for (int logIndex = 0; logIndex < log->logCount; logIndex++) {
+		char name[256];
+
+		parsed = flightLogParse(log, logIndex, NULL, NULL, NULL, false);
+		assert(parsed);
+
+		if (log->mainFieldIndexes.gyroADC[0] == -1 || log->mainFieldIndexes.accSmooth[0] == -1 || !log->sysConfig.acc_1G) {
+			continue;
+		}
+
+		flight.hasMag = log->mainFieldIndexes.magADC[0] != -1;
+		flight.acc_1G = log->sysConfig.acc_1G;
+		flight.gyroScale = log->sysConfig.gyroScale;
+
+		parsed = flightLogParse(log, logIndex, NULL, onFrameReady, NULL, false);
+		assert(parsed);
+
+		snprintf(name, sizeof(name), "%s log %d", filename, logIndex + 1);
+		checkFlight(name);
+	}
+
+	(void) parsed;
+
+	flightLogDestroy(log);
+	close(fd);
+}
+
+static double randomDouble(double min, double max)
+{
+	return min + (max - min) * rand() / RAND_MAX;
+}
+
+/*
+ * Two seconds of a 1kHz flight with the full range of gyro rates (up to 0.035 radians per frame) and a magnetometer,
+ * so both the polynomial trig and the mag heading are exercised. The accelerometer measures 1G in a direction which
+ * wanders all over the sphere, as if the craft was tumbling.
+ *
+ * This is kept short because a tumbling craft makes the estimate chaotic: over longer flights, differences in the last
+ * bit of a float grow without bound (between the exact calculation and itself built with FMA, too).
+ */
+static void checkRandomFlight(void)
+{
+	imuFrame_t frame = {{0, 0, 0}, {0, 0, 4096}, {300, 0, -400}, 1000000};
+	double gravity[3] = {0, 0, 1};
+
+	srand(1);
+
+	flight.hasMag = true;
+	flight.acc_1G = 4096;
+	flight.gyroScale = 1.2e-9f; // Radians per microsecond per gyro unit (2000 deg/s at 29000)
+
+	for (int i = 0; i < RANDOM_FLIGHT_FRAMES; i++) {
+		double length = 0;
+
+		for (int axis = 0; axis < 3; axis++) {
+			gravity[axis] += randomDouble(-0.02, 0.02);
+			length += gravity[axis] * gravity[axis];
+		}
+
+		length = sqrt(length);
+
+		for (int axis = 0; axis < 3; axis++) {
+			int gyro = frame.gyroADC[axis] + rand() % 2001 - 1000;
+
+			gravity[axis] /= length;
+
+			frame.gyroADC[axis] = (int16_t) (gyro > 29000 ? 29000 : gyro < -29000 ? -29000 : gyro);
+			frame.accSmooth[axis] = (int16_t) (gravity[axis] * flight.acc_1G + rand() % 201 - 100);
+			frame.magADC[axis] += rand() % 21 - 10;
+		}
+
+		frame.time += 1000;
+
+		addFrame(&frame);
+	}
+
+	checkFlight("random flight");
+}
+
+/*
+ * A 1kHz flight which wobbles gently around level, long enough to be split into SEGMENT_THREADS segments which each
+ * get a full warm-up. It's checked with its magnetometer and then again without.
+ */
+static void checkSegmentedFlight(void)
+{
+	imuFrame_t frame = {{0, 0, 0}, {0, 0, 4096}, {300, 0, -400}, 1000000};
+
+	srand(2);
+
+	flight.hasMag = true;
+	flight.acc_1G = 4096;
+	flight.gyroScale = 1.2e-9f;
+
+	for (int i = 0; i < SEGMENTED_FLIGHT_FRAMES; i++) {
+		double angle = i * 0.002;
+
+		frame.gyroADC[0] = (int16_t) (2000 * cos(angle) + rand() % 201 - 100);
+		frame.gyroADC[1] = (int16_t) (1500 * sin(angle * 0.7) + rand() % 201 - 100);
+		frame.gyroADC[2] = (int16_t) (rand() % 401 - 200);
+
+		frame.accSmooth[0] = (int16_t) (400 * sin(angle * 0.7) + rand() % 101 - 50);
+		frame.accSmooth[1] = (int16_t) (-500 * cos(angle) + rand() % 101 - 50);
+		frame.accSmooth[2] = (int16_t) (4000 + rand() % 101 - 50);
+
+		frame.magADC[0] = (int16_t) (300 * cos(angle * 0.1) + rand() % 11 - 5);
+		frame.magADC[1] = (int16_t) (300 * sin(angle * 0.1) + rand() % 11 - 5);
+
+		frame.time += 1000;
+
+		addFrame(&frame);
+	}
+
+	checkSegments("segmented flight");
+
+	flight.hasMag = false;
+	checkSegments("segmented flight without mag");
+
+	free(flight.frames);
+	flight.frames = NULL;
+	flight.frameCount = flight.frameCapacity = 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			checkLogFile(argv[i]);
+		}
+	} else {
+		checkLogFile("data/synthetic.bbl");
+	}
+
+	checkRandomFlight();
+	checkSegmentedFlight();
+
+	printf("Done\n");
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+#define _FILE_OFFSET_BITS 64
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "../src/parser.h"
+
+/*
+ * Checks that logs beginning beyond the first 4GB of a file are found and decoded with the right offsets. The test
+ * file is sparse, so it doesn't need 6GB of disk space.
+ */
+
+#define SECOND_LOG_OFFSET (6ULL * 1024 * 1024 * 1024 + 12345)
+#define FRAMES_PER_LOG 10
+
+static const char logHeader[] =
+	"H Product:Blackbox flight data recorder by Nicholas Sherlock\n"
+	"H Data version:2\n"
+	"H I interval:1\n"
+	"H P interval:1/1\n"
+	"H Field I name:loopIteration,time\n"
+	"H Field I signed:0,0\n"
+	"H Field I predictor:0,0\n"
+	"H Field I encoding:1,1\n"
+	"H Field P predictor:6,2\n"
+	"H Field P encoding:9,0\n"
+	"H features:0\n";
+
+static int64_t firstFrameOffset;
+static int framesSeen;
+
+static size_t writeUnsignedVB(uint8_t *buffer, uint32_t value)
+{
+	size_t length = 0;
+
+	while (value > 127) {
+		buffer[length++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	buffer[length++] = (uint8_t) value;
+
+	return length;
+}
+
+static void writeLog(int fd, uint64_t offset)
+{
+	uint8_t buffer[sizeof(logHeader) + FRAMES_PER_LOG * 16];
+	size_t length = strlen(logHeader);
+	ssize_t written;
+
+	memcpy(buffer, logHeader, length);
+
+	for (uint32_t i = 0; i < FRAMES_PER_LOG; i++) {
+		buffer[length++] = 'I';
+		length += writeUnsignedVB(buffer + length, i);
+		length += writeUnsignedVB(buffer + length, 1000000 + i * 1000);
+	}
+
+	written = pwrite(fd, buffer, length, (off_t) offset);
+	assert(written == (ssize_t) length);
+	(void) written;
+}
+
+static void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+	(void) log;
+	(void) frame;
+	(void) fieldCount;
+	(void) frameSize;
+
+	if (frameValid && frameType == 'I') {
+		if (framesSeen == 0) {
+			firstFrameOffset = frameOffset;
+		}
+		framesSeen++;
+	}
+}
+
+int main(void)
+{
+	char filename[] = "/tmp/blackbox_largefile_XXXXXX";
+	int fd = mkstemp(filename);
+	flightLog_t *log;
+	bool parsed;
+
+	assert(fd >= 0);
+
+	writeLog(fd, 0);
+	writeLog(fd, SECOND_LOG_OFFSET);
+
+	log = flightLogCreateWithIOBackend(fd, IO_BACKEND_MMAP, false);
+	assert(log);
+
+	assert(log->logCount == 2);
+	assert((uint64_t) (log->logBegin[1] - log->logBegin[0]) == SECOND_LOG_OFFSET);
+	assert((uint64_t) (log->logBegin[1] - log->logBegin[0]) > UINT32_MAX);
+
+	parsed = flightLogParse(log, 1, NULL, onFrameReady, NULL, false);
+	assert(parsed);
+	(void) parsed;
+
+	assert(framesSeen == FRAMES_PER_LOG);
+	// Frame offsets point just past the frame's marker byte
+	assert((uint64_t) firstFrameOffset == SECOND_LOG_OFFSET + strlen(logHeader) + 1);
+	assert(log->stats.frame['I'].validCount == FRAMES_PER_LOG);
+	assert(log->stats.totalBytes == (uint64_t) (log->logBegin[2] - log->logBegin[1]));
+
+	flightLogDestroy(log);
+
+	close(fd);
+	unlink(filename);
+
+	return 0;
+}
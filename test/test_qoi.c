@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/qoi.h"
+
+/*
+ * Encode premultiplied ARGB32 images and check that a straightforward QOI decoder gives back the unpremultiplied
+ * pixels.
+ */
+
+#define WIDTH 173
+#define HEIGHT 61
+// Rows are padded, like Cairo does
+#define STRIDE (WIDTH * 4 + 12)
+
+static uint32_t randomState = 1;
+
+static uint32_t randomNumber(void)
+{
+	randomState = randomState * 1103515245 + 12345;
+	return randomState >> 16;
+}
+
+static uint32_t premultiply(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	return (uint32_t) a << 24 | (uint32_t) (r * a / 255) << 16 | (uint32_t) (g * a / 255) << 8 | (b * a / 255);
+}
+
+/**
+ * Decode the QOI image into RGBA bytes, checking the header matches the given size.
+ */
+static void decode(const uint8_t *data, size_t length, int width, int height, uint8_t *rgba)
+{
+	uint8_t index[64][4], pixel[4] = {0, 0, 0, 255};
+	const uint8_t *p = data + 14;
+	int run = 0;
+
+	memset(index, 0, sizeof(index));
+
+	assert(memcmp(data, "qoif", 4) == 0);
+	assert((data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7]) == width);
+	assert((data[8] << 24 | data[9] << 16 | data[10] << 8 | data[11]) == height);
+	assert(data[12] == 4);
+
+	for (int i = 0; i < width * height; i++) {
+		if (run > 0) {
+			run--;
+		} else {
+			int op = *p++;
+
+			if (op == 0xFE) {
+				pixel[0] = *p++;
+				pixel[1] = *p++;
+				pixel[2] = *p++;
+			} else if (op == 0xFF) {
+				pixel[0] = *p++;
+				pixel[1] = *p++;
+				pixel[2] = *p++;
+				pixel[3] = *p++;
+			} else if ((op & 0xC0) == 0x00) {
+				memcpy(pixel, index[op], 4);
+			} else if ((op & 0xC0) == 0x40) {
+				pixel[0] += ((op >> 4) & 0x03) - 2;
+				pixel[1] += ((op >> 2) & 0x03) - 2;
+				pixel[2] += (op & 0x03) - 2;
+			} else if ((op & 0xC0) == 0x80) {
+				int second = *p++;
+				int dg = (op & 0x3F) - 32;
+
+				pixel[0] += dg - 8 + ((second >> 4) & 0x0F);
+				pixel[1] += dg;
+				pixel[2] += dg - 8 + (second & 0x0F);
+			} else {
+				run = op & 0x3F;
+			}
+
+			memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+		}
+
+		memcpy(rgba + i * 4, pixel, 4);
+	}
+
+	assert(run == 0);
+	assert(memcmp(p, "\0\0\0\0\0\0\0\1", 8) == 0);
+	assert(p + 8 == data + length);
+}
+
+static void checkImage(const uint8_t *pixels)
+{
+	uint8_t *encoded = malloc(qoiMaxEncodedLength(WIDTH, HEIGHT));
+	uint8_t *rgba = malloc(WIDTH * HEIGHT * 4);
+	size_t length = qoiEncodeARGB32(pixels, WIDTH, HEIGHT, STRIDE, encoded);
+
+	assert(length <= qoiMaxEncodedLength(WIDTH, HEIGHT));
+
+	decode(encoded, length, WIDTH, HEIGHT, rgba);
+
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			uint32_t argb = ((const uint32_t *) (pixels + y * STRIDE))[x];
+			const uint8_t *decoded = rgba + (y * WIDTH + x) * 4;
+			uint32_t a = argb >> 24;
+
+			assert(decoded[3] == a);
+
+			for (int c = 0; c < 3; c++) {
+				uint32_t premultiplied = (argb >> (16 - 8 * c)) & 0xFF;
+				uint32_t expected = a == 0 ? 0 : (premultiplied * 255 + a / 2) / a;
+
+				assert(decoded[c] == expected);
+			}
+		}
+	}
+
+	free(encoded);
+	free(rgba);
+}
+
+int main(void)
+{
+	uint8_t *pixels = calloc(HEIGHT, STRIDE);
+
+	// Transparent, then runs of a few colours (longer than the maximum run length), then noise and gradients
+	checkImage(pixels);
+
+	for (int y = 0; y < HEIGHT; y++) {
+		uint32_t *row = (uint32_t *) (pixels + y * STRIDE);
+
+		for (int x = 0; x < WIDTH; x++) {
+			if (y < 10) {
+				row[x] = premultiply(x < 100 ? 255 : 20, 128, 0, y < 5 ? 255 : 128);
+			} else if (y < 30) {
+				row[x] = premultiply(randomNumber(), randomNumber(), randomNumber(), randomNumber() % 4 == 0 ? 255 : randomNumber());
+			} else if (y < 40) {
+				row[x] = premultiply(x, x + y, 255 - x, 255);
+			} else {
+				uint32_t colors[] = {premultiply(1, 2, 3, 255), premultiply(200, 100, 50, 200), 0};
+				row[x] = colors[randomNumber() % 3];
+			}
+		}
+	}
+
+	checkImage(pixels);
+
+	free(pixels);
+
+	printf("Done\n");
+
+	return 0;
+}
@@ -0,0 +1,334 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/parser.h"
+#include "../src/logrepair.h"
+
+/*
+ * Damages a log with inserted, deleted and garbled bytes, repairs it, and checks that the repaired log decodes cleanly
+ * to the same frames as the original (less the ones that were damaged), with a LOGGING_RESUME event at each gap, and
+ * that the repair reported every frame and byte that it dropped.
+ */
+
+#define MAX_FRAMES 100000
+#define MAX_GAPS 16
+
+/*
+ * The damage, each starting at the beginning of the main frame with the given index. A frame that's damaged partway
+ * through can still decode (to the wrong values), and then nothing can tell it from a real one.
+ */
+#define INSERT_FRAME 1000
+#define INSERT_LENGTH 150
+#define DELETE_FRAME 2000
+#define DELETE_LENGTH 40
+#define GARBLE_FRAME 3000
+#define GARBLE_LENGTH 100
+
+// The decoder stops at a 0xFF byte where it expects a frame marker (as in erased flash), so it never reads the rest
+#define STOP_FRAME 4000
+
+typedef struct decodedLog_t {
+	int fieldCount;
+	int frameCount;
+	int64_t *frames;
+	int64_t *frameOffsets;
+
+	int corruptFrames, invalidFrames, resumeEvents;
+} decodedLog_t;
+
+static decodedLog_t *decoding;
+
+static logRepairGap_t gaps[MAX_GAPS];
+static int gapCount;
+
+static void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+	(void) log;
+	(void) frameSize;
+
+	if (!frame) {
+		decoding->corruptFrames++;
+	} else if (!frameValid) {
+		decoding->invalidFrames++;
+	} else if (frameType == 'I' || frameType == 'P') {
+		assert(decoding->frameCount < MAX_FRAMES);
+
+		decoding->fieldCount = fieldCount;
+		memcpy(decoding->frames + (size_t) decoding->frameCount * fieldCount, frame, fieldCount * sizeof(*frame));
+		// The offset of the frame's marker byte
+		decoding->frameOffsets[decoding->frameCount] = frameOffset - 1;
+		decoding->frameCount++;
+	}
+}
+
+static void onEvent(flightLog_t *log, flightLogEvent_t *event)
+{
+	(void) log;
+
+	if (event->event == FLIGHT_LOG_EVENT_LOGGING_RESUME) {
+		decoding->resumeEvents++;
+	}
+}
+
+static void onGap(flightLog_t *log, const logRepairGap_t *gap)
+{
+	(void) log;
+
+	assert(gapCount < MAX_GAPS);
+
+	gaps[gapCount++] = *gap;
+}
+
+static flightLog_t* decodeLog(FILE *file, decodedLog_t *decoded)
+{
+	flightLog_t *log = flightLogCreate(fileno(file));
+	bool parsed;
+
+	assert(log);
+	assert(log->logCount == 1);
+
+	memset(decoded, 0, sizeof(*decoded));
+	decoded->frames = malloc((size_t) MAX_FRAMES * FLIGHT_LOG_MAX_FIELDS * sizeof(*decoded->frames));
+	decoded->frameOffsets = malloc(MAX_FRAMES * sizeof(*decoded->frameOffsets));
+
+	decoding = decoded;
+
+	parsed = flightLogParse(log, 0, NULL, onFrameReady, onEvent, false);
+	assert(parsed);
+	(void) parsed;
+
+	return log;
+}
+
+static void freeDecodedLog(decodedLog_t *decoded)
+{
+	free(decoded->frames);
+	free(decoded->frameOffsets);
+}
+
+static FILE* writeTempFile(const uint8_t *data, size_t length)
+{
+	FILE *file = tmpfile();
+	size_t written;
+
+	assert(file);
+
+	written = fwrite(data, 1, length, file);
+	assert(written == length);
+	(void) written;
+
+	fflush(file);
+
+	return file;
+}
+
+static uint8_t* readFile(const char *filename, size_t *length)
+{
+	FILE *file = fopen(filename, "rb");
+	uint8_t *data;
+
+	if (!file) {
+		fprintf(stderr, "Failed to open %s\n", filename);
+		exit(-1);
+	}
+
+	fseek(file, 0, SEEK_END);
+	*length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(*length);
+	*length = fread(data, 1, *length, file);
+
+	fclose(file);
+
+	return data;
+}
+
+/**
+ * Bytes that can't be mistaken for the beginning of a frame, for the same reason. These are never 0xFF either, which
+ * would stop the decoder.
+ */
+static uint8_t garbageByte(void)
+{
+	static uint32_t seed = 12345;
+	uint8_t result;
+
+	do {
+		seed = seed * 1103515245 + 12345;
+		result = (seed >> 16) % 0xFF;
+	} while (strchr("IPEGHS", result));
+
+	return result;
+}
+
+static void checkRepair(const char *filename)
+{
+	size_t originalLength, damagedLength = 0;
+	uint8_t *original = readFile(filename, &originalLength), *damaged = malloc(originalLength + INSERT_LENGTH);
+	int64_t insertAt, deleteAt, garbleAt, stopAt, copied;
+	decodedLog_t originalFrames, repairedFrames;
+	logRepairStats_t stats;
+	flightLog_t *log;
+	FILE *file, *repairedFile;
+	bool repaired;
+	int fieldCount, lastIteration, keptFrames, missingIterations;
+	int64_t droppedBytes;
+	uint32_t droppedMainFrames;
+
+	file = writeTempFile(original, originalLength);
+	log = decodeLog(file, &originalFrames);
+
+	fieldCount = originalFrames.fieldCount;
+
+	assert(originalFrames.frameCount > STOP_FRAME);
+	assert(originalFrames.corruptFrames == 0 && originalFrames.invalidFrames == 0);
+
+	// Original iterations are numbered from zero without any skipped, so the iteration is the frame's index
+	for (int i = 0; i < originalFrames.frameCount; i++) {
+		assert(originalFrames.frames[(size_t) i * fieldCount + FLIGHT_LOG_FIELD_INDEX_ITERATION] == i);
+	}
+
+	lastIteration = originalFrames.frameCount - 1;
+
+	flightLogDestroy(log);
+	fclose(file);
+
+	insertAt = originalFrames.frameOffsets[INSERT_FRAME];
+	deleteAt = originalFrames.frameOffsets[DELETE_FRAME];
+	garbleAt = originalFrames.frameOffsets[GARBLE_FRAME];
+	stopAt = originalFrames.frameOffsets[STOP_FRAME];
+
+	// Copy the log with all the damage in order
+	memcpy(damaged, original, insertAt);
+	damagedLength = insertAt;
+
+	for (int i = 0; i < INSERT_LENGTH; i++) {
+		damaged[damagedLength++] = garbageByte();
+	}
+
+	copied = deleteAt - insertAt;
+	memcpy(damaged + damagedLength, original + insertAt, copied);
+	damagedLength += copied;
+
+	copied = garbleAt - (deleteAt + DELETE_LENGTH);
+	memcpy(damaged + damagedLength, original + deleteAt + DELETE_LENGTH, copied);
+	damagedLength += copied;
+
+	for (int i = 0; i < GARBLE_LENGTH; i++) {
+		damaged[damagedLength++] = garbageByte();
+	}
+
+	copied = originalLength - (garbleAt + GARBLE_LENGTH);
+	memcpy(damaged + damagedLength, original + garbleAt + GARBLE_LENGTH, copied);
+	damagedLength += copied;
+
+	damaged[stopAt + INSERT_LENGTH - DELETE_LENGTH] = 0xFF;
+
+	// Repair it
+	file = writeTempFile(damaged, damagedLength);
+	log = flightLogCreate(fileno(file));
+	assert(log && log->logCount == 1);
+
+	repairedFile = tmpfile();
+	assert(repairedFile);
+
+	repaired = logRepairWrite(log, 0, repairedFile, onGap, &stats);
+	assert(repaired);
+	(void) repaired;
+
+	fflush(repairedFile);
+
+	// Every byte of the damaged log was either kept or reported as dropped
+	assert(stats.keptBytes + stats.paddingBytes + stats.dropped.bytes == (int64_t) damagedLength);
+	assert(stats.dropped.bytes >= INSERT_LENGTH + GARBLE_LENGTH + (int64_t) (originalLength - stopAt) - stats.paddingBytes);
+
+	flightLogDestroy(log);
+	fclose(file);
+
+	// One gap at each place the log was damaged, with the decoder stopping at the last
+	assert(gapCount == 4 && stats.gaps == 4);
+	assert(stats.resumesInserted == 3);
+
+	for (int i = 0; i < gapCount; i++) {
+		static const int DAMAGED_FRAMES[] = {INSERT_FRAME, DELETE_FRAME, GARBLE_FRAME, STOP_FRAME};
+
+		assert(gaps[i].haveFrameBefore);
+		assert(gaps[i].iterationBefore < (uint32_t) DAMAGED_FRAMES[i]);
+		assert(gaps[i].dropped.bytes > 0);
+
+		if (i < gapCount - 1) {
+			assert(!gaps[i].atEnd);
+			assert(gaps[i].haveFrameAfter && gaps[i].iterationAfter > (uint32_t) DAMAGED_FRAMES[i]);
+		} else {
+			// The last I-frame of the log, found in the data that the decoder never read
+			assert(gaps[i].atEnd);
+			assert(gaps[i].haveFrameAfter && (int) gaps[i].iterationAfter <= lastIteration
+				&& (int) gaps[i].iterationAfter > lastIteration - 256);
+		}
+	}
+
+	// The repaired log decodes cleanly
+	log = decodeLog(repairedFile, &repairedFrames);
+
+	assert(repairedFrames.corruptFrames == 0 && repairedFrames.invalidFrames == 0);
+	assert(log->stats.totalCorruptFrames == 0);
+	assert(repairedFrames.resumeEvents == 3);
+	assert(repairedFrames.fieldCount == fieldCount);
+	assert(repairedFrames.frameCount == (int) stats.mainFramesWritten);
+
+	for (int i = 0; i < 256; i++) {
+		assert(log->stats.frame[i].desyncCount == 0);
+	}
+
+	// Every frame that survived is the same as it was, and every one that didn't is inside a gap that was reported
+	keptFrames = 0;
+
+	for (int i = 0; i < repairedFrames.frameCount; i++) {
+		const int64_t *frame = repairedFrames.frames + (size_t) i * fieldCount;
+		int64_t iteration = frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+
+		assert(iteration >= 0 && iteration <= lastIteration);
+		assert(memcmp(frame, originalFrames.frames + (size_t) iteration * fieldCount, fieldCount * sizeof(*frame)) == 0);
+
+		keptFrames++;
+	}
+
+	missingIterations = 0;
+	droppedBytes = 0;
+	droppedMainFrames = 0;
+
+	for (int i = 0; i < gapCount; i++) {
+		uint32_t lastMissing = gaps[i].atEnd ? (uint32_t) lastIteration : gaps[i].iterationAfter - 1;
+
+		missingIterations += lastMissing - gaps[i].iterationBefore;
+		droppedBytes += gaps[i].dropped.bytes;
+		droppedMainFrames += gaps[i].dropped.mainFrames;
+	}
+
+	assert(keptFrames + missingIterations == originalFrames.frameCount);
+	assert(droppedBytes == stats.dropped.bytes && droppedMainFrames == stats.dropped.mainFrames);
+
+	printf("%s: kept %d frames, dropped %" PRId64 " bytes in %d gaps\n", filename, keptFrames, stats.dropped.bytes, gapCount);
+
+	flightLogDestroy(log);
+	fclose(repairedFile);
+
+	freeDecodedLog(&originalFrames);
+	freeDecodedLog(&repairedFrames);
+	free(original);
+	free(damaged);
+}
+
+int main(int argc, char **argv)
+{
+	checkRepair(argc > 1 ? argv[1] : "data/synthetic.bbl");
+
+	printf("Done\n");
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/rowfilter.h"
+
+static char mainNames[] = "loopIteration,time,motor[0],motor[1],motor[2],motor[3],gyroADC[0],axisP[0],axisP[1],axisD[0],axisD[1]";
+static char slowNames[] = "flightModeFlags,stateFlags,failsafePhase";
+
+static flightLogFrameDef_t mainDef, slowDef;
+
+static void splitNames(flightLogFrameDef_t *def, char *names)
+{
+	def->fieldCount = 0;
+
+	for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+		def->fieldName[def->fieldCount++] = name;
+	}
+}
+
+static bool matches(const char *expression, const int64_t *mainFrame, const int64_t *slowFrame)
+{
+	char error[256];
+	rowFilter_t *filter = rowFilterCompile(expression, &mainDef, &slowDef, error, sizeof(error));
+	bool result;
+
+	if (!filter) {
+		fprintf(stderr, "Failed to compile '%s': %s\n", expression, error);
+		assert(0);
+	}
+
+	result = rowFilterMatches(filter, mainFrame, slowFrame);
+
+	rowFilterDestroy(filter);
+
+	return result;
+}
+
+static bool compiles(const char *expression)
+{
+	rowFilter_t *filter = rowFilterCompile(expression, &mainDef, &slowDef, NULL, 0);
+
+	rowFilterDestroy(filter);
+
+	return filter != NULL;
+}
+
+int main(void)
+{
+	int64_t frame[] = {100, 5000000, 1500, 1960, 1400, 1450, -200, 30, 10, 20, 40};
+	int64_t slow[] = {2, 0, 0};
+
+	splitNames(&mainDef, mainNames);
+	splitNames(&slowDef, slowNames);
+
+	assert(matches("motor[1] > 1950", frame, slow));
+	assert(!matches("motor[0] > 1950", frame, slow));
+	assert(matches("motor[*] > 1950", frame, slow));
+	assert(!matches("motor[*] > 1990", frame, slow));
+
+	// Negating a wildcard comparison means "all of them"
+	assert(matches("!(motor[*] < 1000)", frame, slow));
+	assert(!matches("!(motor[*] < 1450)", frame, slow));
+
+	// Wildcards in one comparison are expanded in step
+	assert(matches("axisP[*] > axisD[*]", frame, slow));
+	assert(!matches("axisP[*] > axisD[*] + 10", frame, slow));
+
+	assert(matches("motor[*] > 1950 || gyroADC[0] > 1500", frame, slow));
+	assert(matches("gyroADC[0] < -100 && loopIteration % 2 == 0", frame, slow));
+	assert(!matches("gyroADC[0] < -100 && loopIteration % 3 == 0", frame, slow));
+	assert(matches("-gyroADC[0] == 200", frame, slow));
+	assert(matches("(time - 1000000) / 1000000 == 4", frame, slow));
+	assert(matches("motor[1]", frame, slow));
+	assert(matches("0x10 == 16", frame, slow));
+
+	// Slow frame fields and flag names, bitwise operators bind tighter than comparisons
+	assert(matches("flightModeFlags & HORIZON_MODE", frame, slow));
+	assert(!matches("flightModeFlags & ANGLE_MODE", frame, slow));
+	assert(matches("flightModeFlags & (ANGLE_MODE | HORIZON_MODE) != 0", frame, slow));
+	assert(matches("failsafePhase == IDLE", frame, slow));
+
+	// Where the precedence differs from C: "&" and "|" bind tighter than comparisons...
+	assert(matches("flightModeFlags & 2 == 2", frame, slow));
+	assert(matches("flightModeFlags | 1 == 3", frame, slow));
+	assert(matches("2 & 2 == 2", frame, slow));
+	// ...a "!" before a comparison negates the whole comparison...
+	assert(matches("!motor[0] > 2000", frame, slow));
+	assert(!matches("!motor[0] > 1000", frame, slow));
+	// ...but inside arithmetic it's the usual unary operator
+	assert(matches("-!motor[0] == 0", frame, slow));
+	// ...and comparisons don't chain, unless they're in brackets
+	assert(!compiles("motor[1] > motor[0] == 1"));
+	assert(matches("(motor[1] > motor[0]) == 1", frame, slow));
+	assert(!compiles("flightModeFlags ^ 1"));
+
+	// Division by zero doesn't crash
+	assert(!matches("motor[0] / 0", frame, slow));
+
+	assert(!compiles(""));
+	assert(!compiles("motor[4] > 1"));
+	assert(!compiles("servo[*] > 1"));
+	assert(!compiles("motor[*] > axisP[*]"));
+	assert(!compiles("motor[0] > "));
+	assert(!compiles("(motor[0] > 1"));
+	assert(!compiles("motor[0] = 1"));
+	assert(!compiles("motor[0] > 1 2"));
+
+	printf("Done\n");
+
+	return 0;
+}